@@ -0,0 +1,66 @@
+import os
+import random
+import sys
+
+# Generates a LUBM-like data set as CSV files for INMEMORY tables, together
+# with the edb.conf to load them.
+# python3 generate.py <universities> <output-folder> [seed]
+
+if len(sys.argv) < 3:
+    print("python3 generate.py <universities> <output-folder> [seed]")
+    exit(1)
+
+universities = int(sys.argv[1])
+outputdir = sys.argv[2]
+random.seed(int(sys.argv[3]) if len(sys.argv) > 3 else 0)
+os.makedirs(outputdir, exist_ok=True)
+
+relations = ['memberOf', 'subOrganizationOf', 'undergraduateDegreeFrom',
+        'advisor', 'teacherOf', 'takesCourse', 'worksFor', 'knows']
+files = dict((r, open(os.path.join(outputdir, r + '.csv'), 'wt')) for r in relations)
+
+def write(relation, a, b):
+    files[relation].write(a + ',' + b + '\n')
+
+nuniversities = max(universities, 2) * 10
+for u in range(universities):
+    for d in range(15):
+        dept = 'dept' + str(d) + '_' + str(u)
+        write('subOrganizationOf', dept, 'univ' + str(u))
+        profs = [dept + '_prof' + str(p) for p in range(30)]
+        courses = [dept + '_course' + str(c) for c in range(60)]
+        for i, prof in enumerate(profs):
+            write('worksFor', prof, dept)
+            write('teacherOf', prof, courses[2 * i])
+            write('teacherOf', prof, courses[2 * i + 1])
+        for s in range(400):
+            student = dept + '_student' + str(s)
+            write('memberOf', student, dept)
+            # Some students stay at the university of their undergraduate degree
+            if random.random() < 0.2:
+                degree = u
+            else:
+                degree = random.randrange(nuniversities)
+            write('undergraduateDegreeFrom', student, 'univ' + str(degree))
+            advisor = random.randrange(len(profs))
+            write('advisor', student, profs[advisor])
+            taken = random.sample(range(len(courses)), 4)
+            # Courses of the advisor are popular
+            if random.random() < 0.3:
+                taken[0] = 2 * advisor
+            for c in set(taken):
+                write('takesCourse', student, courses[c])
+            # Skewed social network within the department
+            for k in range(10):
+                friend = (int(random.paretovariate(1.0)) - 1) % 400
+                write('knows', student, dept + '_student' + str(friend))
+
+for f in files.values():
+    f.close()
+
+with open(os.path.join(outputdir, 'edb.conf'), 'wt') as conf:
+    for i, r in enumerate(relations):
+        conf.write('EDB%d_predname=%s\n' % (i, r))
+        conf.write('EDB%d_type=INMEMORY\n' % i)
+        conf.write('EDB%d_param0=%s\n' % (i, outputdir))
+        conf.write('EDB%d_param1=%s\n\n' % (i, r))
@@ -29,6 +29,10 @@ class VLogLayer : public DBLayer {
             init();
         }
 
+        Reasoner &getReasoner() {
+            return reasoner;
+        }
+
         VLIBEXP bool lookup(const std::string& text,
                 ::Type::ID type,
                 unsigned subType,
@@ -0,0 +1,188 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cstddef>
+#include <inttypes.h>
+
+//Blocks are taken from chunks of this size
+#define ARENA_CHUNK_SIZE (1 << 20)
+//Size classes are powers of two, from 16 bytes to 64KB. Larger blocks are
+//allocated on the heap
+#define ARENA_MIN_BLOCK 16
+#define ARENA_NCLASSES 13
+//Chunks kept when the arena is rewound, the others are released
+#define ARENA_RETAINED_CHUNKS 2
+
+/*
+ * Arena for the buffers of a rule execution (e.g. the buffers of the parallel
+ * joins and the hash tables). Blocks are cut from large chunks with a bump
+ * pointer. Freed blocks go in a free list of their size class, so that a
+ * growing vector reuses the blocks it leaves behind. When the rule execution
+ * is over, the arena is rewound and all the chunks are free again: the many
+ * short-lived buffers do not fragment the heap of the long-lived tables.
+ *
+ * The arena is rewound only if all its blocks were freed, so a buffer that
+ * outlives the rule execution stays valid. It is thread-safe, because the
+ * workers of a parallel join write in buffers created by the main thread.
+ */
+class TupleArena {
+    private:
+        struct FreeBlock {
+            FreeBlock *next;
+        };
+
+        std::mutex lock;
+        std::vector<char *> chunks;
+        size_t currentChunk;
+        size_t offset;
+        FreeBlock *freeLists[ARENA_NCLASSES];
+
+        size_t usedBytes;
+        size_t peakBytes;
+        uint64_t nAllocations;
+        uint64_t nRewinds;
+
+        static int getSizeClass(const size_t size);
+
+    public:
+        //Enables the arena on this thread while the scope is alive, and
+        //rewinds it at the end
+        class Scope {
+            private:
+                TupleArena &arena;
+                TupleArena *previous;
+
+            public:
+                Scope(TupleArena &arena);
+
+                ~Scope();
+        };
+
+        TupleArena();
+
+        void *allocate(const size_t size);
+
+        void deallocate(void *p, const size_t size);
+
+        //Frees all the chunks at once if no block is in use
+        void rewind();
+
+        size_t getUsedBytes() const {
+            return usedBytes;
+        }
+
+        size_t getPeakBytes() const {
+            return peakBytes;
+        }
+
+        size_t getReservedBytes() const {
+            return chunks.size() * ARENA_CHUNK_SIZE;
+        }
+
+        uint64_t getNAllocations() const {
+            return nAllocations;
+        }
+
+        uint64_t getNRewinds() const {
+            return nRewinds;
+        }
+
+        //Arena enabled on this thread, or NULL
+        static TupleArena *getCurrent();
+
+        ~TupleArena();
+};
+
+//STL allocator that takes the memory from the arena enabled on the thread
+//when the container is created, or from the heap if there is none
+template<typename T>
+class ArenaAllocator {
+    public:
+        typedef T value_type;
+
+        TupleArena *arena;
+
+        ArenaAllocator() : arena(TupleArena::getCurrent()) {
+        }
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {
+        }
+
+        T *allocate(const size_t n) {
+            if (arena != NULL) {
+                return (T *) arena->allocate(n * sizeof(T));
+            }
+            return (T *) ::operator new(n * sizeof(T));
+        }
+
+        void deallocate(T *p, const size_t n) {
+            if (arena != NULL) {
+                arena->deallocate(p, n * sizeof(T));
+            } else {
+                ::operator delete(p);
+            }
+        }
+};
+
+template<typename T, typename U>
+bool operator ==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena == b.arena;
+}
+
+template<typename T, typename U>
+bool operator !=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena != b.arena;
+}
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+//Objects up to this size are allocated in slabs
+#define SLAB_MAX_OBJECT 256
+#define SLAB_SIZE (64 * 1024)
+
+/*
+ * Slabs for the small objects that are created and destroyed in large
+ * numbers during the materialization (columns, segments, inserters and
+ * tables). The objects of a size (a multiple of 16 bytes) are packed in
+ * slabs of 64KB and freed objects are reused for the same size, instead of
+ * leaving holes between the large buffers of the heap. Classes inherit from
+ * SlabObject to be allocated here.
+ */
+class ObjectSlab {
+    public:
+        static void *allocate(const size_t size);
+
+        static void deallocate(void *p, const size_t size);
+
+        //Objects in use
+        static size_t getNObjects();
+
+        static size_t getReservedBytes();
+};
+
+class SlabObject {
+    public:
+        static void *operator new(const size_t size) {
+            return ObjectSlab::allocate(size);
+        }
+
+        static void operator delete(void *p, const size_t size) {
+            ObjectSlab::deallocate(p, size);
+        }
+};
+
+class MemoryStats {
+    public:
+        //Resident set size of the process, in bytes (0 if unknown)
+        static size_t getCurrentRSS();
+
+        //RSS, peak memory, and usage of the arena (if not NULL) and of the slabs
+        static std::string toString(const TupleArena *arena);
+};
+
+#endif
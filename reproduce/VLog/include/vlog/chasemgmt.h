@@ -8,9 +8,17 @@
 #include <map>
 #include <set>
 #include <unordered_map>
+#include <atomic>
 
 #define SIZE_BLOCK 1000
 
+//The rows of an existential variable are split in 2^CHASE_PARTITION_BITS
+//hash partitions, which can be probed and updated in parallel
+#define CHASE_PARTITION_BITS 4
+//Batches with fewer rows are processed one row at a time
+#define CHASE_MIN_BATCH_ROWS 1024
+#define CHASE_MIN_PARALLEL_ROWS 65536
+
 #define RULE_MASK INT64_C(0xffffff0000000000)
 #define RULE_SHIFT(x) (((uint64_t) ((x) + 1)) << 40)
 #define GET_RULE(x) (((x) >> 40) - 1)
@@ -62,10 +70,20 @@ class ChaseMgmt {
                 std::vector<std::unique_ptr<uint64_t[]>> blocks;
                 uint32_t blockCounter;
                 uint64_t *currentblock;
-                std::unordered_map<ChaseRow, uint64_t, hash_ChaseRow> rows;
+                std::vector<std::unordered_map<ChaseRow, uint64_t,
+                    hash_ChaseRow>> partitions;
                 TypeChase typeChase;
                 std::set<uint64_t> deps;    // For SUM chases.
 
+                size_t getPartition(const ChaseRow &r) const {
+                    const uint64_t h = hash_ChaseRow()(r);
+                    return (h * UINT64_C(0x9E3779B97F4A7C15)) >>
+                        (64 - CHASE_PARTITION_BITS);
+                }
+
+                //Copies the row in the blocks and gives it the next ID
+                uint64_t *storeRow(const uint64_t *row, uint64_t &value);
+
             public:
                 Rows(uint64_t startCounter, uint8_t sizerow,
                         std::vector<Var_t> nameArgVars,
@@ -76,6 +94,7 @@ class ChaseMgmt {
                         currentblock = NULL;
                         currentcounter = startCounter;
                         this->typeChase = typeChase;
+                        partitions.resize(1 << CHASE_PARTITION_BITS);
                     }
 
                 uint8_t getSizeRow() {
@@ -92,6 +111,13 @@ class ChaseMgmt {
 
                 bool existingRow(uint64_t *row, uint64_t &value);
 
+                //existingRow and addRow for the n rows in buffer (one after
+                //the other). The IDs are written in out, and the new rows get
+                //them in the order of their first occurrence, as if they were
+                //added one at a time. Not for the SUM chases
+                void getOrAddRows(const uint64_t *buffer, const size_t n,
+                        uint64_t *out, const int nthreads);
+
                 bool checkRecursive(uint64_t target, uint64_t value,
                         std::set<uint64_t> &toCheck);
         };
@@ -127,8 +153,11 @@ class ChaseMgmt {
         const bool checkCyclic;
 
         const int ruleToCheck;
+        const int nthreads;
         bool cyclic;
         PredId_t predIgnoreBlock;
+        //Substitutions whose head was not checked, since it is never satisfied
+        std::atomic<uint64_t> skippedChecks;
 
         bool checkSingle(uint64_t target, uint64_t rv, std::set<uint64_t> &toCheck);
 
@@ -138,7 +167,8 @@ class ChaseMgmt {
         ChaseMgmt(std::vector<RuleExecutionDetails> &rules,
                 const TypeChase typeChase, const bool checkCyclic,
                 const int ruleToCheck = -1,
-                const PredId_t predIgnoreBlocking = -1);
+                const PredId_t predIgnoreBlocking = -1,
+                const int nthreads = 1);
 
         std::shared_ptr<Column> getNewOrExistingIDs(
                 uint32_t ruleid,
@@ -182,6 +212,14 @@ class ChaseMgmt {
         bool isCheckCyclicMode() {
             return checkCyclic;
         }
+
+        void addSkippedChecks(uint64_t n) {
+            skippedChecks += n;
+        }
+
+        uint64_t getSkippedChecks() const {
+            return skippedChecks;
+        }
 };
 
 #endif
@@ -3,6 +3,7 @@
 
 #include <vlog/concepts.h>
 #include <vlog/edb.h>
+#include <vlog/arena.h>
 
 #include <trident/utils/parallel.h>
 
@@ -34,7 +35,7 @@ class ColumnReader {
 
 class ColumnWriter;
 
-class Column {
+class Column : public SlabObject {
     public:
         virtual bool isEmpty() const = 0;
 
@@ -48,12 +49,21 @@ class Column {
 
         virtual size_t getRepresentationSize() const = 0;
 
+        //Memory taken by the values stored in the column, in bytes
+        virtual size_t getBytes() const {
+            return getRepresentationSize() * sizeof(Term_t);
+        }
+
         virtual size_t estimateSize() const = 0;
 
         virtual Term_t getValue(const size_t pos) const = 0;
 
         virtual bool supportsDirectAccess() const = 0;
 
+        //Appends the values in [begin, end) to out
+        virtual void getValues(const size_t begin, const size_t end,
+                std::vector<Term_t> &out) const;
+
         virtual bool isBackedByVector() {
             return false;
         }
@@ -150,12 +160,19 @@ class CompressedColumn final : public Column {
             return blocks.size();
         }
 
+        size_t getBytes() const {
+            return blocks.capacity() * sizeof(CompressedColumnBlock);
+        }
+
         size_t estimateSize() const {
             return _size;
         }
 
         Term_t getValue(const size_t pos) const;
 
+        void getValues(const size_t begin, const size_t end,
+                std::vector<Term_t> &out) const;
+
         bool supportsDirectAccess() const {
             return true;
         }
@@ -264,6 +281,13 @@ class ColumnWriter {
         std::shared_ptr<Column> getColumn();
 
         static std::shared_ptr<Column> getColumn(std::vector<Term_t> &values, bool isSorted);
+
+        //Stores large columns bit-packed if it saves memory (see
+        //packedcolumn.h), and in a vector otherwise. values is emptied
+        static std::shared_ptr<Column> pack(std::vector<Term_t> &values, const bool isSorted);
+
+        //Columns with fewer values are not packed. 0 disables the packing
+        static void setPackMinRows(const size_t minRows);
 };
 
 //----- END GENERIC INTERFACES -------
@@ -376,6 +400,10 @@ class InmemoryColumn final : public Column {
             return values.size();
         }
 
+        size_t getBytes() const {
+            return values.capacity() * sizeof(Term_t);
+        }
+
         size_t estimateSize() const {
             return values.size();
         }
@@ -388,6 +416,11 @@ class InmemoryColumn final : public Column {
             return values[pos];
         }
 
+        void getValues(const size_t begin, const size_t end,
+                std::vector<Term_t> &out) const {
+            out.insert(out.end(), values.begin() + begin, values.begin() + end);
+        }
+
         bool supportsDirectAccess() const {
             return true;
         }
@@ -0,0 +1,65 @@
+#ifndef _COSTMODEL_H
+#define _COSTMODEL_H
+
+#include <vlog/concepts.h>
+#include <vlog/reliances/reliances.h>
+
+#include <vector>
+#include <string>
+#include <inttypes.h>
+
+//Timeout of the reliances of a query, in ms
+#define COSTMODEL_RELIANCE_TIMEOUT 1000
+
+//A query of the calibration, with the runtimes of both strategies
+struct CalibrationSample {
+    std::string query;
+    uint64_t cost;
+    RelevanceFeatures features;
+    double topDownMs;
+    double magicMs;
+};
+
+/*
+ * Decides between QSQR and magic sets from the estimated cardinality of the
+ * query and from the positive reliance graph of its relevant rules. QSQR
+ * evaluates the subqueries of a recursive group again at every iteration,
+ * while magic sets derive them once, so the cost is scaled by the number of
+ * recursive rules (and of restraints, which make the chase of magic sets
+ * cheaper). Recursion through existential rules always goes to magic sets:
+ * QSQR may not terminate on it.
+ *
+ * The threshold and the weights are fitted by Reasoner::calibrate on the
+ * runtimes of a workload, and kept in a file.
+ */
+class ReasoningCostModel {
+    public:
+        uint64_t threshold;
+        double recursionWeight;
+        double restraintWeight;
+
+        ReasoningCostModel(const uint64_t threshold) : threshold(threshold),
+        recursionWeight(0), restraintWeight(0) {
+        }
+
+        static RelevanceFeatures getFeatures(const Literal &query,
+                Program &program);
+
+        double getAdjustedCost(const uint64_t cost,
+                const RelevanceFeatures &features) const;
+
+        bool preferTopDown(const uint64_t cost,
+                const RelevanceFeatures &features) const;
+
+        //Chooses the parameters that minimize the total runtime of the
+        //samples
+        VLIBEXP void fit(const std::vector<CalibrationSample> &samples);
+
+        VLIBEXP bool load(const std::string &path);
+
+        VLIBEXP void save(const std::string &path) const;
+
+        std::string tostring() const;
+};
+
+#endif
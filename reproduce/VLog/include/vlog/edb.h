@@ -17,6 +17,7 @@
 #include <map>
 
 class Column;
+class InmemoryTable;
 class EDBMemIterator final : public EDBIterator {
     private:
         uint8_t nfields = 0;
@@ -328,11 +329,20 @@ class EDBLayer {
         VLIBEXP void addInmemoryTable(std::string predicate,
                 PredId_t id, std::vector<std::vector<std::string>> &rows);
 
+        //The columns hold ids of terms already in the dictionary
+        VLIBEXP void addInmemoryTable(std::string predicate,
+                std::vector<std::vector<Term_t>> &columns);
+
         //For RMFA check
         VLIBEXP void addInmemoryTable(PredId_t predicate,
                 uint8_t arity,
                 std::vector<uint64_t> &rows);
 
+        //Replaces the table of a predicate with an INMEMORY table, such as
+        //an updated copy of the current one
+        VLIBEXP void replaceInmemoryTable(PredId_t predicate,
+                std::shared_ptr<InmemoryTable> table);
+
         ~EDBLayer() {
             for (int i = 0; i < tmpRelations.size(); ++i) {
                 if (tmpRelations[i] != NULL) {
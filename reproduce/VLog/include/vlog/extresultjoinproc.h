@@ -41,6 +41,10 @@ class ExistentialRuleProcessor : public FinalRuleProcessor {
                 uint64_t sizecolumns,
                 std::vector<uint64_t> &output);
 
+        //False if the chase is not restricted, or the heads of the rule
+        //cannot be satisfied before it is applied (see RuleExecutionDetails)
+        bool mustCheckHeads(const uint64_t nrows);
+
         void retainNonExisting(
                 std::vector<uint64_t> &filterRows,
                 uint64_t &sizecolumns,
@@ -170,7 +170,7 @@ class SelectingFCInternalTableItr : public FCInternalTableItr {
         }
 };
 
-class FCInternalTable {
+class FCInternalTable : public SlabObject {
     private:
         //    int references;
 
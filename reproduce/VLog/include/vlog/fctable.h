@@ -4,6 +4,7 @@
 #include <trident/model/table.h>
 #include <vlog/concepts.h>
 #include <vlog/fcinttable.h>
+#include <vlog/packedcolumn.h>
 
 #include <inttypes.h>
 #include <string>
@@ -13,6 +14,7 @@
 struct RuleExecutionDetails;
 class FCTable;
 class TableFilterer;
+class SpillManager;
 
 struct FCRow {
     const Term_t *row;
@@ -79,6 +81,14 @@ class FCIterator {
 
 typedef std::unordered_map<std::string, FCCacheBlock, std::hash<std::string>, std::equal_to<std::string>> FCCache;
 
+//retainFrom uses the sorted runs if the table has at least these blocks
+#define RETAIN_INDEX_MIN_BLOCKS 8
+//A run is merged with the next one if it is less than this many times larger
+#define RETAIN_RUN_RATIO 2
+//Default size of the membership filter of the runs
+#define RETAIN_FILTER_BITS_PER_ROW 16
+#define RETAIN_FILTER_MAX_BYTES (64 * 1024 * 1024)
+
 class FCTable {
     private:
         const uint8_t sizeRow;
@@ -93,6 +103,79 @@ class FCTable {
 
         void removeBlock(const size_t iteration);
 
+        //Column of a run as a frame of reference: the values minus the
+        //smallest one, bit-packed (the wider ones are kept as they are)
+        struct RetainColumn {
+            std::vector<uint64_t> data;
+            Term_t base;
+            Term_t max;
+            uint8_t width;
+
+            Term_t get(const size_t pos) const {
+                return width > PACKED_MAX_WIDTH ? data[pos] :
+                    base + BitPacking::get(data.data(), width, pos);
+            }
+
+            //Allocates n values between base and max
+            void init(const size_t n);
+
+            void set(const size_t pos, const Term_t value);
+
+            //First position in [start, end) whose value is not smaller than
+            //v (or larger than v, if upper), galloping from start
+            size_t gallop(size_t start, size_t end, const Term_t v,
+                    const bool upper) const;
+        };
+
+        //Sorted and duplicate-free rows
+        struct RetainRun {
+            std::vector<RetainColumn> columns;
+            size_t nrows = 0;
+
+            size_t size() const {
+                return nrows;
+            }
+        };
+
+        //Index of retainFrom. The rows of the blocks are copied in a few
+        //sorted runs of decreasing size (as in an LSM tree), so that a new
+        //segment is compared with O(log n) runs instead of with every block.
+        //The index costs a (bit-packed) copy of the rows, so it is only built
+        //for tables with many blocks. Blocks of EDB tables are not copied.
+        //The runs and the filter are never modified once they are read
+        //without retainMutex: updates replace them
+        std::mutex retainMutex;
+        bool retainIndexed;
+        std::vector<std::shared_ptr<const RetainRun>> retainRuns;
+        //Tables added since the runs were updated
+        std::vector<std::shared_ptr<const FCInternalTable>> retainPending;
+        //Blocked bloom filter of the rows of the runs. A row that is not in
+        //the filter is new, and it is not searched in the runs
+        std::shared_ptr<std::vector<uint64_t>> retainFilter;
+
+        static uint64_t hashRow(const Term_t *row, const uint8_t ncolumns);
+
+        void addToFilter(const RetainRun &run);
+
+        static bool filterMayContain(const std::vector<uint64_t> &filter,
+                const uint64_t h);
+
+        RetainRun getRun(std::shared_ptr<const FCInternalTable> table,
+                int nthreads) const;
+
+        static RetainRun mergeRuns(const RetainRun &r1, const RetainRun &r2);
+
+        void updateRetainIndex(int nthreads);
+
+        void addToRetainIndex(std::shared_ptr<const FCInternalTable> t);
+
+        //Removes the rows of t that are in the runs
+        static std::shared_ptr<const Segment> retainFromRuns(
+                std::shared_ptr<const Segment> t,
+                const bool duplicates,
+                const std::vector<std::shared_ptr<const RetainRun>> &runs,
+                const std::vector<uint64_t> *filter);
+
     public:
         FCTable(std::mutex *mutex, const uint8_t sizeRow);
 
@@ -148,7 +231,18 @@ class FCTable {
         std::shared_ptr<const Segment> retainFrom(
                 std::shared_ptr<const Segment> t,
                 const bool dupl,
-                int nthreads) const;
+                int nthreads);
+
+        //Time spent by this thread in retainFrom, in ms
+        static double getRetainTime();
+
+        //Size of the membership filters of retainFrom. bitsPerRow 0 disables
+        //them. A filter never takes more than maxBytes
+        static void setRetainFilter(const unsigned bitsPerRow,
+                const size_t maxBytes);
+
+        //Lookups, rows discarded by the filters and false positives
+        static std::string getRetainFilterStats();
 
         void addBlock(FCBlock block);
 
@@ -163,6 +257,16 @@ class FCTable {
 
         void collapseBlocks(size_t iteration, int nThreads);
 
+        //Spills the blocks of the iterations before maxIteration, oldest
+        //first, until bytesToFree bytes are freed. Returns the bytes freed.
+        //A table is spilled only if no one else reads it, except for the
+        //references counted in otherUses. The new tables are added to spilled
+        size_t spill(SpillManager &manager, const size_t maxIteration,
+                const size_t bytesToFree,
+                const std::unordered_map<const FCInternalTable*, long> &otherUses,
+                std::unordered_map<const FCInternalTable*,
+                std::shared_ptr<const FCInternalTable>> &spilled);
+
         ~FCTable();
 };
 
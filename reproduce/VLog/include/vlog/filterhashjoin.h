@@ -33,8 +33,7 @@ class FilterHashJoin {
 private:
     ResultJoinProcessor *output;
 
-    const JoinHashMap *map1;
-    const DoubleJoinHashMap *map2;
+    const JoinHashTable *map;
     const std::vector<Term_t> *mapValues;
     const uint8_t mapRowSize;
     const uint8_t njoinfields;
@@ -84,7 +83,7 @@ private:
                                       const std::vector<std::pair<uint8_t, uint8_t>> *columnsToFilterOut);
 
 public:
-    FilterHashJoin(ResultJoinProcessor *output, const JoinHashMap *map, const DoubleJoinHashMap *map2,
+    FilterHashJoin(ResultJoinProcessor *output, const JoinHashTable *map,
                    std::vector<Term_t> *mapValues,
                    const uint8_t mapRowSize, const uint8_t njoinfields,
                    const uint8_t joinField1, const uint8_t joinField2,
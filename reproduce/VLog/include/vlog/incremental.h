@@ -0,0 +1,102 @@
+#ifndef _INCREMENTAL_H
+#define _INCREMENTAL_H
+
+#include <vlog/concepts.h>
+#include <vlog/edb.h>
+#include <vlog/seminaiver.h>
+#include <vlog/reliances/reliances.h>
+
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <inttypes.h>
+
+//Timeout of the positive reliances between the rules, in ms
+#define INCREMENTAL_RELIANCE_TIMEOUT 10000
+
+//Facts of an EDB predicate, one vector per column
+typedef std::vector<std::vector<Term_t>> EDBFacts;
+
+struct IncrementalStats {
+    //False if the materialization was computed again from scratch
+    bool incremental;
+    size_t affectedRules;
+    size_t insertedFacts;
+    size_t deletedFacts;
+    //IDB facts removed by the over-deletion, and those derived again
+    size_t overdeleted;
+    size_t rederived;
+    double overdeleteMs;
+    double rederiveMs;
+    double totalMs;
+
+    IncrementalStats() : incremental(false), affectedRules(0),
+    insertedFacts(0), deletedFacts(0), overdeleted(0), rederived(0),
+    overdeleteMs(0), rederiveMs(0), totalMs(0) {
+    }
+
+    std::string tostring() const;
+};
+
+/*
+ * Updates the materialization of a Datalog program after facts are added to
+ * or removed from its EDB predicates, without computing it again.
+ *
+ * The removals follow DRed: the facts that have a derivation using a removed
+ * fact are over-deleted (evaluated on the old database), and those of them
+ * that still have another derivation are derived again, together with the
+ * consequences of the added facts, by continuing the semi-naive evaluation
+ * from the blocks of the old materialization. Only the rules reachable from
+ * the updated predicates in the positive reliance graph are evaluated
+ * (following the predicates if the reliances time out).
+ *
+ * Programs with negation, or with existential rules among the affected ones,
+ * are materialized again from scratch.
+ */
+class IncrementalMaintenance {
+    private:
+        EDBLayer &layer;
+        Program *program;
+        const bool opt_intersect;
+        const bool opt_filtering;
+        const TypeChase typeChase;
+        const int nthreads;
+        const unsigned relianceTimeout;
+
+        const std::vector<Rule> rules;
+        bool negation;
+        //The successors of the rules are computed when they are first needed
+        std::unique_ptr<LazyRelianceGraph> reliances;
+
+        IncrementalStats lastStats;
+
+        std::vector<bool> getAffectedRules(
+                const std::vector<PredId_t> &updatedPredicates);
+
+        SemiNaiver *newSemiNaiver(Program *p);
+
+    public:
+        VLIBEXP IncrementalMaintenance(EDBLayer &layer, Program *program,
+                bool opt_intersect, bool opt_filtering, TypeChase typeChase,
+                int nthreads,
+                unsigned relianceTimeout = INCREMENTAL_RELIANCE_TIMEOUT);
+
+        //Full materialization of the current database
+        VLIBEXP SemiNaiver *materialize(unsigned long *timeout = NULL);
+
+        //Adds and removes facts of the EDB predicates (the removals are
+        //applied first). sn is the materialization of the old database, and
+        //is replaced with the one of the new database. If the update throws
+        //after the old materialization is dropped, sn is NULL. The updated
+        //predicates become INMEMORY tables
+        VLIBEXP void update(std::unique_ptr<SemiNaiver> &sn,
+                const std::map<PredId_t, EDBFacts> &added,
+                const std::map<PredId_t, EDBFacts> &removed);
+
+        const IncrementalStats &getLastStats() const {
+            return lastStats;
+        }
+};
+
+#endif
@@ -76,8 +76,22 @@ class InmemoryTable : public EDBTable {
         EDBIterator *getSortedIterator2(const Literal &query,
                 const std::vector<uint8_t> &fields);
 
+        // Memory-maps the CSV file and parses nthreads chunks of it in parallel.
+        // Only the distinct terms of each chunk go through the dictionary of the layer.
+        void loadCSVParallel(const std::string &tablefile, int nthreads);
+
+        // Reads a snapshot written by writeSnapshot. The terms are added to the
+        // dictionary of the layer; the columns are used without parsing.
+        void loadSnapshot(const std::string &snapshotfile);
+
+        // An empty table, filled by update
+        InmemoryTable(PredId_t predid, uint8_t arity, EDBLayer *layer);
+
     public:
-        InmemoryTable(std::string repository, std::string tablename, PredId_t predid, EDBLayer *layer);
+        // Uses <tablename>.snap if present and not older than the data.
+        // Otherwise, loadThreads > 1 selects the parallel CSV loader (EDBx_param2 in edb.conf)
+        InmemoryTable(std::string repository, std::string tablename, PredId_t predid, EDBLayer *layer,
+                int loadThreads = 1);
 
         InmemoryTable(PredId_t predid, std::vector<std::vector<std::string>> &entries, EDBLayer *layer);
 
@@ -86,8 +100,26 @@ class InmemoryTable : public EDBTable {
                 std::vector<uint64_t> &entries,
                 EDBLayer *layer);
 
+        // The columns hold ids of the dictionary of the layer. They are moved
+        // into the table and left empty. If sorted is true, the rows are
+        // already sorted and without duplicates.
+        InmemoryTable(PredId_t predid,
+                std::vector<std::vector<Term_t>> &columns,
+                EDBLayer *layer, const bool sorted = false);
+
         uint8_t getArity() const;
 
+        // A copy of the table without the rows of removed and with those of
+        // added (sorted and without duplicates, one row after the other; the
+        // removals are applied first). The rows are merged into the rows of
+        // the table and into its cached sorted segments, so that the copy
+        // does not sort them again. deleted and inserted receive the rows
+        // that were really removed and added.
+        InmemoryTable *update(const std::vector<Term_t> &removed,
+                const std::vector<Term_t> &added,
+                std::vector<Term_t> &deleted,
+                std::vector<Term_t> &inserted) const;
+
         void query(QSQQuery *query, TupleTable *outputTable,
                 std::vector<uint8_t> *posToFilter,
                 std::vector<Term_t> *valuesToFilter);
@@ -119,6 +151,10 @@ class InmemoryTable : public EDBTable {
 
         uint64_t getSize();
 
+        // Stores the table in the binary format read at startup if
+        // <tablename>.snap exists next to the CSV/NT file
+        void writeSnapshot(const std::string &snapshotfile);
+
         ~InmemoryTable();
 };
 
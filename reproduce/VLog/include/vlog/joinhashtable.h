@@ -0,0 +1,116 @@
+#ifndef _JOINHASHTABLE_H
+#define _JOINHASHTABLE_H
+
+#include <vector>
+#include <utility>
+#include <functional>
+#include <cstddef>
+#include <inttypes.h>
+
+#include <vlog/term.h>
+#include <vlog/arena.h>
+
+//Slots per bucket. A bucket fills exactly one cache line
+#define JOINHASHTABLE_SLOTS 4
+
+/*
+ * Hash table used by the hash joins to find the rows of the smaller relation
+ * that match a join key. The rows are stored in a vector grouped by key
+ * (e.g. sorted on the join fields), and the table maps every key to the
+ * interval of its rows.
+ *
+ * The table is split in 2^k partitions on the most significant bits of the
+ * hash, so that every partition fits in the cache while it is built and the
+ * partitions can be built in parallel. Every partition is an open-addressing
+ * table of buckets of JOINHASHTABLE_SLOTS keys that are compared at once
+ * (with AVX2 if the CPU supports it). The interval of the rows is stored
+ * next to the key, so a probe touches a single cache line unless it has to
+ * move to the next bucket. Large tables also have a blocked bloom filter,
+ * which discards most of the keys without a match. The table is built for a
+ * single join, so its memory is taken from the arena of the rule execution.
+ */
+class JoinHashTable {
+    public:
+        struct Group {
+            Term_t key1;
+            Term_t key2;
+            //Interval of the group in the values (as offsets of Term_t)
+            size_t start;
+            size_t end;
+        };
+
+        struct Bucket {
+            //The key itself for one join field, the hash of the keys for two
+            Term_t tags[JOINHASHTABLE_SLOTS];
+            uint32_t rows[JOINHASHTABLE_SLOTS];
+            //Number of rows of the group. 0 marks an empty slot
+            uint32_t counts[JOINHASHTABLE_SLOTS];
+        };
+
+        typedef ArenaVector<Group> Groups;
+
+    private:
+        const uint8_t rowSize;
+        const std::vector<uint8_t> keyFields;
+        const std::vector<Term_t> *values;
+
+        Groups groups;
+
+        ArenaVector<char> storage;
+        Bucket *buckets;
+        uint8_t partitionBits;
+        //First bucket of every partition, plus the total number of buckets
+        ArenaVector<size_t> partitionOffsets;
+
+        ArenaVector<uint64_t> bloom;
+        uint64_t bloomMask;
+
+        static uint64_t hash(const Term_t key1, const Term_t key2);
+
+        size_t getPartition(const uint64_t h) const {
+            return partitionBits == 0 ? 0 : h >> (64 - partitionBits);
+        }
+
+        void insert(const Group &group, const uint64_t h);
+
+        bool lookup(const uint64_t h, const Term_t key1, const Term_t key2,
+                size_t &start, size_t &end) const;
+
+    public:
+        //keyFields contains one or two fields of the rows. rowSize is the
+        //number of Term_t of a row
+        JoinHashTable(const uint8_t rowSize, const std::vector<uint8_t> &keyFields);
+
+        //Indexes the rows in values, which must be grouped by key and outlive
+        //the table
+        void build(const std::vector<Term_t> &values, const int nthreads);
+
+        size_t size() const {
+            return groups.size();
+        }
+
+        //Groups in the order of the values
+        const Groups &getGroups() const {
+            return groups;
+        }
+
+        size_t getNPartitions() const {
+            return partitionOffsets.empty() ? 0 : partitionOffsets.size() - 1;
+        }
+
+        bool hasBloomFilter() const {
+            return !bloom.empty();
+        }
+
+        //Sets the interval of the rows with the key. Returns false if there are none
+        bool find(const Term_t key, size_t &start, size_t &end) const {
+            return lookup(hash(key, 0), key, 0, start, end);
+        }
+
+        bool find(const Term_t key1, const Term_t key2, size_t &start,
+                size_t &end) const {
+            return lookup(hash(key1, key2), key1, key2, start, end);
+        }
+};
+
+#endif
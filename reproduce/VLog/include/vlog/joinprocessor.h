@@ -7,14 +7,12 @@
 #include <vlog/seminaiver.h>
 #include <vlog/filterer.h>
 #include <vlog/resultjoinproc.h>
+#include <vlog/joinhashtable.h>
+#include <vlog/arena.h>
 
 #include <inttypes.h>
 #include <mutex>
-
-typedef google::dense_hash_map<Term_t, std::pair<size_t, size_t>, std::hash<Term_t>, std::equal_to<Term_t>> JoinHashMap;
-typedef google::dense_hash_map<std::pair<Term_t, Term_t>,
-        std::pair<size_t, size_t>, std::hash<std::pair<Term_t, Term_t>>,
-        std::equal_to<std::pair<Term_t, Term_t>>> DoubleJoinHashMap;
+#include <functional>
 
 struct LessTwoTuples {
     const uint8_t sizeTuple;
@@ -45,7 +43,7 @@ class Output {
         const uint8_t rowsize;
         const std::pair<uint8_t, uint8_t> *posFromFirst;
         const std::pair<uint8_t, uint8_t> *posFromSecond;
-        std::vector<Term_t> resultTerms;
+        ArenaVector<Term_t> resultTerms;
         std::vector<int> resultBlockId;
         std::vector<bool> resultUnique;
         const bool mustFlush;
@@ -144,6 +142,28 @@ class Output {
         }
 };
 
+//Bounds of the number of rows of the left relation in a morsel
+#define MIN_MORSEL_SIZE 256
+#define MAX_MORSEL_SIZE 65536
+//Morsels per thread, if they are not too small or too large
+#define MORSELS_PER_THREAD 8
+
+/*
+ * Morsel-driven scheduling of a join. The rows of the left relation are split
+ * in small ranges (morsels), and every worker takes the next morsel as soon
+ * as it is done with the previous one. A worker that gets a range with many
+ * matches does not hold up the others, as it does with one range per thread.
+ * Every worker writes in its own Output, which is flushed in the shared
+ * ResultJoinProcessor.
+ */
+class JoinMorsels {
+    public:
+        //Calls f(worker, begin, end) for every morsel of [0, size). worker is
+        //in [0, nthreads)
+        static void run(const size_t size, const int nthreads,
+                const std::function<void(int, size_t, size_t)> &f);
+};
+
 class SemiNaiver;
 class JoinExecutor {
     private:
@@ -234,18 +254,28 @@ class JoinExecutor {
                 size_t i1,  size_t i2,
                 const std::vector<uint8_t> &fields1);
 
-        static void doPhysicalHashJoin(FCIterator &itr2, JoinHashMap &map,
-                std::vector<Term_t> &mapValues, const uint8_t joinIdx2,
-                const uint8_t rowSize, const uint8_t s2,
-                ResultJoinProcessor *output);
+        //Probes the map with the rows of the tables, in morsels if there
+        //are several threads
+        static void doPhysicalHashJoin(
+                const std::vector<std::shared_ptr<const FCInternalTable>> &tables2,
+                const JoinHashTable &map, const std::vector<Term_t> &mapValues,
+                const std::vector<uint8_t> &fields2, const uint8_t rowSize,
+                ResultJoinProcessor *output, int nthreads);
+
+        //Builds the map on the join fields of the tables of the literal,
+        //when they are smaller than t1, and probes it with the rows of t1
+        static void doReversedHashJoin(const FCInternalTable *t1,
+                const std::vector<uint8_t> &fields1,
+                const std::vector<std::shared_ptr<const FCInternalTable>> &tables2,
+                const std::vector<uint8_t> &fields2,
+                ResultJoinProcessor *output, int nthreads);
 
-        static bool isJoinSelective(JoinHashMap &map, const Literal &literal,
+        static bool isJoinSelective(const JoinHashTable &map, const Literal &literal,
                 const size_t minIteration, const size_t maxIteration,
                 SemiNaiver *naiver, const uint8_t joinPos);
 
         static void execSelectiveHashJoin(const RuleExecutionDetails &currentRule,
-                SemiNaiver *naiver, const JoinHashMap &map,
-                const DoubleJoinHashMap &doublemap,
+                SemiNaiver *naiver, const JoinHashTable &map,
                 ResultJoinProcessor *out, const uint8_t njoinfields,
                 const uint8_t idxJoinField1, const uint8_t idxJoinField2,
                 const std::vector<Literal> *outputLiterals,
@@ -317,6 +347,16 @@ class JoinExecutor {
                 const RuleExecutionPlan &hv,
                 int &processedTables, int nthreads);
 
+        //Builds a JoinHashTable on the join fields of the smaller side, t1 or
+        //the tables of the literal, and probes it with the other side, which
+        //does not have to be sorted
+        static void physicalHashJoin(const FCInternalTable *t1,
+                SemiNaiver *naiver, const std::vector<Literal> *outputLiterals,
+                const Literal &literal,
+                const size_t min, const size_t max,
+                const std::vector<std::pair<uint8_t, uint8_t>> &joinsCoordinates,
+                ResultJoinProcessor *output, int nthreads);
+
         static int cmp(const Term_t *r1, const Term_t *r2, const uint8_t s);
 
         static void leftjoin(const FCInternalTable * t1, SemiNaiver *naiver,
@@ -334,7 +374,9 @@ class JoinExecutor {
                const std::vector<uint8_t> &fields2, ResultJoinProcessor * output,
                int nthreads);
 
+        //Outputs the rows in [l1, u1) of vectors1 without a match in vectors2
         static void do_left_join(const std::vector<const std::vector<Term_t> *> &vectors1,
+                size_t l1, size_t u1,
                 const std::vector<const std::vector<Term_t> *> &vectors2,
                 const std::vector<uint8_t> &fields1,
                 const std::vector<uint8_t> &fields2,
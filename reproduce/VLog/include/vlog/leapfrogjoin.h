@@ -0,0 +1,83 @@
+#ifndef _LEAPFROGJOIN_H
+#define _LEAPFROGJOIN_H
+
+#include <vlog/concepts.h>
+#include <vlog/segment.h>
+#include <vlog/ruleexecplan.h>
+
+#include <vector>
+#include <memory>
+
+class SemiNaiver;
+class ResultJoinProcessor;
+
+/*
+ * Worst-case optimal join (leapfrog triejoin, Veldhuizen 2014) of all the
+ * body literals of a rule. Every literal is copied in a Segment that is
+ * sorted on its variables in the order of RuleExecutionPlan::trieJoinVars.
+ * The variables are then bound one after the other by intersecting the
+ * sorted columns of the literals that contain them, so that no intermediate
+ * relation is materialized. This avoids the blow up of the binary joins on
+ * cyclic bodies like R(X,Y),R(Y,Z),R(Z,X).
+ */
+class LeapfrogTrieJoin {
+    private:
+        //Trie over the rows of a sorted and duplicate-free segment
+        struct TrieIterator {
+            std::shared_ptr<const Segment> segment;
+            std::vector<std::vector<Term_t>> ownedColumns;
+            std::vector<const std::vector<Term_t> *> columns;
+            //For each opened level: current row and end of the range
+            std::vector<size_t> pos;
+            std::vector<size_t> end;
+            int depth;
+
+            TrieIterator(std::shared_ptr<const Segment> segment);
+
+            size_t size() const {
+                return columns.empty() ? 0 : columns[0]->size();
+            }
+
+            Term_t key() const {
+                return (*columns[depth])[pos[depth]];
+            }
+
+            bool atEnd() const {
+                return pos[depth] >= end[depth];
+            }
+
+            void open();
+
+            void up() {
+                depth--;
+            }
+
+            void next();
+
+            void seek(const Term_t v);
+        };
+
+        std::vector<std::unique_ptr<TrieIterator>> relations;
+        //For each variable, the relations that contain it
+        std::vector<std::vector<TrieIterator *>> participants;
+        std::vector<Term_t> binding;
+        ResultJoinProcessor *output;
+        size_t nResults;
+
+        void search(const size_t varIdx);
+
+    public:
+        LeapfrogTrieJoin() : output(NULL), nResults(0) {
+        }
+
+        //ranges contains, for each literal of plan.plan, the interval of
+        //iterations to consider. Returns the number of bindings found.
+        size_t join(SemiNaiver *naiver,
+                const RuleExecutionPlan &plan,
+                const std::vector<std::pair<size_t, size_t>> &ranges,
+                ResultJoinProcessor *output,
+                int &processedTables,
+                const int nthreads);
+};
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef _MATEXPORTER_H
+#define _MATEXPORTER_H
+
+#include <vlog/concepts.h>
+#include <vlog/fcinttable.h>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <fstream>
+#include <atomic>
+#include <inttypes.h>
+
+class SemiNaiver;
+class EDBLayer;
+
+//Rows of a chunk, the unit of work of the threads of the exporter
+#define EXPORT_CHUNK_ROWS (1 << 20)
+//Capacity of the cache of the text of the terms of every thread
+#define EXPORT_CACHE_TERMS (1 << 18)
+//Size of the buffers of the output files
+#define EXPORT_FILE_BUFFER (8 << 20)
+//Header of the files in the binary format
+#define EXPORT_BINARY_MAGIC "VLOGCOL1"
+
+enum MatExportFormat {
+    //The iteration of the row, and the terms separated by tabs
+    EXPORT_FILES,
+    //Comma-separated text of the terms
+    EXPORT_CSV,
+    //EXPORT_BINARY_MAGIC, the arity as a 32-bit integer, and then every
+    //chunk as the number of rows (64 bits) followed by the IDs of the terms
+    //(64 bits each) column after column
+    EXPORT_BINARY
+};
+
+/*
+ * Writes the IDB tables of a materialization to one file per predicate.
+ * The rows are split in chunks of about EXPORT_CHUNK_ROWS rows (the blocks
+ * of a predicate, or ranges of the rows of the large blocks), which are
+ * formatted and compressed by several threads and appended to the files in
+ * the order of the rows. With compression, every chunk is a gzip member, so
+ * the files can be read with any gzip reader.
+ *
+ * The dictionaries of the EDB layer are not thread-safe: every thread
+ * collects the terms of a chunk that are not in its cache, and looks them up
+ * at once under a lock.
+ */
+class MatExporter {
+    private:
+        struct Piece {
+            std::shared_ptr<const FCInternalTable> table;
+            size_t iteration;
+            size_t begin, end;
+        };
+
+        struct Chunk {
+            size_t file;
+            size_t index;
+            std::vector<Piece> pieces;
+        };
+
+        //Output file of a predicate. The chunks are appended in order
+        struct OutputFile {
+            std::string path;
+            uint8_t arity;
+            size_t nchunks;
+
+            std::mutex mutex;
+            std::condition_variable turn;
+            size_t nextChunk;
+            std::unique_ptr<std::ofstream> out;
+            std::vector<char> buffer;
+        };
+
+        //Per-thread state
+        struct Worker {
+            std::unordered_map<Term_t, std::string> cache;
+            std::vector<std::vector<Term_t>> columns;
+            std::vector<size_t> iterations;
+            std::string text;
+            std::string compressed;
+            std::vector<char> term;
+        };
+
+        SemiNaiver &sn;
+        EDBLayer &layer;
+        const MatExportFormat format;
+        const bool decompress;
+        const bool compress;
+        const int nthreads;
+
+        std::vector<std::unique_ptr<OutputFile>> files;
+        std::vector<Chunk> chunks;
+        std::atomic<size_t> nextChunk;
+
+        std::mutex dictMutex;
+        //The first error, thrown at the end of the export
+        std::mutex errorMutex;
+        std::string error;
+        std::atomic<uint64_t> nRows;
+        std::atomic<uint64_t> nBytes;
+        std::atomic<uint64_t> nLookups;
+        std::atomic<uint64_t> nCacheHits;
+
+        void addFile(const std::string &path, const PredId_t pred);
+
+        static void readPiece(const Piece &piece, const uint8_t arity,
+                Worker &worker);
+
+        void lookupTerms(Worker &worker);
+
+        void formatChunk(const Chunk &chunk, const uint8_t arity,
+                Worker &worker);
+
+        static void gzip(const std::string &input, std::string &output);
+
+        void setError(const std::string &message);
+
+        void writeChunk(const Chunk &chunk, const std::string &data);
+
+        void run();
+
+    public:
+        VLIBEXP MatExporter(SemiNaiver &sn, const MatExportFormat format,
+                const bool decompress, const bool compress, const int nthreads);
+
+        //One file per non-empty IDB predicate in the directory path
+        VLIBEXP void storeOnFiles(const std::string &path);
+
+        //The rows of pred in path (an empty file if there are none)
+        VLIBEXP void storeOnFile(const std::string &path, const PredId_t pred);
+
+        //Suffix of the names of the files ("" or ".gz")
+        std::string getSuffix() const {
+            return compress ? ".gz" : "";
+        }
+
+        static bool parseFormat(const std::string &name, MatExportFormat &format);
+};
+
+#endif
@@ -0,0 +1,255 @@
+#ifndef _PACKEDCOLUMN_H
+#define _PACKEDCOLUMN_H
+
+#include <vlog/column.h>
+
+#include <vector>
+#include <memory>
+#include <inttypes.h>
+
+//Columns with fewer values are never packed (see ColumnWriter::pack)
+#define PACKED_COLUMN_MIN_ROWS (1 << 20)
+//A column is packed only if it takes at most this fraction of a vector
+#define PACKED_COLUMN_MAX_RATIO 0.75
+//Number of values that a reader decodes at once
+#define PACKED_READER_BLOCK 64
+//Larger widths are not worth packing
+#define PACKED_MAX_WIDTH 56
+
+/*
+ * Bit-packed arrays of integers of a fixed width (at most PACKED_MAX_WIDTH
+ * bits). The value at position i starts at bit i * width, so that it can be
+ * read with a single unaligned 64-bit load. Blocks of values are decoded
+ * with AVX2 gathers if the CPU supports them.
+ */
+class BitPacking {
+    public:
+        //Number of bits needed to represent v
+        static uint8_t getWidth(const uint64_t v);
+
+        //Packs the n values minus base. The data has eight bytes of padding
+        static void pack(const Term_t *values, const size_t n, const Term_t base,
+                const uint8_t width, std::vector<uint64_t> &data);
+
+        static uint64_t get(const uint64_t *data, const uint8_t width,
+                const size_t pos) {
+            const size_t bit = pos * width;
+            uint64_t word;
+            memcpy(&word, (const char *) data + (bit >> 3), sizeof(word));
+            return (word >> (bit & 7)) & ((1ULL << width) - 1);
+        }
+
+        //Writes base + the values in [start, start + n) to output. If
+        //dictionary is not NULL, the values are indexes in the dictionary
+        static void unpack(const uint64_t *data, const uint8_t width,
+                const size_t start, const size_t n, const Term_t base,
+                const Term_t *dictionary, Term_t *output);
+};
+
+class PackedColumnReader final : public ColumnReader {
+    private:
+        const uint64_t *data;
+        const uint8_t width;
+        const Term_t base;
+        const Term_t *dictionary;
+        const size_t _size;
+
+        size_t position;
+        size_t bufferStart;
+        size_t bufferEnd;
+        Term_t buffer[PACKED_READER_BLOCK];
+
+    public:
+        PackedColumnReader(const uint64_t *data, const uint8_t width,
+                const Term_t base, const Term_t *dictionary,
+                const size_t size) : data(data), width(width), base(base),
+        dictionary(dictionary), _size(size), position(0), bufferStart(0),
+        bufferEnd(0) {
+        }
+
+        Term_t first();
+
+        Term_t last();
+
+        std::vector<Term_t> asVector();
+
+        bool hasNext() {
+            return position < _size;
+        }
+
+        Term_t next() {
+            if (position == bufferEnd) {
+                bufferStart = position;
+                bufferEnd = std::min(_size, position + PACKED_READER_BLOCK);
+                BitPacking::unpack(data, width, bufferStart,
+                        bufferEnd - bufferStart, base, dictionary, buffer);
+            }
+            return buffer[position++ - bufferStart];
+        }
+
+        void clear() {
+        }
+};
+
+/*
+ * Column stored as a frame of reference: the minimum value, and the
+ * differences from it bit-packed with the width of the largest one. It
+ * suits columns whose values lie in a narrow range (e.g., the IDs of the
+ * terms of a single data set).
+ */
+class FORColumn final : public Column {
+    private:
+        std::vector<uint64_t> data;
+        Term_t base;
+        uint8_t width;
+        size_t _size;
+
+    public:
+        FORColumn(const std::vector<Term_t> &values, const Term_t min,
+                const uint8_t width);
+
+        size_t size() const {
+            return _size;
+        }
+
+        size_t getRepresentationSize() const {
+            return data.size();
+        }
+
+        size_t getBytes() const {
+            return data.capacity() * sizeof(uint64_t);
+        }
+
+        size_t estimateSize() const {
+            return _size;
+        }
+
+        bool isEmpty() const {
+            return _size == 0;
+        }
+
+        Term_t getValue(const size_t pos) const {
+            return base + BitPacking::get(data.data(), width, pos);
+        }
+
+        void getValues(const size_t begin, const size_t end,
+                std::vector<Term_t> &out) const;
+
+        bool supportsDirectAccess() const {
+            return true;
+        }
+
+        bool isEDB() const {
+            return false;
+        }
+
+        bool containsDuplicates() const {
+            return _size > 1;
+        }
+
+        std::unique_ptr<ColumnReader> getReader() const {
+            return std::unique_ptr<ColumnReader>(new PackedColumnReader(
+                        data.data(), width, base, NULL, _size));
+        }
+
+        std::shared_ptr<Column> sort() const;
+
+        std::shared_ptr<Column> sort(const int nthreads) const;
+
+        std::shared_ptr<Column> unique() const;
+
+        bool isIn(const Term_t t) const;
+
+        bool isConstant() const {
+            return _size < 2 || width == 0;
+        }
+
+        Term_t first() const {
+            assert(_size > 0);
+            return getValue(0);
+        }
+};
+
+/*
+ * Column stored as a sorted dictionary of its distinct values and the
+ * bit-packed positions of the values in the dictionary. It suits skewed
+ * columns with few distinct values spread over a large range.
+ */
+class DictionaryColumn final : public Column {
+    private:
+        std::vector<Term_t> dictionary;
+        std::vector<uint64_t> data;
+        uint8_t width;
+        size_t _size;
+
+    public:
+        //dictionary must contain all the values, sorted and without duplicates
+        DictionaryColumn(const std::vector<Term_t> &values,
+                std::vector<Term_t> &dictionary);
+
+        size_t size() const {
+            return _size;
+        }
+
+        size_t getRepresentationSize() const {
+            return dictionary.size() + data.size();
+        }
+
+        size_t getBytes() const {
+            return dictionary.capacity() * sizeof(Term_t) +
+                data.capacity() * sizeof(uint64_t);
+        }
+
+        size_t estimateSize() const {
+            return _size;
+        }
+
+        bool isEmpty() const {
+            return _size == 0;
+        }
+
+        Term_t getValue(const size_t pos) const {
+            return dictionary[BitPacking::get(data.data(), width, pos)];
+        }
+
+        void getValues(const size_t begin, const size_t end,
+                std::vector<Term_t> &out) const;
+
+        bool supportsDirectAccess() const {
+            return true;
+        }
+
+        bool isEDB() const {
+            return false;
+        }
+
+        bool containsDuplicates() const {
+            return _size > 1;
+        }
+
+        std::unique_ptr<ColumnReader> getReader() const {
+            return std::unique_ptr<ColumnReader>(new PackedColumnReader(
+                        data.data(), width, 0, dictionary.data(), _size));
+        }
+
+        std::shared_ptr<Column> sort() const;
+
+        std::shared_ptr<Column> sort(const int nthreads) const;
+
+        std::shared_ptr<Column> unique() const;
+
+        bool isIn(const Term_t t) const {
+            return std::binary_search(dictionary.begin(), dictionary.end(), t);
+        }
+
+        bool isConstant() const {
+            return dictionary.size() < 2;
+        }
+
+        Term_t first() const {
+            assert(_size > 0);
+            return getValue(0);
+        }
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef _PLANSTATS_H
+#define _PLANSTATS_H
+
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include <functional>
+#include <cstddef>
+#include <inttypes.h>
+
+//A rule is re-planned if its intermediate results are this many times larger
+//than the estimate of the plan
+#define PLANSTATS_DEVIATION 10
+//Smaller intermediate results are never re-planned
+#define PLANSTATS_MIN_ROWS 100000
+
+/*
+ * Statistics on the execution of the rules, used to choose the body atom
+ * that is evaluated first. The plans are ordered on the estimated
+ * cardinalities of the atoms (see SemiNaiver::reorderPlan), which assumes
+ * that a join is not larger than its largest input. If the intermediate
+ * results of a combination of a rule are much larger than that, the rule is
+ * re-planned: the next executions start from each of the other atoms once,
+ * and from then on the atom whose executions produced the fewest
+ * intermediate rows per input row is chosen.
+ *
+ * The statistics of the re-planned rules can be saved to a file and loaded
+ * in a later run of the same program, which then skips the exploration.
+ * The class is thread-safe, because the rules can be executed in parallel.
+ */
+class PlanStatistics {
+    private:
+        struct Candidate {
+            uint64_t executions;
+            double rows;
+            double inputRows;
+            double time;
+
+            Candidate() : executions(0), rows(0), inputRows(0), time(0) {
+            }
+
+            double getCost() const {
+                return rows / (inputRows < 1 ? 1 : inputRows);
+            }
+        };
+
+        struct RulePlan {
+            std::string rule;
+            //Indexed by the position of the first atom in the combination
+            std::vector<Candidate> candidates;
+            //Atoms that cannot be evaluated first (e.g., negated)
+            std::vector<bool> excluded;
+            bool replanned;
+            int chosen;
+
+            RulePlan() : replanned(false), chosen(-1) {
+            }
+        };
+
+        std::mutex lock;
+        bool enabled;
+        //The key is the id of the rule and the index of the combination
+        std::map<std::pair<size_t, int>, RulePlan> plans;
+        uint64_t nReplanned;
+
+        int chooseFirstAtom(RulePlan &plan);
+
+    public:
+        PlanStatistics() : enabled(true), nReplanned(0) {
+        }
+
+        void setEnabled(bool enabled) {
+            this->enabled = enabled;
+        }
+
+        //Returns the position of the atom to evaluate first in the
+        //combination, or -1 to order the atoms on the estimates
+        int getFirstAtom(const size_t ruleid, const int combination);
+
+        //Records an execution that started from firstAtom. estimatedRows is
+        //the size of the intermediate results expected by the plan and
+        //inputRows the sum of the cardinalities of the atoms. excluded marks
+        //the atoms that must not be evaluated first. getRule is called only
+        //if the rule is logged
+        void record(const size_t ruleid, const int combination,
+                std::function<std::string()> getRule,
+                const int firstAtom,
+                const std::vector<bool> &excluded,
+                const double estimatedRows,
+                const double inputRows,
+                const double intermediateRows,
+                const double time);
+
+        //Statistics are loaded only if programHash is the one of the file.
+        //Returns false if the file cannot be read
+        bool load(const std::string &path, const uint64_t programHash);
+
+        void save(const std::string &path, const uint64_t programHash);
+
+        std::string toString();
+
+        //FNV-1a, to identify the program in the files of statistics
+        static uint64_t hashString(const std::string &s, uint64_t h = 14695981039346656037ULL);
+};
+
+#endif
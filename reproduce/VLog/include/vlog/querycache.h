@@ -0,0 +1,95 @@
+#ifndef _QUERYCACHE_H
+#define _QUERYCACHE_H
+
+#include <vlog/concepts.h>
+
+#include <trident/model/table.h>
+
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <inttypes.h>
+
+//Default size of the results in the cache
+#define QUERYCACHE_DEFAULT_BYTES (64 << 20)
+
+/*
+ * Results of queries, to answer the repeated ones without evaluating them
+ * again. The key is the normalized query: the predicate, the constants, and
+ * the positions of the variables numbered by their first occurrence (plus
+ * the options of the iterator). Every entry keeps the predicates the query
+ * depends on, so that it is dropped when their facts change. The least
+ * recently used entries are evicted when the results exceed the size.
+ */
+class QueryCache {
+    private:
+        struct Entry {
+            std::shared_ptr<TupleTable> table;
+            size_t bytes;
+            std::vector<PredId_t> dependencies;
+            std::list<std::string>::iterator lruPosition;
+        };
+
+        const size_t maxBytes;
+
+        std::mutex lock;
+        std::unordered_map<std::string, Entry> entries;
+        //Most recently used first
+        std::list<std::string> lru;
+        size_t bytes;
+
+        uint64_t nHits;
+        uint64_t nMisses;
+        uint64_t nEvictions;
+        uint64_t nInvalidations;
+
+        void remove(std::unordered_map<std::string, Entry>::iterator itr);
+
+    public:
+        VLIBEXP QueryCache(const size_t maxBytes);
+
+        static std::string getKey(const Literal &query, const bool returnOnlyVars,
+                const std::vector<uint8_t> *sortByFields);
+
+        //The predicates whose facts may change the answers of pred
+        static std::vector<PredId_t> getDependencies(Program &program,
+                const PredId_t pred);
+
+        //NULL if the query is not in the cache
+        VLIBEXP std::shared_ptr<TupleTable> get(const std::string &key);
+
+        VLIBEXP void put(const std::string &key, std::shared_ptr<TupleTable> table,
+                const std::vector<PredId_t> &dependencies);
+
+        //Drops the results that depend on pred
+        VLIBEXP void invalidate(const PredId_t pred);
+
+        VLIBEXP void clear();
+
+        uint64_t getNHits() {
+            std::lock_guard<std::mutex> guard(lock);
+            return nHits;
+        }
+
+        uint64_t getNMisses() {
+            std::lock_guard<std::mutex> guard(lock);
+            return nMisses;
+        }
+
+        size_t getNEntries() {
+            std::lock_guard<std::mutex> guard(lock);
+            return entries.size();
+        }
+
+        size_t getBytes() {
+            std::lock_guard<std::mutex> guard(lock);
+            return bytes;
+        }
+
+        VLIBEXP std::string getStats();
+};
+
+#endif
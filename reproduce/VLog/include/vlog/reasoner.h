@@ -7,12 +7,16 @@
 #include <vlog/seminaiver.h>
 #include <vlog/seminaiver_trigger.h>
 #include <vlog/consts.h>
+#include <vlog/costmodel.h>
+#include <vlog/querycache.h>
 
 #include <trident/kb/kb.h>
 #include <trident/kb/querier.h>
 
 #include <trident/sparql/query.h>
 
+#include <functional>
+
 #define QUERY_MAT 0
 #define QUERY_ONDEM 1
 
@@ -23,6 +27,17 @@ class Reasoner {
 
         const uint64_t threshold;
 
+        //Slice the program with the positive reliances before answering
+        //a query (see getRelevantProgram)
+        bool relevanceSlicing;
+        unsigned relevanceTimeout;
+
+        //Used by chooseMostEfficientAlgo instead of the threshold if set
+        bool useCostModel;
+        ReasoningCostModel costModel;
+
+        std::shared_ptr<QueryCache> queryCache;
+
         void cleanBindings(std::vector<Term_t> &bindings, std::vector<uint8_t> * posJoins,
                 TupleTable *input);
 
@@ -37,6 +52,13 @@ class Reasoner {
                 std::vector<Term_t> *possibleValuesJoins);
 
 
+        TupleIterator *getUncachedIterator(Literal &query,
+                std::vector<uint8_t> * posJoins,
+                std::vector<Term_t> *possibleValuesJoins,
+                EDBLayer &layer, Program &program,
+                bool returnOnlyVars,
+                std::vector<uint8_t> *sortByFields);
+
         TupleIterator *getIncrReasoningIterator(Literal &query,
                 std::vector<uint8_t> * posJoins,
                 std::vector<Term_t> *possibleValuesJoins,
@@ -46,7 +68,22 @@ class Reasoner {
 
     public:
 
-        Reasoner(const uint64_t threshold) : threshold(threshold) {}
+        Reasoner(const uint64_t threshold) : threshold(threshold),
+        relevanceSlicing(false), relevanceTimeout(0), useCostModel(false),
+        costModel(threshold) {}
+
+        //timeoutMs bounds the computation of the reliances of every query (0
+        //is no limit). After a timeout, the rules that may reach the query
+        //through the predicates are kept
+        void setRelevanceSlicing(const bool enabled, const unsigned timeoutMs) {
+            relevanceSlicing = enabled;
+            relevanceTimeout = timeoutMs;
+        }
+
+        //The rules of program on which the query relies. Returns NULL if
+        //slicing is disabled or if all rules are relevant
+        VLIBEXP std::shared_ptr<Program> getRelevantProgram(Literal &query,
+                Program &program);
 
         size_t estimate(Literal &query, std::vector<uint8_t> *posBindings,
                 std::vector<Term_t> *valueBindings, EDBLayer &layer,
@@ -57,6 +94,33 @@ class Reasoner {
                 std::vector<uint8_t> *posBindings,
                 std::vector<Term_t> *valueBindings);
 
+        void setCostModel(const ReasoningCostModel &model) {
+            useCostModel = true;
+            costModel = model;
+        }
+
+        //The answers of getIterator (without join bindings) and of
+        //getCachedIterator are kept in the cache if it is set
+        void setQueryCache(std::shared_ptr<QueryCache> cache) {
+            queryCache = cache;
+        }
+
+        std::shared_ptr<QueryCache> getQueryCache() {
+            return queryCache;
+        }
+
+        //The answers of query from the cache, or the ones of evaluate (which
+        //are then added to the cache)
+        VLIBEXP TupleIterator *getCachedIterator(Literal &query,
+                bool returnOnlyVars, std::vector<uint8_t> *sortByFields,
+                Program &program, std::function<TupleIterator *()> evaluate);
+
+        //Runs the queries with QSQR and magic sets, and fits a cost model
+        //(starting from the current one) on their runtimes. The model is
+        //then used by chooseMostEfficientAlgo
+        VLIBEXP ReasoningCostModel calibrate(std::vector<Literal> &queries,
+                EDBLayer &layer, Program &program, const int repeat);
+
         VLIBEXP TupleIterator *getIterator(Literal &query,
                 std::vector<uint8_t> * posJoins,
                 std::vector<Term_t> *possibleValuesJoins,
@@ -8,6 +8,6 @@
 #include <string>
 #include <algorithm>
 
-void experimentCoreStratified(const std::string &rulesPath, bool pieceDecomposition, RelianceStrategy strat, unsigned timeoutMilliSeconds, bool printCycles);
+void experimentCoreStratified(const std::string &rulesPath, bool pieceDecomposition, RelianceStrategy strat, unsigned timeoutMilliSeconds, bool printCycles, bool lazy = false);
 void experimentCycles(const std::string &rulePath, const std::string &algorithm, bool splitPositive, unsigned timeoutMilliSeconds);
-void experimentGRD(const std::string &rulesPath, unsigned timeoutMilliSeconds);
+void experimentGRD(const std::string &rulesPath, unsigned timeoutMilliSeconds, bool lazy = false);
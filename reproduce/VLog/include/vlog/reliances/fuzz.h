@@ -0,0 +1,30 @@
+#include <vlog/reliances/reliances.h>
+#include <vlog/concepts.h>
+#include <vlog/edbconf.h>
+#include <vlog/edb.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct FuzzParameters
+{
+    unsigned seed = 0;
+    unsigned timeBudgetSeconds = 60;
+
+    unsigned maxRules = 6;
+    unsigned numberOfPredicates = 4;
+    unsigned maxArity = 3;
+    unsigned maxBodySize = 3;
+    unsigned maxHeadSize = 3;
+    unsigned numberOfConstants = 2;
+
+    // Folder into which minimized programs are written
+    std::string reproducerFolder = ".";
+};
+
+// Generates random existential rule programs and compares the positive and restraint graphs
+// computed by every strategy against the ones computed by RelianceStrategy::Naive,
+// as well as the answers of the lazy acyclicity and core-stratification queries.
+// Returns true if no disagreement was found within the time budget.
+bool performFuzzTests(const FuzzParameters &parameters);
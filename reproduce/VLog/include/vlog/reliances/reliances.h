@@ -76,6 +76,83 @@ struct SimpleGraph
     }
 };
 
+// Maps predicates to the (sorted) rules in which they occur.
+// Candidates for a rule are collected in a reusable bitset,
+// which yields each candidate only once and in increasing order.
+struct PredicateRuleIndex
+{
+    std::unordered_map<PredId_t, std::vector<size_t>> predicateToRules;
+
+    PredicateRuleIndex(size_t numberOfRules)
+    {
+        candidateBits.resize((numberOfRules + 63) / 64, 0);
+        candidates.reserve(numberOfRules);
+    }
+
+    // Rules have to be added in increasing order
+    void addRule(PredId_t predicate, size_t ruleIndex)
+    {
+        std::vector<size_t> &predicateRules = predicateToRules[predicate];
+
+        if (predicateRules.empty() || predicateRules.back() != ruleIndex)
+            predicateRules.push_back(ruleIndex);
+    }
+
+    const std::vector<size_t> &getCandidates(const std::vector<Literal> &literals)
+    {
+        candidates.clear();
+
+        size_t firstWord = candidateBits.size(), lastWord = 0;
+        for (const Literal &currentLiteral : literals)
+        {
+            auto rulesIterator = predicateToRules.find(currentLiteral.getPredicate().getId());
+            if (rulesIterator == predicateToRules.end() || rulesIterator->second.empty())
+                continue;
+
+            for (size_t ruleIndex : rulesIterator->second)
+            {
+                candidateBits[ruleIndex / 64] |= (uint64_t)1 << (ruleIndex % 64);
+            }
+
+            firstWord = std::min(firstWord, rulesIterator->second.front() / 64);
+            lastWord = std::max(lastWord, rulesIterator->second.back() / 64);
+        }
+
+        for (size_t wordIndex = firstWord; wordIndex <= lastWord && wordIndex < candidateBits.size(); ++wordIndex)
+        {
+            uint64_t word = candidateBits[wordIndex];
+            candidateBits[wordIndex] = 0;
+
+            while (word != 0)
+            {
+                candidates.push_back(wordIndex * 64 + countTrailingZeros(word));
+                word &= word - 1;
+            }
+        }
+
+        return candidates;
+    }
+
+private:
+    std::vector<uint64_t> candidateBits;
+    std::vector<size_t> candidates;
+
+    static unsigned countTrailingZeros(uint64_t word)
+    {
+#if defined(_WIN32)
+        unsigned result = 0;
+        while ((word & 1) == 0)
+        {
+            word >>= 1;
+            ++result;
+        }
+        return result;
+#else
+        return (unsigned)__builtin_ctzll(word);
+#endif
+    }
+};
+
 enum class RelianceRuleRelation
 {
     From, To
@@ -108,6 +185,28 @@ struct CoreStratifiedResult
     std::vector<unsigned> smallestRestrainedComponent;
 };
 
+// Rules needed to answer a query, in increasing order
+struct RelevanceResult
+{
+    std::vector<size_t> rules;
+    size_t numberOfReachableRules = 0;
+    uint64_t numberOfCalls = 0;
+    bool timeout = false;
+    size_t timeMilliSeconds = 0;
+};
+
+// Features of the positive reliance graph of the rules relevant to a query
+struct RelevanceFeatures
+{
+    size_t numberOfRelevantRules = 0;
+    // Rules in groups with a cycle
+    size_t numberOfRecursiveRules = 0;
+    bool existentialRecursion = false;
+    size_t numberOfRestraints = 0;
+    bool timeout = false;
+    size_t timeMilliSeconds = 0;
+};
+
 const size_t rulePairCacheSize = 40000;
 struct RuleHashInfo
 {
@@ -357,6 +456,42 @@ struct RelianceGroupResult
     size_t minimumGroup;
 };
 
+enum class RelianceType
+{
+    Positive, Restraint
+};
+
+// Computes the outgoing reliances of a rule only when they are first requested,
+// so that yes/no questions about the graph can stop before all pairs are checked.
+// Produces the same edges as computePositiveReliances/computeRestrainReliances.
+struct LazyRelianceGraph
+{
+    LazyRelianceGraph(const std::vector<Rule> &rules, RelianceType type,
+        RelianceStrategy strat = RelianceStrategy::Full, unsigned timeoutMilliSeconds = 0);
+
+    const std::vector<size_t> &getSuccessors(size_t ruleFrom);
+
+    size_t size() const { return rules.size(); }
+
+    bool timeout = false;
+    uint64_t numberOfCalls = 0;
+private:
+    const std::vector<Rule> &rules;
+    RelianceType type;
+    RelianceStrategy strat;
+
+    std::vector<Rule> markedRules;
+    std::vector<unsigned> variableCounts;
+    std::vector<RuleHashInfo> ruleHashInfos;
+    PredicateRuleIndex candidateIndex;
+    std::unordered_map<std::string, bool> resultCache;
+
+    std::vector<std::vector<size_t>> successors;
+    std::vector<bool> computed;
+
+    bool isReliance(size_t ruleFrom, size_t ruleTo);
+};
+
 // Common
 TermInfo getTermInfoUnify(VTerm term, const VariableAssignments &assignments, RelianceRuleRelation relation);
 TermInfo getTermInfoModels(VTerm term, const VariableAssignments &assignments, RelianceRuleRelation relation, bool alwaysDefaultAssignExistentials);
@@ -376,8 +511,23 @@ std::pair<SimpleGraph, SimpleGraph> combineGraphs(const SimpleGraph &positiveGra
 void splitIntoPieces(const Rule &rule, std::vector<Rule> &outRules);
 RelianceGroupResult computeRelianceGroups(const SimpleGraph &graph, const SimpleGraph &graphTransposed, std::vector<bool> *activeNodes = nullptr);
 CoreStratifiedResult isCoreStratified(const SimpleGraph & unionGraph, const SimpleGraph & unionGraphTransposed, const SimpleGraph &restrainingGraph);
-std::string rulePairHash(RuleHashInfo ruleFromInfo, const RuleHashInfo &ruleToInfo, const Rule &ruleTo);
+std::string rulePairHash(RuleHashInfo &ruleFromInfo, const RuleHashInfo &ruleToInfo, const Rule &ruleTo);
 RuleHashInfo ruleHashInfoFirst(const Rule &rule);
 bool possiblySatisfied(const std::vector<Literal> &right, std::initializer_list<std::vector<Literal>> leftParts, const std::vector<std::reference_wrapper<const Literal>> &leftRef);
 bool possiblySatisfied(const std::vector<Literal> &right, std::initializer_list<std::vector<Literal>> leftParts);
+// Single pairs
+bool positiveReliance(const Rule &ruleFrom, unsigned variableCountFrom, const Rule &ruleTo, unsigned variableCountTo, RelianceStrategy strat);
+bool restrainReliance(const Rule &ruleFrom, unsigned variableCountFrom, const Rule &ruleTo, unsigned variableCountTo, RelianceStrategy strat);
+bool selfRestrainReliance(const Rule &rule, unsigned variableCount, RelianceStrategy strat);
+void positiveStartTimeout(unsigned timeoutMilliSeconds);
+bool positiveIsTimeout(bool rare);
+void restrainStartTimeout(unsigned timeoutMilliSeconds);
+bool restrainIsTimeout(bool rare);
+// Lazy queries, stopping at the first witness
+bool isAcyclicLazy(LazyRelianceGraph &graph);
+bool isCoreStratifiedLazy(LazyRelianceGraph &positiveGraph, LazyRelianceGraph &restraintGraph);
+
+// Query relevance
+RelevanceResult computeRelevantRules(const std::vector<Rule> &rules, const Literal &query, unsigned timeoutMilliSeconds = 0);
+RelevanceFeatures computeRelevanceFeatures(const std::vector<Rule> &rules, const Literal &query, unsigned timeoutMilliSeconds = 0);
 #endif
\ No newline at end of file
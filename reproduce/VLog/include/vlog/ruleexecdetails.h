@@ -14,6 +14,9 @@ struct RuleExecutionDetails {
     const Literal *atomFailure = NULL;
 
     uint32_t nIDBs = 0;
+    //Its head is never satisfied before it is applied, so the restricted
+    //chase does not check it
+    bool freshHead = false;
     std::vector<RuleExecutionPlan> orderExecutions;
 
     std::vector<uint8_t> posEDBVarsInHead;
@@ -23,6 +26,8 @@ struct RuleExecutionDetails {
 
     double executionTime = 0;
     double cardinalitySum = 1;
+    //Time spent removing the derivations that were already known (ms)
+    double duplicateEliminationTime = 0;
 
     RuleExecutionDetails(Rule rule, size_t ruleid) : rule(rule), ruleid(ruleid) {
         std::vector<Literal> bodyLiterals = rule.getBody();
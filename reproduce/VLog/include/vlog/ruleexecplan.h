@@ -52,6 +52,15 @@ struct RuleExecutionPlan {
     //Created by RuleExecutionDetails::createExecutionPlan
     std::map<Var_t, std::vector<Var_t>> dependenciesExtVars;
 
+    //Set if the variables of the body form a cyclic hypergraph (e.g.,
+    //triangles). Such bodies can be evaluated with a leapfrog triejoin over
+    //all the literals at once (see leapfrogjoin.h), which binds the variables
+    //in the order of trieJoinVars. trieJoinPosFromFirst maps the positions of
+    //the head to the bound variables.
+    bool cyclicBody = false;
+    std::vector<Var_t> trieJoinVars;
+    std::vector<std::pair<uint8_t, uint8_t>> trieJoinPosFromFirst;
+
     //Check if we can apply filtering HashMap. See comment above
     void checkIfFilteringHashMapIsPossible(const Literal &head);
 
@@ -61,6 +70,11 @@ struct RuleExecutionPlan {
     void calculateJoinsCoordinates(const std::vector<Literal> &heads,
             bool copyAllVars);
 
+    void calculateTrieJoinCoordinates(const std::vector<Literal> &heads);
+
+    //GYO reduction of the hypergraph formed by the variables of the literals
+    static bool hasCyclicVariableStructure(const std::vector<const Literal*> &plan);
+
     RuleExecutionPlan reorder(std::vector<int> &order,
             const std::vector<Literal> &heads,
             bool copyAllVars) const;
@@ -148,7 +148,7 @@ class VectorSegmentIterator final : public SegmentIterator {
         }
 };
 
-class Segment {
+class Segment : public SlabObject {
     private:
         const uint8_t nfields;
         std::shared_ptr<Column> *columns;
@@ -361,7 +361,7 @@ class Segment {
 class FCInternalTableItr;
 class FCInternalTable;
 
-class SegmentInserter {
+class SegmentInserter : public SlabObject {
     private:
         const uint8_t nfields;
         std::vector<ColumnWriter> columns;
@@ -8,6 +8,9 @@
 #include <vlog/ruleexecdetails.h>
 #include <vlog/chasemgmt.h>
 #include <vlog/consts.h>
+#include <vlog/arena.h>
+#include <vlog/planstats.h>
+#include <vlog/spill.h>
 
 #include <trident/model/table.h>
 
@@ -62,10 +65,25 @@ class SemiNaiver {
         std::vector<StatsRule> statsRuleExecution;
 
         bool ignoreDuplicatesElimination;
+        bool useTrieJoin;
+        bool useHashJoin;
+        bool skipFreshHeadChecks;
         std::vector<int> stratification;
         int nStratificationClasses;
         Program *RMFC_program;
 
+        //Buffers of the rule executions. Rewound after every execution
+        TupleArena arena;
+
+        //Observed costs of the plans, and the file where they are kept
+        //between runs (empty if they are not)
+        PlanStatistics planStats;
+        std::string planStatsPath;
+
+        //Spills the old blocks of the IDB tables when the process exceeds the
+        //memory budget (NULL if there is no budget)
+        std::unique_ptr<SpillManager> spillManager;
+
 #ifdef WEBINTERFACE
         long statsLastIteration;
         std::string currentRule;
@@ -100,14 +118,30 @@ class SemiNaiver {
                 std::vector<std::pair<uint8_t, uint8_t>> *filterValueVars,
                 ResultJoinProcessor *joinOutput);
 
+        //If firstAtom is not -1, the plan starts from that atom
         void reorderPlan(RuleExecutionPlan &plan,
                 const std::vector<size_t> &cards,
                 const std::vector<Literal> &headLiteral,
-                bool copyAllVars);
+                bool copyAllVars,
+                const int firstAtom = -1);
+
+        uint64_t getProgramHash();
 
         void reorderPlanForNegatedLiterals(RuleExecutionPlan &plan,
                 const std::vector<Literal> &heads);
 
+        bool canUseTrieJoin(const RuleExecutionDetails &ruleDetails,
+                const RuleExecutionPlan &plan);
+
+        //Returns false if the combination must be joined atom by atom
+        bool executeTrieJoin(const RuleExecutionDetails &ruleDetails,
+                RuleExecutionPlan &plan,
+                std::vector<Literal> &heads,
+                const size_t iteration,
+                const int orderExecution,
+                int &processedTables,
+                std::vector<ResultJoinProcessor*> *finalResultContainer);
+
         void executeRules(
                 std::vector<RuleExecutionDetails> &EDBRules,
                 std::vector<RuleExecutionDetails> &ExtEDBRules,
@@ -160,6 +194,21 @@ class SemiNaiver {
 
         void prepare(size_t lastExecution, int singleRuleToCheck, std::vector<RuleExecutionDetails> &allrules);
 
+        //Whether the heads of the rules that are never satisfied before the
+        //rules are applied go unchecked in this run
+        bool skipsFreshHeadChecks() const {
+            return skipFreshHeadChecks &&
+                typeChase == TypeChase::RESTRICTED_CHASE && !checkCyclicTerms;
+        }
+
+        //Marks the existential rules whose head is never satisfied before
+        //they are applied, and returns their number
+        size_t markFreshHeadRules(const std::vector<RuleExecutionDetails*> &rules);
+
+        //Spills old blocks if the process exceeds the memory budget. Must
+        //not run while other threads read the tables
+        void checkMemoryBudget(const std::vector<RuleExecutionDetails> &ruleset);
+
         void setIgnoreDuplicatesElimination() {
             ignoreDuplicatesElimination = true;
         }
@@ -201,6 +250,41 @@ class SemiNaiver {
             return opt_intersect;
         }
 
+        //Evaluate rules with a cyclic body with a leapfrog triejoin instead
+        //of a sequence of binary joins (enabled by default)
+        void setTrieJoin(bool enabled) {
+            useTrieJoin = enabled;
+        }
+
+        //Evaluate the generic binary joins with a hash table on the
+        //intermediate results instead of a merge join (disabled by default)
+        void setHashJoin(bool enabled) {
+            useHashJoin = enabled;
+        }
+
+        bool usesHashJoin() const {
+            return useHashJoin;
+        }
+
+        //In the restricted chase, do not check whether the head of the
+        //existential rules is already satisfied when it never can be: no
+        //other rule derives its predicates, and every atom of the head has
+        //its own predicate and all the variables of the body (disabled by
+        //default)
+        void setSkipFreshHeadChecks(bool enabled) {
+            skipFreshHeadChecks = enabled;
+        }
+
+        //Re-plan the rules whose intermediate results are much larger than
+        //estimated (enabled by default). If statsPath is not empty, the
+        //statistics of the plans are loaded from and saved to that file
+        VLIBEXP void setAdaptivePlans(bool enabled, const std::string &statsPath);
+
+        //Keep the resident memory under bytes (0 disables the budget) by
+        //spilling the blocks of old iterations to files in directory
+        VLIBEXP void setMemoryBudget(const size_t bytes,
+                const std::string &directory);
+
         std::shared_ptr<ChaseMgmt> getChaseManager() {
             return chaseMgmt;
         }
@@ -164,8 +164,8 @@ private:
     // bool executeGroupBottomUp(std::vector<RuleExecutionDetails> &ruleset, std::vector<unsigned> &rulesetOrder, std::vector<StatIteration> &costRules, bool blocked, unsigned long *timeout);
     // bool executeGroupInOrder(std::vector<RuleExecutionDetails> &ruleset, std::vector<unsigned> &rulesetOrder, std::vector<StatIteration> &costRules, bool blocked, unsigned long *timeout);
     // bool executeGroupAverageRuntime(std::vector<RuleExecutionDetails> &ruleset, std::vector<StatIteration> &costRules, bool blocked, unsigned long *timeout);
-    PositiveGroup *executeGroupUnrestrainedFirst(RestrainedGroup &group, std::vector<StatIteration> &costRules, unsigned long *timeout, SemiNaiverOrderedType strategy);
-    PositiveGroup *executeGroupByPositiveGroups(RestrainedGroup &group, std::vector<StatIteration> &costRules, unsigned long *timeout);
+    PositiveGroup *executeGroupUnrestrainedFirst(RestrainedGroup &group, const std::vector<RuleExecutionDetails> &ruleset, std::vector<StatIteration> &costRules, unsigned long *timeout, SemiNaiverOrderedType strategy);
+    PositiveGroup *executeGroupByPositiveGroups(RestrainedGroup &group, const std::vector<RuleExecutionDetails> &ruleset, std::vector<StatIteration> &costRules, unsigned long *timeout);
 };
 
 #endif
@@ -0,0 +1,54 @@
+#ifndef _SORTEDKERNELS_H
+#define _SORTEDKERNELS_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <utility>
+#include <functional>
+
+#include <vlog/term.h>
+
+/*
+ * Search and intersection kernels over the raw data of sorted columns. The
+ * searches gallop (exponential followed by binary search) and finish with a
+ * linear scan, which uses AVX2 or SSE4.2 if the CPU supports it. The
+ * implementation is chosen at runtime, so that the binary does not need to
+ * be compiled for a specific instruction set.
+ */
+class SortedKernels {
+    public:
+        enum Implementation { SCALAR, SSE42, AVX2 };
+
+        //First position in [start, end) whose value is >= v (end if none)
+        static size_t lowerBound(const Term_t *values, size_t start,
+                const size_t end, const Term_t v);
+
+        //First position in [start, end) whose value is > v (end if none)
+        static size_t upperBound(const Term_t *values, const size_t start,
+                const size_t end, const Term_t v);
+
+        //Appends the values that occur in both sorted and duplicate-free
+        //arrays to output. Merges arrays of similar size, and gallops over
+        //the larger one otherwise.
+        static void intersect(const Term_t *values1, const size_t size1,
+                const Term_t *values2, const size_t size2,
+                std::vector<Term_t> &output);
+
+        static Implementation getImplementation();
+
+        //Returns false if the CPU does not support the implementation
+        static bool setImplementation(Implementation impl);
+
+        static std::string getImplementationName(Implementation impl);
+
+        //Prints the time of the merge loop used by Column::intersection, of
+        //the galloping intersection and of lowerBound with every kernel on
+        //synthetic sorted columns with size1 and size2 values (one in
+        //density values of a range is present), followed by a sweep of the
+        //second size across the threshold between merge and gallop
+        static void benchmark(const size_t size1, const size_t size2,
+                const unsigned density);
+};
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef _SPILL_H
+#define _SPILL_H
+
+#include <vlog/column.h>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <inttypes.h>
+
+class Segment;
+
+//Smaller columns stay in memory when a segment is spilled
+#define SPILL_MIN_COLUMN_BYTES 4096
+//Number of values written at once
+#define SPILL_WRITE_BUFFER 65536
+
+/*
+ * Read-only memory mapping of a file with the columns of a spilled segment.
+ * The file is unlinked as soon as it is mapped, so it disappears with the
+ * mapping (or with the process). The pages are read back by the OS when the
+ * columns are accessed, and SpillManager::releasePages drops them from the
+ * resident set again.
+ */
+class MappedFile {
+    private:
+        char *data;
+        size_t length;
+        std::atomic<bool> resident;
+
+    public:
+        MappedFile(char *data, const size_t length) : data(data),
+        length(length), resident(false) {
+        }
+
+        const char *getData() const {
+            return data;
+        }
+
+        size_t getLength() const {
+            return length;
+        }
+
+        //Counts a page-in if the pages were released since the last access
+        void touch() {
+            if (!resident.load(std::memory_order_relaxed) &&
+                    !resident.exchange(true)) {
+                countPageIn();
+            }
+        }
+
+        void release();
+
+        void countPageIn();
+
+        ~MappedFile();
+};
+
+class MappedColumnReader final : public ColumnReader {
+    private:
+        const Term_t *values;
+        const size_t _size;
+        size_t position;
+
+    public:
+        MappedColumnReader(const Term_t *values, const size_t size) :
+            values(values), _size(size), position(0) {
+            }
+
+        Term_t first() {
+            return values[0];
+        }
+
+        Term_t last() {
+            return values[_size - 1];
+        }
+
+        std::vector<Term_t> asVector() {
+            return std::vector<Term_t>(values, values + _size);
+        }
+
+        bool hasNext() {
+            return position < _size;
+        }
+
+        Term_t next() {
+            return values[position++];
+        }
+
+        void clear() {
+        }
+};
+
+//Column of a spilled segment: its values are an array in a mapped file
+class MappedColumn final : public Column {
+    private:
+        std::shared_ptr<MappedFile> file;
+        const Term_t *values;
+        const size_t _size;
+
+    public:
+        MappedColumn(std::shared_ptr<MappedFile> file, const size_t offset,
+                const size_t size) : file(file),
+        values((const Term_t *) (file->getData() + offset)), _size(size) {
+        }
+
+        size_t size() const {
+            return _size;
+        }
+
+        size_t getRepresentationSize() const {
+            return _size;
+        }
+
+        //The values are on disk
+        size_t getBytes() const {
+            return 0;
+        }
+
+        size_t estimateSize() const {
+            return _size;
+        }
+
+        bool isEmpty() const {
+            return _size == 0;
+        }
+
+        Term_t getValue(const size_t pos) const {
+            file->touch();
+            return values[pos];
+        }
+
+        bool supportsDirectAccess() const {
+            return true;
+        }
+
+        bool isEDB() const {
+            return false;
+        }
+
+        bool containsDuplicates() const {
+            return _size > 1;
+        }
+
+        std::unique_ptr<ColumnReader> getReader() const {
+            file->touch();
+            return std::unique_ptr<ColumnReader>(new MappedColumnReader(
+                        values, _size));
+        }
+
+        std::shared_ptr<Column> sort() const;
+
+        std::shared_ptr<Column> sort(const int nthreads) const;
+
+        std::shared_ptr<Column> unique() const;
+
+        bool isIn(const Term_t t) const {
+            file->touch();
+            return std::binary_search(values, values + _size, t);
+        }
+
+        bool isConstant() const {
+            return _size < 2;
+        }
+
+        Term_t first() const {
+            assert(_size > 0);
+            file->touch();
+            return values[0];
+        }
+};
+
+/*
+ * Keeps the materialization under a memory budget. When the resident set
+ * exceeds the budget, the pages of the spilled segments are released first,
+ * and then the segments of the oldest blocks of the IDB tables are written
+ * to files in a directory and replaced by mapped columns (see
+ * SemiNaiver::checkMemoryBudget). The tables keep working as before: the
+ * OS reads the pages back when they are accessed.
+ */
+class SpillManager {
+    private:
+        const size_t budget;
+        const std::string directory;
+
+        std::mutex lock;
+        std::vector<std::weak_ptr<MappedFile>> files;
+
+        uint64_t nSpilledSegments;
+        uint64_t spilledBytes;
+        uint64_t nReleases;
+
+    public:
+        SpillManager(const size_t budget, const std::string &directory);
+
+        size_t getBudget() const {
+            return budget;
+        }
+
+        //Bytes above the budget (0 if the process is within the budget)
+        size_t getExcess() const;
+
+        //Writes the large columns of the segment to a file. Returns the
+        //segment with the mapped columns, or NULL if nothing was spilled. freed
+        //is set to the bytes that were in memory
+        std::shared_ptr<const Segment> spill(const Segment &segment,
+                const uint8_t nfields, size_t &freed);
+
+        //Drops the pages of the spilled segments from the resident set
+        void releasePages();
+
+        std::string getStats();
+
+        //Page-ins since the start of the process
+        static uint64_t getNPageIns();
+};
+
+#endif
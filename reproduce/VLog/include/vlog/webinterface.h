@@ -6,6 +6,7 @@
 #ifdef WEBINTERFACE
 
 #include <vlog/seminaiver.h>
+#include <vlog/querycache.h>
 #include <vlog/trident/tridenttable.h>
 
 #include <layers/TridentLayer.hpp>
@@ -24,6 +25,56 @@
 #include <map>
 #include <condition_variable>
 #include <mutex>
+#include <atomic>
+
+//Latencies kept for the percentiles of every endpoint
+#define WEB_LATENCY_SAMPLES 1024
+
+/*
+ * Lock of the state of the web interface (the EDB layer, the program and
+ * the materialization). The requests that only read it share the lock,
+ * while /setup and /launchMat take it alone. Waiting writers block new
+ * readers, so that they are not starved.
+ */
+class WebStateLock {
+    private:
+        std::mutex mutex;
+        std::condition_variable cv;
+        int readers;
+        int waitingWriters;
+        bool writer;
+
+    public:
+        WebStateLock() : readers(0), waitingWriters(0), writer(false) {
+        }
+
+        void lockShared();
+
+        void unlockShared();
+
+        void lock();
+
+        void unlock();
+};
+
+//Latency percentiles of the requests of every endpoint
+class WebRequestStats {
+    private:
+        struct Endpoint {
+            uint64_t count;
+            double maxMs;
+            //The last WEB_LATENCY_SAMPLES latencies
+            std::vector<double> samples;
+        };
+
+        std::mutex mutex;
+        std::map<std::string, Endpoint> endpoints;
+
+    public:
+        void add(const std::string &endpoint, const double ms);
+
+        void toJSON(JSON &out);
+};
 
 class VLogLayer;
 class WebInterface {
@@ -31,11 +82,23 @@ class WebInterface {
         ProgramArgs &vm;
         std::unique_ptr<Program> program;
         std::unique_ptr<EDBLayer> edb;
-        std::unique_ptr<VLogLayer> vloglayer;
+        //Every concurrent SPARQL query over the program has its own layer,
+        //because the layers keep buffers
+        std::mutex vloglayersMutex;
+        std::vector<std::unique_ptr<VLogLayer>> vloglayers;
         std::unique_ptr<TridentLayer> tridentlayer;
+        std::mutex tridentlayerMutex;
+        //Answers of the SPARQL queries over the program
+        std::shared_ptr<QueryCache> queryCache;
 
         void setupTridentLayer();
 
+        void addQueryCacheStats(JSON &pt);
+
+        std::unique_ptr<VLogLayer> getVLogLayer();
+
+        void releaseVLogLayer(std::unique_ptr<VLogLayer> layer);
+
     private:
         std::shared_ptr<SemiNaiver> sn;
         std::thread t;
@@ -47,19 +110,26 @@ class WebInterface {
 
         std::shared_ptr<HttpServer> server;
 
-        bool isActive;
+        std::atomic<int> nActive;
+        WebStateLock stateLock;
+        WebRequestStats requestStats;
         std::string edbFile;
         int webport;
         int nthreads;
 
         map<std::string, std::string> cachehtml;
+        std::mutex cachehtmlMutex;
+        std::mutex programMutex;
 
         void startThread(int port);
 
         void processMaterialization();
 
+        //Called by the threads of the server
         void processRequest(std::string req, std::string &resp);
 
+        void handleRequest(std::string req, std::string &resp);
+
         void getResultsQueryLiteral(std::string predicate, long limit, JSON &out);
 
     public:
@@ -79,11 +149,11 @@ class WebInterface {
         long getDurationExecMs();
 
         void setActive() {
-            isActive = true;
+            nActive++;
         }
 
         void setInactive() {
-            isActive = false;
+            nActive--;
         }
 
         void join() {
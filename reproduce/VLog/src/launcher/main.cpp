@@ -4,14 +4,20 @@
 #include <vlog/seminaiver.h>
 #include <vlog/edbconf.h>
 #include <vlog/edb.h>
+#include <vlog/inmemory/inmemorytable.h>
+#include <vlog/sortedkernels.h>
+#include <vlog/packedcolumn.h>
 #include <vlog/webinterface.h>
 #include <vlog/fcinttable.h>
 #include <vlog/exporter.h>
+#include <vlog/matexporter.h>
+#include <vlog/incremental.h>
 #include <vlog/utils.h>
 #include <vlog/ml/ml.h>
 #include <vlog/deps/detector.h>
 #include <vlog/reliances/experiments.h>
 #include <vlog/reliances/tests.h>
+#include <vlog/reliances/fuzz.h>
 
 #include <vlog/cycles/checker.h>
 
@@ -44,6 +50,7 @@
 #include <chrono>
 #include <thread>
 #include <cmath>
+#include <random>
 
 void printHelp(const char *programName, ProgramArgs &desc) {
     cout << "Usage: " << programName << " <command> [options]" << endl << endl;
@@ -60,6 +67,10 @@ void printHelp(const char *programName, ProgramArgs &desc) {
     cout << "cycles\t\t try and detect cycles in the rules." << endl << endl;
     cout << "deps\t\t detect dependencies in the database." << endl << endl;
     cout << "rel\t\t detect reliances in the rule set." << endl << endl;
+    cout << "snapshot\t store a CSV/NT file in the binary format of INMEMORY tables." << endl << endl;
+    cout << "calibrate\t fit the choice between QSQR and magic sets on a workload of queries." << endl << endl;
+    cout << "incremental\t compare the incremental update of the materialization after removing and adding facts with a full materialization." << endl << endl;
+    cout << "benchkernels\t compare the merge loop of the joins with the (SIMD) sorted-column kernels." << endl << endl;
 
     cout << desc.tostring() << endl;
 }
@@ -82,7 +93,8 @@ bool checkParams(ProgramArgs &vm, int argc, const char** argv) {
 
     if (cmd != "help" && cmd != "query" && cmd != "lookup" && cmd != "load" && cmd != "queryLiteral"
             && cmd != "mat" && cmd != "mat_tg" && cmd != "rulesgraph" && cmd != "server" && cmd != "gentq" &&
-            cmd != "cycles" && cmd !="deps" && cmd != "rel") {
+            cmd != "cycles" && cmd !="deps" && cmd != "rel" && cmd != "snapshot" &&
+            cmd != "benchkernels" && cmd != "calibrate" && cmd != "incremental") {
         printErrorMsg("The command \"" + cmd + "\" is unknown.");
         return false;
     }
@@ -220,6 +232,40 @@ bool checkParams(ProgramArgs &vm, int argc, const char** argv) {
                 return false;
             }
         }
+        else if (cmd == "calibrate") {
+            std::string queryFile = vm["query"].as<string>();
+            if (queryFile.empty() || !Utils::exists(queryFile)) {
+                printErrorMsg("The query file \"" + queryFile + "\" doesn't exist.");
+                return false;
+            }
+            if (vm["costModel"].as<string>().empty()) {
+                printErrorMsg("You must set up the \"costModel\" parameter to store the calibration");
+                return false;
+            }
+        }
+        else if (cmd == "incremental") {
+            std::string path = vm["rules"].as<string>();
+            if (path.empty() || !Utils::exists(path)) {
+                printErrorMsg("The rule file \"" + path + "\" does not exists");
+                return false;
+            }
+            if (vm["updatePredicate"].as<string>().empty()) {
+                printErrorMsg("You must set up the \"updatePredicate\" parameter to update the materialization");
+                return false;
+            }
+            int perc = vm["updatePerc"].as<int>();
+            if (perc <= 0 || perc > 100) {
+                printErrorMsg("The \"updatePerc\" parameter must be between 1 and 100");
+                return false;
+            }
+        }
+        else if (cmd == "snapshot") {
+            std::string path = vm["table"].as<string>();
+            if (path.empty() || !Utils::exists(path)) {
+                printErrorMsg("The table file \"" + path + "\" does not exist");
+                return false;
+            }
+        }
     }
 
     return true;
@@ -243,6 +289,12 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
             false);
     query_options.add<string>("", "selectionStrategy", "",
             "Determines the selection strategy (only for <queryLiteral>, when \"auto\" is specified for the reasoningAlgorithm). Possible values are \"cardEst\", ... (to be extended) .", false);
+    query_options.add<bool>("", "sliceQueries", false,
+            "Before answering a query (only for <queryLiteral>), keep only the rules on which it relies through the positive reliances. Default is false.", false);
+    query_options.add<int>("", "sliceTimeout", 1000,
+            "Timeout in milliseconds of the computation of the relevant rules of a query. After it, the rules that may reach the query through the predicates are kept. 0 is no limit. Default is 1000.", false);
+    query_options.add<string>("", "costModel", "",
+            "File with the cost model that chooses between QSQR and magic sets from the estimated cost and the reliances of the query (written by <calibrate>, which reads one query per line from --query). Default is '' (only the reasoningThreshold).", false);
     query_options.add<int64_t>("", "matThreshold", 10000000,
             "In case reasoning is activated, this parameter sets a threshold above which a full materialization is performed before we execute the query. Default is 10000000 (10M).", false);
     query_options.add<bool>("", "printResults", true,
@@ -250,7 +302,7 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
     query_options.add<bool>("", "automat", false,
             "Automatically premateralialize some atoms.", false);
     query_options.add<bool>("", "printRepresentationSize", false,
-            "Print the representation size of the materialization.", false);
+            "Print the representation size of the materialization, and the bytes per row of the IDB predicates.", false);
     query_options.add<int>("", "timeoutPremat", 1000000,
             "Timeout used during automatic prematerialization (in microseconds). Default is 1000000 (i.e. one second per query)", false);
     query_options.add<string>("", "premat", "",
@@ -263,8 +315,28 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
             "Set maximum number of threads to use when run in multithreaded mode. Default is " + to_string(std::max((unsigned int)1, std::thread::hardware_concurrency() / 2)), false);
     query_options.add<int>("", "interRuleThreads", 0,
             "Set maximum number of threads to use for inter-rule parallelism. Default is 0", false);
+    query_options.add<bool>("", "skipFreshHeadChecks", false,
+            "In the restricted chase, do not check whether the head of an existential rule is already satisfied when it never can be: no other rule derives its predicates, and every head atom has its own predicate and all the body variables. Default is false.", false);
     query_options.add<bool>("", "ordered", false, 
             "Whether or not to use the ordered version of the seminaive algorithm.", false);
+    query_options.add<bool>("", "trieJoin", true,
+            "Evaluate rules whose body has a cyclic variable structure (e.g., triangles) with a leapfrog triejoin instead of binary joins. Default is true.", false);
+    query_options.add<bool>("", "hashJoin", false,
+            "Evaluate the generic binary joins with a partitioned hash table on the smaller side, the intermediate results or the literal, probed by several threads, instead of a merge join. Default is false.", false);
+    query_options.add<int>("", "dupFilterBits", RETAIN_FILTER_BITS_PER_ROW,
+            "Bits per row of the filters that skip the duplicate check of new derivations in large IDB tables. 0 disables them. Default is " + to_string(RETAIN_FILTER_BITS_PER_ROW), false);
+    query_options.add<int>("", "dupFilterMaxMB", RETAIN_FILTER_MAX_BYTES / 1024 / 1024,
+            "Maximum size in MB of the filter of one IDB table. Default is " + to_string(RETAIN_FILTER_MAX_BYTES / 1024 / 1024), false);
+    query_options.add<int>("", "packColumns", PACKED_COLUMN_MIN_ROWS,
+            "Minimum number of rows of the columns that are stored bit-packed (as a frame of reference or a dictionary) when it saves memory. 0 disables the packing. Default is " + to_string(PACKED_COLUMN_MIN_ROWS), false);
+    query_options.add<bool>("", "adaptivePlans", true,
+            "Re-plan the rules whose intermediate results are much larger than estimated, starting from the body atom with the lowest observed cost. Default is true.", false);
+    query_options.add<string>("", "planStats", "",
+            "File where the statistics of the re-planned rules are kept between runs of the same program. Default is '' (disabled).", false);
+    query_options.add<int>("", "memoryBudget", 0,
+            "Memory budget of the materialization in MB. When it is exceeded, the old blocks of the IDB tables are spilled to memory-mapped files. Default is 0 (no budget).", false);
+    query_options.add<string>("", "spillDir", "",
+            "Directory of the files of the spilled blocks. Default is '' ($TMPDIR or /tmp).", false);
 
     query_options.add<bool>("", "shufflerules", false,
             "shuffle rules randomly instead of using heuristics (only for <mat>, and only when running multithreaded).", false);
@@ -273,7 +345,11 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
     query_options.add<string>("","storemat_path", "",
             "Directory where to store all results of the materialization. Default is '' (disable).",false);
     query_options.add<string>("","storemat_format", "files",
-            "Format in which to dump the materialization. 'files' simply dumps the IDBs in files. 'csv' creates comma-separated files. 'db' creates a new RDF database. Default is 'files'.",false);
+            "Format in which to dump the materialization. 'files' simply dumps the IDBs in files. 'csv' creates comma-separated files. 'binary' writes the IDs of the terms column by column. 'db' creates a new RDF database. Default is 'files'.",false);
+    query_options.add<int>("","storemat_threads", 1,
+            "Number of threads that write the materialization in the formats 'files', 'csv' and 'binary'. Default is 1.",false);
+    query_options.add<bool>("","storemat_compress", false,
+            "Compress the files of the materialization with gzip (formats 'files', 'csv' and 'binary'). Default is false.",false);
     query_options.add<bool>("","explain", false,
             "Explain the query instead of executing it. Default is false.",false);
     query_options.add<bool>("","decompressmat", false,
@@ -318,6 +394,10 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
     ProgramArgs::GroupArgs& server_options = *vm.newGroup("Options for <server>");
     server_options.add<string>("","webpages", "../webinterface",
             "Path to the webpages relative to where the executable is. Default is ../webinterface", false);
+    server_options.add<int>("","queryCacheMB", QUERYCACHE_DEFAULT_BYTES / 1024 / 1024,
+            "Size in MB of the cache of the answers of the repeated queries of the web interface. 0 disables it. Default is " + to_string(QUERYCACHE_DEFAULT_BYTES / 1024 / 1024), false);
+    server_options.add<int>("","webThreads", 4,
+            "Number of threads that answer the requests of the web interface. Only /setup and /launchMat wait for the others. Default is 4", false);
 
     ProgramArgs::GroupArgs& generateTraining_options = *vm.newGroup("Options for command <gentq>");
     generateTraining_options.add<int>("", "maxTuples", 500, "Number of EDB tuples to consider for training", false);
@@ -334,6 +414,28 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
             "Path to the edb conf file. Default is 'edb.conf' in the same directory as the exec file.",false);
     cmdline_options.add<int>("","sleep", 0, "sleep <arg> seconds before starting the run. Useful for attaching profiler.",false);
 
+    ProgramArgs::GroupArgs& snapshot_options = *vm.newGroup("Options for <snapshot>");
+    snapshot_options.add<string>("", "table", "",
+            "Path to the .csv or .nt file of an INMEMORY table.", false);
+    snapshot_options.add<string>("", "snapshotFile", "",
+            "Path of the snapshot. Default is the table file with the extension .snap, where INMEMORY tables look for it.", false);
+
+    ProgramArgs::GroupArgs& bench_options = *vm.newGroup("Options for <benchkernels>");
+    bench_options.add<int64_t>("", "size1", 1000000,
+            "Number of values of the first column. Default is 1000000.", false);
+    bench_options.add<int64_t>("", "size2", 10000,
+            "Number of values of the second column. Default is 10000.", false);
+    bench_options.add<int>("", "density", 10,
+            "The columns contain about one in <arg> values of their range. Default is 10.", false);
+
+    ProgramArgs::GroupArgs& incremental_options = *vm.newGroup("Options for <incremental>");
+    incremental_options.add<string>("", "updatePredicate", "",
+            "EDB predicate whose facts are removed and added again (the rules are read from --rules).", false);
+    incremental_options.add<int>("", "updatePerc", 1,
+            "Percentage of the facts of the predicate that are updated. Default is 1.", false);
+    incremental_options.add<int>("", "updateSeed", 0,
+            "Seed of the choice of the updated facts. Default is 0.", false);
+
     ProgramArgs::GroupArgs& rel_options = *vm.newGroup("Options for <rel>");
     rel_options.add<string>("", "rule", "",
             "Path to file containing the rule set.", false);
@@ -353,6 +455,14 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
             "Prints restraining-cycle.", false);
     rel_options.add<bool>("", "grd", false,
             "Runs GRD experiment", false);
+    rel_options.add<bool>("", "lazy", false,
+            "Computes reliances on demand and stops at the first cycle (GRD) or restrained component (core-stratification). Only the yes/no answer is reported.", false);
+    rel_options.add<bool>("", "fuzz", false,
+            "If set compares all strategies against the naive one on randomly generated rule sets. Use rule parameter to supply folder for the minimized reproducers.", false);
+    rel_options.add<int>("", "fuzzBudget", 60,
+            "Time budget of the fuzz tests in seconds.", false);
+    rel_options.add<int>("", "fuzzSeed", 0,
+            "Seed of the fuzz tests (0 picks one from the clock).", false);
     
     vm.parse(argc, argv);
     return checkParams(vm, argc, argv);
@@ -524,9 +634,12 @@ void launchTriggeredMat(int argc,
 
         std::string storemat_format = vm["storemat_format"].as<string>();
 
-        if (storemat_format == "files" || storemat_format == "csv") {
-            sn->storeOnFiles(vm["storemat_path"].as<string>(),
-                    vm["decompressmat"].as<bool>(), 0, storemat_format == "csv");
+        MatExportFormat format;
+        if (MatExporter::parseFormat(storemat_format, format)) {
+            MatExporter exporter(*sn, format, vm["decompressmat"].as<bool>(),
+                    vm["storemat_compress"].as<bool>(),
+                    vm["storemat_threads"].as<int>());
+            exporter.storeOnFiles(vm["storemat_path"].as<string>());
         } else if (storemat_format == "db") {
             //I will store the details on a Trident index
             exp.generateTridentDiffIndex(vm["storemat_path"].as<string>());
@@ -559,14 +672,25 @@ void printRepresentationSize(std::shared_ptr<SemiNaiver> sn) {
             continue;
         }
         FCIterator itr = sn->getTable(i);
+        std::string predName = sn->getProgram()->getPredicateName(i);
+        size_t bytes = 0;
+        size_t rows = 0;
         while (!itr.isEmpty()) {
             auto table = itr.getCurrentTable();
-            //Get predicate name
-            std::string predName = sn->getProgram()->getPredicateName(i);
             LOG(DEBUGL) << "Adding the representation size for " << i << " " << predName << " current size: " << size;
             size += table->getRepresentationSize(columnsIDs);
+            if (!table->isEDB()) {
+                for (uint8_t j = 0; j < table->getRowSize(); ++j) {
+                    bytes += table->getColumn(j)->getBytes();
+                }
+            }
+            rows += table->getNRows();
             itr.moveNextCount();
         }
+        if (rows > 0 && sn->getProgram()->isPredicateIDB(i)) {
+            LOG(INFOL) << "Memory of " << predName << ": " << bytes <<
+                " bytes, " << (double) bytes / rows << " bytes/row";
+        }
     }
     LOG(INFOL) << "Representation size: " << size;
 }
@@ -635,6 +759,16 @@ void launchFullMat(int argc,
                 vm["shufflerules"].as<bool>(),
                 NULL,
                 vm["ordered"].as<bool>());
+        sn->setTrieJoin(vm["trieJoin"].as<bool>());
+        sn->setHashJoin(vm["hashJoin"].as<bool>());
+        sn->setSkipFreshHeadChecks(vm["skipFreshHeadChecks"].as<bool>());
+        FCTable::setRetainFilter(std::max(0, vm["dupFilterBits"].as<int>()),
+                (size_t) std::max(1, vm["dupFilterMaxMB"].as<int>()) * 1024 * 1024);
+        ColumnWriter::setPackMinRows(std::max(0, vm["packColumns"].as<int>()));
+        sn->setAdaptivePlans(vm["adaptivePlans"].as<bool>(),
+                vm["planStats"].as<string>());
+        sn->setMemoryBudget((size_t) std::max(0, vm["memoryBudget"].as<int>()) *
+                1024 * 1024, vm["spillDir"].as<string>());
 
 #ifdef WEBINTERFACE
         //Start the web interface if requested
@@ -667,6 +801,11 @@ void launchFullMat(int argc,
         sn->run();
         std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
         LOG(INFOL) << "Runtime materialization = " << sec.count() * 1000 << " milliseconds";
+        if (vm["skipFreshHeadChecks"].as<bool>() && !vm["ordered"].as<bool>() &&
+                sn->getChaseManager()) {
+            LOG(INFOL) << "Restricted checks skipped for the rules with fresh heads: " <<
+                sn->getChaseManager()->getSkippedChecks();
+        }
         sn->printCountAllIDBs("");
 
 #if defined(__linux__) || defined(__linux) || defined(linux) || defined(__gnu_linux__)
@@ -689,9 +828,12 @@ void launchFullMat(int argc,
 
             std::string storemat_format = vm["storemat_format"].as<string>();
 
-            if (storemat_format == "files" || storemat_format == "csv") {
-                sn->storeOnFiles(vm["storemat_path"].as<string>(),
-                        vm["decompressmat"].as<bool>(), 0, storemat_format == "csv");
+            MatExportFormat format;
+            if (MatExporter::parseFormat(storemat_format, format)) {
+                MatExporter exporter(*sn, format, vm["decompressmat"].as<bool>(),
+                        vm["storemat_compress"].as<bool>(),
+                        vm["storemat_threads"].as<int>());
+                exporter.storeOnFiles(vm["storemat_path"].as<string>());
             } else if (storemat_format == "db") {
                 //I will store the details on a Trident index
                 exp.generateTridentDiffIndex(vm["storemat_path"].as<string>());
@@ -717,7 +859,7 @@ void launchFullMat(int argc,
     }
 }
 
-void launchRelianceComputation(ProgramArgs &vm) {
+bool launchRelianceComputation(ProgramArgs &vm) {
     std::string pathRules = vm["rule"].as<string>();
     bool pieceDecomposition = vm["piece"].as<bool>();
     int32_t strategy = vm["strat"].as<int32_t>();
@@ -728,8 +870,19 @@ void launchRelianceComputation(ProgramArgs &vm) {
     std::string algorithm = vm["alg"].as<string>();
     bool printCycles = vm["printCycles"].as<bool>();
     bool isGRD = vm["grd"].as<bool>();
+    bool isFuzz = vm["fuzz"].as<bool>();
+    bool isLazy = vm["lazy"].as<bool>();
 
-    if (isTest)
+    if (isFuzz)
+    {
+        FuzzParameters parameters;
+        parameters.seed = (unsigned)vm["fuzzSeed"].as<int>();
+        parameters.timeBudgetSeconds = (unsigned)vm["fuzzBudget"].as<int>();
+        parameters.reproducerFolder = pathRules;
+
+        return performFuzzTests(parameters);
+    }
+    else if (isTest)
     {
         performTests(pathRules, (RelianceStrategy)strategy);
     }
@@ -739,12 +892,14 @@ void launchRelianceComputation(ProgramArgs &vm) {
     }
     else if (isGRD)
     {
-        experimentGRD(pathRules, timeout);
+        experimentGRD(pathRules, timeout, isLazy);
     }
     else
     {
-        experimentCoreStratified(pathRules, pieceDecomposition, (RelianceStrategy)strategy, (unsigned)timeout, printCycles);
+        experimentCoreStratified(pathRules, pieceDecomposition, (RelianceStrategy)strategy, (unsigned)timeout, printCycles, isLazy);
     }
+
+    return true;
 }
 
 void execSPARQLQuery(EDBLayer &edb, ProgramArgs &vm) {
@@ -838,10 +993,14 @@ std::string selectStrategy(EDBLayer &edb, Program &p, Literal &literal, Reasoner
     throw 10;
 }
 
-void runLiteralQuery(EDBLayer &edb, Program &p, Literal &literal, Reasoner &reasoner, ProgramArgs &vm) {
+void runLiteralQuery(EDBLayer &edb, Program &program, Literal &literal, Reasoner &reasoner, ProgramArgs &vm) {
 
     std::chrono::system_clock::time_point startQ1 = std::chrono::system_clock::now();
 
+    //The slicing is part of the runtime of the query
+    std::shared_ptr<Program> relevantProgram = reasoner.getRelevantProgram(literal, program);
+    Program &p = relevantProgram != NULL ? *relevantProgram : program;
+
     std::string algo = vm["reasoningAlgo"].as<string>();
     int times = vm["repeatQuery"].as<int>();
     bool printResults = vm["printResults"].as<bool>();
@@ -996,9 +1155,183 @@ void execLiteralQuery(EDBLayer &edb, ProgramArgs &vm) {
     Dictionary dictVariables;
     Literal literal = p.parseLiteral(query, dictVariables);
     Reasoner reasoner(vm["reasoningThreshold"].as<int64_t>());
+    reasoner.setRelevanceSlicing(vm["sliceQueries"].as<bool>(),
+            vm["sliceTimeout"].as<int>());
+    std::string costModelFile = vm["costModel"].as<string>();
+    if (!costModelFile.empty()) {
+        ReasoningCostModel model(vm["reasoningThreshold"].as<int64_t>());
+        if (model.load(costModelFile)) {
+            reasoner.setCostModel(model);
+        } else {
+            LOG(WARNL) << "Cannot read the cost model in " << costModelFile;
+        }
+    }
     runLiteralQuery(edb, p, literal, reasoner, vm);
 }
 
+void calibrateCostModel(EDBLayer &edb, ProgramArgs &vm) {
+    Program p(&edb);
+    std::string s = p.readFromFile(vm["rules"].as<string>(),
+            vm["rewriteMultihead"].as<bool>());
+    if (!s.empty()) {
+        LOG(ERRORL) << s;
+        return;
+    }
+    p.sortRulesByIDBPredicates();
+
+    //One query per line
+    std::vector<Literal> queries;
+    std::ifstream inFile(vm["query"].as<string>());
+    std::string line;
+    while (std::getline(inFile, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        Dictionary dictVariables;
+        queries.push_back(p.parseLiteral(line, dictVariables));
+    }
+
+    Reasoner reasoner(vm["reasoningThreshold"].as<int64_t>());
+    std::string costModelFile = vm["costModel"].as<string>();
+    ReasoningCostModel model(vm["reasoningThreshold"].as<int64_t>());
+    if (model.load(costModelFile)) {
+        reasoner.setCostModel(model);
+    }
+    model = reasoner.calibrate(queries, edb, p, vm["repeatQuery"].as<int>());
+    model.save(costModelFile);
+    LOG(INFOL) << "Stored the cost model in " << costModelFile;
+}
+
+//Sorted facts of an IDB predicate, one row after the other, to compare two
+//materializations
+static std::vector<Term_t> getIDBFacts(Program &p, SemiNaiver *sn,
+        const PredId_t pred) {
+    const uint8_t card = p.getPredicate(pred).getCardinality();
+    std::vector<std::vector<Term_t>> rows;
+    FCIterator itr = sn->getTable(pred);
+    while (!itr.isEmpty()) {
+        std::shared_ptr<const FCInternalTable> table = itr.getCurrentTable();
+        FCInternalTableItr *titr = table->getIterator();
+        while (titr->hasNext()) {
+            titr->next();
+            std::vector<Term_t> row(card);
+            for (uint8_t i = 0; i < card; ++i) {
+                row[i] = titr->getCurrentValue(i);
+            }
+            rows.push_back(row);
+        }
+        table->releaseIterator(titr);
+        itr.moveNextCount();
+    }
+    std::sort(rows.begin(), rows.end());
+    std::vector<Term_t> facts;
+    facts.reserve(rows.size() * card);
+    for (const auto &row : rows) {
+        facts.insert(facts.end(), row.begin(), row.end());
+    }
+    return facts;
+}
+
+//Returns the number of IDB predicates whose facts are different
+static size_t compareIDBFacts(Program &p, SemiNaiver *sn1, SemiNaiver *sn2,
+        const char *name) {
+    size_t different = 0;
+    for (const PredId_t pred : p.getAllPredicateIDs()) {
+        if (p.isPredicateIDB(pred) &&
+                getIDBFacts(p, sn1, pred) != getIDBFacts(p, sn2, pred)) {
+            LOG(ERRORL) << "The facts of " << p.getPredicateName(pred) <<
+                " are different after the " << name;
+            different++;
+        }
+    }
+    return different;
+}
+
+static double getMs(std::chrono::system_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+            std::chrono::system_clock::now() - start).count();
+}
+
+void benchIncremental(EDBLayer &edb, ProgramArgs &vm) {
+    Program p(&edb);
+    std::string s = p.readFromFile(vm["rules"].as<string>(),
+            vm["rewriteMultihead"].as<bool>());
+    if (!s.empty()) {
+        LOG(ERRORL) << s;
+        return;
+    }
+    p.sortRulesByIDBPredicates();
+
+    std::string predName = vm["updatePredicate"].as<string>();
+    Predicate pred = p.getPredicate(predName);
+    if (pred.getCardinality() == 0 || pred.getType() != EDB) {
+        LOG(ERRORL) << "The predicate " << predName << " is not an EDB predicate";
+        return;
+    }
+
+    //Pick the updated facts
+    VTuple t(pred.getCardinality());
+    for (int i = 0; i < t.getSize(); ++i) {
+        t.set(VTerm(i + 1, 0), i);
+    }
+    EDBIterator *itr = edb.getIterator(Literal(pred, t));
+    EDBFacts facts(pred.getCardinality());
+    while (itr->hasNext()) {
+        itr->next();
+        for (int i = 0; i < t.getSize(); ++i) {
+            facts[i].push_back(itr->getElementAt(i));
+        }
+    }
+    edb.releaseIterator(itr);
+    const size_t nfacts = facts[0].size();
+    std::vector<size_t> rows(nfacts);
+    for (size_t i = 0; i < nfacts; ++i) {
+        rows[i] = i;
+    }
+    std::mt19937 gen(vm["updateSeed"].as<int>());
+    std::shuffle(rows.begin(), rows.end(), gen);
+    rows.resize(nfacts * vm["updatePerc"].as<int>() / 100);
+    std::map<PredId_t, EDBFacts> updated, none;
+    EDBFacts &updatedFacts = updated[pred.getId()];
+    updatedFacts.resize(pred.getCardinality());
+    for (const size_t row : rows) {
+        for (int i = 0; i < t.getSize(); ++i) {
+            updatedFacts[i].push_back(facts[i][row]);
+        }
+    }
+    LOG(INFOL) << "Updating " << rows.size() << " of the " << nfacts <<
+        " facts of " << predName;
+
+    IncrementalMaintenance maint(edb, &p, !vm["no-intersect"].as<bool>(),
+            !vm["no-filtering"].as<bool>(),
+            vm["restrictedChase"].as<bool>() ? TypeChase::RESTRICTED_CHASE :
+            TypeChase::SKOLEM_CHASE, vm["multithreaded"].as<bool>() ?
+            vm["nthreads"].as<int>() : -1);
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    std::unique_ptr<SemiNaiver> sn(maint.materialize());
+    LOG(INFOL) << "Full materialization: " << getMs(start) << "ms";
+
+    //Remove the facts, and add them back
+    for (int step = 0; step < 2; ++step) {
+        const char *name = step == 0 ? "removal" : "addition";
+        if (step == 0) {
+            maint.update(sn, none, updated);
+        } else {
+            maint.update(sn, updated, none);
+        }
+        LOG(INFOL) << "Incremental " << name << ": " <<
+            maint.getLastStats().tostring();
+        start = std::chrono::system_clock::now();
+        SemiNaiver *full = maint.materialize();
+        LOG(INFOL) << "Full materialization after the " << name << ": " <<
+            getMs(start) << "ms";
+        if (compareIDBFacts(p, sn.get(), full, name) == 0) {
+            LOG(INFOL) << "The facts of the IDB predicates are the same after the " << name;
+        }
+        delete full;
+    }
+}
+
 void checkAcyclicity(std::string ruleFile, std::string alg, EDBLayer &db, bool rewriteMultihead) {
 	std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
     int response = Checker::checkFromFile(ruleFile, alg, db, rewriteMultihead);
@@ -1056,7 +1389,8 @@ int main(int argc, const char** argv) {
         edbFile = dirExecFile + DIR_SEP + std::string("edb.conf");
     }
 
-    if (cmd != "load" && cmd != "rel" && !Utils::exists(edbFile)) {
+    if (cmd != "load" && cmd != "rel" && cmd != "snapshot" && cmd != "benchkernels"
+            && !Utils::exists(edbFile)) {
         printErrorMsg("I could not find the EDB conf file " + edbFile);
         return EXIT_FAILURE;
     }
@@ -1273,7 +1607,42 @@ int main(int argc, const char** argv) {
 	delete layer;
     }
     else if (cmd == "rel") {
-        launchRelianceComputation(vm);
+        if (!launchRelianceComputation(vm)) {
+            return EXIT_FAILURE;
+        }
+    }
+    else if (cmd == "snapshot") {
+        std::string tableFile = vm["table"].as<string>();
+        std::string repository = Utils::parentDir(tableFile);
+        std::string tableName = Utils::removeExtension(Utils::filename(tableFile));
+        std::string snapshotFile = vm["snapshotFile"].as<string>();
+        if (snapshotFile.empty()) {
+            snapshotFile = repository + DIR_SEP + tableName + ".snap";
+        }
+        // Parse the table into an empty layer, so that only its own terms are stored
+        EDBConf emptyConf("", false);
+        EDBLayer layer(emptyConf, false);
+        InmemoryTable table(repository, tableName, 0, &layer);
+        table.writeSnapshot(snapshotFile);
+        LOG(INFOL) << "Stored " << table.getSize() << " rows in " << snapshotFile;
+    }
+    else if (cmd == "calibrate") {
+        EDBConf conf(edbFile);
+        EDBLayer *layer = new EDBLayer(conf, false);
+        calibrateCostModel(*layer, vm);
+        delete layer;
+    }
+    else if (cmd == "incremental") {
+        EDBConf conf(edbFile);
+        EDBLayer *layer = new EDBLayer(conf, false);
+        benchIncremental(*layer, vm);
+        delete layer;
+    }
+    else if (cmd == "benchkernels") {
+        LOG(INFOL) << "Kernels selected for this CPU: " <<
+            SortedKernels::getImplementationName(SortedKernels::getImplementation());
+        SortedKernels::benchmark(vm["size1"].as<int64_t>(), vm["size2"].as<int64_t>(),
+                vm["density"].as<int>());
     }
 
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
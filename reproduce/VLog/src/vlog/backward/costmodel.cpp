@@ -0,0 +1,128 @@
+#include <vlog/costmodel.h>
+
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+
+RelevanceFeatures ReasoningCostModel::getFeatures(const Literal &query,
+        Program &program) {
+    std::vector<Rule> rules = program.getAllRules();
+    return computeRelevanceFeatures(rules, query, COSTMODEL_RELIANCE_TIMEOUT);
+}
+
+double ReasoningCostModel::getAdjustedCost(const uint64_t cost,
+        const RelevanceFeatures &features) const {
+    //Incomplete features are not used
+    if (features.timeout) {
+        return cost;
+    }
+    return cost * (1 + recursionWeight * features.numberOfRecursiveRules +
+            restraintWeight * features.numberOfRestraints);
+}
+
+bool ReasoningCostModel::preferTopDown(const uint64_t cost,
+        const RelevanceFeatures &features) const {
+    if (features.existentialRecursion && !features.timeout) {
+        return false;
+    }
+    return getAdjustedCost(cost, features) < threshold;
+}
+
+void ReasoningCostModel::fit(const std::vector<CalibrationSample> &samples) {
+    if (samples.empty()) {
+        LOG(WARNL) << "No queries to calibrate the cost model";
+        return;
+    }
+    static const double weights[] = {0, 0.1, 0.25, 0.5, 1, 2, 4, 8, 16};
+    static const double restraintWeights[] = {0, 0.1, 0.5, 1, 4};
+
+    double bestTime = std::numeric_limits<double>::max();
+    ReasoningCostModel best(*this);
+    for (const double rw : weights) {
+        for (const double sw : restraintWeights) {
+            ReasoningCostModel candidate(*this);
+            candidate.recursionWeight = rw;
+            candidate.restraintWeight = sw;
+
+            //The thresholds between the adjusted costs of the samples
+            std::vector<double> costs;
+            for (const auto &s : samples) {
+                costs.push_back(candidate.getAdjustedCost(s.cost, s.features));
+            }
+            std::sort(costs.begin(), costs.end());
+            std::vector<double> thresholds;
+            thresholds.push_back(0);
+            for (size_t i = 1; i < costs.size(); ++i) {
+                thresholds.push_back((costs[i - 1] + costs[i]) / 2 + 1);
+            }
+            thresholds.push_back(costs.back() + 1);
+
+            for (const double t : thresholds) {
+                candidate.threshold = (uint64_t) std::min(t,
+                        (double) std::numeric_limits<uint64_t>::max() / 2);
+                double time = 0;
+                for (const auto &s : samples) {
+                    time += candidate.preferTopDown(s.cost, s.features) ?
+                        s.topDownMs : s.magicMs;
+                }
+                //Ties keep the smallest weights and threshold
+                if (time < bestTime) {
+                    bestTime = time;
+                    best = candidate;
+                }
+            }
+        }
+    }
+
+    double timeTopDown = 0, timeMagic = 0, timeOracle = 0, timeBefore = 0;
+    for (const auto &s : samples) {
+        timeTopDown += s.topDownMs;
+        timeMagic += s.magicMs;
+        timeOracle += std::min(s.topDownMs, s.magicMs);
+        timeBefore += preferTopDown(s.cost, s.features) ? s.topDownMs : s.magicMs;
+    }
+    LOG(INFOL) << "Calibration on " << samples.size() << " queries: " <<
+        "QSQR " << timeTopDown << "ms, magic " << timeMagic << "ms, best " <<
+        timeOracle << "ms, model before " << timeBefore << "ms, fitted " <<
+        bestTime << "ms";
+    *this = best;
+    LOG(INFOL) << "Fitted cost model: " << tostring();
+}
+
+bool ReasoningCostModel::load(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string header;
+    uint64_t t;
+    double rw, sw;
+    if (!(file >> header >> t >> rw >> sw) || header != "costmodel") {
+        LOG(WARNL) << "Malformed cost model in " << path << ": ignored";
+        return false;
+    }
+    threshold = t;
+    recursionWeight = rw;
+    restraintWeight = sw;
+    return true;
+}
+
+void ReasoningCostModel::save(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file) {
+        LOG(ERRORL) << "Cannot write the cost model in " << path;
+        return;
+    }
+    file << "costmodel " << threshold << " " << recursionWeight << " " <<
+        restraintWeight << std::endl;
+}
+
+std::string ReasoningCostModel::tostring() const {
+    std::stringstream ss;
+    ss << "threshold " << threshold << ", recursion weight " <<
+        recursionWeight << ", restraint weight " << restraintWeight;
+    return ss.str();
+}
@@ -110,8 +110,12 @@ void EDBLayer::addInmemoryTable(const EDBConf::Table &tableConf) {
     const std::string pn = tableConf.predname;
     infot.id = (PredId_t) predDictionary->getOrAdd(pn);
     infot.type = tableConf.type;
+    int loadThreads = 1;
+    if (tableConf.params.size() > 2 && tableConf.params[2] != "") {
+        loadThreads = std::max(1, (int) strtol(tableConf.params[2].c_str(), NULL, 10));
+    }
     InmemoryTable *table = new InmemoryTable(tableConf.params[0],
-            tableConf.params[1], infot.id, this);
+            tableConf.params[1], infot.id, this, loadThreads);
     infot.manager = std::shared_ptr<EDBTable>(table);
     infot.arity = table->getArity();
     dbPredicates.insert(make_pair(infot.id, infot));
@@ -137,6 +141,21 @@ void EDBLayer::addInmemoryTable(std::string predicate, PredId_t id, std::vector<
     LOG(DEBUGL) << "Added table for " << predicate << ":" << infot.id << ", arity = " << (int) table->getArity() << ", size = " << table->getSize();
 }
 
+void EDBLayer::addInmemoryTable(std::string predicate,
+        std::vector<std::vector<Term_t>> &columns) {
+    EDBInfoTable infot;
+    infot.id = (PredId_t) predDictionary->getOrAdd(predicate);
+    if (doesPredExists(infot.id)) {
+        LOG(INFOL) << "Rewriting table for predicate " << predicate;
+        dbPredicates.erase(infot.id);
+    }
+    infot.type = "INMEMORY";
+    InmemoryTable *table = new InmemoryTable(infot.id, columns, this);
+    infot.arity = table->getArity();
+    infot.manager = std::shared_ptr<EDBTable>(table);
+    dbPredicates.insert(make_pair(infot.id, infot));
+    LOG(DEBUGL) << "Added table for " << predicate << ":" << infot.id << ", arity = " << (int) table->getArity() << ", size = " << table->getSize();
+}
 
 void EDBLayer::addInmemoryTable(PredId_t id,
         uint8_t arity,
@@ -154,6 +173,20 @@ void EDBLayer::addInmemoryTable(PredId_t id,
     dbPredicates.insert(make_pair(infot.id, infot));
 }
 
+void EDBLayer::replaceInmemoryTable(PredId_t id,
+        std::shared_ptr<InmemoryTable> table) {
+    EDBInfoTable infot;
+    infot.id = id;
+    if (doesPredExists(infot.id)) {
+        LOG(DEBUGL) << "Replacing table for predicate " << id;
+        dbPredicates.erase(infot.id);
+    }
+    infot.type = "INMEMORY";
+    infot.arity = table->getArity();
+    infot.manager = table;
+    dbPredicates.insert(make_pair(infot.id, infot));
+}
+
 #ifdef SPARQL
 void EDBLayer::addSparqlTable(const EDBConf::Table &tableConf) {
     EDBInfoTable infot;
@@ -0,0 +1,142 @@
+#include <vlog/querycache.h>
+
+#include <kognac/logs.h>
+
+#include <sstream>
+#include <algorithm>
+
+QueryCache::QueryCache(const size_t maxBytes) : maxBytes(maxBytes), bytes(0),
+    nHits(0), nMisses(0), nEvictions(0), nInvalidations(0) {
+    }
+
+std::string QueryCache::getKey(const Literal &query, const bool returnOnlyVars,
+        const std::vector<uint8_t> *sortByFields) {
+    std::string key;
+    const PredId_t pred = query.getPredicate().getId();
+    key.append((const char *) &pred, sizeof(pred));
+    key += (char) returnOnlyVars;
+    //The variables are numbered by their first occurrence
+    std::vector<Var_t> vars;
+    for (int i = 0; i < query.getTupleSize(); ++i) {
+        VTerm t = query.getTermAtPos(i);
+        if (t.isVariable()) {
+            auto itr = std::find(vars.begin(), vars.end(), t.getId());
+            if (itr == vars.end()) {
+                vars.push_back(t.getId());
+                itr = vars.end() - 1;
+            }
+            key += 'v';
+            key += (char) (itr - vars.begin());
+        } else {
+            const uint64_t value = t.getValue();
+            key += 'c';
+            key.append((const char *) &value, sizeof(value));
+        }
+    }
+    if (sortByFields != NULL) {
+        key += 's';
+        key.append(sortByFields->begin(), sortByFields->end());
+    }
+    return key;
+}
+
+std::vector<PredId_t> QueryCache::getDependencies(Program &program,
+        const PredId_t pred) {
+    std::vector<PredId_t> dependencies;
+    dependencies.push_back(pred);
+    for (size_t i = 0; i < dependencies.size(); ++i) {
+        const PredId_t p = dependencies[i];
+        if (p >= program.getNPredicates()) {
+            continue;
+        }
+        for (const uint32_t ruleid : program.getRulesIDsByPredicate(p)) {
+            for (const auto &literal : program.getRule(ruleid).getBody()) {
+                const PredId_t bodyPred = literal.getPredicate().getId();
+                if (std::find(dependencies.begin(), dependencies.end(),
+                            bodyPred) == dependencies.end()) {
+                    dependencies.push_back(bodyPred);
+                }
+            }
+        }
+    }
+    std::sort(dependencies.begin(), dependencies.end());
+    return dependencies;
+}
+
+void QueryCache::remove(std::unordered_map<std::string, Entry>::iterator itr) {
+    bytes -= itr->second.bytes;
+    lru.erase(itr->second.lruPosition);
+    entries.erase(itr);
+}
+
+std::shared_ptr<TupleTable> QueryCache::get(const std::string &key) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto itr = entries.find(key);
+    if (itr == entries.end()) {
+        nMisses++;
+        return NULL;
+    }
+    nHits++;
+    lru.splice(lru.begin(), lru, itr->second.lruPosition);
+    return itr->second.table;
+}
+
+void QueryCache::put(const std::string &key, std::shared_ptr<TupleTable> table,
+        const std::vector<PredId_t> &dependencies) {
+    const size_t size = key.size() + sizeof(Entry) +
+        table->getNRows() * table->getSizeRow() * sizeof(uint64_t);
+    if (size > maxBytes) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    auto itr = entries.find(key);
+    if (itr != entries.end()) {
+        remove(itr);
+    }
+    while (bytes + size > maxBytes && !lru.empty()) {
+        remove(entries.find(lru.back()));
+        nEvictions++;
+    }
+    lru.push_front(key);
+    Entry &entry = entries[key];
+    entry.table = table;
+    entry.bytes = size;
+    entry.dependencies = dependencies;
+    entry.lruPosition = lru.begin();
+    bytes += size;
+}
+
+void QueryCache::invalidate(const PredId_t pred) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto itr = entries.begin();
+    while (itr != entries.end()) {
+        const std::vector<PredId_t> &deps = itr->second.dependencies;
+        if (std::binary_search(deps.begin(), deps.end(), pred)) {
+            auto next = itr;
+            ++next;
+            remove(itr);
+            nInvalidations++;
+            itr = next;
+        } else {
+            ++itr;
+        }
+    }
+}
+
+void QueryCache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    nInvalidations += entries.size();
+    entries.clear();
+    lru.clear();
+    bytes = 0;
+}
+
+std::string QueryCache::getStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    std::stringstream ss;
+    ss << entries.size() << " queries (" << bytes / 1024 << "KB of " <<
+        maxBytes / 1024 << "KB), " << nHits << " hits, " << nMisses <<
+        " misses, " << nEvictions << " evictions, " << nInvalidations <<
+        " invalidations";
+    return ss.str();
+}
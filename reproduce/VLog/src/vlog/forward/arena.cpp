@@ -0,0 +1,203 @@
+#include <vlog/arena.h>
+
+#include <kognac/logs.h>
+#include <kognac/utils.h>
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+static thread_local TupleArena *currentArena = NULL;
+
+TupleArena::Scope::Scope(TupleArena &arena) : arena(arena),
+    previous(currentArena) {
+        currentArena = &arena;
+    }
+
+TupleArena::Scope::~Scope() {
+    currentArena = previous;
+    arena.rewind();
+}
+
+TupleArena *TupleArena::getCurrent() {
+    return currentArena;
+}
+
+TupleArena::TupleArena() : currentChunk(0), offset(0), usedBytes(0),
+    peakBytes(0), nAllocations(0), nRewinds(0) {
+        for (int i = 0; i < ARENA_NCLASSES; ++i) {
+            freeLists[i] = NULL;
+        }
+    }
+
+int TupleArena::getSizeClass(const size_t size) {
+    int c = 0;
+    while (c < ARENA_NCLASSES && ((size_t) ARENA_MIN_BLOCK << c) < size) {
+        c++;
+    }
+    return c < ARENA_NCLASSES ? c : -1;
+}
+
+void *TupleArena::allocate(const size_t size) {
+    const int c = getSizeClass(size);
+    if (c < 0) {
+        return ::operator new(size);
+    }
+    const size_t blockSize = (size_t) ARENA_MIN_BLOCK << c;
+    std::lock_guard<std::mutex> guard(lock);
+    nAllocations++;
+    usedBytes += blockSize;
+    if (usedBytes > peakBytes) {
+        peakBytes = usedBytes;
+    }
+    if (freeLists[c] != NULL) {
+        FreeBlock *block = freeLists[c];
+        freeLists[c] = block->next;
+        return block;
+    }
+    if (offset + blockSize > ARENA_CHUNK_SIZE) {
+        //The rest of the chunk is unused until the arena is rewound
+        currentChunk++;
+        offset = 0;
+    }
+    if (currentChunk == chunks.size()) {
+        chunks.push_back((char *) ::operator new(ARENA_CHUNK_SIZE));
+    }
+    void *p = chunks[currentChunk] + offset;
+    offset += blockSize;
+    return p;
+}
+
+void TupleArena::deallocate(void *p, const size_t size) {
+    const int c = getSizeClass(size);
+    if (c < 0) {
+        ::operator delete(p);
+        return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    FreeBlock *block = (FreeBlock *) p;
+    block->next = freeLists[c];
+    freeLists[c] = block;
+    usedBytes -= (size_t) ARENA_MIN_BLOCK << c;
+}
+
+void TupleArena::rewind() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (usedBytes != 0) {
+        LOG(DEBUGL) << "Arena not rewound: " << usedBytes << " bytes are in use";
+        return;
+    }
+    for (int i = 0; i < ARENA_NCLASSES; ++i) {
+        freeLists[i] = NULL;
+    }
+    currentChunk = 0;
+    offset = 0;
+    while (chunks.size() > ARENA_RETAINED_CHUNKS) {
+        ::operator delete(chunks.back());
+        chunks.pop_back();
+    }
+    nRewinds++;
+}
+
+TupleArena::~TupleArena() {
+    if (usedBytes != 0) {
+        //Some buffers outlive the arena: do not release their memory
+        LOG(WARNL) << "Arena destroyed while " << usedBytes << " bytes are in use";
+        return;
+    }
+    for (auto chunk : chunks) {
+        ::operator delete(chunk);
+    }
+}
+
+struct SlabClass {
+    std::mutex lock;
+    void *freeList;
+    char *slab;
+    size_t offset;
+
+    SlabClass() : freeList(NULL), slab(NULL), offset(SLAB_SIZE) {
+    }
+};
+
+//Never destroyed, because objects can be freed during the static destruction
+static SlabClass *getSlabClasses() {
+    static SlabClass *classes = new SlabClass[SLAB_MAX_OBJECT / 16];
+    return classes;
+}
+
+static std::atomic<size_t> slabObjects(0);
+static std::atomic<size_t> slabBytes(0);
+
+void *ObjectSlab::allocate(const size_t size) {
+    if (size == 0 || size > SLAB_MAX_OBJECT) {
+        return ::operator new(size);
+    }
+    const size_t c = (size - 1) / 16;
+    const size_t objectSize = (c + 1) * 16;
+    SlabClass &sc = getSlabClasses()[c];
+    std::lock_guard<std::mutex> guard(sc.lock);
+    slabObjects++;
+    if (sc.freeList != NULL) {
+        void *p = sc.freeList;
+        sc.freeList = *((void **) p);
+        return p;
+    }
+    if (sc.offset + objectSize > SLAB_SIZE) {
+        sc.slab = (char *) ::operator new(SLAB_SIZE);
+        sc.offset = 0;
+        slabBytes += SLAB_SIZE;
+    }
+    void *p = sc.slab + sc.offset;
+    sc.offset += objectSize;
+    return p;
+}
+
+void ObjectSlab::deallocate(void *p, const size_t size) {
+    if (p == NULL) {
+        return;
+    }
+    if (size == 0 || size > SLAB_MAX_OBJECT) {
+        ::operator delete(p);
+        return;
+    }
+    SlabClass &sc = getSlabClasses()[(size - 1) / 16];
+    std::lock_guard<std::mutex> guard(sc.lock);
+    *((void **) p) = sc.freeList;
+    sc.freeList = p;
+    slabObjects--;
+}
+
+size_t ObjectSlab::getNObjects() {
+    return slabObjects;
+}
+
+size_t ObjectSlab::getReservedBytes() {
+    return slabBytes;
+}
+
+size_t MemoryStats::getCurrentRSS() {
+    //The second field of statm is the number of resident pages
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    if (!(statm >> size >> resident)) {
+        return 0;
+    }
+    return resident * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+std::string MemoryStats::toString(const TupleArena *arena) {
+    std::stringstream ss;
+    ss << "RSS " << getCurrentRSS() / 1024 / 1024 << "MB, peak " <<
+        Utils::get_max_mem() << "MB";
+    if (arena != NULL) {
+        ss << ", arena peak " << arena->getPeakBytes() / 1024 << "KB in " <<
+            arena->getReservedBytes() / 1024 / 1024 << "MB (" <<
+            arena->getNAllocations() << " blocks, " << arena->getNRewinds() <<
+            " rewinds)";
+    }
+    ss << ", slabs " << ObjectSlab::getNObjects() << " objects in " <<
+        ObjectSlab::getReservedBytes() / 1024 << "KB";
+    return ss.str();
+}
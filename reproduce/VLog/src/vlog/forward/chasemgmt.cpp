@@ -1,8 +1,11 @@
 #include <vlog/chasemgmt.h>
 
+#include <trident/utils/parallel.h>
+
+#include <algorithm>
+
 //************** ROWS ***************
-uint64_t ChaseMgmt::Rows::addRow(uint64_t* row) {
-    // LOG(TRACEL) << "Addrow: " << row[0];
+uint64_t *ChaseMgmt::Rows::storeRow(const uint64_t *row, uint64_t &value) {
     if (!currentblock || blockCounter >= SIZE_BLOCK) {
         //Create a new block
         std::unique_ptr<uint64_t[]> n =
@@ -12,18 +15,17 @@ uint64_t ChaseMgmt::Rows::addRow(uint64_t* row) {
         blocks.push_back(std::move(n));
         blockCounter = 0;
     }
+    uint64_t *stored = currentblock;
     for(uint8_t i = 0; i < sizerow; ++i) {
-        currentblock[i] = row[i];
+        stored[i] = row[i];
     }
-    ChaseRow r(sizerow, currentblock);
-    rows[r] = currentcounter;
     currentblock += sizerow;
     blockCounter++;
     if (((uint32_t)currentcounter) == UINT32_MAX) {
         LOG(ERRORL) << "I can assign at most 2^32 new IDs to an ext. variable... Stop!";
         throw 10;
     }
-    auto out = currentcounter;
+    value = currentcounter;
     if (typeChase != TypeChase::SUM_CHASE && typeChase != TypeChase::SUM_RESTRICTED_CHASE) {
         currentcounter++;
     } else {
@@ -34,12 +36,21 @@ uint64_t ChaseMgmt::Rows::addRow(uint64_t* row) {
             }
         }
     }
+    return stored;
+}
+
+uint64_t ChaseMgmt::Rows::addRow(uint64_t* row) {
+    // LOG(TRACEL) << "Addrow: " << row[0];
+    uint64_t out;
+    ChaseRow r(sizerow, storeRow(row, out));
+    partitions[getPartition(r)][r] = out;
     // LOG(DEBUGL) << "addRow returns " << out;
     return out;
 }
 
 bool ChaseMgmt::Rows::existingRow(uint64_t *row, uint64_t &value) {
     ChaseRow r(sizerow, row);
+    const auto &rows = partitions[getPartition(r)];
     auto search = rows.find(r);
     if (search != rows.end()) {
         value = search->second;
@@ -48,6 +59,122 @@ bool ChaseMgmt::Rows::existingRow(uint64_t *row, uint64_t &value) {
     return false;
 }
 
+void ChaseMgmt::Rows::getOrAddRows(const uint64_t *buffer, const size_t n,
+        uint64_t *out, const int nthreads) {
+    const uint8_t sz = sizerow;
+    auto getBufferRow = [buffer, sz](const size_t i) {
+        return ChaseRow(sz, (uint64_t *) buffer + i * sz);
+    };
+
+    //Group the rows by partition, keeping their order
+    const size_t npartitions = partitions.size();
+    std::vector<size_t> histogram(npartitions + 1, 0);
+    std::vector<uint8_t> partitionOfRow(n);
+    for (size_t i = 0; i < n; ++i) {
+        partitionOfRow[i] = getPartition(getBufferRow(i));
+        histogram[partitionOfRow[i] + 1]++;
+    }
+    for (size_t p = 0; p < npartitions; ++p) {
+        histogram[p + 1] += histogram[p];
+    }
+    std::vector<size_t> order(n);
+    {
+        std::vector<size_t> next(histogram.begin(), histogram.end() - 1);
+        for (size_t i = 0; i < n; ++i) {
+            order[next[partitionOfRow[i]]++] = i;
+        }
+    }
+
+    //Sort every partition, so that the copies of a row are next to each
+    //other (the first is its first occurrence), and look up every distinct
+    //row once. The runs of new rows are ranges of order
+    std::vector<std::vector<std::pair<size_t, size_t>>> newRuns(npartitions);
+    auto probe = [&](const size_t p) {
+        const auto begin = order.begin() + histogram[p];
+        const auto end = order.begin() + histogram[p + 1];
+        std::stable_sort(begin, end, [&](const size_t a, const size_t b) {
+                const uint64_t *ra = buffer + a * sz;
+                const uint64_t *rb = buffer + b * sz;
+                for (uint8_t j = 0; j < sz; ++j) {
+                    if (ra[j] != rb[j]) {
+                        return ra[j] < rb[j];
+                    }
+                }
+                return false;
+                });
+        const auto &rows = partitions[p];
+        auto itr = begin;
+        while (itr != end) {
+            const ChaseRow r = getBufferRow(*itr);
+            auto runEnd = itr + 1;
+            while (runEnd != end && getBufferRow(*runEnd) == r) {
+                runEnd++;
+            }
+            auto search = rows.find(r);
+            if (search != rows.end()) {
+                for (auto k = itr; k != runEnd; ++k) {
+                    out[*k] = search->second;
+                }
+            } else {
+                newRuns[p].push_back(std::make_pair(itr - order.begin(),
+                            runEnd - order.begin()));
+            }
+            itr = runEnd;
+        }
+    };
+    const bool parallel = nthreads > 1 && n >= CHASE_MIN_PARALLEL_ROWS;
+    if (parallel) {
+        ParallelTasks::parallel_for(0, npartitions, 1,
+                [&](const ParallelRange &r) {
+                for (size_t p = r.begin(); p < r.end(); ++p) {
+                probe(p);
+                }
+                });
+    } else {
+        for (size_t p = 0; p < npartitions; ++p) {
+            probe(p);
+        }
+    }
+
+    //The new rows get their IDs in the order of their first occurrence
+    std::vector<std::pair<size_t, std::pair<size_t, size_t>>> allNewRuns;
+    for (size_t p = 0; p < npartitions; ++p) {
+        for (const auto &run : newRuns[p]) {
+            allNewRuns.push_back(std::make_pair(order[run.first], run));
+        }
+    }
+    std::sort(allNewRuns.begin(), allNewRuns.end());
+    std::vector<std::vector<std::pair<ChaseRow, uint64_t>>> newRows(npartitions);
+    for (const auto &el : allNewRuns) {
+        uint64_t value;
+        const ChaseRow r(sz, storeRow(buffer + el.first * sz, value));
+        for (size_t k = el.second.first; k < el.second.second; ++k) {
+            out[order[k]] = value;
+        }
+        newRows[partitionOfRow[el.first]].push_back(std::make_pair(r, value));
+    }
+
+    auto insert = [&](const size_t p) {
+        auto &rows = partitions[p];
+        rows.reserve(rows.size() + newRows[p].size());
+        for (const auto &el : newRows[p]) {
+            rows.insert(el);
+        }
+    };
+    if (parallel) {
+        ParallelTasks::parallel_for(0, npartitions, 1,
+                [&](const ParallelRange &r) {
+                for (size_t p = r.begin(); p < r.end(); ++p) {
+                insert(p);
+                }
+                });
+    } else {
+        for (size_t p = 0; p < npartitions; ++p) {
+            insert(p);
+        }
+    }
+}
+
 uint64_t *ChaseMgmt::Rows::getRow(size_t id) {
     uint64_t blocknr = id / SIZE_BLOCK;
     uint64_t offset = id % SIZE_BLOCK;
@@ -76,10 +203,11 @@ ChaseMgmt::Rows *ChaseMgmt::RuleContainer::getRows(Var_t var) {
 //************** CHASE MGMT ***************
 ChaseMgmt::ChaseMgmt(std::vector<RuleExecutionDetails> &rules,
         const TypeChase typeChase, const bool checkCyclic,
-        const int ruleToCheck, const PredId_t predIgnoreBlock) :
+        const int ruleToCheck, const PredId_t predIgnoreBlock,
+        const int nthreads) :
     typeChase(typeChase), checkCyclic(checkCyclic),
-    ruleToCheck(ruleToCheck), cyclic(false),
-    predIgnoreBlock(predIgnoreBlock) {
+    ruleToCheck(ruleToCheck), nthreads(nthreads), cyclic(false),
+    predIgnoreBlock(predIgnoreBlock), skippedChecks(0) {
         this->rules.resize(rules.size());
         for(const auto &r : rules) {
             if (r.rule.getId() >= rules.size()) {
@@ -191,8 +319,31 @@ std::shared_ptr<Column> ChaseMgmt::getNewOrExistingIDs(
     const uint8_t sizerow = rows->getSizeRow();
     assert(sizerow == columns.size());
     std::vector<Term_t> functerms;
-    uint64_t row[256];
 
+    //The large batches are gathered in a buffer of rows, and the distinct
+    //rows are looked up together
+    if (!checkCyclic && sizecolumns >= CHASE_MIN_BATCH_ROWS &&
+            typeChase != TypeChase::SUM_CHASE &&
+            typeChase != TypeChase::SUM_RESTRICTED_CHASE) {
+        std::vector<Term_t> buffer(sizecolumns * sizerow);
+        for (uint8_t j = 0; j < sizerow; ++j) {
+            std::vector<Term_t> values;
+            if (!columns[j]->isBackedByVector()) {
+                values = columns[j]->getReader()->asVector();
+            }
+            const std::vector<Term_t> &column = columns[j]->isBackedByVector() ?
+                columns[j]->getVectorRef() : values;
+            for (uint64_t i = 0; i < sizecolumns; ++i) {
+                buffer[i * sizerow + j] = column[i];
+            }
+        }
+        functerms.resize(sizecolumns);
+        rows->getOrAddRows(buffer.data(), sizecolumns, functerms.data(),
+                nthreads);
+        return ColumnWriter::getColumn(functerms, false);
+    }
+
+    uint64_t row[256];
     std::vector<std::unique_ptr<ColumnReader>> readers;
     for(uint8_t j = 0; j < sizerow; ++j) {
         readers.push_back(columns[j]->getReader());
@@ -1,5 +1,6 @@
 #include <vlog/column.h>
 #include <vlog/segment.h>
+#include <vlog/sortedkernels.h>
 #include <vlog/qsqquery.h>
 #include <vlog/trident/tridentiterator.h>
 #include <kognac/utils.h>
@@ -146,6 +147,21 @@ Term_t CompressedColumn::getValue(const size_t pos) const {
     throw 10;
 }
 
+void CompressedColumn::getValues(const size_t begin, const size_t end,
+        std::vector<Term_t> &out) const {
+    size_t p = 0;
+    for (const auto &block : blocks) {
+        const size_t blockEnd = p + block.size + 1;
+        for (size_t i = std::max(p, begin); i < std::min(blockEnd, end); ++i) {
+            out.push_back(block.value + (i - p) * block.delta);
+        }
+        if (blockEnd >= end) {
+            break;
+        }
+        p = blockEnd;
+    }
+}
+
 Term_t ColumnReaderImpl::next() {
     position++;
     if (posInBlock == 0) {
@@ -541,13 +557,13 @@ std::shared_ptr<Column> ColumnWriter::getColumn() {
         } else {
             CompressedColumn col(blocks, /*offsetsize, deltas,*/ _size);
             std::vector<Term_t> values = col.getReader()->asVector();
-            cachedColumn = std::shared_ptr<Column>(new InmemoryColumn(values, true));
+            cachedColumn = pack(values, false);
         }
     } else {
-        cachedColumn = std::shared_ptr<Column>(new InmemoryColumn(values, true));
+        cachedColumn = pack(values, false);
     }
 #else
-    cachedColumn = std::shared_ptr<Column>(new InmemoryColumn(values, true));
+    cachedColumn = pack(values, false);
 #endif
     return cachedColumn;
 }
@@ -607,15 +623,44 @@ std::shared_ptr<Column> ColumnWriter::getColumn(std::vector<Term_t> &values, boo
         deltas, values.size()));*/
     } else {
         //swap the values. After, "values" is empty
-        return std::shared_ptr<Column>(new InmemoryColumn(values, true));
+        return pack(values, isSorted);
     }
 #else
-    return std::shared_ptr<Column>(new InmemoryColumn(values, true));
+    return pack(values, isSorted);
 #endif
 }
 
+void Column::getValues(const size_t begin, const size_t end,
+        std::vector<Term_t> &out) const {
+    if (supportsDirectAccess()) {
+        for (size_t i = begin; i < end; ++i) {
+            out.push_back(getValue(i));
+        }
+    } else {
+        //The readers are sequential: skip the rows before begin
+        std::unique_ptr<ColumnReader> reader = getReader();
+        for (size_t i = 0; i < begin; ++i) {
+            reader->next();
+        }
+        for (size_t i = begin; i < end; ++i) {
+            out.push_back(reader->next());
+        }
+    }
+}
+
 void Column::intersection(std::shared_ptr<Column> c1,
         std::shared_ptr<Column> c2, ColumnWriter &writer) {
+    if (c1->isBackedByVector() && c2->isBackedByVector()) {
+        const std::vector<Term_t> &v1 = c1->getVectorRef();
+        const std::vector<Term_t> &v2 = c2->getVectorRef();
+        std::vector<Term_t> output;
+        SortedKernels::intersect(v1.data(), v1.size(), v2.data(), v2.size(), output);
+        for (const Term_t v : output) {
+            writer.add(v);
+        }
+        return;
+    }
+
     std::unique_ptr<ColumnReader> r1 = c1->getReader();
     std::unique_ptr<ColumnReader> r2 = c2->getReader();
     Term_t v1, v2;
@@ -679,37 +724,15 @@ void Column::intersection(std::shared_ptr<Column> c1,
     cols.push_back(c1);
     cols.push_back(c2);
     const std::vector<const std::vector<Term_t> *> vectors = Segment::getAllVectors(cols);
-    size_t c1Size = vectors[0]->size();
-    size_t c2Size = vectors[1]->size();
 
     // TODO: parallelize this!
-    Term_t v1, v2;
-    size_t i1 = 1, i2 = 1;
-    v1 = (*vectors[0])[0];
-    v2 = (*vectors[1])[0];
-    for (;;) {
-        if (v1 < v2) {
-            if (i1 >= c1Size) {
-                return;
-            }
-            v1 = (*vectors[0])[i1++];
-        } else if (v1 > v2) {
-            if (i2 >= c2Size) {
-                return;
-            }
-            v2 = (*vectors[1])[i2++];
-        } else {
-            writer.add(v1);
-            if (i1 >= c1Size) {
-                return;
-            }
-            v1 = (*vectors[0])[i1++];
-            if (i2 >= c2Size) {
-                return;
-            }
-            v2 = (*vectors[1])[i2++];
-        }
+    std::vector<Term_t> output;
+    SortedKernels::intersect(vectors[0]->data(), vectors[0]->size(),
+            vectors[1]->data(), vectors[1]->size(), output);
+    for (const Term_t v : output) {
+        writer.add(v);
     }
+    Segment::deleteAllVectors(cols, vectors);
 }
 
 uint64_t Column::countMatches(
@@ -253,6 +253,17 @@ void ExistentialRuleProcessor::retainNonRecursive(
     }
 }
 
+bool ExistentialRuleProcessor::mustCheckHeads(const uint64_t nrows) {
+    if (!chaseMgmt->isRestricted()) {
+        return false;
+    }
+    if (ruleDetails->freshHead && !chaseMgmt->isCheckCyclicMode()) {
+        chaseMgmt->addSkippedChecks(nrows);
+        return false;
+    }
+    return true;
+}
+
 void ExistentialRuleProcessor::retainNonExisting(
         std::vector<uint64_t> &filterRows,
         uint64_t &sizecolumns,
@@ -376,7 +387,7 @@ void ExistentialRuleProcessor::addColumns(const int blockid,
         }
     }
 
-    if (chaseMgmt->isRestricted()) {
+    if (mustCheckHeads(sizecolumns)) {
         size_t nAtomsToCheck = atomTables.size();
         PredId_t headPredicateToIgnore = -1;
         if (chaseMgmt->getChaseType() == TypeChase::SUM_RESTRICTED_CHASE) {
@@ -575,7 +586,7 @@ void ExistentialRuleProcessor::addColumns(const int blockid,
         return;
     }
 
-    if (chaseMgmt->isRestricted()) {
+    if (mustCheckHeads(sizecolumns)) {
         size_t nAtomsToCheck = atomTables.size();
         PredId_t headPredicateToIgnore = -1;
         if (chaseMgmt->getChaseType() == TypeChase::SUM_RESTRICTED_CHASE) {
@@ -1108,7 +1119,7 @@ void ExistentialRuleProcessor::consolidate(const bool isFinished) {
         }
 
         //If the chase is restricted, we must first remove data
-        if (chaseMgmt->isRestricted()) {
+        if (mustCheckHeads(nrows)) {
             size_t nAtomsToCheck = atomTables.size();
             PredId_t headPredicateToIgnore = -1;
             if (chaseMgmt->getChaseType() == TypeChase::SUM_RESTRICTED_CHASE) {
@@ -2,13 +2,26 @@
 #include <vlog/fctable.h>
 #include <vlog/joinprocessor.h>
 #include <vlog/concepts.h>
+#include <vlog/spill.h>
 
 #include <trident/model/table.h>
 
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+
 // Note: When running multithreaded, mutex != NULL.
 
+static thread_local double retainTime = 0;
+
+static unsigned filterBitsPerRow = RETAIN_FILTER_BITS_PER_ROW;
+static size_t filterMaxBytes = RETAIN_FILTER_MAX_BYTES;
+static std::atomic<uint64_t> filterLookups(0);
+static std::atomic<uint64_t> filterNegatives(0);
+static std::atomic<uint64_t> filterFalsePositives(0);
+
 FCTable::FCTable(std::mutex *mutex, const uint8_t sizeRow) :
-    sizeRow(sizeRow), mutex(mutex) {
+    sizeRow(sizeRow), mutex(mutex), retainIndexed(false) {
     }
 
 std::string FCTable::getSignature(const Literal &literal) {
@@ -110,11 +123,17 @@ void FCTable::collapseBlocks(size_t maxIter, int nThreads) {
         if (splitBlocks[i].size() > 1) {
             auto itr = splitBlocks[i][0];
             std::shared_ptr<const FCInternalTable> currentTable(new InmemoryFCInternalTable(itr->table->getRowSize(), itr->iteration));
+            bool mergesEDB = false;
             for (int j = 0; j < splitBlocks[i].size(); j++) {
                 itr = splitBlocks[i][j];
+                mergesEDB |= itr->table->isEDB();
                 currentTable = currentTable->merge(itr->table, nThreads);
             }
             splitBlocks[i][0]->table = currentTable;
+            if (mergesEDB && !currentTable->isEDB()) {
+                //The rows of the EDB tables were not in the runs
+                addToRetainIndex(currentTable);
+            }
             collapsed = true;
         }
     }
@@ -325,10 +344,363 @@ bool FCTable::isEmpty(size_t count) const {
     return true;
 }
 
+void FCTable::RetainColumn::init(const size_t n) {
+    width = BitPacking::getWidth(max - base);
+    if (width > PACKED_MAX_WIDTH) {
+        data.assign(n, 0);
+    } else {
+        //One more word, as in BitPacking::pack
+        data.assign((n * width + 63) / 64 + 1, 0);
+    }
+}
+
+void FCTable::RetainColumn::set(const size_t pos, const Term_t value) {
+    if (width > PACKED_MAX_WIDTH) {
+        data[pos] = value;
+    } else if (width > 0) {
+        const uint64_t v = value - base;
+        const size_t bit = pos * width;
+        const size_t word = bit >> 6;
+        const int offset = bit & 63;
+        data[word] |= v << offset;
+        if (offset + width > 64) {
+            data[word + 1] |= v >> (64 - offset);
+        }
+    }
+}
+
+size_t FCTable::RetainColumn::gallop(size_t start, size_t end,
+        const Term_t v, const bool upper) const {
+    auto before = [&](const size_t pos) {
+        const Term_t value = get(pos);
+        return upper ? value <= v : value < v;
+    };
+    size_t step = 1;
+    while (start + step < end && before(start + step)) {
+        start += step;
+        step *= 2;
+    }
+    end = std::min(end, start + step + 1);
+    while (start < end) {
+        const size_t mid = start + (end - start) / 2;
+        if (before(mid)) {
+            start = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    return start;
+}
+
+FCTable::RetainRun FCTable::getRun(
+        std::shared_ptr<const FCInternalTable> table, int nthreads) const {
+    std::vector<std::vector<Term_t>> values(sizeRow);
+    FCInternalTableItr *itr = table->getSortedIterator(nthreads);
+    while (itr->hasNext()) {
+        itr->next();
+        bool same = !values[0].empty();
+        for (uint8_t i = 0; i < sizeRow && same; ++i) {
+            same = itr->getCurrentValue(i) == values[i].back();
+        }
+        if (!same) {
+            for (uint8_t i = 0; i < sizeRow; ++i) {
+                values[i].push_back(itr->getCurrentValue(i));
+            }
+        }
+    }
+    table->releaseIterator(itr);
+
+    RetainRun run;
+    run.nrows = values[0].size();
+    if (run.nrows == 0) {
+        return run;
+    }
+    run.columns.resize(sizeRow);
+    for (uint8_t i = 0; i < sizeRow; ++i) {
+        RetainColumn &column = run.columns[i];
+        const auto minmax = std::minmax_element(values[i].begin(),
+                values[i].end());
+        column.base = *minmax.first;
+        column.max = *minmax.second;
+        column.init(run.nrows);
+        for (size_t j = 0; j < run.nrows; ++j) {
+            column.set(j, values[i][j]);
+        }
+    }
+    return run;
+}
+
+FCTable::RetainRun FCTable::mergeRuns(const RetainRun &r1,
+        const RetainRun &r2) {
+    const size_t ncolumns = r1.columns.size();
+    RetainRun run;
+    run.columns.resize(ncolumns);
+    //The rows are written directly in the packed columns, which are
+    //allocated for the rows of both runs
+    for (size_t c = 0; c < ncolumns; ++c) {
+        RetainColumn &column = run.columns[c];
+        column.base = std::min(r1.columns[c].base, r2.columns[c].base);
+        column.max = std::max(r1.columns[c].max, r2.columns[c].max);
+        column.init(r1.size() + r2.size());
+    }
+    size_t i1 = 0, i2 = 0;
+    while (i1 < r1.size() || i2 < r2.size()) {
+        int res = 0;
+        if (i1 == r1.size()) {
+            res = 1;
+        } else if (i2 == r2.size()) {
+            res = -1;
+        } else {
+            for (size_t c = 0; c < ncolumns && res == 0; ++c) {
+                const Term_t v1 = r1.columns[c].get(i1);
+                const Term_t v2 = r2.columns[c].get(i2);
+                if (v1 != v2) {
+                    res = v1 < v2 ? -1 : 1;
+                }
+            }
+        }
+        const RetainRun &from = res <= 0 ? r1 : r2;
+        const size_t idx = res <= 0 ? i1 : i2;
+        for (size_t c = 0; c < ncolumns; ++c) {
+            run.columns[c].set(run.nrows, from.columns[c].get(idx));
+        }
+        run.nrows++;
+        if (res <= 0) {
+            i1++;
+        }
+        if (res >= 0) {
+            i2++;
+        }
+    }
+    return run;
+}
+
+uint64_t FCTable::hashRow(const Term_t *row, const uint8_t ncolumns) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL * (ncolumns + 1);
+    for (uint8_t i = 0; i < ncolumns; ++i) {
+        h = (h ^ (uint64_t) row[i]) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+//Three bits in one word per row, as in JoinHashTable
+static uint64_t getFilterBits(const uint64_t h) {
+    return (1ULL << ((h >> 40) & 63)) | (1ULL << ((h >> 46) & 63)) |
+        (1ULL << ((h >> 52) & 63));
+}
+
+bool FCTable::filterMayContain(const std::vector<uint64_t> &filter,
+        const uint64_t h) {
+    const uint64_t bits = getFilterBits(h);
+    return (filter[h & (filter.size() - 1)] & bits) == bits;
+}
+
+void FCTable::addToFilter(const RetainRun &run) {
+    if (filterBitsPerRow == 0) {
+        retainFilter = NULL;
+        return;
+    }
+    size_t nrows = 0;
+    for (const auto &r : retainRuns) {
+        nrows += r->size();
+    }
+    size_t maxWords = 1;
+    while (maxWords * 2 * sizeof(uint64_t) <= filterMaxBytes) {
+        maxWords *= 2;
+    }
+    size_t words = 1;
+    while (words * 64 < nrows * filterBitsPerRow && words < maxWords) {
+        words *= 2;
+    }
+
+    std::vector<const RetainRun *> toAdd;
+    if (!retainFilter || words > retainFilter->size()) {
+        //Too many rows for the bits per row: rebuild the filter larger
+        retainFilter = std::make_shared<std::vector<uint64_t>>(words, 0);
+        for (const auto &r : retainRuns) {
+            toAdd.push_back(r.get());
+        }
+    } else {
+        if (retainFilter.use_count() > 1) {
+            //Still read by a retainFrom without the lock
+            retainFilter = std::make_shared<std::vector<uint64_t>>(*retainFilter);
+        }
+        toAdd.push_back(&run);
+    }
+    std::vector<uint64_t> &filter = *retainFilter;
+    Term_t row[256];
+    const uint8_t ncolumns = sizeRow;
+    for (const RetainRun *r : toAdd) {
+        for (size_t i = 0; i < r->size(); ++i) {
+            for (uint8_t c = 0; c < ncolumns; ++c) {
+                row[c] = r->columns[c].get(i);
+            }
+            const uint64_t h = hashRow(row, ncolumns);
+            filter[h & (filter.size() - 1)] |= getFilterBits(h);
+        }
+    }
+}
+
+void FCTable::updateRetainIndex(int nthreads) {
+    for (auto &table : retainPending) {
+        std::shared_ptr<const RetainRun> run = std::make_shared<const RetainRun>(
+                getRun(table, nthreads));
+        if (run->size() == 0) {
+            continue;
+        }
+        retainRuns.push_back(run);
+        addToFilter(*run);
+        //Keep the sizes decreasing geometrically, so there are O(log n) runs
+        size_t n = retainRuns.size();
+        while (n > 1 && retainRuns[n - 2]->size() <=
+                RETAIN_RUN_RATIO * retainRuns[n - 1]->size()) {
+            std::shared_ptr<const RetainRun> merged =
+                std::make_shared<const RetainRun>(mergeRuns(
+                            *retainRuns[n - 2], *retainRuns[n - 1]));
+            retainRuns.pop_back();
+            retainRuns.back() = merged;
+            n--;
+        }
+    }
+    retainPending.clear();
+}
+
+std::shared_ptr<const Segment> FCTable::retainFromRuns(
+        std::shared_ptr<const Segment> t,
+        const bool duplicates,
+        const std::vector<std::shared_ptr<const RetainRun>> &runs,
+        const std::vector<uint64_t> *filter) {
+    const uint8_t ncolumns = t->getNColumns();
+    //Position of every run from which the next row is searched. The rows
+    //of t are sorted, so the searches only move forward
+    std::vector<size_t> cursors(runs.size(), 0);
+    Term_t row[256];
+    Term_t prevrow[256];
+    bool prevrowvalid = false;
+    //The rows are copied only after the first one that is removed, so
+    //that nothing is copied if all of them are new
+    bool removed = false;
+    size_t rowIdx = 0;
+    SegmentInserter retainedValues(ncolumns);
+    auto removeRow = [&]() {
+        if (!removed) {
+            std::unique_ptr<VectorSegmentIterator> itrKept = t->vectorIterator();
+            for (size_t i = 0; i < rowIdx; ++i) {
+                itrKept->next();
+                Term_t kept[256];
+                for (uint8_t c = 0; c < ncolumns; ++c) {
+                    kept[c] = itrKept->get(c);
+                }
+                retainedValues.addRow(kept);
+            }
+            itrKept->clear();
+            removed = true;
+        }
+    };
+
+    const bool useFilter = filter != NULL;
+    uint64_t lookups = 0, negatives = 0, falsePositives = 0;
+
+    std::unique_ptr<VectorSegmentIterator> itr = t->vectorIterator();
+    for (; itr->hasNext(); ++rowIdx) {
+        itr->next();
+        int res = 0;
+        for (uint8_t i = 0; i < ncolumns; ++i) {
+            row[i] = itr->get(i);
+            if (res == 0 && prevrowvalid && row[i] != prevrow[i]) {
+                res = row[i] < prevrow[i] ? -1 : 1;
+            }
+        }
+        if (prevrowvalid && res == 0 && duplicates) {
+            removeRow();
+            continue;
+        } else if (res < 0) {
+            //Not sorted: start again from the beginning of the runs
+            std::fill(cursors.begin(), cursors.end(), 0);
+        }
+        std::copy(row, row + ncolumns, prevrow);
+        prevrowvalid = true;
+
+        bool search = true;
+        if (useFilter) {
+            lookups++;
+            if (!filterMayContain(*filter, hashRow(row, ncolumns))) {
+                negatives++;
+                search = false;
+            }
+        }
+        bool found = false;
+        for (size_t r = 0; search && r < runs.size() && !found; ++r) {
+            //Galloping search of the row, one column at a time within the
+            //rows that share the previous columns
+            const RetainRun &run = *runs[r];
+            size_t start = cursors[r];
+            size_t end = run.size();
+            found = true;
+            for (uint8_t i = 0; i < ncolumns && found; ++i) {
+                const RetainColumn &column = run.columns[i];
+                start = column.gallop(start, end, row[i], false);
+                if (i == 0) {
+                    cursors[r] = start;
+                }
+                if (start == end || column.get(start) != row[i]) {
+                    found = false;
+                } else {
+                    end = column.gallop(start, end, row[i], true);
+                }
+            }
+        }
+        if (search && !found && useFilter) {
+            falsePositives++;
+        }
+        if (found) {
+            removeRow();
+        } else if (removed) {
+            retainedValues.addRow(row);
+        }
+    }
+    itr->clear();
+    filterLookups += lookups;
+    filterNegatives += negatives;
+    filterFalsePositives += falsePositives;
+
+    if (!removed) {
+        return t;
+    }
+    return retainedValues.getSegment();
+}
+
+double FCTable::getRetainTime() {
+    return retainTime;
+}
+
+void FCTable::setRetainFilter(const unsigned bitsPerRow,
+        const size_t maxBytes) {
+    filterBitsPerRow = bitsPerRow;
+    filterMaxBytes = maxBytes;
+}
+
+std::string FCTable::getRetainFilterStats() {
+    const uint64_t lookups = filterLookups;
+    const uint64_t negatives = filterNegatives;
+    const uint64_t falsePositives = filterFalsePositives;
+    std::stringstream ss;
+    ss << "lookups " << lookups << ", rows proven new " << negatives <<
+        ", false positives " << falsePositives;
+    if (negatives + falsePositives > 0) {
+        ss << " (" << 100.0 * falsePositives / (negatives + falsePositives) <<
+            "% of the new rows)";
+    }
+    return ss.str();
+}
+
 std::shared_ptr<const Segment> FCTable::retainFrom(
         std::shared_ptr<const Segment> t,
         const bool dupl,
-        int nthreads) const {
+        int nthreads) {
     bool duplicates = dupl;
 
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
@@ -343,19 +715,49 @@ std::shared_ptr<const Segment> FCTable::retainFrom(
     //    LOG(TRACEL) << "retainFrom: t.size() = " << t->getNRows() << ", blocks.size() = " << blocks.size() << ", sz = " << sz;
 #endif
     LOG(DEBUGL) << "FCTable::retainFrom: blocks.size() = " << blocks.size() << ", duplicates = " << dupl;
-    for (std::vector<FCBlock>::const_iterator itr = blocks.cbegin();
-            itr != blocks.cend();
-            ++itr) {
-        t = SegmentInserter::retain(t, itr->table, duplicates, nthreads);
-        //        LOG(TRACEL) << "after retain: t.size() = " << t->getNRows() << ", table size was " << itr->table->getNRows();
-        duplicates = false;     // Only check for duplicates at most once.
+    std::unique_lock<std::mutex> lock(retainMutex);
+    if (!retainIndexed && sizeRow > 0 && !t->isEmpty() &&
+            blocks.size() >= RETAIN_INDEX_MIN_BLOCKS) {
+        for (const auto &block : blocks) {
+            if (!block.table->isEDB()) {
+                retainPending.push_back(block.table);
+            }
+        }
+        retainIndexed = true;
     }
 
-    if (duplicates) {
-        //I still need to filter the segment.
-        t = SegmentInserter::retain(t, NULL, true, nthreads);
+    if (retainIndexed && !t->isEmpty()) {
+        updateRetainIndex(nthreads);
+        LOG(DEBUGL) << "FCTable::retainFrom: " << retainRuns.size() << " sorted runs";
+        //The rows are searched in the current runs without the lock
+        const std::vector<std::shared_ptr<const RetainRun>> runs = retainRuns;
+        const std::shared_ptr<const std::vector<uint64_t>> filter = retainFilter;
+        lock.unlock();
+        //The blocks of EDB tables are not in the runs
+        for (const auto &block : blocks) {
+            if (block.table->isEDB()) {
+                t = SegmentInserter::retain(t, block.table, duplicates, nthreads);
+                duplicates = false;
+            }
+        }
+        t = retainFromRuns(t, duplicates, runs, filter.get());
+    } else {
+        lock.unlock();
+        for (std::vector<FCBlock>::const_iterator itr = blocks.cbegin();
+                itr != blocks.cend();
+                ++itr) {
+            t = SegmentInserter::retain(t, itr->table, duplicates, nthreads);
+            //        LOG(TRACEL) << "after retain: t.size() = " << t->getNRows() << ", table size was " << itr->table->getNRows();
+            duplicates = false;     // Only check for duplicates at most once.
+        }
+
+        if (duplicates) {
+            //I still need to filter the segment.
+            t = SegmentInserter::retain(t, NULL, true, nthreads);
+        }
     }
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    retainTime += sec.count() * 1000;
     LOG(TRACEL) << "Time retainFrom = " << sec.count() * 1000;
 
     return t;
@@ -397,7 +799,12 @@ bool FCTable::add(std::shared_ptr<const FCInternalTable> t,
             // Note: for multiple-head rules, the predicate may appear more than once in the head, with different
             // variables/constants. In that case, we may not merge the blocks.
             if (posLiteralInRule == lastBlock->posQueryInRule) {
+                const bool wasEDB = lastBlock->table->isEDB();
                 lastBlock->table = lastBlock->table->merge(t, nthreads);
+                if (!lastBlock->table->isEDB()) {
+                    //The rows of an EDB table were not in the runs
+                    addToRetainIndex(wasEDB ? lastBlock->table : t);
+                }
 
                 //Invalidate possible subtables which contain partial results
                 for (FCCache::iterator itr = cache.begin(); itr != cache.end(); ++itr) {
@@ -418,19 +825,81 @@ bool FCTable::add(std::shared_ptr<const FCInternalTable> t,
     FCBlock block(iteration, t, literal, posLiteralInRule,
             rule, ruleExecOrder, isCompleted);
     blocks.push_back(block);
+    if (!t->isEDB()) {
+        addToRetainIndex(t);
+    }
     return true;
 }
 
+void FCTable::addToRetainIndex(std::shared_ptr<const FCInternalTable> t) {
+    std::lock_guard<std::mutex> lock(retainMutex);
+    if (retainIndexed) {
+        retainPending.push_back(t);
+    }
+}
+
 void FCTable::addBlock(FCBlock block) {
     assert(blocks.size() == 0 || blocks.back().iteration < block.iteration);
     blocks.push_back(block);
+    if (!block.table->isEDB()) {
+        addToRetainIndex(block.table);
+    }
 }
 
 void FCTable::removeBlock(const size_t iteration) {
     assert(blocks.size() == 0 || blocks.back().iteration <= iteration);
     if (blocks.size() > 0 && blocks.back().iteration == iteration) {
         blocks.pop_back();
+        //The runs cannot remove rows: rebuild them when needed
+        std::lock_guard<std::mutex> lock(retainMutex);
+        retainIndexed = false;
+        retainRuns.clear();
+        retainPending.clear();
+        retainFilter = NULL;
+    }
+}
+
+size_t FCTable::spill(SpillManager &manager, const size_t maxIteration,
+        const size_t bytesToFree,
+        const std::unordered_map<const FCInternalTable*, long> &otherUses,
+        std::unordered_map<const FCInternalTable*,
+        std::shared_ptr<const FCInternalTable>> &spilled) {
+    size_t freed = 0;
+    bool cacheCleared = false;
+    for (auto &block : blocks) {
+        if (freed >= bytesToFree || block.iteration >= maxIteration) {
+            break;
+        }
+        const InmemoryFCInternalTable *table =
+            dynamic_cast<const InmemoryFCInternalTable*>(block.table.get());
+        if (table == NULL || table->isEDB() || !table->supportsDirectAccess()) {
+            continue;
+        }
+        if (!cacheCleared) {
+            //The filtered tables in the cache would keep the blocks in memory
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            cache.clear();
+            cacheCleared = true;
+        }
+        auto uses = otherUses.find(table);
+        if (block.table.use_count() > 1 + (uses != otherUses.end() ?
+                    uses->second : 0)) {
+            //Still read by someone else (e.g., not yet in the retain runs)
+            continue;
+        }
+        size_t freedBlock = 0;
+        std::shared_ptr<const Segment> seg = manager.spill(
+                *table->getUnderlyingSegment(), sizeRow, freedBlock);
+        if (seg != NULL) {
+            std::shared_ptr<const FCInternalTable> newTable(
+                    new InmemoryFCInternalTable(sizeRow, block.iteration,
+                        table->isSorted(), seg));
+            spilled[table] = newTable;
+            block.table = newTable;
+            freed += freedBlock;
+        }
     }
+    return freed;
 }
 
 size_t FCTable::getNRows(const size_t iteration) const {
@@ -8,7 +8,7 @@ FilterHashJoinSorter::FilterHashJoinSorter(const uint8_t s, const std::pair<uint
 }
 
 FilterHashJoin::FilterHashJoin(ResultJoinProcessor *output,
-        const JoinHashMap *map1, const DoubleJoinHashMap *map2,
+        const JoinHashTable *map,
         std::vector<Term_t> *mapValues,
         const uint8_t mapRowSize, const uint8_t njoinfields,
         const uint8_t joinField1, const uint8_t joinField2,
@@ -18,7 +18,7 @@ FilterHashJoin::FilterHashJoin(ResultJoinProcessor *output,
         const uint8_t nLastLiteralPosConstsInHead,
         const Term_t *lastLiteralValueConstsInHead,
         const uint8_t *lastLiteralPosConstsInHead) :
-    output(output), map1(map1), map2(map2),
+    output(output), map(map),
     mapValues(mapValues), mapRowSize(mapRowSize), njoinfields(njoinfields),
     joinField1(joinField1), joinField2(joinField2),
     nValuesHead(this->output->getNCopyFromSecond()), posValuesHead(this->output->getPosFromSecond()),
@@ -51,11 +51,9 @@ inline void FilterHashJoin::doJoin_join(const Term_t *constantValues,
     matches.clear();
     if (njoinfields == 1) {
         for (std::vector<Term_t>::const_iterator itr = joins1.begin(); itr != joins1.end(); ++itr) {
-            JoinHashMap::const_iterator mapItr = map1->find(*itr);
-            if (mapItr != map1->end()) {
+            size_t start, end;
+            if (map->find(*itr, start, end)) {
                 //Check whether the derivation does not clash with the input
-                size_t start = mapItr->second.first;
-                const size_t end = mapItr->second.second;
                 while (start < end) {
                     const Term_t *row = &(mapValues->at(start));
                     bool ok = true;
@@ -90,11 +88,9 @@ inline void FilterHashJoin::doJoin_join(const Term_t *constantValues,
     } else {
         for (std::vector<std::pair<Term_t, Term_t>>::const_iterator itr = joins2.begin();
                 itr != joins2.end(); ++itr) {
-            DoubleJoinHashMap::const_iterator mapItr = map2->find(*itr);
-            if (mapItr != map2->end()) {
+            size_t start, end;
+            if (map->find(itr->first, itr->second, start, end)) {
                 //Check whether the derivation does not clash with the input
-                size_t start = mapItr->second.first;
-                const size_t end = mapItr->second.second;
                 while (start < end) {
                     const Term_t *row = &(mapValues->at(start));
                     bool ok = true;
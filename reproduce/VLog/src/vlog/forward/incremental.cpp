@@ -0,0 +1,746 @@
+#include <vlog/incremental.h>
+#include <vlog/fcinttable.h>
+#include <vlog/segment.h>
+#include <vlog/edbiterator.h>
+#include <vlog/inmemory/inmemorytable.h>
+
+#include <kognac/logs.h>
+
+#include <algorithm>
+#include <set>
+#include <numeric>
+#include <chrono>
+#include <sstream>
+
+//The rows of a relation one after the other. sortUnique must be called
+//before contains
+struct FactSet {
+    uint8_t arity;
+    std::vector<Term_t> values;
+
+    FactSet(const uint8_t arity) : arity(arity) {
+    }
+
+    size_t size() const {
+        return arity == 0 ? 0 : values.size() / arity;
+    }
+
+    const Term_t *row(const size_t i) const {
+        return values.data() + i * arity;
+    }
+
+    void add(const Term_t *row) {
+        values.insert(values.end(), row, row + arity);
+    }
+
+    int cmp(const Term_t *r1, const Term_t *r2) const {
+        for (int i = 0; i < arity; ++i) {
+            if (r1[i] != r2[i]) {
+                return r1[i] < r2[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    void sortUnique() {
+        std::vector<size_t> idx(size());
+        std::iota(idx.begin(), idx.end(), 0);
+        std::sort(idx.begin(), idx.end(), [this](size_t a, size_t b) {
+                return cmp(row(a), row(b)) < 0;
+                });
+        std::vector<Term_t> sorted;
+        sorted.reserve(values.size());
+        for (const size_t i : idx) {
+            if (sorted.empty() ||
+                    cmp(sorted.data() + sorted.size() - arity, row(i)) != 0) {
+                sorted.insert(sorted.end(), row(i), row(i) + arity);
+            }
+        }
+        values.swap(sorted);
+    }
+
+    //The position of the first row in [low, high) not smaller than r
+    size_t lowerBound(const Term_t *r, size_t low, size_t high) const {
+        while (low < high) {
+            const size_t mid = (low + high) / 2;
+            if (cmp(row(mid), r) < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    bool contains(const Term_t *r) const {
+        const size_t pos = lowerBound(r, 0, size());
+        return pos < size() && cmp(row(pos), r) == 0;
+    }
+};
+
+std::string IncrementalStats::tostring() const {
+    std::stringstream ss;
+    if (!incremental) {
+        ss << "full materialization";
+    } else {
+        ss << affectedRules << " affected rules, " << overdeleted <<
+            " over-deleted and " << rederived << " rederived facts, " <<
+            "over-deletion " << overdeleteMs << "ms, rederivation and " <<
+            "insertion " << rederiveMs << "ms";
+    }
+    ss << ", " << insertedFacts << " EDB facts added and " << deletedFacts <<
+        " removed, total " << totalMs << "ms";
+    return ss.str();
+}
+
+static Literal getGenericLiteral(const Predicate &pred) {
+    VTuple t(pred.getCardinality());
+    for (int i = 0; i < t.getSize(); ++i) {
+        t.set(VTerm(i + 1, 0), i);
+    }
+    return Literal(pred, t);
+}
+
+static void readEDBTable(EDBLayer &layer, const PredId_t pred, FactSet &out) {
+    Literal query = getGenericLiteral(Predicate(pred, 0, EDB, out.arity));
+    EDBIterator *itr = layer.getIterator(query);
+    std::vector<Term_t> row(out.arity);
+    while (itr->hasNext()) {
+        itr->next();
+        for (int i = 0; i < out.arity; ++i) {
+            row[i] = itr->getElementAt(i);
+        }
+        out.add(row.data());
+    }
+    layer.releaseIterator(itr);
+    out.sortUnique();
+}
+
+//An updated copy of the table of an EDB predicate. The rows are merged into
+//the INMEMORY tables, the other tables are read and sorted first
+static InmemoryTable *updateEDBTable(EDBLayer &layer, const PredId_t pred,
+        const FactSet &toRemove, const FactSet &toAdd, FactSet &del,
+        FactSet &ins) {
+    std::shared_ptr<EDBTable> table = layer.getEDBTable(pred);
+    InmemoryTable *current = dynamic_cast<InmemoryTable *>(table.get());
+    std::unique_ptr<InmemoryTable> copy;
+    if (current == NULL) {
+        FactSet facts(toRemove.arity);
+        readEDBTable(layer, pred, facts);
+        EDBFacts columns(facts.arity);
+        for (size_t i = 0; i < facts.size(); ++i) {
+            for (uint8_t k = 0; k < facts.arity; ++k) {
+                columns[k].push_back(facts.row(i)[k]);
+            }
+        }
+        copy = std::unique_ptr<InmemoryTable>(new InmemoryTable(pred, columns,
+                    &layer, true));
+        current = copy.get();
+    }
+    return current->update(toRemove.values, toAdd.values, del.values,
+            ins.values);
+}
+
+static void readFCTable(FCIterator itr, FactSet &out) {
+    std::vector<Term_t> row(out.arity);
+    while (!itr.isEmpty()) {
+        std::shared_ptr<const FCInternalTable> table = itr.getCurrentTable();
+        FCInternalTableItr *tableItr = table->getIterator();
+        while (tableItr->hasNext()) {
+            tableItr->next();
+            for (int i = 0; i < out.arity; ++i) {
+                row[i] = tableItr->getCurrentValue(i);
+            }
+            out.add(row.data());
+        }
+        table->releaseIterator(tableItr);
+        itr.moveNextCount();
+    }
+    out.sortUnique();
+}
+
+static FCBlock getBlock(const FactSet &facts, const Predicate &pred,
+        const size_t iteration) {
+    SegmentInserter inserter(facts.arity);
+    for (size_t i = 0; i < facts.size(); ++i) {
+        inserter.addRow(facts.row(i));
+    }
+    std::shared_ptr<const FCInternalTable> table(new InmemoryFCInternalTable(
+                facts.arity, iteration, inserter.isSorted(),
+                inserter.getSegment()));
+    return FCBlock(iteration, table, getGenericLiteral(pred), 0, NULL, 0, true);
+}
+
+//The blocks of the IDB predicates, without the rules that produced them
+static size_t getIDBBlocks(SemiNaiver *sn, Program *program,
+        std::vector<std::vector<FCBlock>> &blocks) {
+    size_t lastIteration = 0;
+    blocks.resize(program->getMaxPredicateId());
+    for (PredId_t p = 0; p < blocks.size(); ++p) {
+        if (!program->isPredicateIDB(p)) {
+            continue;
+        }
+        FCIterator itr = sn->getTable(p);
+        while (!itr.isEmpty()) {
+            const FCBlock *b = itr.getCurrentBlock();
+            blocks[p].push_back(FCBlock(b->iteration, b->table, b->query,
+                        b->posQueryInRule, NULL, b->ruleExecOrder,
+                        b->isCompleted));
+            lastIteration = std::max(lastIteration, b->iteration);
+            itr.moveNextCount();
+        }
+    }
+    return lastIteration;
+}
+
+static void addIDBBlocks(SemiNaiver *sn, Program *program,
+        const std::vector<std::vector<FCBlock>> &blocks) {
+    for (PredId_t p = 0; p < blocks.size(); ++p) {
+        for (const auto &block : blocks[p]) {
+            sn->addDataToIDBRelation(program->getPredicate(p), block);
+        }
+    }
+}
+
+//Removes the facts in deleted from the blocks, and copies in memory the
+//blocks that read the updated EDB tables (which are about to change). The
+//other blocks are kept as they are. Every block is read once: a block is
+//copied from its first deleted row on, after the rows that precede it
+static void filterBlocks(std::vector<FCBlock> &blocks, const FactSet *deleted,
+        const std::vector<PredId_t> &updated) {
+    std::vector<FCBlock> kept;
+    for (const auto &b : blocks) {
+        const uint8_t rowsize = b.table->getRowSize();
+        bool readsEDB = false;
+        for (uint8_t i = 0; i < rowsize && !readsEDB; ++i) {
+            std::shared_ptr<Column> column = b.table->getColumn(i);
+            if (column->isEDB()) {
+                const PredId_t pred = ((EDBColumn *) column.get())->
+                    getLiteral().getPredicate().getId();
+                readsEDB = std::find(updated.begin(), updated.end(), pred) !=
+                    updated.end();
+            }
+        }
+        if (!readsEDB && (deleted == NULL || deleted->size() == 0)) {
+            kept.push_back(b);
+            continue;
+        }
+
+        //The position in deleted of the first row not smaller than the
+        //current one. The rows of the blocks are mostly sorted, so it only
+        //moves forward, and by a few rows
+        size_t cursor = 0;
+        auto isDeleted = [&](const Term_t *row) {
+            if (deleted == NULL) {
+                return false;
+            }
+            const size_t n = deleted->size();
+            if (cursor < n && deleted->cmp(deleted->row(cursor), row) < 0) {
+                cursor = deleted->lowerBound(row, cursor + 1, n);
+            } else if (cursor > 0 &&
+                    deleted->cmp(deleted->row(cursor - 1), row) >= 0) {
+                cursor = deleted->lowerBound(row, 0, cursor - 1);
+            }
+            return cursor < n && deleted->cmp(deleted->row(cursor), row) == 0;
+        };
+
+        std::unique_ptr<SegmentInserter> inserter;
+        size_t skipped = 0;
+        std::vector<Term_t> row(rowsize);
+        FCInternalTableItr *itr = b.table->getIterator();
+        while (itr->hasNext()) {
+            itr->next();
+            for (uint8_t i = 0; i < rowsize; ++i) {
+                row[i] = itr->getCurrentValue(i);
+            }
+            const bool isDel = isDeleted(row.data());
+            if (inserter == NULL) {
+                if (!readsEDB && !isDel) {
+                    skipped++;
+                    continue;
+                }
+                inserter = std::unique_ptr<SegmentInserter>(
+                        new SegmentInserter(rowsize));
+                std::vector<Term_t> previous(rowsize);
+                FCInternalTableItr *itr2 = b.table->getIterator();
+                for (size_t j = 0; j < skipped; ++j) {
+                    itr2->next();
+                    for (uint8_t i = 0; i < rowsize; ++i) {
+                        previous[i] = itr2->getCurrentValue(i);
+                    }
+                    inserter->addRow(previous.data());
+                }
+                b.table->releaseIterator(itr2);
+            }
+            if (!isDel) {
+                inserter->addRow(row.data());
+            }
+        }
+        b.table->releaseIterator(itr);
+        if (inserter == NULL) {
+            kept.push_back(b);
+        } else if (!inserter->isEmpty()) {
+            std::shared_ptr<const FCInternalTable> table(
+                    new InmemoryFCInternalTable(rowsize, b.iteration,
+                        inserter->isSorted(), inserter->getSegment()));
+            kept.push_back(FCBlock(b.iteration, table, b.query,
+                        b.posQueryInRule, NULL, b.ruleExecOrder,
+                        b.isCompleted));
+        }
+    }
+    blocks.swap(kept);
+}
+
+//The body with the predicate of its j-th atom replaced
+static std::vector<Literal> replaceAtom(const std::vector<Literal> &body,
+        const size_t j, const Predicate &pred) {
+    std::vector<Literal> newBody;
+    for (size_t i = 0; i < body.size(); ++i) {
+        if (i == j) {
+            newBody.push_back(Literal(pred, body[i].getTuple()));
+        } else {
+            newBody.push_back(body[i]);
+        }
+    }
+    return newBody;
+}
+
+//P@del (or P@ins) in p, for the predicate P of the original program
+static Predicate getAuxPredicate(Program &p, Program *original,
+        const PredId_t pred, const uint8_t card, const std::string &suffix) {
+    std::string name = original->getPredicateName(pred) + suffix;
+    int64_t id = p.getOrAddPredicate(name, card);
+    if (id < 0) {
+        LOG(ERRORL) << "Predicate " << name << " is already in the program";
+        throw ("Cannot rewrite the program for the incremental update");
+    }
+    return p.getPredicate((PredId_t) id);
+}
+
+IncrementalMaintenance::IncrementalMaintenance(EDBLayer &layer,
+        Program *program, bool opt_intersect, bool opt_filtering,
+        TypeChase typeChase, int nthreads, unsigned relianceTimeout) :
+    layer(layer), program(program), opt_intersect(opt_intersect),
+    opt_filtering(opt_filtering), typeChase(typeChase), nthreads(nthreads),
+    relianceTimeout(relianceTimeout), rules(program->getAllRules()),
+    negation(false) {
+        for (const auto &rule : rules) {
+            for (const auto &literal : rule.getBody()) {
+                negation |= literal.isNegated();
+            }
+        }
+    }
+
+SemiNaiver *IncrementalMaintenance::newSemiNaiver(Program *p) {
+    return new SemiNaiver(layer, p, opt_intersect, opt_filtering, false,
+            typeChase, nthreads, false, false);
+}
+
+SemiNaiver *IncrementalMaintenance::materialize(unsigned long *timeout) {
+    SemiNaiver *sn = newSemiNaiver(program);
+    sn->run(timeout);
+    return sn;
+}
+
+std::vector<bool> IncrementalMaintenance::getAffectedRules(
+        const std::vector<PredId_t> &updatedPredicates) {
+    std::vector<bool> affected(rules.size(), false);
+    std::vector<size_t> queue;
+    for (size_t i = 0; i < rules.size(); ++i) {
+        for (const auto &literal : rules[i].getBody()) {
+            if (std::find(updatedPredicates.begin(), updatedPredicates.end(),
+                        literal.getPredicate().getId()) !=
+                    updatedPredicates.end()) {
+                affected[i] = true;
+                queue.push_back(i);
+                break;
+            }
+        }
+    }
+
+    //The successors computed by the previous updates are kept
+    if (reliances == NULL || reliances->timeout) {
+        reliances = std::unique_ptr<LazyRelianceGraph>(new LazyRelianceGraph(
+                    rules, RelianceType::Positive, RelianceStrategy::Full,
+                    relianceTimeout));
+    } else {
+        positiveStartTimeout(relianceTimeout);
+    }
+    std::vector<bool> reachable = affected;
+    while (!queue.empty() && !reliances->timeout) {
+        const size_t ruleFrom = queue.back();
+        queue.pop_back();
+        for (const size_t ruleTo : reliances->getSuccessors(ruleFrom)) {
+            if (!reachable[ruleTo]) {
+                reachable[ruleTo] = true;
+                queue.push_back(ruleTo);
+            }
+        }
+    }
+    if (!reliances->timeout) {
+        return reachable;
+    }
+
+    //Without the reliances, a rule is affected if it reads a predicate
+    //derived by an affected rule
+    LOG(WARNL) << "The reliances timed out: the affected rules follow the predicates";
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::vector<bool> derived(program->getMaxPredicateId(), false);
+        for (size_t i = 0; i < rules.size(); ++i) {
+            if (affected[i]) {
+                for (const auto &head : rules[i].getHeads()) {
+                    derived[head.getPredicate().getId()] = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < rules.size(); ++i) {
+            if (affected[i]) {
+                continue;
+            }
+            for (const auto &literal : rules[i].getBody()) {
+                if (derived[literal.getPredicate().getId()]) {
+                    affected[i] = true;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    return affected;
+}
+
+void IncrementalMaintenance::update(std::unique_ptr<SemiNaiver> &sn,
+        const std::map<PredId_t, EDBFacts> &added,
+        const std::map<PredId_t, EDBFacts> &removed) {
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    lastStats = IncrementalStats();
+
+    for (const auto *facts : {&added, &removed}) {
+        for (const auto &el : *facts) {
+            if (!layer.doesPredExists(el.first)) {
+                LOG(ERRORL) << "Predicate " << el.first << " is not in the EDB layer";
+                throw ("Only the facts of the EDB predicates can be updated");
+            }
+            const uint8_t arity = layer.getPredArity(el.first);
+            if (el.second.size() != arity) {
+                LOG(ERRORL) << "The facts of " << layer.getPredName(el.first)
+                    << " should have " << (int) arity << " columns";
+                throw ("The facts do not have the arity of their predicate");
+            }
+            for (const auto &column : el.second) {
+                if (column.size() != el.second[0].size()) {
+                    throw ("Columns of different sizes in input");
+                }
+            }
+        }
+    }
+
+    //The facts really removed from and added to each EDB table, and its new
+    //content
+    std::set<PredId_t> predicates;
+    for (const auto *facts : {&added, &removed}) {
+        for (const auto &el : *facts) {
+            predicates.insert(el.first);
+        }
+    }
+    std::vector<PredId_t> updated;
+    std::map<PredId_t, FactSet> deleted, inserted;
+    std::map<PredId_t, std::shared_ptr<InmemoryTable>> newTables;
+    for (const PredId_t pred : predicates) {
+        const uint8_t arity = layer.getPredArity(pred);
+        if (arity == 0) {
+            continue;
+        }
+        FactSet toRemove(arity), toAdd(arity);
+        std::vector<Term_t> row(arity);
+        for (int j = 0; j < 2; ++j) {
+            const auto &input = j == 0 ? removed : added;
+            FactSet &output = j == 0 ? toRemove : toAdd;
+            auto itr = input.find(pred);
+            if (itr == input.end()) {
+                continue;
+            }
+            for (size_t i = 0; i < itr->second[0].size(); ++i) {
+                for (uint8_t k = 0; k < arity; ++k) {
+                    row[k] = itr->second[k][i];
+                }
+                output.add(row.data());
+            }
+            output.sortUnique();
+        }
+
+        FactSet del(arity), ins(arity);
+        std::shared_ptr<InmemoryTable> table(updateEDBTable(layer, pred,
+                    toRemove, toAdd, del, ins));
+        lastStats.deletedFacts += del.size();
+        lastStats.insertedFacts += ins.size();
+        if (del.size() > 0 || ins.size() > 0) {
+            updated.push_back(pred);
+            deleted.insert(std::make_pair(pred, del));
+            inserted.insert(std::make_pair(pred, ins));
+            newTables.insert(std::make_pair(pred, table));
+        }
+    }
+    if (updated.empty()) {
+        LOG(INFOL) << "The update does not change the EDB tables";
+        lastStats.incremental = true;
+        return;
+    }
+
+    auto applyEDBUpdate = [&]() {
+        for (const auto &el : newTables) {
+            layer.replaceInmemoryTable(el.first, el.second);
+        }
+    };
+
+    const std::vector<bool> affected = getAffectedRules(updated);
+    std::vector<bool> affectedPredicates(program->getMaxPredicateId(), false);
+    for (size_t i = 0; i < rules.size(); ++i) {
+        if (affected[i]) {
+            lastStats.affectedRules++;
+            for (const auto &head : rules[i].getHeads()) {
+                affectedPredicates[head.getPredicate().getId()] = true;
+            }
+        }
+    }
+
+    //Nulls cannot be rederived, and the removals do not propagate through
+    //negation
+    bool incremental = !negation;
+    for (const auto &rule : rules) {
+        for (const auto &head : rule.getHeads()) {
+            if (affectedPredicates[head.getPredicate().getId()] &&
+                    rule.isExistential()) {
+                incremental = false;
+            }
+        }
+    }
+    if (!incremental) {
+        LOG(INFOL) << "The program has negation or affected existential rules: materializing it again";
+        sn.reset();
+        applyEDBUpdate();
+        sn.reset(materialize());
+        lastStats.totalMs = std::chrono::duration<double, std::milli>(
+                std::chrono::system_clock::now() - start).count();
+        return;
+    }
+    lastStats.incremental = true;
+
+    //Fail before deleting sn if the names of the auxiliary predicates are
+    //already taken
+    {
+        Program check(program, &layer);
+        std::vector<PredId_t> auxPredicates = updated;
+        for (PredId_t p = 0; p < affectedPredicates.size(); ++p) {
+            if (affectedPredicates[p]) {
+                auxPredicates.push_back(p);
+            }
+        }
+        for (const PredId_t p : auxPredicates) {
+            const uint8_t card = program->getPredicate(p).getCardinality();
+            getAuxPredicate(check, program, p, card, "@del");
+            getAuxPredicate(check, program, p, card, "@ins");
+        }
+    }
+
+    //The deltas of the updates are in the first iteration after the old
+    //blocks
+    std::vector<std::vector<FCBlock>> blocks;
+    const size_t deltaIteration = getIDBBlocks(sn.get(), program, blocks) + 1;
+    sn.reset();
+
+    //Over-deletion, on the old database. For every affected rule and every
+    //atom B_i of its body that may lose facts: H@del :- B_1, ..., B_i@del,
+    //..., B_n
+    std::chrono::system_clock::time_point startPhase = std::chrono::system_clock::now();
+    std::map<PredId_t, FactSet> overdeleted;
+    {
+        Program delProgram(program, &layer);
+        std::map<PredId_t, Predicate> delPredicates;
+        auto getDelPredicate = [&](const Literal &literal) {
+            const PredId_t id = literal.getPredicate().getId();
+            auto itr = delPredicates.find(id);
+            if (itr == delPredicates.end()) {
+                itr = delPredicates.insert(std::make_pair(id,
+                            getAuxPredicate(delProgram, program, id,
+                                literal.getTupleSize(), "@del"))).first;
+            }
+            return itr->second;
+        };
+        for (size_t i = 0; i < rules.size(); ++i) {
+            if (!affected[i]) {
+                continue;
+            }
+            const std::vector<Literal> &body = rules[i].getBody();
+            for (size_t j = 0; j < body.size(); ++j) {
+                const PredId_t id = body[j].getPredicate().getId();
+                const bool loses = body[j].getPredicate().getType() == EDB ?
+                    deleted.count(id) && deleted.find(id)->second.size() > 0 :
+                    affectedPredicates[id];
+                if (!loses) {
+                    continue;
+                }
+                std::vector<Literal> heads;
+                for (const auto &head : rules[i].getHeads()) {
+                    heads.push_back(Literal(getDelPredicate(head), head.getTuple()));
+                }
+                delProgram.addRule(heads, replaceAtom(body, j,
+                            getDelPredicate(body[j])));
+            }
+        }
+
+        bool seeded = false;
+        for (const auto &el : deleted) {
+            seeded |= el.second.size() > 0 && delPredicates.count(el.first);
+        }
+        if (delProgram.getNRules() > 0 && seeded) {
+            std::unique_ptr<SemiNaiver> delSn(newSemiNaiver(&delProgram));
+            //The rules have the old tables in cyclic bodies, which the
+            //triejoin would sort again at every iteration
+            delSn->setTrieJoin(false);
+            addIDBBlocks(delSn.get(), &delProgram, blocks);
+            for (const auto &el : deleted) {
+                auto itr = delPredicates.find(el.first);
+                if (el.second.size() > 0 && itr != delPredicates.end()) {
+                    delSn->addDataToIDBRelation(itr->second,
+                            getBlock(el.second, itr->second, deltaIteration));
+                }
+            }
+            delSn->run(deltaIteration, deltaIteration + 1);
+            for (const auto &el : delPredicates) {
+                if (!program->isPredicateIDB(el.first)) {
+                    continue;
+                }
+                FactSet facts(el.second.getCardinality());
+                readFCTable(delSn->getTable(el.second.getId()), facts);
+                lastStats.overdeleted += facts.size();
+                overdeleted.insert(std::make_pair(el.first, facts));
+            }
+        }
+    }
+    for (PredId_t p = 0; p < blocks.size(); ++p) {
+        if (affectedPredicates[p]) {
+            auto itr = overdeleted.find(p);
+            filterBlocks(blocks[p], itr == overdeleted.end() ? NULL :
+                    &itr->second, updated);
+        }
+    }
+    lastStats.overdeleteMs = std::chrono::duration<double, std::milli>(
+            std::chrono::system_clock::now() - startPhase).count();
+
+    applyEDBUpdate();
+
+    //Rederivation and insertion, on the new database, continuing the
+    //semi-naive evaluation from the remaining facts:
+    // - H :- H@del, B_1, ..., B_n for the rules of the over-deleted facts
+    // - the affected rules, for the consequences of the new IDB facts. Without
+    //   insertions the new database is a subset of the old one, and the first
+    //   rules already derive again all the over-deleted facts
+    // - H :- B_1, ..., B_i@ins, ..., B_n for the updated EDB atoms B_i
+    startPhase = std::chrono::system_clock::now();
+    Program insProgram(program, &layer);
+    std::map<PredId_t, Predicate> rederivedPredicates, insertedPredicates;
+    for (const auto &el : overdeleted) {
+        if (el.second.size() == 0) {
+            continue;
+        }
+        Predicate delPred = getAuxPredicate(insProgram, program, el.first,
+                el.second.arity, "@del");
+        rederivedPredicates.insert(std::make_pair(el.first, delPred));
+        for (const auto &rule : rules) {
+            for (const auto &head : rule.getHeads()) {
+                if (head.getPredicate().getId() != el.first) {
+                    continue;
+                }
+                std::vector<Literal> heads = { head };
+                std::vector<Literal> body;
+                body.push_back(Literal(delPred, head.getTuple()));
+                for (const auto &literal : rule.getBody()) {
+                    body.push_back(literal);
+                }
+                insProgram.addRule(heads, body);
+            }
+        }
+    }
+    const bool anyInserted = lastStats.insertedFacts > 0;
+    for (size_t i = 0; i < rules.size(); ++i) {
+        if (!affected[i]) {
+            continue;
+        }
+        const std::vector<Literal> &body = rules[i].getBody();
+        bool idbBody = false;
+        for (size_t j = 0; j < body.size(); ++j) {
+            const PredId_t id = body[j].getPredicate().getId();
+            if (body[j].getPredicate().getType() != EDB) {
+                idbBody = true;
+                continue;
+            }
+            auto ins = inserted.find(id);
+            if (ins == inserted.end() || ins->second.size() == 0) {
+                continue;
+            }
+            auto itr = insertedPredicates.find(id);
+            if (itr == insertedPredicates.end()) {
+                itr = insertedPredicates.insert(std::make_pair(id,
+                            getAuxPredicate(insProgram, program, id,
+                                ins->second.arity, "@ins"))).first;
+            }
+            insProgram.addRule(rules[i].getHeads(), replaceAtom(body, j,
+                        itr->second));
+        }
+        if (idbBody && anyInserted) {
+            insProgram.addRule(rules[i].getHeads(), body);
+        }
+    }
+
+    std::unique_ptr<SemiNaiver> insSn;
+    if (!rederivedPredicates.empty() || !insertedPredicates.empty()) {
+        insSn = std::unique_ptr<SemiNaiver>(newSemiNaiver(&insProgram));
+        insSn->setTrieJoin(false);
+        addIDBBlocks(insSn.get(), &insProgram, blocks);
+        for (const auto &el : rederivedPredicates) {
+            insSn->addDataToIDBRelation(el.second, getBlock(
+                        overdeleted.find(el.first)->second, el.second,
+                        deltaIteration));
+        }
+        for (const auto &el : insertedPredicates) {
+            insSn->addDataToIDBRelation(el.second, getBlock(
+                        inserted.find(el.first)->second, el.second,
+                        deltaIteration));
+        }
+        insSn->run(deltaIteration, deltaIteration + 1);
+        std::vector<std::vector<FCBlock>> newBlocks;
+        getIDBBlocks(insSn.get(), program, newBlocks);
+        blocks.swap(newBlocks);
+
+        for (const auto &el : rederivedPredicates) {
+            const FactSet &facts = overdeleted.find(el.first)->second;
+            for (const auto &b : blocks[el.first]) {
+                if (b.iteration <= deltaIteration) {
+                    continue;
+                }
+                FCInternalTableItr *itr = b.table->getIterator();
+                std::vector<Term_t> row(facts.arity);
+                while (itr->hasNext()) {
+                    itr->next();
+                    for (uint8_t i = 0; i < facts.arity; ++i) {
+                        row[i] = itr->getCurrentValue(i);
+                    }
+                    lastStats.rederived += facts.contains(row.data());
+                }
+                b.table->releaseIterator(itr);
+            }
+        }
+    }
+    lastStats.rederiveMs = std::chrono::duration<double, std::milli>(
+            std::chrono::system_clock::now() - startPhase).count();
+
+    //The materialization of the original program, with the new blocks
+    sn.reset(newSemiNaiver(program));
+    addIDBBlocks(sn.get(), program, blocks);
+    lastStats.totalMs = std::chrono::duration<double, std::milli>(
+            std::chrono::system_clock::now() - start).count();
+    LOG(INFOL) << "Incremental update: " << lastStats.tostring();
+}
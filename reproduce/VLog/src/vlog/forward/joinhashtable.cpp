@@ -0,0 +1,244 @@
+#include <vlog/joinhashtable.h>
+
+#include <trident/utils/parallel.h>
+#include <kognac/logs.h>
+
+#include <string>
+#include <limits>
+
+#if TERM_IS_UINT64 && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_PROBE 1
+#include <immintrin.h>
+#else
+#define SIMD_PROBE 0
+#endif
+
+//Number of groups that a partition should contain (about 64KB of buckets)
+#define GROUPS_PER_PARTITION 2048
+//Tables with fewer groups are built by a single thread
+#define MIN_PARALLEL_GROUPS 65536
+//Tables with fewer groups fit in the cache and need no bloom filter
+#define MIN_BLOOM_GROUPS 65536
+
+//Returns a bitmask of the slots whose tag is equal to tag
+typedef int (*MatchFunction)(const JoinHashTable::Bucket &bucket, const Term_t tag);
+
+static int matchScalar(const JoinHashTable::Bucket &bucket, const Term_t tag) {
+    int mask = 0;
+    for (int i = 0; i < JOINHASHTABLE_SLOTS; ++i) {
+        mask |= (bucket.tags[i] == tag) << i;
+    }
+    return mask;
+}
+
+#if SIMD_PROBE && JOINHASHTABLE_SLOTS == 4
+__attribute__((target("avx2")))
+static int matchAVX2(const JoinHashTable::Bucket &bucket, const Term_t tag) {
+    __m256i tags = _mm256_loadu_si256((const __m256i *) bucket.tags);
+    __m256i eq = _mm256_cmpeq_epi64(tags, _mm256_set1_epi64x((long long) tag));
+    return _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+}
+
+static MatchFunction chooseMatchFunction() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return matchAVX2;
+    }
+    return matchScalar;
+}
+#else
+static MatchFunction chooseMatchFunction() {
+    return matchScalar;
+}
+#endif
+
+static const MatchFunction match = chooseMatchFunction();
+
+static size_t nextPowerOfTwo(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+JoinHashTable::JoinHashTable(const uint8_t rowSize,
+        const std::vector<uint8_t> &keyFields) : rowSize(rowSize),
+    keyFields(keyFields), values(NULL), buckets(NULL), partitionBits(0),
+    bloomMask(0) {
+        if (keyFields.size() < 1 || keyFields.size() > 2) {
+            LOG(ERRORL) << "JoinHashTable supports one or two key fields, not " << keyFields.size();
+            throw std::string("JoinHashTable supports one or two key fields");
+        }
+    }
+
+uint64_t JoinHashTable::hash(const Term_t key1, const Term_t key2) {
+    //Finalizer of MurmurHash3, so that all the bits depend on the keys
+    uint64_t h = (uint64_t) key1 ^ ((uint64_t) key2 * 0x9E3779B97F4A7C15ULL);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void JoinHashTable::insert(const Group &group, const uint64_t h) {
+    const size_t p = getPartition(h);
+    const size_t first = partitionOffsets[p];
+    const size_t mask = partitionOffsets[p + 1] - first - 1;
+    const Term_t tag = keyFields.size() == 1 ? group.key1 : h;
+    size_t b = h & mask;
+    while (true) {
+        Bucket &bucket = buckets[first + b];
+        for (int i = 0; i < JOINHASHTABLE_SLOTS; ++i) {
+            if (bucket.counts[i] == 0) {
+                bucket.tags[i] = tag;
+                bucket.rows[i] = group.start / rowSize;
+                bucket.counts[i] = (group.end - group.start) / rowSize;
+                return;
+            }
+        }
+        b = (b + 1) & mask;
+    }
+}
+
+void JoinHashTable::build(const std::vector<Term_t> &values, const int nthreads) {
+    this->values = &values;
+    groups.clear();
+    if (rowSize == 0 || values.empty()) {
+        return;
+    }
+    if (values.size() / rowSize > std::numeric_limits<uint32_t>::max()) {
+        LOG(ERRORL) << "JoinHashTable: too many rows (" << values.size() / rowSize << ")";
+        throw std::string("JoinHashTable: too many rows");
+    }
+
+    //Collect the groups of rows with the same key
+    const uint8_t f1 = keyFields[0];
+    const uint8_t f2 = keyFields.size() > 1 ? keyFields[1] : 0;
+    const bool pairs = keyFields.size() > 1;
+    for (size_t start = 0; start < values.size(); start += rowSize) {
+        const Term_t key1 = values[start + f1];
+        const Term_t key2 = pairs ? values[start + f2] : 0;
+        if (groups.empty() || groups.back().key1 != key1 || groups.back().key2 != key2) {
+            Group g;
+            g.key1 = key1;
+            g.key2 = key2;
+            g.start = start;
+            g.end = start;
+            groups.push_back(g);
+        }
+        groups.back().end = start + rowSize;
+    }
+    const size_t ngroups = groups.size();
+
+    //Radix partitioning on the most significant bits of the hash
+    partitionBits = 0;
+    while (((size_t) GROUPS_PER_PARTITION << partitionBits) < ngroups) {
+        partitionBits++;
+    }
+    const size_t npartitions = (size_t) 1 << partitionBits;
+    ArenaVector<uint64_t> hashes(ngroups);
+    ArenaVector<size_t> histogram(npartitions + 1);
+    for (size_t i = 0; i < ngroups; ++i) {
+        hashes[i] = hash(groups[i].key1, groups[i].key2);
+        histogram[getPartition(hashes[i]) + 1]++;
+    }
+    ArenaVector<size_t> order(ngroups);
+    {
+        ArenaVector<size_t> next(npartitions);
+        for (size_t p = 0; p < npartitions; ++p) {
+            histogram[p + 1] += histogram[p];
+            next[p] = histogram[p];
+        }
+        for (size_t i = 0; i < ngroups; ++i) {
+            order[next[getPartition(hashes[i])]++] = i;
+        }
+    }
+
+    //At most half of the slots of a partition are used
+    partitionOffsets.resize(npartitions + 1);
+    partitionOffsets[0] = 0;
+    for (size_t p = 0; p < npartitions; ++p) {
+        const size_t n = histogram[p + 1] - histogram[p];
+        partitionOffsets[p + 1] = partitionOffsets[p] +
+            nextPowerOfTwo((2 * n + JOINHASHTABLE_SLOTS - 1) / JOINHASHTABLE_SLOTS);
+    }
+    const size_t nbuckets = partitionOffsets[npartitions];
+    storage.assign(nbuckets * sizeof(Bucket) + 63, 0);
+    buckets = (Bucket *) (((uintptr_t) storage.data() + 63) & ~(uintptr_t) 63);
+
+    auto insertPartitions = [&](const size_t begin, const size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            for (size_t i = histogram[p]; i < histogram[p + 1]; ++i) {
+                insert(groups[order[i]], hashes[order[i]]);
+            }
+        }
+    };
+    if (nthreads > 1 && ngroups >= MIN_PARALLEL_GROUPS) {
+        //Every partition has its own buckets
+        ParallelTasks::parallel_for(0, npartitions, 1,
+                [&](const ParallelRange &r) {
+                insertPartitions(r.begin(), r.end());
+                });
+    } else {
+        insertPartitions(0, npartitions);
+    }
+
+    //Blocked bloom filter: three bits in one word per key, about 16 bits per key
+    bloom.clear();
+    if (ngroups >= MIN_BLOOM_GROUPS) {
+        bloom.resize(nextPowerOfTwo(ngroups / 4));
+        bloomMask = bloom.size() - 1;
+        for (size_t i = 0; i < ngroups; ++i) {
+            const uint64_t h = hashes[i];
+            bloom[(h >> 20) & bloomMask] |= (1ULL << ((h >> 40) & 63)) |
+                (1ULL << ((h >> 46) & 63)) | (1ULL << ((h >> 52) & 63));
+        }
+    }
+    LOG(DEBUGL) << "JoinHashTable: " << ngroups << " keys, " << npartitions <<
+        " partitions, " << nbuckets << " buckets, bloom filter: " << !bloom.empty();
+}
+
+bool JoinHashTable::lookup(const uint64_t h, const Term_t key1,
+        const Term_t key2, size_t &start, size_t &end) const {
+    if (groups.empty()) {
+        return false;
+    }
+    if (!bloom.empty()) {
+        const uint64_t bits = (1ULL << ((h >> 40) & 63)) |
+            (1ULL << ((h >> 46) & 63)) | (1ULL << ((h >> 52) & 63));
+        if ((bloom[(h >> 20) & bloomMask] & bits) != bits) {
+            return false;
+        }
+    }
+
+    const bool pairs = keyFields.size() > 1;
+    const Term_t tag = pairs ? h : key1;
+    const size_t p = getPartition(h);
+    const size_t first = partitionOffsets[p];
+    const size_t mask = partitionOffsets[p + 1] - first - 1;
+    size_t b = h & mask;
+    while (true) {
+        const Bucket &bucket = buckets[first + b];
+        int candidates = match(bucket, tag);
+        for (int i = 0; candidates != 0; ++i, candidates >>= 1) {
+            if ((candidates & 1) && bucket.counts[i] != 0) {
+                const size_t s = (size_t) bucket.rows[i] * rowSize;
+                //The tag of two keys is their hash: compare the keys in the row
+                if (!pairs || ((*values)[s + keyFields[0]] == key1 &&
+                            (*values)[s + keyFields[1]] == key2)) {
+                    start = s;
+                    end = s + (size_t) bucket.counts[i] * rowSize;
+                    return true;
+                }
+            }
+        }
+        if (bucket.counts[JOINHASHTABLE_SLOTS - 1] == 0) {
+            //The bucket is not full, so the key is not in the next ones
+            return false;
+        }
+        b = (b + 1) & mask;
+    }
+}
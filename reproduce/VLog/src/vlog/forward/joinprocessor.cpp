@@ -1,14 +1,35 @@
 #include <vlog/filterer.h>
 #include <vlog/joinprocessor.h>
+#include <vlog/sortedkernels.h>
 #include <vlog/seminaiver.h>
 #include <vlog/filterhashjoin.h>
 #include <vlog/finalresultjoinproc.h>
 #include <trident/model/table.h>
 
-#include <google/dense_hash_map>
 #include <limits.h>
 #include <vector>
 #include <inttypes.h>
+#include <atomic>
+
+void JoinMorsels::run(const size_t size, const int nthreads,
+        const std::function<void(int, size_t, size_t)> &f) {
+    const size_t workers = std::max(nthreads, 1);
+    const size_t morselSize = std::max((size_t) MIN_MORSEL_SIZE,
+            std::min((size_t) MAX_MORSEL_SIZE, size / (workers * MORSELS_PER_THREAD)));
+    const size_t nmorsels = (size + morselSize - 1) / morselSize;
+    LOG(TRACEL) << "Morsels: " << nmorsels << " of " << morselSize << " rows";
+    std::atomic<size_t> next(0);
+    ParallelTasks::parallel_for(0, std::min(workers, nmorsels), 1,
+            [&](const ParallelRange &r) {
+                for (size_t worker = r.begin(); worker != r.end(); ++worker) {
+                    size_t morsel;
+                    while ((morsel = next++) < nmorsels) {
+                        const size_t begin = morsel * morselSize;
+                        f((int) worker, begin, std::min(begin + morselSize, size));
+                    }
+                }
+            });
+}
 
 bool JoinExecutor::isJoinTwoToOneJoin(const RuleExecutionPlan &hv,
         const int currentLiteral) {
@@ -609,26 +630,34 @@ void JoinExecutor::join(SemiNaiver * naiver, const FCInternalTable * t1,
             output->checkSizes();
 #endif
         } else {*/
+        //The hash join reads the expensive EDB predicates completely
+        if (naiver->usesHashJoin() && factor == 1
+                && joinsCoordinates.size() > 0 && joinsCoordinates.size() < 3) {
+            LOG(TRACEL) << "Executing physicalHashJoin.";
+            physicalHashJoin(t1, naiver, outputLiterals, literal, min, max,
+                    joinsCoordinates, output, nthreads);
+        } else {
             LOG(TRACEL) << "Executing mergejoin.";
             mergejoin(t1, naiver, outputLiterals, literal, min, max,
                     joinsCoordinates, output, nthreads);
+        }
 #ifdef DEBUG
-            output->checkSizes();
+        output->checkSizes();
 #endif
         /*}*/
     }
 }
 
-bool JoinExecutor::isJoinSelective(JoinHashMap & map, const Literal & literal,
+bool JoinExecutor::isJoinSelective(const JoinHashTable & map, const Literal & literal,
         const size_t minIteration, const size_t maxIteration,
         SemiNaiver * naiver, const uint8_t joinPos) {
     size_t totalCardinality = naiver->estimateCardinality(literal, minIteration, maxIteration);
     size_t filteringCardinality = 0;
-    for (JoinHashMap::iterator itr = map.begin(); itr != map.end(); ++itr) {
+    for (const JoinHashTable::Group &group : map.getGroups()) {
         VTuple tuple = literal.getTuple();
         // Watch out: this variable could occur more than once in the literal. --Ceriel
         // tuple.set(VTerm(0, itr->first), joinPos);
-        tuple.replaceAll(tuple.get(joinPos), VTerm(0, itr->first));
+        tuple.replaceAll(tuple.get(joinPos), VTerm(0, group.key1));
 
         Literal literalToQuery(literal.getPredicate(), tuple);
         filteringCardinality += naiver->estimateCardinality(literalToQuery, minIteration, maxIteration);
@@ -651,8 +680,7 @@ uint8_t removePosConstants(uint8_t c, Literal literal) {
 }
 
 void JoinExecutor::execSelectiveHashJoin(const RuleExecutionDetails & currentRule,
-        SemiNaiver * naiver, const JoinHashMap & map,
-        const DoubleJoinHashMap & doublemap,
+        SemiNaiver * naiver, const JoinHashTable & map,
         ResultJoinProcessor *resultsContainer, const uint8_t njoinfields,
         const uint8_t idxJoinField1, const uint8_t idxJoinField2,
         const std::vector<Literal> *outputLiterals, const Literal & literal, const uint8_t rowSize,
@@ -742,20 +770,10 @@ void JoinExecutor::execSelectiveHashJoin(const RuleExecutionDetails & currentRul
         const uint8_t nPosFromFirst = resultsContainer->getNCopyFromFirst();
         std::vector<DuplicateContainers> existingTuples;
 
-        //Iterating through the hashmap
-        JoinHashMap::const_iterator itr1;
-        DoubleJoinHashMap::const_iterator itr2;
+        //Iterating through the groups of the hashmap
+        const JoinHashTable::Groups &groups = map.getGroups();
         {
-            bool ok;
-            if (njoinfields < 2) {
-                itr1 = map.begin();
-                ok = itr1 != map.end();
-            } else {
-                itr2 = doublemap.begin();
-                ok = itr2 != doublemap.end();
-            }
-
-            while (ok) {
+            for (const JoinHashTable::Group &group : groups) {
                 VTuple tuple = literal.getTuple();
                 existingTuples.clear();
 
@@ -766,22 +784,19 @@ void JoinExecutor::execSelectiveHashJoin(const RuleExecutionDetails & currentRul
                         // uint8_t var = tuple.get(idxJoinFieldInLiteral1).getId();
                         // tuple.set(VTerm(0, itr1->first), idxJoinFieldInLiteral1);
                         // Watch out: this variable could occur more than once in the literal. --Ceriel
-                        tuple.replaceAll(tuple.get(idxJoinFieldInLiteral1), VTerm(0, itr1->first));
+                        tuple.replaceAll(tuple.get(idxJoinFieldInLiteral1), VTerm(0, group.key1));
                     }
-                    start = itr1->second.first;
-                    end = itr1->second.second;
                 } else {
                     // uint8_t var1 = tuple.get(idxJoinFieldInLiteral1).getId();
                     // uint8_t var2 = tuple.get(idxJoinFieldInLiteral2).getId();
                     // tuple.set(VTerm(0, itr2->first.first), idxJoinFieldInLiteral1);
                     // tuple.set(VTerm(0, itr2->first.second), idxJoinFieldInLiteral2);
                     // Watch out: the variables could occur more than once in the literal. --Ceriel
-                    tuple.replaceAll(tuple.get(idxJoinFieldInLiteral1), VTerm(0, itr2->first.first));
-                    tuple.replaceAll(tuple.get(idxJoinFieldInLiteral2), VTerm(0, itr2->first.second));
-
-                    start = itr2->second.first;
-                    end = itr2->second.second;
+                    tuple.replaceAll(tuple.get(idxJoinFieldInLiteral1), VTerm(0, group.key1));
+                    tuple.replaceAll(tuple.get(idxJoinFieldInLiteral2), VTerm(0, group.key2));
                 }
+                start = group.start;
+                end = group.end;
                 Literal literalToQuery(literal.getPredicate(), tuple);
 
                 //These are values that cannot appear in certain positions,
@@ -801,14 +816,6 @@ void JoinExecutor::execSelectiveHashJoin(const RuleExecutionDetails & currentRul
 #endif
                 if (tableItr.isEmpty()) {
                     LOG(TRACEL) << "Empty table!";
-                    //Move to the next entry in the hashmap
-                    if (njoinfields < 2) {
-                        itr1++;
-                        ok = itr1 != map.end();
-                    } else {
-                        itr2++;
-                        ok = itr2 != doublemap.end();
-                    }
                     continue;
                 }
 
@@ -887,27 +894,19 @@ void JoinExecutor::execSelectiveHashJoin(const RuleExecutionDetails & currentRul
                     {
                         std::vector<uint8_t> ps = newPosToSort;
 
-                        FilterHashJoin exec(resultsContainer, &map, &doublemap, &values, rowSize, njoinfields,
+                        FilterHashJoin exec(resultsContainer, &map, &values, rowSize, njoinfields,
                                 idxJoinField1, idxJoinField2,
                                 &literalToQuery, true, false, (emptyIterals) ? NULL : &existingTuples,
                                 0, NULL, NULL); //The last three parameters are
                         //not set because the flag 'isDerivationUnique' is set to false
                         LOG(TRACEL) << "Retained table size = " << retainedTables.size();
                         if (retainedTables.size() > 0) {
-                            if (njoinfields == 1) {
-                                // LOG(TRACEL) << "first = " << (int) itr1->second.first << ", second = " << (int) itr1->second.second;
-                                // LOG(TRACEL) << "idxJoinField = " << (int) idxJoinField1;
-                                exec.run(retainedTables, true, itr1->second.first, itr1->second.second,
-                                        newPosToSort, processedTables,
-                                        valuesToFilterOut.size() > 0 ? &valuesToFilterOut : NULL,
-                                        columnsToFilterOut.size() > 0 ? &columnsToFilterOut : NULL);
-                            } else {
-                                exec.run(retainedTables, true, itr2->second.first, itr2->second.second,
-                                        newPosToSort, processedTables,
-                                        valuesToFilterOut.size() > 0 ? &valuesToFilterOut : NULL,
-                                        columnsToFilterOut.size() > 0 ? &columnsToFilterOut : NULL);
-
-                            }
+                            // LOG(TRACEL) << "first = " << (int) group.start << ", second = " << (int) group.end;
+                            // LOG(TRACEL) << "idxJoinField = " << (int) idxJoinField1;
+                            exec.run(retainedTables, true, group.start, group.end,
+                                    newPosToSort, processedTables,
+                                    valuesToFilterOut.size() > 0 ? &valuesToFilterOut : NULL,
+                                    columnsToFilterOut.size() > 0 ? &columnsToFilterOut : NULL);
                         }
                     }
                     //std::chrono::duration<double> secJ = std::chrono::system_clock::now() - startJ;
@@ -934,15 +933,6 @@ void JoinExecutor::execSelectiveHashJoin(const RuleExecutionDetails & currentRul
                 //LOG(TRACEL) << "HashJoin: ntables=" << tableItr.getNTables() << " exitingTuples=" << existingTuples.size() << " GetRetrTime=" << secRetr.count() * 1000 << " GetDuplTime=" << secD.count() * 1000 << " JoinTime=" << secJ.count() * 1000 << "ms ConsolidationTime=" << secC.count() * 1000 << "ms. Input=" << exec.getProcessedElements() << " Output(f)=" << uniqueDerivation << " Output(nf)=" << unfilteredDerivation << " JoinKey=" << itr->first << " MapValues=" << sMapValues;
                 /*** END LOGGING ***/
 #endif
-
-                //Move to the next entry in the hashmap
-                if (njoinfields == 1) {
-                    itr1++;
-                    ok = itr1 != map.end();
-                } else {
-                    itr2++;
-                    ok = itr2 != doublemap.end();
-                }
             }
 
 
@@ -970,134 +960,62 @@ void JoinExecutor::hashjoin(const FCInternalTable * t1, SemiNaiver * naiver,
         literalSharesVarsWithHead = hv.lastLiteralSharesWithHead;
     }
 
-    JoinHashMap map;
-    DoubleJoinHashMap doublemap;
-
-    if (joinsCoordinates.size() < 2) {
-        map.set_empty_key(std::numeric_limits<Term_t>::max());
-    } else {
-        doublemap.set_empty_key(std::make_pair(std::numeric_limits<Term_t>::max(),
-                    std::numeric_limits<Term_t>::max()));
-    }
-
     std::vector<Term_t> values;
+    std::vector<uint8_t> fields;
+    for (uint32_t i = 0; i < joinsCoordinates.size(); ++i) {
+        fields.push_back(joinsCoordinates[i].first);
+    }
 
-    //Fill the hashmap
+    //Copy the rows grouped by key
     {
-        std::vector<uint8_t> fields;
-        for (uint32_t i = 0; i < joinsCoordinates.size(); ++i) {
-            fields.push_back(joinsCoordinates[i].first);
-        }
         // No parallel sort, t1 is not supposed to be large.
         FCInternalTableItr *t2 = t1->sortBy(fields);
 
-        size_t startpos = 0;
-        bool first = true;
-
-        if (joinsCoordinates.size() < 2) {
-            //we can have 0 or 1 joins
-            Term_t currentKey;
-            uint8_t keyField = 0;
-            if (joinsCoordinates.size() > 0)
-                keyField = joinsCoordinates[0].first;
-
-            //Filter equal value in the join and head position
-            bool filterRowsInhashMap = lastLiteral && hv.filterLastHashMap;
-            uint8_t filterRowsPosJoin, filterRowsPosOther = 0;
-            if (filterRowsInhashMap) {
-                filterRowsPosJoin = joinsCoordinates[0].first;
-                FinalRuleProcessor* o = (FinalRuleProcessor*)output;
-                if (o->getNCopyFromFirst() != 1) {
+        //Filter equal value in the join and head position
+        bool filterRowsInhashMap = joinsCoordinates.size() == 1 &&
+            lastLiteral && hv.filterLastHashMap;
+        uint8_t filterRowsPosJoin, filterRowsPosOther = 0;
+        if (filterRowsInhashMap) {
+            filterRowsPosJoin = joinsCoordinates[0].first;
+            FinalRuleProcessor* o = (FinalRuleProcessor*)output;
+            if (o->getNCopyFromFirst() != 1) {
+                filterRowsInhashMap = false;
+            } else {
+                filterRowsPosOther = o->getPosFromFirst()[0].second;
+                if (filterRowsPosJoin == filterRowsPosOther) {
                     filterRowsInhashMap = false;
-                } else {
-                    filterRowsPosOther = o->getPosFromFirst()[0].second;
-                    if (filterRowsPosJoin == filterRowsPosOther) {
-                        filterRowsInhashMap = false;
-                    }
-                }
-            }
-
-            while (t2->hasNext()) {
-                t2->next();
-
-                if (filterRowsInhashMap &&
-                        t2->getCurrentValue(filterRowsPosJoin) == t2->getCurrentValue(filterRowsPosOther)) {
-                    continue;
-                }
-                Term_t newKey = t2->getCurrentValue(keyField);
-                if (first) {
-                    currentKey = newKey;
-                    first = false;
-                } else if (newKey != currentKey) {
-                    size_t end = values.size();
-                    map.insert(std::make_pair(currentKey, std::make_pair(startpos, end)));
-                    currentKey = newKey;
-                    startpos = values.size();
-                }
-                for (int j = 0; j < t1->getRowSize(); ++j) {
-                    values.push_back(t2->getCurrentValue(j));
                 }
             }
+        }
 
-            if (!first) {
-                size_t end = values.size();
-                map.insert(std::make_pair(currentKey, std::make_pair(startpos, end)));
-            }
-
-            //If the map does not contain any entry, then I can safetly exit
-            if (map.size() == 0) {
-                t1->releaseIterator(t2);
-                return;
-            }
-
-        } else {
-            const uint8_t keyField1 = joinsCoordinates[0].first;
-            const uint8_t keyField2 = joinsCoordinates[1].first;
-            std::pair<Term_t, Term_t> currentKey;
-            while (t2->hasNext()) {
-                t2->next();
-                Term_t newFirst = t2->getCurrentValue(keyField1);
-                Term_t newSecond = t2->getCurrentValue(keyField2);
-                if (first) {
-                    currentKey.first = newFirst;
-                    currentKey.second = newSecond;
-                    first = false;
-                } else {
-                    if (newFirst != currentKey.first ||
-                            newSecond != currentKey.second) {
-                        size_t end = values.size();
-                        doublemap.insert(std::make_pair(currentKey, std::make_pair(startpos, end)));
-                        currentKey.first = newFirst;
-                        currentKey.second = newSecond;
-                        startpos = values.size();
-                    }
-                }
-                for (int j = 0; j < t1->getRowSize(); ++j)
-                    values.push_back(t2->getCurrentValue(j));
-            }
-
-            if (!first) {
-                size_t end = values.size();
-                doublemap.insert(std::make_pair(currentKey, std::make_pair(startpos, end)));
+        while (t2->hasNext()) {
+            t2->next();
+            if (filterRowsInhashMap &&
+                    t2->getCurrentValue(filterRowsPosJoin) == t2->getCurrentValue(filterRowsPosOther)) {
+                continue;
             }
-
-            if (doublemap.size() == 0) {
-                t1->releaseIterator(t2);
-                return;
+            for (int j = 0; j < t1->getRowSize(); ++j) {
+                values.push_back(t2->getCurrentValue(j));
             }
         }
-
         t1->releaseIterator(t2);
     }
 
-    if (joinsCoordinates.size() < 2) {
-        LOG(DEBUGL) << "Hashmap size = " << map.size();
-    } else {
-        LOG(DEBUGL) << "Hashmap size = " << doublemap.size();
+    //If the map does not contain any entry, then I can safetly exit
+    if (values.empty()) {
+        return;
+    }
+
+    //Without joins, the rows are grouped by the first field
+    if (fields.empty()) {
+        fields.push_back(0);
     }
+    JoinHashTable map(t1->getRowSize(), fields);
+    map.build(values, nthreads);
+    LOG(DEBUGL) << "Hashmap size = " << map.size();
 
     //Perform as many joins as the rows in the hashmap
-    execSelectiveHashJoin(ruleDetails, naiver, map, doublemap, output, (uint8_t) joinsCoordinates.size(),
+    execSelectiveHashJoin(ruleDetails, naiver, map, output, (uint8_t) joinsCoordinates.size(),
             (joinsCoordinates.size() > 0) ? joinsCoordinates[0].second : 0,
             (joinsCoordinates.size() > 1) ? joinsCoordinates[1].second : 0,
             outputLiterals, literal, t1->getRowSize(), lastPosToSort, values,
@@ -1112,31 +1030,219 @@ int JoinExecutor::cmp(const Term_t *r1, const Term_t *r2, const uint8_t s) {
     return 0;
 }
 
-void JoinExecutor::doPhysicalHashJoin(FCIterator & itr2, JoinHashMap & map,
-        std::vector<Term_t> &mapValues, const uint8_t joinIdx2,
-        const uint8_t rowSize, const uint8_t s2,
-        ResultJoinProcessor * output) {
+void JoinExecutor::physicalHashJoin(const FCInternalTable * t1,
+        SemiNaiver * naiver, const std::vector<Literal> *outputLiterals,
+        const Literal & literal,
+        const size_t min, const size_t max,
+        const std::vector<std::pair<uint8_t, uint8_t>> &joinsCoordinates,
+        ResultJoinProcessor * output, int nthreads) {
+    std::vector<uint8_t> fields1, fields2;
+    for (const auto &coordinates : joinsCoordinates) {
+        fields1.push_back(coordinates.first);
+        fields2.push_back(coordinates.second);
+    }
+
+    //Skip the blocks that cannot produce new derivations, as in mergejoin
+    TableFilterer filterer(naiver);
+    std::vector<std::shared_ptr<const FCInternalTable>> tables2;
+    size_t nrows2 = 0;
+    FCIterator itr2 = naiver->getTable(literal, min, max, &filterer);
     while (!itr2.isEmpty()) {
-        std::shared_ptr<const FCInternalTable> table = itr2.getCurrentTable();
+        std::shared_ptr<const FCInternalTable> t = itr2.getCurrentTable();
+        if (outputLiterals == NULL ||
+                !filterer.isEligibleForPartialSubs(itr2.getCurrentBlock(),
+                    *outputLiterals, t1, output->getNCopyFromFirst(),
+                    joinsCoordinates.size()) ||
+                !filterer.producedDerivationInPreviousStepsWithSubs(
+                    itr2.getCurrentBlock(), *outputLiterals, literal, t1,
+                    output->getNCopyFromFirst(), output->getPosFromFirst(),
+                    joinsCoordinates.size(), &joinsCoordinates[0])) {
+            tables2.push_back(t);
+            nrows2 += t->getNRows();
+        }
         itr2.moveNextCount();
-        FCInternalTableItr *itr = table->getIterator();
-        while (itr->hasNext()) {
-            itr->next();
-            JoinHashMap::iterator mapItr = map.find(itr->getCurrentValue(joinIdx2));
-            if (mapItr != map.end()) {
-                //Perform the join
-                size_t start = mapItr->second.first;
-                const size_t end = mapItr->second.second;
-                int i = 0;
-                while (start < end) {
-                    const Term_t *idxValues = &(mapValues[start]);
-                    output->processResults(i, idxValues, itr, false);
-                    start += rowSize;
-                    i++;
+    }
+    if (tables2.empty() || t1->isEmpty()) {
+        return;
+    }
+
+    //The table is built on the smaller side
+    if (nrows2 < t1->getNRows()) {
+        doReversedHashJoin(t1, fields1, tables2, fields2, output, nthreads);
+        return;
+    }
+
+    //Copy the rows of t1 grouped by key
+    const uint8_t rowSize = t1->getRowSize();
+    std::vector<Term_t> values;
+    values.reserve(t1->getNRows() * rowSize);
+    FCInternalTableItr *itr1 = t1->sortBy(fields1, nthreads);
+    while (itr1->hasNext()) {
+        itr1->next();
+        for (uint8_t j = 0; j < rowSize; ++j) {
+            values.push_back(itr1->getCurrentValue(j));
+        }
+    }
+    t1->releaseIterator(itr1);
+    if (values.empty()) {
+        return;
+    }
+
+    JoinHashTable map(rowSize, fields1);
+    map.build(values, nthreads);
+    LOG(TRACEL) << "Hash join: " << map.size() << " keys in " <<
+        map.getNPartitions() << " partitions";
+    doPhysicalHashJoin(tables2, map, values, fields2, rowSize, output,
+            nthreads);
+}
+
+void JoinExecutor::doReversedHashJoin(const FCInternalTable *t1,
+        const std::vector<uint8_t> &fields1,
+        const std::vector<std::shared_ptr<const FCInternalTable>> &tables2,
+        const std::vector<uint8_t> &fields2,
+        ResultJoinProcessor * output, int nthreads) {
+    //Every row of the map contains the keys of a row of the literal, its
+    //table and its position in the table
+    const uint8_t nkeys = (uint8_t) fields2.size();
+    const uint8_t rowSize = nkeys + 2;
+    std::vector<FCInternalTableItr *> itrs2;
+    std::vector<std::vector<const std::vector<Term_t> *>> vectors2;
+    std::vector<Term_t> rows;
+    for (size_t t = 0; t < tables2.size(); ++t) {
+        itrs2.push_back(tables2[t]->getIterator());
+        vectors2.push_back(itrs2.back()->getAllVectors(nthreads));
+        const size_t size = vectors2.back().empty() ? 0 :
+            vectors2.back()[0]->size();
+        for (size_t i = 0; i < size; ++i) {
+            for (uint8_t j = 0; j < nkeys; ++j) {
+                rows.push_back((*vectors2.back()[fields2[j]])[i]);
+            }
+            rows.push_back(t);
+            rows.push_back(i);
+        }
+    }
+
+    //Group the rows by key. The literal is the smaller side, so sorting
+    //it is cheaper than sorting t1
+    std::vector<size_t> order;
+    for (size_t start = 0; start < rows.size(); start += rowSize) {
+        order.push_back(start);
+    }
+    std::sort(order.begin(), order.end(), LessTwoTuples(nkeys, rows));
+    std::vector<Term_t> values;
+    values.reserve(rows.size());
+    for (const size_t start : order) {
+        values.insert(values.end(), rows.begin() + start,
+                rows.begin() + start + rowSize);
+    }
+    std::vector<uint8_t> keyFields;
+    for (uint8_t j = 0; j < nkeys; ++j) {
+        keyFields.push_back(j);
+    }
+    JoinHashTable map(rowSize, keyFields);
+    map.build(values, nthreads);
+    LOG(TRACEL) << "Hash join on the literal: " << map.size() << " keys in " <<
+        map.getNPartitions() << " partitions";
+
+    //Probe the map with the rows of t1, which need not be sorted
+    FCInternalTableItr *itr1 = t1->getIterator();
+    const std::vector<const std::vector<Term_t> *> vectors1 =
+        itr1->getAllVectors(nthreads);
+    auto probe = [&](const size_t begin, const size_t end, Output *out) {
+        for (size_t i = begin; i < end; ++i) {
+            size_t start, last;
+            const bool found = nkeys == 1 ?
+                map.find((*vectors1[fields1[0]])[i], start, last) :
+                map.find((*vectors1[fields1[0]])[i],
+                        (*vectors1[fields1[1]])[i], start, last);
+            if (found) {
+                for (; start < last; start += rowSize) {
+                    out->processResults(0, vectors1, i,
+                            vectors2[values[start + nkeys]],
+                            values[start + nkeys + 1], false);
                 }
             }
         }
-        table->releaseIterator(itr);
+    };
+    const size_t t1Size = vectors1.empty() ? 0 : vectors1[0]->size();
+    if (nthreads > 1 && t1Size > 4096) {
+        std::mutex m;
+        std::vector<std::unique_ptr<Output>> outputs(nthreads);
+        JoinMorsels::run(t1Size, nthreads,
+                [&](const int worker, const size_t begin, const size_t end) {
+                    if (!outputs[worker]) {
+                        outputs[worker].reset(new Output(output, &m));
+                    }
+                    probe(begin, end, outputs[worker].get());
+                });
+        for (auto &o : outputs) {
+            if (o) {
+                o->flush();
+            }
+        }
+    } else if (t1Size > 0) {
+        Output out(output, NULL);
+        probe(0, t1Size, &out);
+    }
+    itr1->deleteAllVectors(vectors1);
+    t1->releaseIterator(itr1);
+    for (size_t t = 0; t < tables2.size(); ++t) {
+        itrs2[t]->deleteAllVectors(vectors2[t]);
+        tables2[t]->releaseIterator(itrs2[t]);
+    }
+}
+
+void JoinExecutor::doPhysicalHashJoin(
+        const std::vector<std::shared_ptr<const FCInternalTable>> &tables2,
+        const JoinHashTable & map, const std::vector<Term_t> &mapValues,
+        const std::vector<uint8_t> &fields2, const uint8_t rowSize,
+        ResultJoinProcessor * output, int nthreads) {
+    std::mutex m;
+    //Probes the rows [begin, end) of a table
+    auto probe = [&](const std::vector<const std::vector<Term_t> *> &vectors2,
+            const size_t begin, const size_t end, Output *out) {
+        VectorFCInternalTableItr itr(vectors2, begin, end);
+        while (itr.hasNext()) {
+            itr.next();
+            size_t start, last;
+            const bool found = fields2.size() == 1 ?
+                map.find(itr.getCurrentValue(fields2[0]), start, last) :
+                map.find(itr.getCurrentValue(fields2[0]),
+                        itr.getCurrentValue(fields2[1]), start, last);
+            if (found) {
+                for (; start < last; start += rowSize) {
+                    out->processResults(0, &mapValues[start], &itr, false);
+                }
+            }
+        }
+    };
+
+    for (const auto &t2 : tables2) {
+        //The probed tables are not sorted
+        FCInternalTableItr *itr = t2->getIterator();
+        std::vector<const std::vector<Term_t> *> vectors2 =
+            itr->getAllVectors(nthreads);
+        const size_t t2Size = vectors2.empty() ? 0 : vectors2[0]->size();
+        if (nthreads > 1 && t2Size > 4096) {
+            std::vector<std::unique_ptr<Output>> outputs(nthreads);
+            JoinMorsels::run(t2Size, nthreads,
+                    [&](const int worker, const size_t begin, const size_t end) {
+                        if (!outputs[worker]) {
+                            outputs[worker].reset(new Output(output, &m));
+                        }
+                        probe(vectors2, begin, end, outputs[worker].get());
+                    });
+            for (auto &o : outputs) {
+                if (o) {
+                    o->flush();
+                }
+            }
+        } else if (t2Size > 0) {
+            Output out(output, NULL);
+            probe(vectors2, 0, t2Size, &out);
+        }
+        itr->deleteAllVectors(vectors2);
+        t2->releaseIterator(itr);
     }
 }
 
@@ -1717,7 +1823,42 @@ void JoinExecutor::do_merge_join_classicalgo(const std::vector<const std::vector
         }
     }
 
+    //Single join key: skip the non-matching values with the galloping
+    //(and possibly SIMD) searches of SortedKernels
+    const bool singleKey = fields1.size() == 1;
+    const Term_t *keys1 = singleKey ? vectors1[fields1[0]]->data() : NULL;
+    const Term_t *keys2 = singleKey ? vectors2[fields2[0]]->data() : NULL;
+
     while (l1 < u1 && l2 < u2) {
+        if (singleKey) {
+            if (keys1[l1] < keys2[l2]) {
+                l1 = SortedKernels::lowerBound(keys1, l1 + 1, u1, keys2[l2]);
+                continue;
+            } else if (keys1[l1] > keys2[l2]) {
+                l2 = SortedKernels::lowerBound(keys2, l2 + 1, u2, keys1[l1]);
+                continue;
+            }
+            const size_t count1 = SortedKernels::upperBound(keys1, l1 + 1, u1, keys1[l1]) - l1;
+            const size_t count2 = SortedKernels::upperBound(keys2, l2 + 1, u2, keys2[l2]) - l2;
+            for (size_t j = 0; j < count2; j++) {
+                uint8_t idxBlock = 0;
+                for (size_t i = 0; i < count1; i++) {
+                    if (valBlocks != NULL) {
+                        Term_t currentValue = (*vectors1[posBlocks])[l1 + i];
+                        while (valBlocks[idxBlock] < currentValue) {
+                            idxBlock++;
+                        }
+                        assert(currentValue == valBlocks[idxBlock]);
+                    }
+                    output->processResults(idxBlock, vectors1, l1 + i, vectors2, l2 + j, false);
+                }
+                total += count1;
+            }
+            l1 += count1;
+            l2 += count2;
+            continue;
+        }
+
         //Are they matching?
         while (l1 < u1 && (res = JoinExecutor::cmp(vectors1, l1, vectors2, l2, fields1, fields2)) < 0) {
             l1++;
@@ -1892,84 +2033,6 @@ void JoinExecutor::do_merge_join_fasteralgo(FCInternalTableItr * sortedItr1,
     }
 }
 
-struct CreateParallelMergeJoiner {
-    const std::vector<const std::vector<Term_t> *> vectors;
-    FCInternalTableItr *sortedItr2;
-    const std::vector<uint8_t> &fields1;
-    const std::vector<uint8_t> &fields2;
-    const uint8_t posBlocks;
-    const uint8_t nValBlocks;
-    const Term_t *valBlocks;
-    ResultJoinProcessor *output;
-    std::mutex *m;
-
-    CreateParallelMergeJoiner(const std::vector<const std::vector<Term_t> *> &vectors,
-            FCInternalTableItr *sortedItr2,
-            const std::vector<uint8_t> &fields1,
-            const std::vector<uint8_t> &fields2,
-            const uint8_t posBlocks,
-            const uint8_t nValBlocks,
-            const Term_t *valBlocks,
-            ResultJoinProcessor *output,
-            std::mutex *m) :
-        vectors(vectors), sortedItr2(sortedItr2),
-        fields1(fields1), fields2(fields2), posBlocks(posBlocks),
-        nValBlocks(nValBlocks), valBlocks(valBlocks), output(output), m(m) {
-        }
-
-    void operator()(const ParallelRange& r) const {
-        LOG(TRACEL) << "Parallel merge joiner: r.begin = " << r.begin() << ", r.end = " << r.end();
-        FCInternalTableItr *itr1 = new VectorFCInternalTableItr(vectors, r.begin(), r.end());
-        Output out(output, m);
-        FCInternalTableItr *itr2 = sortedItr2->copy();
-
-        JoinExecutor::do_merge_join_classicalgo(itr1, itr2, fields1,
-                fields2, posBlocks, valBlocks, &out);
-
-        out.flush();
-        delete itr2;
-        delete itr1;
-    }
-};
-
-struct CreateParallelMergeJoinerVectors {
-    const std::vector<const std::vector<Term_t> *> vectors;
-    const std::vector<const std::vector<Term_t> *> vectors2;
-    const std::vector<uint8_t> &fields1;
-    const std::vector<uint8_t> &fields2;
-    const uint8_t posBlocks;
-    const uint8_t nValBlocks;
-    const Term_t *valBlocks;
-    ResultJoinProcessor *output;
-    std::mutex *m;
-
-    CreateParallelMergeJoinerVectors(const std::vector<const std::vector<Term_t> *> &vectors,
-            const std::vector<const std::vector<Term_t> *> vectors2,
-            const std::vector<uint8_t> &fields1,
-            const std::vector<uint8_t> &fields2,
-            const uint8_t posBlocks,
-            const uint8_t nValBlocks,
-            const Term_t *valBlocks,
-            ResultJoinProcessor *output,
-            std::mutex *m) :
-        vectors(vectors), vectors2(vectors2),
-        fields1(fields1), fields2(fields2), posBlocks(posBlocks),
-        nValBlocks(nValBlocks), valBlocks(valBlocks), output(output), m(m) {
-        }
-
-    void operator()(const ParallelRange& r) const {
-        LOG(TRACEL) << "Parallel vector merge joiner: r.begin = " << r.begin() << ", r.end = " << r.end();
-        Output out(output, m);
-
-        JoinExecutor::do_merge_join_classicalgo(vectors, r.begin(), r.end(),
-                vectors2, 0, vectors2[0]->size(),
-                fields1, fields2,
-                posBlocks, valBlocks, &out);
-
-        out.flush();
-    }
-};
-
 void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
         std::vector<uint8_t> &fieldsToSortInMap,
         std::vector<std::shared_ptr<const FCInternalTable>> &tables2,
@@ -1995,7 +2058,6 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
     std::chrono::duration<double> secS;
     startS = std::chrono::system_clock::now();
 
-    size_t chunks = 0;
     std::mutex m;
 
     size_t totalsize2 = 0;
@@ -2032,17 +2094,6 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
 
     size_t totalsize1 = filteredT1->getNRows();
 
-    // if (vectorSupported) {
-    // Possibility to parallelize, but also a possibility to create a faster
-    // iterator.
-    if (nthreads > 1) {
-        // chunks = (totalsize1 + nthreads - 1) / nthreads;
-        chunks = (totalsize1 + 2 * nthreads - 1) / (2 * nthreads);
-    }
-    // for (int i = 0; i < ncols; i++) {
-    // vectors.push_back(&cols[i]->getVectorRef());
-    // }
-    // }
     VectorFCInternalTableItr *itr1 = new VectorFCInternalTableItr(vectors, 0, totalsize1);
 
     secS = std::chrono::system_clock::now() - startS;
@@ -2075,7 +2126,6 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
         } else {
             sortedItr2 = t2->getIterator();
         }
-        bool vector2Supported = true;
         std::vector<const std::vector<Term_t> *> vectors2 = sortedItr2->getAllVectors(nthreads);
         /*
            std::vector<std::shared_ptr<Column>> cols = sortedItr2->getAllColumns();
@@ -2118,21 +2168,24 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
             LOG(TRACEL) << "Classical algo";
             LOG(TRACEL) << "totalsize1 = " << totalsize1 << ", t2Size = " << t2Size;
             if (/* vectorSupported && */ nthreads > 1 && totalsize1 > 1 && (totalsize1 + t2Size) > 4096 /* ? */) {
-                LOG(TRACEL) << "Chunk size = " << chunks << ", t2->getNRows() = " << t2Size;
-                if (vector2Supported) {
-                    //tbb::parallel_for(tbb::blocked_range<int>(0, totalsize1, chunks),
-                    //        CreateParallelMergeJoinerVectors(vectors, vectors2, fields1, fields2, posBlocks, nValBlocks, valBlocks, output, &m));
-                    ParallelTasks::parallel_for(0, totalsize1, chunks,
-                            CreateParallelMergeJoinerVectors(vectors, vectors2,
-                                fields1, fields2, posBlocks, nValBlocks,
-                                valBlocks, output, &m));
-                } else {
-                    //tbb::parallel_for(tbb::blocked_range<int>(0, totalsize1, chunks),
-                    //        CreateParallelMergeJoiner(vectors, sortedItr2, fields1, fields2, posBlocks, nValBlocks, valBlocks, output, &m));
-                    ParallelTasks::parallel_for(0, totalsize1, chunks,
-                            CreateParallelMergeJoiner(vectors, sortedItr2,
-                                fields1, fields2, posBlocks, nValBlocks,
-                                valBlocks, output, &m));
+                LOG(TRACEL) << "Parallel merge join, t2->getNRows() = " << t2Size;
+                //Every morsel of t1 is merged with the whole t2. The
+                //classical algorithm starts with a binary search in t2.
+                std::vector<std::unique_ptr<Output>> outputs(nthreads);
+                JoinMorsels::run(totalsize1, nthreads,
+                        [&](const int worker, const size_t begin, const size_t end) {
+                            if (!outputs[worker]) {
+                                outputs[worker].reset(new Output(output, &m));
+                            }
+                            JoinExecutor::do_merge_join_classicalgo(vectors, begin, end,
+                                    vectors2, 0, t2Size,
+                                    fields1, fields2,
+                                    posBlocks, valBlocks, outputs[worker].get());
+                        });
+                for (auto &o : outputs) {
+                    if (o) {
+                        o->flush();
+                    }
                 }
             } else {
                 JoinExecutor::do_merge_join_classicalgo(vectors, 0, totalsize1,
@@ -2468,7 +2521,8 @@ void JoinExecutor::left_join(const FCInternalTable * filteredT1,
     if (tables2.size() == 0) {
         std::vector<const std::vector<Term_t> *> vectors2;
         std::vector<uint8_t> dummyFields;
-        JoinExecutor::do_left_join(vectors1, vectors2, dummyFields, dummyFields, out);
+        JoinExecutor::do_left_join(vectors1, 0, filteredT1->getNRows(),
+                vectors2, dummyFields, dummyFields, out);
         sortedItr1->deleteAllVectors(vectors1);
         filteredT1->releaseIterator(sortedItr1);
         delete out;
@@ -2506,7 +2560,28 @@ void JoinExecutor::left_join(const FCInternalTable * filteredT1,
     std::vector<const std::vector<Term_t> *> vectors2 = sortedItr2->getAllVectors(nthreads);
     secS = std::chrono::system_clock::now() - startS;
 
-    JoinExecutor::do_left_join(vectors1, vectors2, fields1, fields2, out);
+    const size_t totalsize1 = filteredT1->getNRows();
+    const size_t t2Size = vectors2.size() > 0 ? vectors2[0]->size() : 0;
+    if (nthreads > 1 && totalsize1 > 1 && (totalsize1 + t2Size) > 4096) {
+        std::mutex m;
+        std::vector<std::unique_ptr<Output>> outputs(nthreads);
+        JoinMorsels::run(totalsize1, nthreads,
+                [&](const int worker, const size_t begin, const size_t end) {
+                    if (!outputs[worker]) {
+                        outputs[worker].reset(new Output(output, &m));
+                    }
+                    JoinExecutor::do_left_join(vectors1, begin, end, vectors2,
+                            fields1, fields2, outputs[worker].get());
+                });
+        for (auto &o : outputs) {
+            if (o) {
+                o->flush();
+            }
+        }
+    } else {
+        JoinExecutor::do_left_join(vectors1, 0, totalsize1, vectors2,
+                fields1, fields2, out);
+    }
 #if DEBUG
     output->checkSizes();
 #endif
@@ -2530,6 +2605,7 @@ void JoinExecutor::left_join(const FCInternalTable * filteredT1,
  */
 void JoinExecutor::do_left_join(
         const std::vector<const std::vector<Term_t> *> &vectors1,
+        size_t l1, size_t u1,
         const std::vector<const std::vector<Term_t> *> &vectors2,
         const std::vector<uint8_t> &fields1,
         const std::vector<uint8_t> &fields2,
@@ -2556,11 +2632,22 @@ void JoinExecutor::do_left_join(
     //    LOG(TRACEL) << "    L. " << v;
     //LOG(TRACEL) << "  L. XXXXXXXXXXXXXXXX";
 
-    size_t l1 = 0;
     size_t l2 = 0;
-    size_t u1 = vectors1[0]->size();
     size_t u2 = vectors2.size() > 0 ? vectors2[0]->size() : 0;
 
+    //Skip the rows of vectors2 that are smaller than the first row of the range
+    if (l1 > 0 && l1 < u1 && fields1.size() > 0) {
+        size_t u = u2;
+        while (l2 < u) {
+            size_t m = (l2 + u) / 2;
+            if (JoinExecutor::cmp(vectors1, l1, vectors2, m, fields1, fields2) > 0) {
+                l2 = m + 1;
+            } else {
+                u = m;
+            }
+        }
+    }
+
     //Special case. There is no left join
     if (fields1.size() == 0 && l1 < u1 && l2 < u2) {
         if (vectors1.size() == 0) {
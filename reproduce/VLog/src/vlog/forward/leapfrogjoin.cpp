@@ -0,0 +1,186 @@
+#include <vlog/leapfrogjoin.h>
+#include <vlog/seminaiver.h>
+#include <vlog/fctable.h>
+#include <vlog/fcinttable.h>
+#include <vlog/resultjoinproc.h>
+#include <vlog/column.h>
+#include <vlog/sortedkernels.h>
+
+#include <kognac/logs.h>
+
+#include <algorithm>
+
+LeapfrogTrieJoin::TrieIterator::TrieIterator(std::shared_ptr<const Segment> segment) :
+    segment(segment), depth(-1) {
+        const uint8_t ncolumns = segment->getNColumns();
+        ownedColumns.reserve(ncolumns);
+        for (uint8_t i = 0; i < ncolumns; ++i) {
+            std::shared_ptr<Column> column = segment->getColumn(i);
+            if (column->isBackedByVector()) {
+                columns.push_back(&column->getVectorRef());
+            } else {
+                ownedColumns.push_back(column->getReader()->asVector());
+                columns.push_back(&ownedColumns.back());
+            }
+        }
+        pos.resize(ncolumns);
+        end.resize(ncolumns);
+    }
+
+void LeapfrogTrieJoin::TrieIterator::open() {
+    depth++;
+    if (depth == 0) {
+        pos[0] = 0;
+        end[0] = size();
+    } else {
+        //The rows that share the current key of the parent level
+        const std::vector<Term_t> &parent = *columns[depth - 1];
+        const size_t begin = pos[depth - 1];
+        pos[depth] = begin;
+        end[depth] = SortedKernels::upperBound(parent.data(), begin,
+                end[depth - 1], parent[begin]);
+    }
+}
+
+void LeapfrogTrieJoin::TrieIterator::next() {
+    //Consecutive seeks usually move only a few positions forward, which is
+    //what the galloping search of the kernels is good at
+    pos[depth] = SortedKernels::upperBound(columns[depth]->data(), pos[depth],
+            end[depth], key());
+}
+
+void LeapfrogTrieJoin::TrieIterator::seek(const Term_t v) {
+    pos[depth] = SortedKernels::lowerBound(columns[depth]->data(), pos[depth],
+            end[depth], v);
+}
+
+void LeapfrogTrieJoin::search(const size_t varIdx) {
+    if (varIdx == binding.size()) {
+        output->processResults(0, binding.data(), (FCInternalTableItr*)NULL, false);
+        nResults++;
+        return;
+    }
+
+    std::vector<TrieIterator *> &iterators = participants[varIdx];
+    for (auto it : iterators) {
+        it->open();
+    }
+
+    //Leapfrog: the iterator with the smallest key seeks the largest one
+    //until all of them agree
+    std::sort(iterators.begin(), iterators.end(),
+            [](const TrieIterator *a, const TrieIterator *b) {
+            return a->key() < b->key();
+            });
+    const size_t n = iterators.size();
+    size_t p = 0;
+    Term_t maxKey = iterators[n - 1]->key();
+    while (true) {
+        TrieIterator *it = iterators[p];
+        if (it->key() == maxKey) {
+            binding[varIdx] = maxKey;
+            search(varIdx + 1);
+            it->next();
+        } else {
+            it->seek(maxKey);
+        }
+        if (it->atEnd()) {
+            break;
+        }
+        maxKey = it->key();
+        p = (p + 1) % n;
+    }
+
+    for (auto it : iterators) {
+        it->up();
+    }
+}
+
+size_t LeapfrogTrieJoin::join(SemiNaiver *naiver,
+        const RuleExecutionPlan &plan,
+        const std::vector<std::pair<size_t, size_t>> &ranges,
+        ResultJoinProcessor *output,
+        int &processedTables,
+        const int nthreads) {
+    const std::vector<Var_t> &vars = plan.trieJoinVars;
+    this->output = output;
+    nResults = 0;
+    relations.clear();
+    participants.clear();
+    participants.resize(vars.size());
+    binding.resize(vars.size());
+
+    for (size_t i = 0; i < plan.plan.size(); ++i) {
+        const Literal *literal = plan.plan[i];
+        FCIterator literalItr = naiver->getTable(*literal, ranges[i].first,
+                ranges[i].second);
+        if (literal->getPredicate().getType() == IDB) {
+            processedTables += literalItr.getNTables();
+        }
+
+        //The tables only contain the variables of the literal. Pick the
+        //columns of the variables in the order in which they are bound.
+        std::vector<Var_t> varsInTable;
+        for (int j = 0; j < literal->getTupleSize(); ++j) {
+            VTerm t = literal->getTermAtPos(j);
+            if (t.isVariable()) {
+                varsInTable.push_back(t.getId());
+            }
+        }
+        std::vector<uint8_t> fields;
+        std::vector<size_t> levels;
+        for (size_t v = 0; v < vars.size(); ++v) {
+            auto itr = std::find(varsInTable.begin(), varsInTable.end(), vars[v]);
+            if (itr != varsInTable.end()) {
+                fields.push_back(itr - varsInTable.begin());
+                levels.push_back(v);
+            }
+        }
+
+        std::vector<std::vector<Term_t>> values(fields.size());
+        bool isEmpty = true;
+        while (!literalItr.isEmpty()) {
+            std::shared_ptr<const FCInternalTable> table = literalItr.getCurrentTable();
+            FCInternalTableItr *tableItr = table->getIterator();
+            while (tableItr->hasNext()) {
+                tableItr->next();
+                isEmpty = false;
+                for (size_t f = 0; f < fields.size(); ++f) {
+                    values[f].push_back(tableItr->getCurrentValue(fields[f]));
+                }
+            }
+            table->releaseIterator(tableItr);
+            literalItr.moveNextCount();
+        }
+        if (isEmpty) {
+            LOG(DEBUGL) << "Triejoin: literal " << i << " is empty";
+            return 0;
+        }
+        if (fields.empty()) {
+            //Ground literal that holds
+            continue;
+        }
+
+        std::vector<std::shared_ptr<Column>> columns;
+        for (auto &v : values) {
+            columns.push_back(std::shared_ptr<Column>(new InmemoryColumn(v, true)));
+        }
+        std::shared_ptr<const Segment> segment(new Segment(fields.size(), columns));
+        if (segment->getNRows() > 1) {
+            if (nthreads > 1) {
+                segment = segment->sortBy(NULL, nthreads, false);
+            } else {
+                segment = segment->sortBy(NULL);
+            }
+            segment = SegmentInserter::unique(segment);
+        }
+
+        relations.push_back(std::unique_ptr<TrieIterator>(new TrieIterator(segment)));
+        for (size_t level : levels) {
+            participants[level].push_back(relations.back().get());
+        }
+    }
+
+    search(0);
+    return nResults;
+}
@@ -0,0 +1,367 @@
+#include <vlog/matexporter.h>
+#include <vlog/seminaiver.h>
+#include <vlog/edb.h>
+#include <vlog/utils.h>
+
+#include <kognac/logs.h>
+#include <kognac/utils.h>
+#include <kognac/consts.h>
+
+#include <zlib.h>
+
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+
+MatExporter::MatExporter(SemiNaiver &sn, const MatExportFormat format,
+        const bool decompress, const bool compress, const int nthreads) :
+    sn(sn), layer(sn.getEDBLayer()), format(format), decompress(decompress),
+    compress(compress), nthreads(std::max(1, nthreads)), nextChunk(0),
+    nRows(0), nBytes(0), nLookups(0), nCacheHits(0) {
+        if (format == EXPORT_BINARY && decompress) {
+            LOG(WARNL) << "The binary format contains the IDs of the terms: "
+                "they are not decompressed";
+        }
+    }
+
+bool MatExporter::parseFormat(const std::string &name, MatExportFormat &format) {
+    if (name == "files") {
+        format = EXPORT_FILES;
+    } else if (name == "csv") {
+        format = EXPORT_CSV;
+    } else if (name == "binary") {
+        format = EXPORT_BINARY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static std::string generateFileName(std::string name) {
+    std::stringstream stream;
+
+    stream << std::oct << std::setfill('0');
+
+    for(char ch : name) {
+        int code = static_cast<unsigned char>(ch);
+
+        if (code != '\\' && code != '/') {
+            stream.put(ch);
+        } else {
+            stream << "\\" << std::setw(3) << code;
+        }
+    }
+
+    return stream.str();
+}
+
+void MatExporter::addFile(const std::string &path, const PredId_t pred) {
+    std::unique_ptr<OutputFile> file(new OutputFile());
+    file->path = path;
+    file->arity = 0;
+    file->nchunks = 0;
+    file->nextChunk = 0;
+    const size_t fileIdx = files.size();
+
+    //Group the blocks in chunks, and split the large ones if their columns
+    //can be read from any row
+    Chunk chunk;
+    chunk.file = fileIdx;
+    size_t chunkRows = 0;
+    FCIterator itr = sn.getTable(pred);
+    while (!itr.isEmpty()) {
+        std::shared_ptr<const FCInternalTable> t = itr.getCurrentTable();
+        file->arity = t->getRowSize();
+        const size_t nrows = t->getNRows();
+        const bool splittable = !t->isEDB() && t->supportsDirectAccess();
+        size_t begin = 0;
+        while (begin < nrows) {
+            size_t end = nrows;
+            if (splittable) {
+                end = std::min(nrows, begin + EXPORT_CHUNK_ROWS - chunkRows);
+            }
+            Piece piece;
+            piece.table = t;
+            piece.iteration = itr.getCurrentIteration();
+            piece.begin = begin;
+            piece.end = end;
+            chunk.pieces.push_back(piece);
+            chunkRows += end - begin;
+            begin = end;
+            if (chunkRows >= EXPORT_CHUNK_ROWS) {
+                chunk.index = file->nchunks++;
+                chunks.push_back(chunk);
+                chunk.pieces.clear();
+                chunkRows = 0;
+            }
+        }
+        itr.moveNextCount();
+    }
+    //A file without rows still has a chunk, to be created
+    if (!chunk.pieces.empty() || file->nchunks == 0) {
+        chunk.index = file->nchunks++;
+        chunks.push_back(chunk);
+    }
+    files.push_back(std::move(file));
+}
+
+void MatExporter::readPiece(const Piece &piece, const uint8_t arity,
+        Worker &worker) {
+    const size_t n = piece.end - piece.begin;
+    worker.iterations.insert(worker.iterations.end(), n, piece.iteration);
+    if (piece.begin == 0 && piece.end == piece.table->getNRows()) {
+        FCInternalTableItr *itr = piece.table->getIterator();
+        while (itr->hasNext()) {
+            itr->next();
+            for (int m = 0; m < arity; ++m) {
+                worker.columns[m].push_back(itr->getCurrentValue(m));
+            }
+        }
+        piece.table->releaseIterator(itr);
+        return;
+    }
+    //The pieces of a split table are read from their first row: its
+    //columns support direct access
+    for (int m = 0; m < arity; ++m) {
+        piece.table->getColumn(m)->getValues(piece.begin, piece.end,
+                worker.columns[m]);
+    }
+}
+
+void MatExporter::lookupTerms(Worker &worker) {
+    std::vector<Term_t> missing;
+    for (const auto &column : worker.columns) {
+        for (const Term_t v : column) {
+            if (worker.cache.count(v)) {
+                nCacheHits++;
+            } else {
+                missing.push_back(v);
+            }
+        }
+    }
+    if (missing.empty()) {
+        return;
+    }
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    nLookups += missing.size();
+
+    std::lock_guard<std::mutex> lock(dictMutex);
+    for (const Term_t v : missing) {
+        std::string &text = worker.cache[v];
+        if (layer.getDictText(v, worker.term.data())) {
+            text = worker.term.data();
+        } else {
+            text = std::to_string(v >> 40) + "_" +
+                std::to_string((v >> 32) & 0377) + "_" +
+                std::to_string(v & 0xffffffff);
+        }
+        if (format == EXPORT_CSV) {
+            text = VLogUtils::csvString(text);
+        }
+    }
+}
+
+void MatExporter::formatChunk(const Chunk &chunk, const uint8_t arity,
+        Worker &worker) {
+    worker.columns.resize(arity);
+    for (auto &column : worker.columns) {
+        column.clear();
+    }
+    worker.iterations.clear();
+    for (const Piece &piece : chunk.pieces) {
+        readPiece(piece, arity, worker);
+    }
+    const size_t n = worker.iterations.size();
+    nRows += n;
+
+    std::string &text = worker.text;
+    text.clear();
+    if (format == EXPORT_BINARY) {
+        const uint64_t nrows = n;
+        text.append((const char *) &nrows, sizeof(nrows));
+        for (const auto &column : worker.columns) {
+            for (const Term_t v : column) {
+                const uint64_t id = v;
+                text.append((const char *) &id, sizeof(id));
+            }
+        }
+        return;
+    }
+
+    const bool decode = decompress || format == EXPORT_CSV;
+    if (decode) {
+        lookupTerms(worker);
+    }
+    char number[24];
+    for (size_t i = 0; i < n; ++i) {
+        if (format == EXPORT_FILES) {
+            const int len = snprintf(number, sizeof(number), "%zu",
+                    worker.iterations[i]);
+            text.append(number, len);
+        }
+        for (int m = 0; m < arity; ++m) {
+            if (format == EXPORT_CSV) {
+                if (m > 0) {
+                    text += ',';
+                }
+            } else {
+                text += '\t';
+            }
+            const Term_t v = worker.columns[m][i];
+            if (decode) {
+                text += worker.cache.find(v)->second;
+            } else {
+                const int len = snprintf(number, sizeof(number), "%" PRIu64,
+                        (uint64_t) v);
+                text.append(number, len);
+            }
+        }
+        text += '\n';
+    }
+    if (worker.cache.size() > EXPORT_CACHE_TERMS) {
+        //Keep the terms of the next chunks
+        worker.cache.clear();
+    }
+}
+
+void MatExporter::gzip(const std::string &input, std::string &output) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    //15 + 16: a gzip header instead of a zlib one
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                Z_DEFAULT_STRATEGY) != Z_OK) {
+        LOG(ERRORL) << "Cannot initialize the compression of the export";
+        throw std::string("Cannot initialize the compression of the export");
+    }
+    output.resize(deflateBound(&stream, input.size()) + 32);
+    stream.next_in = (Bytef *) input.data();
+    stream.avail_in = input.size();
+    stream.next_out = (Bytef *) &output[0];
+    stream.avail_out = output.size();
+    const int ret = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+        LOG(ERRORL) << "Compression of the export failed";
+        throw std::string("Compression of the export failed");
+    }
+}
+
+void MatExporter::setError(const std::string &message) {
+    LOG(ERRORL) << message;
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (error.empty()) {
+        error = message;
+    }
+}
+
+void MatExporter::writeChunk(const Chunk &chunk, const std::string &data) {
+    OutputFile &file = *files[chunk.file];
+    std::unique_lock<std::mutex> lock(file.mutex);
+    file.turn.wait(lock, [&]{ return file.nextChunk == chunk.index; });
+    //Errors do not stop the chunks, otherwise the threads that wait for the
+    //next ones would be blocked
+    if (chunk.index == 0) {
+        file.buffer.resize(EXPORT_FILE_BUFFER);
+        file.out.reset(new std::ofstream());
+        file.out->rdbuf()->pubsetbuf(file.buffer.data(), file.buffer.size());
+        file.out->open(file.path, std::ios_base::out | std::ios_base::binary);
+        if (file.out->fail()) {
+            setError("Could not open " + file.path + " for writing");
+        }
+    }
+    if (!file.out->fail()) {
+        file.out->write(data.data(), data.size());
+        nBytes += data.size();
+    }
+    if (chunk.index == file.nchunks - 1) {
+        if (file.out->is_open()) {
+            file.out->close();
+            if (file.out->fail()) {
+                setError("Could not write " + file.path);
+            }
+        }
+        file.out.reset();
+        std::vector<char>().swap(file.buffer);
+    }
+    file.nextChunk++;
+    file.turn.notify_all();
+}
+
+void MatExporter::run() {
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    nextChunk = 0;
+    error.clear();
+    auto work = [&]() {
+        Worker worker;
+        worker.term.resize(MAX_TERM_SIZE);
+        size_t idx;
+        while ((idx = nextChunk++) < chunks.size()) {
+            const Chunk &chunk = chunks[idx];
+            OutputFile &file = *files[chunk.file];
+            std::string data;
+            try {
+                if (format == EXPORT_BINARY && chunk.index == 0) {
+                    const uint32_t arity = file.arity;
+                    data.append(EXPORT_BINARY_MAGIC);
+                    data.append((const char *) &arity, sizeof(arity));
+                }
+                formatChunk(chunk, file.arity, worker);
+                data.append(worker.text);
+                if (compress) {
+                    gzip(data, worker.compressed);
+                    data.swap(worker.compressed);
+                }
+            } catch (std::string &e) {
+                setError(e);
+                data.clear();
+            }
+            writeChunk(chunk, data);
+        }
+    };
+    const int n = std::min((size_t) nthreads, chunks.size());
+    if (n <= 1) {
+        work();
+    } else {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < n; ++i) {
+            threads.push_back(std::thread(work));
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+    }
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    LOG(INFOL) << "Exported " << nRows << " rows in " << files.size() <<
+        " files (" << nBytes / 1024 / 1024 << "MB) in " << sec.count() * 1000 <<
+        "ms with " << std::max(n, 1) << " threads. Dictionary lookups " <<
+        nLookups << ", cache hits " << nCacheHits;
+    files.clear();
+    chunks.clear();
+    if (!error.empty()) {
+        throw error;
+    }
+}
+
+void MatExporter::storeOnFiles(const std::string &path) {
+    Utils::create_directories(path);
+
+    //I create a new file for every idb predicate
+    Program *program = sn.getProgram();
+    for (PredId_t i = 0; i < program->getNPredicates(); ++i) {
+        if (sn.getSizeTable(i) > 0) {
+            addFile(path + "/" + generateFileName(program->getPredicateName(i)) +
+                    getSuffix(), i);
+        }
+    }
+    run();
+}
+
+void MatExporter::storeOnFile(const std::string &path, const PredId_t pred) {
+    addFile(path, pred);
+    run();
+}
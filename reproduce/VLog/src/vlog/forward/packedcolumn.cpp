@@ -0,0 +1,300 @@
+#include <vlog/packedcolumn.h>
+
+#include <kognac/logs.h>
+
+#include <unordered_set>
+
+#if TERM_IS_UINT64 && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_UNPACK 1
+#include <immintrin.h>
+#else
+#define SIMD_UNPACK 0
+#endif
+
+typedef void (*UnpackFunction)(const uint64_t *data, const uint8_t width,
+        const size_t start, const size_t n, const Term_t base,
+        const Term_t *dictionary, Term_t *output);
+
+static void unpackScalar(const uint64_t *data, const uint8_t width,
+        const size_t start, const size_t n, const Term_t base,
+        const Term_t *dictionary, Term_t *output) {
+    if (dictionary != NULL) {
+        for (size_t i = 0; i < n; ++i) {
+            output[i] = dictionary[BitPacking::get(data, width, start + i)];
+        }
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            output[i] = base + BitPacking::get(data, width, start + i);
+        }
+    }
+}
+
+#if SIMD_UNPACK
+//Four values at a time: one gather loads the 64 bits that contain every
+//value, and a second one reads the dictionary
+__attribute__((target("avx2")))
+static void unpackAVX2(const uint64_t *data, const uint8_t width,
+        const size_t start, const size_t n, const Term_t base,
+        const Term_t *dictionary, Term_t *output) {
+    const long long *bytes = (const long long *) data;
+    const __m256i mask = _mm256_set1_epi64x((long long) ((1ULL << width) - 1));
+    const __m256i seven = _mm256_set1_epi64x(7);
+    const __m256i baseV = _mm256_set1_epi64x((long long) base);
+    const __m256i step = _mm256_set1_epi64x((long long) width * 4);
+    __m256i bits = _mm256_add_epi64(_mm256_set1_epi64x((long long) (start * width)),
+            _mm256_set_epi64x((long long) width * 3, (long long) width * 2,
+                (long long) width, 0));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i words = _mm256_i64gather_epi64(bytes, _mm256_srli_epi64(bits, 3), 1);
+        __m256i v = _mm256_and_si256(_mm256_srlv_epi64(words,
+                    _mm256_and_si256(bits, seven)), mask);
+        if (dictionary != NULL) {
+            v = _mm256_i64gather_epi64((const long long *) dictionary, v, 8);
+        } else {
+            v = _mm256_add_epi64(v, baseV);
+        }
+        _mm256_storeu_si256((__m256i *) (output + i), v);
+        bits = _mm256_add_epi64(bits, step);
+    }
+    unpackScalar(data, width, start + i, n - i, base, dictionary, output + i);
+}
+
+static UnpackFunction chooseUnpackFunction() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return unpackAVX2;
+    }
+    return unpackScalar;
+}
+#else
+static UnpackFunction chooseUnpackFunction() {
+    return unpackScalar;
+}
+#endif
+
+static const UnpackFunction unpackValues = chooseUnpackFunction();
+
+uint8_t BitPacking::getWidth(const uint64_t v) {
+    return v == 0 ? 0 : 64 - __builtin_clzll(v);
+}
+
+static size_t getNWords(const size_t n, const uint8_t width) {
+    //One more word, so that the last value can be read with a 64-bit load
+    return (n * width + 63) / 64 + 1;
+}
+
+void BitPacking::pack(const Term_t *values, const size_t n, const Term_t base,
+        const uint8_t width, std::vector<uint64_t> &data) {
+    data.assign(getNWords(n, width), 0);
+    if (width == 0) {
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t v = values[i] - base;
+        const size_t bit = i * width;
+        const size_t word = bit >> 6;
+        const int offset = bit & 63;
+        data[word] |= v << offset;
+        if (offset + width > 64) {
+            data[word + 1] |= v >> (64 - offset);
+        }
+    }
+}
+
+void BitPacking::unpack(const uint64_t *data, const uint8_t width,
+        const size_t start, const size_t n, const Term_t base,
+        const Term_t *dictionary, Term_t *output) {
+    unpackValues(data, width, start, n, base, dictionary, output);
+}
+
+Term_t PackedColumnReader::first() {
+    const uint64_t v = BitPacking::get(data, width, 0);
+    return dictionary != NULL ? dictionary[v] : base + v;
+}
+
+Term_t PackedColumnReader::last() {
+    const uint64_t v = BitPacking::get(data, width, _size - 1);
+    return dictionary != NULL ? dictionary[v] : base + v;
+}
+
+std::vector<Term_t> PackedColumnReader::asVector() {
+    std::vector<Term_t> output(_size);
+    if (_size > 0) {
+        BitPacking::unpack(data, width, 0, _size, base, dictionary, &output[0]);
+    }
+    return output;
+}
+
+FORColumn::FORColumn(const std::vector<Term_t> &values, const Term_t min,
+        const uint8_t width) : base(min), width(width), _size(values.size()) {
+    BitPacking::pack(values.data(), values.size(), min, width, data);
+}
+
+std::shared_ptr<Column> FORColumn::sort() const {
+    std::vector<Term_t> values = getReader()->asVector();
+    std::sort(values.begin(), values.end());
+    return ColumnWriter::getColumn(values, true);
+}
+
+std::shared_ptr<Column> FORColumn::sort(const int nthreads) const {
+    if (nthreads <= 1) {
+        return sort();
+    }
+    std::vector<Term_t> values = getReader()->asVector();
+    ParallelTasks::sort_int(values.begin(), values.end());
+    return ColumnWriter::getColumn(values, true);
+}
+
+std::shared_ptr<Column> FORColumn::unique() const {
+    //I assume the column is already sorted
+    std::vector<Term_t> values = getReader()->asVector();
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    return ColumnWriter::getColumn(values, true);
+}
+
+void FORColumn::getValues(const size_t begin, const size_t end,
+        std::vector<Term_t> &out) const {
+    const size_t n = out.size();
+    out.resize(n + end - begin);
+    BitPacking::unpack(data.data(), width, begin, end - begin, base, NULL,
+            out.data() + n);
+}
+
+bool FORColumn::isIn(const Term_t t) const {
+    //The column is assumed to be sorted, as in InmemoryColumn::isIn
+    size_t begin = 0;
+    size_t end = _size;
+    while (begin < end) {
+        const size_t mid = begin + (end - begin) / 2;
+        const Term_t v = getValue(mid);
+        if (v == t) {
+            return true;
+        } else if (v < t) {
+            begin = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    return false;
+}
+
+DictionaryColumn::DictionaryColumn(const std::vector<Term_t> &values,
+        std::vector<Term_t> &dictionary) : _size(values.size()) {
+    this->dictionary.swap(dictionary);
+    width = BitPacking::getWidth(this->dictionary.size() - 1);
+    std::vector<Term_t> codes(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        codes[i] = std::lower_bound(this->dictionary.begin(),
+                this->dictionary.end(), values[i]) - this->dictionary.begin();
+    }
+    BitPacking::pack(codes.data(), codes.size(), 0, width, data);
+}
+
+void DictionaryColumn::getValues(const size_t begin, const size_t end,
+        std::vector<Term_t> &out) const {
+    const size_t n = out.size();
+    out.resize(n + end - begin);
+    BitPacking::unpack(data.data(), width, begin, end - begin, 0,
+            dictionary.data(), out.data() + n);
+}
+
+std::shared_ptr<Column> DictionaryColumn::sort() const {
+    std::vector<Term_t> values = getReader()->asVector();
+    std::sort(values.begin(), values.end());
+    return ColumnWriter::getColumn(values, true);
+}
+
+std::shared_ptr<Column> DictionaryColumn::sort(const int nthreads) const {
+    if (nthreads <= 1) {
+        return sort();
+    }
+    std::vector<Term_t> values = getReader()->asVector();
+    ParallelTasks::sort_int(values.begin(), values.end());
+    return ColumnWriter::getColumn(values, true);
+}
+
+std::shared_ptr<Column> DictionaryColumn::unique() const {
+    //I assume the column is already sorted
+    std::vector<Term_t> values = getReader()->asVector();
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    return ColumnWriter::getColumn(values, true);
+}
+
+static size_t packMinRows = PACKED_COLUMN_MIN_ROWS;
+
+void ColumnWriter::setPackMinRows(const size_t minRows) {
+    packMinRows = minRows;
+}
+
+std::shared_ptr<Column> ColumnWriter::pack(std::vector<Term_t> &values,
+        const bool isSorted) {
+    const size_t n = values.size();
+    if (packMinRows == 0 || n < packMinRows) {
+        return std::shared_ptr<Column>(new InmemoryColumn(values, true));
+    }
+
+    Term_t min = values[0];
+    Term_t max = values[0];
+    bool sorted = isSorted;
+    for (size_t i = 1; i < n; ++i) {
+        const Term_t v = values[i];
+        sorted = sorted && values[i - 1] <= v;
+        if (v < min) {
+            min = v;
+        } else if (v > max) {
+            max = v;
+        }
+    }
+    const size_t rawBytes = n * sizeof(Term_t);
+    const uint8_t forWidth = BitPacking::getWidth(max - min);
+    size_t forBytes = forWidth <= PACKED_MAX_WIDTH ?
+        getNWords(n, forWidth) * sizeof(uint64_t) : rawBytes;
+
+    //The dictionary pays off only if the distinct values are much fewer
+    //than the values of the range. Stop counting them when there are too many
+    std::vector<Term_t> dictionary;
+    size_t dictBytes = rawBytes;
+    if (forWidth > 8) {
+        const size_t maxDistinct = n / 64;
+        bool small = true;
+        if (sorted) {
+            dictionary.push_back(values[0]);
+            for (size_t i = 1; i < n && small; ++i) {
+                if (values[i] != values[i - 1]) {
+                    dictionary.push_back(values[i]);
+                    small = dictionary.size() <= maxDistinct;
+                }
+            }
+        } else {
+            std::unordered_set<Term_t> distinct;
+            for (size_t i = 0; i < n && small; ++i) {
+                distinct.insert(values[i]);
+                small = distinct.size() <= maxDistinct;
+            }
+            if (small) {
+                dictionary.assign(distinct.begin(), distinct.end());
+                std::sort(dictionary.begin(), dictionary.end());
+            }
+        }
+        if (small) {
+            dictBytes = dictionary.size() * sizeof(Term_t) + getNWords(n,
+                    BitPacking::getWidth(dictionary.size() - 1)) * sizeof(uint64_t);
+        }
+    }
+
+    std::shared_ptr<Column> column;
+    if (std::min(forBytes, dictBytes) > rawBytes * PACKED_COLUMN_MAX_RATIO) {
+        return std::shared_ptr<Column>(new InmemoryColumn(values, true));
+    } else if (dictBytes < forBytes) {
+        LOG(TRACEL) << "Dictionary column: " << n << " values, " <<
+            dictionary.size() << " distinct, " << dictBytes << " bytes";
+        column = std::shared_ptr<Column>(new DictionaryColumn(values, dictionary));
+    } else {
+        LOG(TRACEL) << "FOR column: " << n << " values, width " <<
+            (int) forWidth << ", " << forBytes << " bytes";
+        column = std::shared_ptr<Column>(new FORColumn(values, min, forWidth));
+    }
+    std::vector<Term_t>().swap(values);
+    return column;
+}
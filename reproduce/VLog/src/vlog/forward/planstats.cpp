@@ -0,0 +1,179 @@
+#include <vlog/planstats.h>
+
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <sstream>
+
+int PlanStatistics::chooseFirstAtom(RulePlan &plan) {
+    //Try every atom once before comparing them
+    int best = -1;
+    for (int i = 0; i < plan.candidates.size(); ++i) {
+        if (plan.excluded[i]) {
+            continue;
+        }
+        if (plan.candidates[i].executions == 0) {
+            return i;
+        }
+        if (best == -1 || plan.candidates[i].getCost() <
+                plan.candidates[best].getCost()) {
+            best = i;
+        }
+    }
+    if (best != -1 && best != plan.chosen) {
+        LOG(INFOL) << "Plan of rule " << plan.rule << ": atom " << best <<
+            " is evaluated first (" << plan.candidates[best].getCost() <<
+            " intermediate rows per input row)";
+        plan.chosen = best;
+    }
+    return best;
+}
+
+int PlanStatistics::getFirstAtom(const size_t ruleid, const int combination) {
+    if (!enabled) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    auto itr = plans.find(std::make_pair(ruleid, combination));
+    if (itr == plans.end() || !itr->second.replanned) {
+        return -1;
+    }
+    return chooseFirstAtom(itr->second);
+}
+
+void PlanStatistics::record(const size_t ruleid, const int combination,
+        std::function<std::string()> getRule,
+        const int firstAtom,
+        const std::vector<bool> &excluded,
+        const double estimatedRows,
+        const double inputRows,
+        const double intermediateRows,
+        const double time) {
+    if (!enabled || firstAtom < 0 || firstAtom >= excluded.size()) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    RulePlan &plan = plans[std::make_pair(ruleid, combination)];
+    if (plan.candidates.size() != excluded.size()) {
+        plan.candidates.clear();
+        plan.candidates.resize(excluded.size());
+        plan.excluded = excluded;
+        plan.replanned = false;
+        plan.chosen = -1;
+    }
+    Candidate &c = plan.candidates[firstAtom];
+    c.executions++;
+    c.rows += intermediateRows;
+    c.inputRows += inputRows;
+    c.time += time;
+
+    if (!plan.replanned && intermediateRows >= PLANSTATS_MIN_ROWS &&
+            intermediateRows > PLANSTATS_DEVIATION * estimatedRows) {
+        size_t nCandidates = 0;
+        for (int i = 0; i < excluded.size(); ++i) {
+            nCandidates += !excluded[i];
+        }
+        if (nCandidates > 1) {
+            plan.rule = getRule();
+            LOG(INFOL) << "Re-planning rule " << plan.rule << " (combination " <<
+                combination << "): " << (uint64_t) intermediateRows <<
+                " intermediate rows, " << (uint64_t) estimatedRows <<
+                " estimated";
+            plan.replanned = true;
+            nReplanned++;
+        }
+    }
+}
+
+bool PlanStatistics::load(const std::string &path, const uint64_t programHash) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string header;
+    uint64_t hash = 0;
+    file >> header >> hash;
+    if (header != "planstats" || hash != programHash) {
+        LOG(INFOL) << "The plan statistics in " << path <<
+            " are not about this program: ignored";
+        return true;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    size_t loaded = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        //ruleid, combination, atom, excluded, executions, rows, inputRows,
+        //time, and the rule after a tab
+        std::stringstream ss(line);
+        size_t ruleid;
+        int combination, atom;
+        bool excluded;
+        Candidate c;
+        if (!(ss >> ruleid >> combination >> atom >> excluded >>
+                    c.executions >> c.rows >> c.inputRows >> c.time) || atom < 0) {
+            LOG(WARNL) << "Malformed line in " << path << ": " << line;
+            continue;
+        }
+        RulePlan &plan = plans[std::make_pair(ruleid, combination)];
+        if (plan.candidates.size() <= atom) {
+            plan.candidates.resize(atom + 1);
+            plan.excluded.resize(atom + 1, true);
+        }
+        plan.candidates[atom] = c;
+        plan.excluded[atom] = excluded;
+        plan.replanned = true;
+        std::string rule;
+        if (std::getline(ss, rule, '\t') && std::getline(ss, rule)) {
+            plan.rule = rule;
+        }
+        loaded++;
+    }
+    LOG(INFOL) << "Loaded " << loaded << " plan statistics from " << path;
+    return true;
+}
+
+void PlanStatistics::save(const std::string &path, const uint64_t programHash) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::ofstream file(path);
+    if (!file) {
+        LOG(ERRORL) << "Cannot write the plan statistics in " << path;
+        return;
+    }
+    file << "planstats " << programHash << std::endl;
+    for (const auto &p : plans) {
+        if (!p.second.replanned) {
+            continue;
+        }
+        for (int i = 0; i < p.second.candidates.size(); ++i) {
+            const Candidate &c = p.second.candidates[i];
+            file << p.first.first << " " << p.first.second << " " << i << " " <<
+                p.second.excluded[i] << " " << c.executions << " " << c.rows <<
+                " " << c.inputRows << " " << c.time << "\t" << p.second.rule <<
+                std::endl;
+        }
+    }
+}
+
+std::string PlanStatistics::toString() {
+    std::lock_guard<std::mutex> guard(lock);
+    size_t replanned = 0;
+    for (const auto &p : plans) {
+        replanned += p.second.replanned;
+    }
+    std::stringstream ss;
+    ss << plans.size() << " rule combinations observed, " << replanned <<
+        " re-planned (" << nReplanned << " in this run)";
+    return ss.str();
+}
+
+uint64_t PlanStatistics::hashString(const std::string &s, uint64_t h) {
+    for (const char c : s) {
+        h ^= (unsigned char) c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
@@ -257,5 +257,95 @@ void RuleExecutionPlan::calculateJoinsCoordinates(const std::vector<Literal> &he
         posFromSecond.push_back(ps);
     }
 
+    calculateTrieJoinCoordinates(heads);
+}
+
+bool RuleExecutionPlan::hasCyclicVariableStructure(const std::vector<const Literal*> &plan) {
+    std::vector<std::vector<Var_t>> edges;
+    for (const Literal *literal : plan) {
+        std::vector<Var_t> vars = literal->getAllVars();
+        std::sort(vars.begin(), vars.end());
+        edges.push_back(vars);
+    }
+
+    //Repeatedly remove the variables that occur in only one edge and the
+    //edges that are contained in another one. The hypergraph is acyclic iff
+    //at most one edge survives.
+    bool changed = true;
+    while (changed && edges.size() > 1) {
+        changed = false;
+        std::map<Var_t, int> occurrences;
+        for (const auto &edge : edges) {
+            for (Var_t v : edge) {
+                occurrences[v]++;
+            }
+        }
+        for (auto &edge : edges) {
+            size_t oldSize = edge.size();
+            edge.erase(std::remove_if(edge.begin(), edge.end(), [&occurrences](Var_t v) {
+                        return occurrences[v] == 1;
+                        }), edge.end());
+            changed |= edge.size() != oldSize;
+        }
+        for (size_t i = 0; i < edges.size(); ++i) {
+            for (size_t j = 0; j < edges.size(); ++j) {
+                if (i != j && std::includes(edges[j].begin(), edges[j].end(),
+                            edges[i].begin(), edges[i].end())) {
+                    edges.erase(edges.begin() + i);
+                    changed = true;
+                    i--;
+                    break;
+                }
+            }
+        }
+    }
+    return edges.size() > 1;
+}
+
+void RuleExecutionPlan::calculateTrieJoinCoordinates(const std::vector<Literal> &heads) {
+    trieJoinVars.clear();
+    trieJoinPosFromFirst.clear();
+    cyclicBody = plan.size() > 2 && hasCyclicVariableStructure(plan);
+    if (!cyclicBody) {
+        return;
+    }
+
+    //Variables that occur in many literals first, so that they restrict
+    //the search early. Ties are broken by the order of the plan.
+    std::vector<Var_t> vars;
+    std::map<Var_t, int> occurrences;
+    for (const Literal *literal : plan) {
+        std::vector<Var_t> litVars = literal->getAllVars();
+        for (Var_t v : litVars) {
+            if (std::find(vars.begin(), vars.end(), v) == vars.end()) {
+                vars.push_back(v);
+            }
+            occurrences[v]++;
+        }
+    }
+    std::stable_sort(vars.begin(), vars.end(), [&occurrences](Var_t a, Var_t b) {
+            return occurrences[a] > occurrences[b];
+            });
+    trieJoinVars = vars;
+
+    uint32_t countVars = 0;
+    for (auto &headLiteral : heads) {
+        for (int headPos = 0; headPos < headLiteral.getTupleSize(); ++headPos) {
+            const VTerm headTerm = headLiteral.getTermAtPos(headPos);
+            if (headTerm.isVariable()) {
+                auto itr = std::find(vars.begin(), vars.end(), headTerm.getId());
+                if (itr == vars.end()) {
+                    //Existential variable. Not supported by the triejoin.
+                    cyclicBody = false;
+                    trieJoinVars.clear();
+                    trieJoinPosFromFirst.clear();
+                    return;
+                }
+                trieJoinPosFromFirst.push_back(std::make_pair(countVars + headPos,
+                            itr - vars.begin()));
+            }
+        }
+        countVars += headLiteral.getTupleSize();
+    }
 }
 
@@ -1,12 +1,14 @@
 #include <vlog/seminaiver.h>
 #include <vlog/concepts.h>
 #include <vlog/joinprocessor.h>
+#include <vlog/leapfrogjoin.h>
 #include <vlog/fctable.h>
 #include <vlog/fcinttable.h>
 #include <vlog/filterer.h>
 #include <vlog/finalresultjoinproc.h>
 #include <vlog/extresultjoinproc.h>
 #include <vlog/utils.h>
+#include <vlog/matexporter.h>
 #include <trident/model/table.h>
 #include <kognac/consts.h>
 #include <kognac/utils.h>
@@ -17,6 +19,11 @@
 #include <memory>
 #include <sstream>
 #include <unordered_set>
+#include <algorithm>
+#include <cstdlib>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 void SemiNaiver::createGraphRuleDependency(std::vector<int> &nodes,
         std::vector<std::pair<int, int>> &edges) {
@@ -94,6 +101,9 @@ SemiNaiver::SemiNaiver(EDBLayer &layer,
         std::vector<Rule> ruleset = program->getAllRules();
         predicatesTables.resize(program->getMaxPredicateId());
         ignoreDuplicatesElimination = false;
+        useTrieJoin = true;
+        useHashJoin = false;
+        skipFreshHeadChecks = false;
         TableFilterer::setOptIntersect(opt_intersect);
 
         if (! program->stratify(stratification, nStratificationClasses)) {
@@ -322,6 +332,18 @@ void SemiNaiver::prepare(size_t lastExecution, int singleRuleToCheck, std::vecto
     }
     allRulesSize += allEDBRules.size();
     allrules.reserve(allRulesSize);
+    if (skipsFreshHeadChecks()) {
+        std::vector<RuleExecutionDetails*> details;
+        for (auto &d : allEDBRules) {
+            details.push_back(&d);
+        }
+        for (auto &strata : allIDBRules) {
+            for (auto &d : strata) {
+                details.push_back(&d);
+            }
+        }
+        LOG(INFOL) << markFreshHeadRules(details) << " existential rules never have a satisfied head: their heads are not checked";
+    }
 
     //Setup the datastructures to handle the chase
     std::copy(allEDBRules.begin(), allEDBRules.end(), std::back_inserter(allrules));
@@ -331,13 +353,56 @@ void SemiNaiver::prepare(size_t lastExecution, int singleRuleToCheck, std::vecto
     chaseMgmt = std::shared_ptr<ChaseMgmt>(new ChaseMgmt(allrules,
                 typeChase, checkCyclicTerms,
                 singleRuleToCheck,
-                predIgnoreBlock));
+                predIgnoreBlock, nthreads));
 #if DEBUG
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
     LOG(DEBUGL) << "Runtime ruleset optimization ms = " << sec.count() * 1000;
 #endif
 }
 
+//The head of a trigger is never satisfied before the rule is applied to it
+//if no other rule derives its predicates, the atoms of the head have distinct
+//predicates, and each of them contains all the variables of the body. Then
+//only an earlier trigger of the same rule could satisfy it, and that trigger
+//would have to agree with this one on all the variables of the body
+static bool hasFreshHead(const Rule &rule,
+        const std::map<PredId_t, size_t> &nHeadsPerPredicate) {
+    if (!rule.isExistential()) {
+        return false;
+    }
+    const std::vector<Var_t> bodyVars = rule.getVarsInBody();
+    for (const auto &head : rule.getHeads()) {
+        if (head.getPredicate().getType() != IDB ||
+                nHeadsPerPredicate.at(head.getPredicate().getId()) > 1) {
+            return false;
+        }
+        const std::vector<Var_t> headVars = head.getAllVars();
+        for (const Var_t var : bodyVars) {
+            if (std::find(headVars.begin(), headVars.end(), var) ==
+                    headVars.end()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+size_t SemiNaiver::markFreshHeadRules(
+        const std::vector<RuleExecutionDetails*> &rules) {
+    std::map<PredId_t, size_t> nHeadsPerPredicate;
+    for (const Rule &rule : program->getAllRules()) {
+        for (const auto &head : rule.getHeads()) {
+            nHeadsPerPredicate[head.getPredicate().getId()]++;
+        }
+    }
+    size_t nFresh = 0;
+    for (RuleExecutionDetails *d : rules) {
+        d->freshHead = hasFreshHead(d->rule, nHeadsPerPredicate);
+        nFresh += d->freshHead;
+    }
+    return nFresh;
+}
+
 void SemiNaiver::run(size_t lastExecution, size_t it, unsigned long *timeout,
         bool checkCyclicTerms, int singleRuleToCheck, PredId_t predIgnoreBlock) {
     this->checkCyclicTerms = checkCyclicTerms;
@@ -409,6 +474,16 @@ void SemiNaiver::run(size_t lastExecution, size_t it, unsigned long *timeout,
 
     running = false;
     LOG(DEBUGL) << "Finished process. Iterations=" << iteration;
+    LOG(INFOL) << "Memory: " << MemoryStats::toString(&arena);
+    LOG(INFOL) << "Membership filters of the duplicate elimination: " <<
+        FCTable::getRetainFilterStats();
+    LOG(INFOL) << "Plans: " << planStats.toString();
+    if (spillManager != NULL) {
+        LOG(INFOL) << "Spilling: " << spillManager->getStats();
+    }
+    if (!planStatsPath.empty()) {
+        planStats.save(planStatsPath, getProgramHash());
+    }
 
     //DEBUGGING CODE -- needed to see which rules cost the most
     //Sort the iteration costs
@@ -476,6 +551,7 @@ bool SemiNaiver::executeUntilSaturation(
             ruleset[currentRule].lastExecution = iteration;
         }
         iteration++;
+        checkMemoryBudget(ruleset);
 
         if (checkCyclicTerms) {
             foundCyclicTerms = chaseMgmt->checkCyclicTerms(currentRule);
@@ -578,104 +654,16 @@ bool SemiNaiver::executeUntilSaturation(
 }
 
 void SemiNaiver::storeOnFile(std::string path, const PredId_t pred, const bool decompress, const int minLevel, const bool csv) {
-    FCTable *table = predicatesTables[pred];
-    char buffer[MAX_TERM_SIZE];
-
-    std::ofstream streamout(path);
-    if (streamout.fail()) {
-        throw("Could not open " + path + " for writing");
-    }
-
-    if (table != NULL && !table->isEmpty()) {
-        FCIterator itr = table->read(0);
-        if (! itr.isEmpty()) {
-            const int sizeRow = table->getSizeRow();
-            while (!itr.isEmpty()) {
-                std::shared_ptr<const FCInternalTable> t = itr.getCurrentTable();
-                FCInternalTableItr *iitr = t->getIterator();
-                while (iitr->hasNext()) {
-                    iitr->next();
-                    std::string row = "";
-                    if (! csv) {
-                        row = to_string(iitr->getCurrentIteration());
-                    }
-                    bool first = true;
-                    for (int m = 0; m < sizeRow; ++m) {
-                        if (decompress || csv) {
-                            if (layer.getDictText(iitr->getCurrentValue(m), buffer)) {
-                                if (csv) {
-                                    if (first) {
-                                        first = false;
-                                    } else {
-                                        row += ",";
-                                    }
-                                    row += VLogUtils::csvString(std::string(buffer));
-                                } else {
-                                    row += "\t";
-                                    row += std::string(buffer);
-                                }
-                            } else {
-                                uint64_t v = iitr->getCurrentValue(m);
-                                std::string t = "" + std::to_string(v >> 40) + "_"
-                                    + std::to_string((v >> 32) & 0377) + "_"
-                                    + std::to_string(v & 0xffffffff);
-                                if (csv) {
-                                    if (first) {
-                                        first = false;
-                                    } else {
-                                        row += ",";
-                                    }
-                                    row += VLogUtils::csvString(t);
-                                } else {
-                                    row += "\t";
-                                    row += t;
-                                }
-                            }
-                        } else {
-                            row += "\t" + to_string(iitr->getCurrentValue(m));
-                        }
-                    }
-                    streamout << row << std::endl;
-                }
-                t->releaseIterator(iitr);
-                itr.moveNextCount();
-            }
-        }
-    }
-    streamout.close();
-}
-
-static std::string generateFileName(std::string name) {
-    std::stringstream stream;
-
-    stream << std::oct << std::setfill('0');
-
-    for(char ch : name) {
-        int code = static_cast<unsigned char>(ch);
-
-        if (code != '\\' && code != '/') {
-            stream.put(ch);
-        } else {
-            stream << "\\" << std::setw(3) << code;
-        }
-    }
-
-    return stream.str();
+    MatExporter exporter(*this, csv ? EXPORT_CSV : EXPORT_FILES, decompress,
+            false, nthreads);
+    exporter.storeOnFile(path, pred);
 }
 
 void SemiNaiver::storeOnFiles(std::string path, const bool decompress,
         const int minLevel, const bool csv) {
-    char buffer[MAX_TERM_SIZE];
-
-    Utils::create_directories(path);
-
-    //I create a new file for every idb predicate
-    for (PredId_t i = 0; i < program->getNPredicates(); ++i) {
-        FCTable *table = predicatesTables[i];
-        if (table != NULL && !table->isEmpty()) {
-            storeOnFile(path + "/" + generateFileName(program->getPredicateName(i)), i, decompress, minLevel, csv);
-        }
-    }
+    MatExporter exporter(*this, csv ? EXPORT_CSV : EXPORT_FILES, decompress,
+            false, nthreads);
+    exporter.storeOnFiles(path);
 }
 
 bool _sortCards(const std::pair<int, size_t> &v1, const std::pair<int, size_t> &v2) {
@@ -1091,7 +1079,8 @@ void SemiNaiver::reorderPlanForNegatedLiterals(RuleExecutionPlan &plan, const st
 void SemiNaiver::reorderPlan(RuleExecutionPlan &plan,
         const std::vector<size_t> &cards,
         const std::vector<Literal> &heads,
-        bool copyAllVars) {
+        bool copyAllVars,
+        const int firstAtom) {
     //Reorder the atoms in terms of cardinality.
     std::vector<std::pair<int, size_t>> positionCards;
     for (int i = 0; i < cards.size(); ++i) {
@@ -1099,6 +1088,16 @@ void SemiNaiver::reorderPlan(RuleExecutionPlan &plan,
         positionCards.push_back(std::make_pair(i, cards[i]));
     }
     sort(positionCards.begin(), positionCards.end(), _sortCards);
+    if (firstAtom >= 0 && firstAtom < positionCards.size()) {
+        //Chosen on the observed costs of the previous executions
+        for (int i = 0; i < positionCards.size(); ++i) {
+            if (positionCards[i].first == firstAtom) {
+                std::rotate(positionCards.begin(), positionCards.begin() + i,
+                        positionCards.begin() + i + 1);
+                break;
+            }
+        }
+    }
 
     //Ensure there are always variables
     std::vector<std::pair<int, size_t>> adaptedPosCards;
@@ -1155,6 +1154,92 @@ void SemiNaiver::reorderPlan(RuleExecutionPlan &plan,
     }
 }
 
+uint64_t SemiNaiver::getProgramHash() {
+    uint64_t h = PlanStatistics::hashString("");
+    for (const auto &rule : program->getAllRules()) {
+        h = PlanStatistics::hashString(rule.tostring(program, &layer) + "\n", h);
+    }
+    return h;
+}
+
+void SemiNaiver::setAdaptivePlans(bool enabled, const std::string &statsPath) {
+    planStats.setEnabled(enabled);
+    planStatsPath = enabled ? statsPath : "";
+    if (!planStatsPath.empty() && !planStats.load(planStatsPath, getProgramHash())) {
+        LOG(INFOL) << "No plan statistics in " << planStatsPath <<
+            ": they will be created";
+    }
+}
+
+void SemiNaiver::setMemoryBudget(const size_t bytes,
+        const std::string &directory) {
+    if (bytes == 0) {
+        spillManager.reset();
+        return;
+    }
+    std::string dir = directory;
+    if (dir.empty()) {
+        const char *tmp = getenv("TMPDIR");
+        dir = tmp != NULL ? tmp : "/tmp";
+    }
+    spillManager.reset(new SpillManager(bytes, dir));
+}
+
+void SemiNaiver::checkMemoryBudget(
+        const std::vector<RuleExecutionDetails> &ruleset) {
+    if (spillManager == NULL || spillManager->getExcess() == 0) {
+        return;
+    }
+    //First drop the pages that were read back
+    spillManager->releasePages();
+    size_t excess = spillManager->getExcess();
+    if (excess == 0) {
+        return;
+    }
+
+    //Blocks before the last execution of every rule are not read as deltas
+    //anymore, so they are accessed less often. Spill them first, and the
+    //other ones only if that is not enough
+    size_t cold = iteration;
+    for (const auto &r : ruleset) {
+        cold = std::min(cold, (size_t) r.lastExecution);
+    }
+    //The list of derivations shares the tables of the blocks
+    std::unordered_map<const FCInternalTable*, long> otherUses;
+    for (const auto &block : listDerivations) {
+        otherUses[block.table.get()]++;
+    }
+    std::unordered_map<const FCInternalTable*,
+        std::shared_ptr<const FCInternalTable>> spilled;
+    const size_t limits[2] = { cold, iteration };
+    size_t freed = 0;
+    for (const size_t limit : limits) {
+        for (FCTable *table : predicatesTables) {
+            if (freed >= excess) {
+                break;
+            }
+            if (table != NULL) {
+                freed += table->spill(*spillManager, limit, excess - freed,
+                        otherUses, spilled);
+            }
+        }
+    }
+    for (auto &block : listDerivations) {
+        auto itr = spilled.find(block.table.get());
+        if (itr != spilled.end()) {
+            block.table = itr->second;
+        }
+    }
+#ifdef __GLIBC__
+    //Otherwise the freed columns stay in the heap of the process
+    if (freed > 0) {
+        malloc_trim(0);
+    }
+#endif
+    LOG(DEBUGL) << "Memory budget exceeded by " << excess / 1024 / 1024 <<
+        "MB: spilled " << freed / 1024 / 1024 << "MB";
+}
+
 FCTable *SemiNaiver::getTable(const PredId_t pred, const int card) {
     FCTable *endTable;
     if (predicatesTables[pred] != NULL) {
@@ -1166,6 +1251,90 @@ FCTable *SemiNaiver::getTable(const PredId_t pred, const int card) {
     return endTable;
 }
 
+bool SemiNaiver::canUseTrieJoin(const RuleExecutionDetails &ruleDetails,
+        const RuleExecutionPlan &plan) {
+    if (!plan.cyclicBody || ruleDetails.rule.isExistential()) {
+        return false;
+    }
+    for (const Literal *literal : plan.plan) {
+        //Expensive EDB predicates must be queried with bindings
+        if (literal->isNegated() || (literal->getPredicate().getType() == EDB &&
+                    layer.expensiveEDBPredicate(literal->getPredicate().getId()))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SemiNaiver::executeTrieJoin(const RuleExecutionDetails &ruleDetails,
+        RuleExecutionPlan &plan,
+        std::vector<Literal> &heads,
+        const size_t iteration,
+        const int orderExecution,
+        int &processedTables,
+        std::vector<ResultJoinProcessor*> *finalResultContainer) {
+    //Same ranges as in executeRule
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (const auto &range : plan.ranges) {
+        size_t min = range.first;
+        size_t max = range.second;
+        if (min == 1)
+            min = ruleDetails.lastExecution;
+        if (max == 1)
+            max = ruleDetails.lastExecution - 1;
+        if (min > max) {
+            //executeRule skips this atom and joins the others, so leave
+            //the combination to the binary joins
+            return false;
+        }
+        ranges.push_back(std::make_pair(min, max));
+    }
+
+    //The bindings of all the variables are passed as the first row
+    std::vector<std::pair<uint8_t, uint8_t>> noPositions;
+    ResultJoinProcessor *joinOutput = NULL;
+    if (heads.size() == 1) {
+        FCTable *table = getTable(heads[0].getPredicate().getId(),
+                heads[0].getPredicate().getCardinality());
+        joinOutput = new SingleHeadFinalRuleProcessor(
+                plan.trieJoinPosFromFirst,
+                noPositions,
+                listDerivations,
+                table,
+                heads[0],
+                0,
+                &ruleDetails,
+                orderExecution,
+                iteration,
+                finalResultContainer == NULL,
+                !multithreaded ? -1 : nthreads,
+                ignoreDuplicatesElimination);
+    } else {
+        joinOutput = new FinalRuleProcessor(
+                plan.trieJoinPosFromFirst,
+                noPositions,
+                listDerivations,
+                heads, &ruleDetails,
+                orderExecution, iteration,
+                finalResultContainer == NULL,
+                !multithreaded ? -1 : nthreads, this,
+                ignoreDuplicatesElimination);
+    }
+
+    LeapfrogTrieJoin join;
+    size_t nBindings = join.join(this, plan, ranges, joinOutput, processedTables,
+            multithreaded ? nthreads : -1);
+    LOG(DEBUGL) << "Triejoin found " << nBindings << " bindings";
+    joinOutput->consolidate(true);
+
+    if (finalResultContainer) {
+        finalResultContainer->push_back(joinOutput);
+    } else {
+        delete joinOutput;
+    }
+    return true;
+}
+
 void SemiNaiver::saveDerivationIntoDerivationList(FCTable *endTable) {
     LOG(ERRORL) << "Legacy method. Shouldn't be needed anymore ...";
     throw 10;
@@ -1209,11 +1378,15 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
 
     LOG(DEBUGL) << "Iteration: " << iteration << " Rule: " << rule.tostring(program, &layer);
 
+    //The joins of this rule take their buffers from the arena
+    TupleArena::Scope arenaScope(arena);
+
     //Set up timers
     const std::chrono::system_clock::time_point startRule = std::chrono::system_clock::now();
     std::chrono::duration<double> durationJoin(0);
     std::chrono::duration<double> durationConsolidation(0);
     std::chrono::duration<double> durationFirstAtom(0);
+    const double startRetain = FCTable::getRetainTime();
 
     //Get table corresponding to the head predicate
     //FCTable *endTable = getTable(idHeadPredicate, headLiteral.
@@ -1257,8 +1430,11 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
             continue;
         }
 
-        //Reorder the list of atoms depending on the observed cardinalities
-        reorderPlan(plan, cards, heads, checkCyclicTerms);
+        //Reorder the list of atoms depending on the observed cardinalities,
+        //or on the costs of the previous executions if the rule was re-planned
+        const std::vector<const Literal*> originalOrder = plan.plan;
+        reorderPlan(plan, cards, heads, checkCyclicTerms,
+                planStats.getFirstAtom(ruleDetails.ruleid, orderExecution));
         //Reorder for input negation (can we merge these two?)
         reorderPlanForNegatedLiterals(plan, heads);
 
@@ -1270,10 +1446,24 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
         LOG(DEBUGL) << listLiterals;
 #endif
 
+        if (useTrieJoin && canUseTrieJoin(ruleDetails, plan)) {
+            std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+            const bool joined = executeTrieJoin(ruleDetails, plan, heads,
+                    iteration, orderExecution, processedTables,
+                    finalResultContainer);
+            durationJoin += std::chrono::system_clock::now() - start;
+            if (joined) {
+                continue;
+            }
+        }
+
         /*******************************************************************/
 
         std::shared_ptr<const FCInternalTable> currentResults = NULL;
         int optimalOrderIdx = 0;
+        const std::chrono::system_clock::time_point startCombination =
+            std::chrono::system_clock::now();
+        double intermediateRows = 0;
 
         bool first = true;
         while (optimalOrderIdx < nBodyLiterals) {
@@ -1441,6 +1631,9 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
             if (!lastLiteral && !first) {
                 currentResults = ((InterTableJoinProcessor*)joinOutput)->getTable();
                 notEmptyZeroRowsize = ((InterTableJoinProcessor*)joinOutput)->getNonEmptyZeroRowsize();
+                if (currentResults != NULL) {
+                    intermediateRows += currentResults->getNRows();
+                }
             }
             if (lastLiteral && finalResultContainer) {
                 finalResultContainer->push_back(joinOutput);
@@ -1463,6 +1656,35 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
                 break;
             }
         }
+
+        if (nBodyLiterals > 1) {
+            //The plan expects that a join is not larger than its largest input
+            std::vector<bool> excluded(nBodyLiterals);
+            double estimatedRows = 0;
+            double inputRows = 0;
+            size_t maxCard = 0;
+            int firstAtom = -1;
+            for (int i = 0; i < nBodyLiterals; ++i) {
+                const int pos = std::find(originalOrder.begin(),
+                        originalOrder.end(), plan.plan[i]) - originalOrder.begin();
+                if (i == 0) {
+                    firstAtom = pos;
+                }
+                excluded[pos] = originalOrder[pos]->isNegated();
+                inputRows += cards[pos];
+                maxCard = std::max(maxCard, cards[pos]);
+                if (i < nBodyLiterals - 1) {
+                    estimatedRows += maxCard;
+                }
+            }
+            std::chrono::duration<double> d =
+                std::chrono::system_clock::now() - startCombination;
+            planStats.record(ruleDetails.ruleid, orderExecution,
+                    [&]() { return rule.tostring(program, &layer); },
+                    firstAtom, excluded,
+                    estimatedRows, inputRows, intermediateRows,
+                    d.count() * 1000);
+        }
     }
 
     bool prodDer = false;
@@ -1482,6 +1704,8 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
     std::chrono::duration<double> totalDuration =
         std::chrono::system_clock::now() - startRule;
     double td = totalDuration.count() * 1000;
+    const double durationRetain = FCTable::getRetainTime() - startRetain;
+    ruleDetails.duplicateEliminationTime += durationRetain;
 
 #ifdef WEBINTERFACE
     StatsRule stats;
@@ -1518,7 +1742,9 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
         << ", Total runtime " << stream.str()
         << ", join " << durationJoin.count() * 1000
         << "ms, consolidation " << durationConsolidation.count() * 1000
-        << "ms, retrieving first atom " << durationFirstAtom.count() * 1000 << "ms.";
+        << "ms, retrieving first atom " << durationFirstAtom.count() * 1000
+        << "ms, duplicate elimination " << durationRetain << "ms.";
+    LOG(DEBUGL) << "Memory: " << MemoryStats::toString(&arena);
 
     std::string trueFalseString = prodDer ? "true" : "false";
     //std::cout << "Executed rule " << ruleDetails.rule.getId() << ": " << trueFalseString << '\n';
@@ -1688,7 +1914,8 @@ FCIterator SemiNaiver::getTable(const Literal & literal,
 }
 
 FCIterator SemiNaiver::getTable(const PredId_t predid) {
-    if (predicatesTables[predid] == NULL) {
+    //The predicates added to the program after this object have no table
+    if (predid >= predicatesTables.size() || predicatesTables[predid] == NULL) {
         return FCIterator();
     }
     return predicatesTables[predid]->read(0);
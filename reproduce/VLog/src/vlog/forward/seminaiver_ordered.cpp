@@ -45,11 +45,12 @@ void SemiNaiverOrdered::prepare(size_t lastExecution, int singleRuleToCheck, con
     chaseMgmt = std::shared_ptr<ChaseMgmt>(new ChaseMgmt(outRuleDetails,
         typeChase, checkCyclicTerms,
         singleRuleToCheck,
-        predIgnoreBlock));
+        predIgnoreBlock, nthreads));
 }
 
 SemiNaiverOrdered::PositiveGroup *SemiNaiverOrdered::executeGroupUnrestrainedFirst(
     RestrainedGroup &group, 
+    const std::vector<RuleExecutionDetails> &ruleset,
     std::vector<StatIteration> &costRules, unsigned long *timeout,
     SemiNaiverOrderedType strategy
 )
@@ -117,6 +118,7 @@ SemiNaiverOrdered::PositiveGroup *SemiNaiverOrdered::executeGroupUnrestrainedFir
         currentRuleInfo.ruleDetails->executionTime += (double)iterationDuration.count();
         currentRuleInfo.ruleDetails->lastExecution = iteration;
         iteration++;
+        checkMemoryBudget(ruleset);
 
         currentRuleInfo.setTriggered(false);
 
@@ -155,6 +157,7 @@ SemiNaiverOrdered::PositiveGroup *SemiNaiverOrdered::executeGroupUnrestrainedFir
 
 SemiNaiverOrdered::PositiveGroup *SemiNaiverOrdered::executeGroupByPositiveGroups(
     RestrainedGroup &group, 
+    const std::vector<RuleExecutionDetails> &ruleset,
     std::vector<StatIteration> &costRules, unsigned long *timeout
 )
 {   
@@ -194,6 +197,7 @@ SemiNaiverOrdered::PositiveGroup *SemiNaiverOrdered::executeGroupByPositiveGroup
             currentRuleInfo.ruleDetails->executionTime += (double)iterationDuration.count();
             currentRuleInfo.ruleDetails->lastExecution = iteration;
             iteration++;
+            checkMemoryBudget(ruleset);
 
             currentRuleInfo.setTriggered(false);
 
@@ -423,6 +427,15 @@ void SemiNaiverOrdered::run(size_t lastExecution,
         currentInfo.initialize(currentPositiveGroup, positiveSuccessors, restraintSuccessors);
     }
 
+    size_t numFreshHeads = 0;
+    if (skipsFreshHeadChecks())
+    {
+        std::vector<RuleExecutionDetails *> details;
+        for (RelianceRuleInfo &currentInfo : allRuleInfos)
+            details.push_back(currentInfo.ruleDetails);
+        numFreshHeads = markFreshHeadRules(details);
+    }
+
     std::pair<SimpleGraph, SimpleGraph> unionGraphs = combineGraphs(positiveGraphs.first, restrainingGraphs.first);
 
     for (RelianceRuleInfo &currentInfo : allRuleInfos)
@@ -561,11 +574,11 @@ void SemiNaiverOrdered::run(size_t lastExecution,
         PositiveGroup *nextInactive;
         if ((strategy & SemiNaiverOrderedType::UnrestrainedFirst) > 0)
         {
-            nextInactive = executeGroupUnrestrainedFirst(currentRestrainedGroup, costRules, timeout, strategy);
+            nextInactive = executeGroupUnrestrainedFirst(currentRestrainedGroup, allRuleDetails, costRules, timeout, strategy);
         }
         else
         {
-            nextInactive = executeGroupByPositiveGroups(currentRestrainedGroup, costRules, timeout);
+            nextInactive = executeGroupByPositiveGroups(currentRestrainedGroup, allRuleDetails, costRules, timeout);
             // std::cout << "Positive first" << std::endl;
         }
 
@@ -586,6 +599,14 @@ void SemiNaiverOrdered::run(size_t lastExecution,
     } 
 
     std::cout << "Iterations: " << this->iteration << std::endl;
+    if (skipsFreshHeadChecks())
+    {
+        std::cout << "Existential rules with fresh heads: " << numFreshHeads << ", skipped restricted checks: " << chaseMgmt->getSkippedChecks() << std::endl;
+    }
+    if (spillManager != NULL)
+    {
+        LOG(INFOL) << "Spilling: " << spillManager->getStats();
+    }
 
     this->running = false;
 }
\ No newline at end of file
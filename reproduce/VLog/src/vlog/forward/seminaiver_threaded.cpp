@@ -39,6 +39,9 @@ bool SemiNaiverThreaded::executeUntilSaturation(
         for (int i = 0; i < interRuleThreads; ++i) {
             threads[i].join();
         }
+        //The tables are only spilled between the rounds, when no thread
+        //reads them
+        checkMemoryBudget(ruleset);
 
         //Copy all the derivations produced by the rules in the KB
         anotherRound = false;
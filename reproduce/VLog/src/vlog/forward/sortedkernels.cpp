@@ -0,0 +1,345 @@
+#include <vlog/sortedkernels.h>
+
+#include <kognac/logs.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+
+#if TERM_IS_UINT64 && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_KERNELS 1
+#include <immintrin.h>
+#else
+#define SIMD_KERNELS 0
+#endif
+
+//Windows of at most this size are scanned linearly
+#define LINEAR_SCAN_SIZE 32
+//intersect gallops only if one array is this many times larger than the other
+#define MERGE_SIZE_RATIO 32
+
+typedef size_t (*ScanFunction)(const Term_t *values, size_t i,
+        const size_t end, const Term_t v);
+
+//First position in [i, end) whose value is >= v
+static size_t scanScalar(const Term_t *values, size_t i, const size_t end,
+        const Term_t v) {
+    while (i < end && values[i] < v) {
+        i++;
+    }
+    return i;
+}
+
+#if SIMD_KERNELS
+//The SIMD comparisons are signed, so the sign bit is flipped on both sides.
+//The values are sorted, hence the number of values smaller than v in a
+//block is the offset of the first value >= v.
+
+__attribute__((target("sse4.2")))
+static size_t scanSSE42(const Term_t *values, size_t i, const size_t end,
+        const Term_t v) {
+    const __m128i flip = _mm_set1_epi64x((long long) 0x8000000000000000ULL);
+    const __m128i key = _mm_xor_si128(_mm_set1_epi64x((long long) v), flip);
+    while (i + 2 <= end) {
+        __m128i block = _mm_xor_si128(
+                _mm_loadu_si128((const __m128i *) (values + i)), flip);
+        int smaller = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(key, block)));
+        if (smaller != 0x3) {
+            return i + __builtin_popcount(smaller);
+        }
+        i += 2;
+    }
+    return scanScalar(values, i, end, v);
+}
+
+__attribute__((target("avx2")))
+static size_t scanAVX2(const Term_t *values, size_t i, const size_t end,
+        const Term_t v) {
+    const __m256i flip = _mm256_set1_epi64x((long long) 0x8000000000000000ULL);
+    const __m256i key = _mm256_xor_si256(_mm256_set1_epi64x((long long) v), flip);
+    while (i + 4 <= end) {
+        __m256i block = _mm256_xor_si256(
+                _mm256_loadu_si256((const __m256i *) (values + i)), flip);
+        int smaller = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(key, block)));
+        if (smaller != 0xF) {
+            return i + __builtin_popcount(smaller);
+        }
+        i += 4;
+    }
+    return scanScalar(values, i, end, v);
+}
+#endif
+
+static bool isSupported(SortedKernels::Implementation impl) {
+#if SIMD_KERNELS
+    __builtin_cpu_init();
+    switch (impl) {
+        case SortedKernels::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case SortedKernels::SSE42:
+            return __builtin_cpu_supports("sse4.2");
+        default:
+            return true;
+    }
+#else
+    return impl == SortedKernels::SCALAR;
+#endif
+}
+
+static SortedKernels::Implementation bestImplementation() {
+    if (isSupported(SortedKernels::AVX2)) {
+        return SortedKernels::AVX2;
+    } else if (isSupported(SortedKernels::SSE42)) {
+        return SortedKernels::SSE42;
+    }
+    return SortedKernels::SCALAR;
+}
+
+static ScanFunction getScanFunction(SortedKernels::Implementation impl) {
+#if SIMD_KERNELS
+    if (impl == SortedKernels::AVX2) {
+        return scanAVX2;
+    } else if (impl == SortedKernels::SSE42) {
+        return scanSSE42;
+    }
+#endif
+    return scanScalar;
+}
+
+//Scalar until the best implementation is selected during static initialization
+static SortedKernels::Implementation currentImplementation = SortedKernels::SCALAR;
+static ScanFunction scan = scanScalar;
+static bool initialized = SortedKernels::setImplementation(bestImplementation());
+
+size_t SortedKernels::lowerBound(const Term_t *values, size_t start,
+        const size_t end, const Term_t v) {
+    if (start >= end || values[start] >= v) {
+        return start;
+    }
+    //Gallop: values[start] < v
+    size_t step = 1;
+    size_t bound = start + 1;
+    while (bound < end && values[bound] < v) {
+        start = bound;
+        step <<= 1;
+        bound = start + step;
+    }
+    size_t hi = std::min(bound, end);
+    //The result is in (start, hi]
+    while (hi - start > LINEAR_SCAN_SIZE) {
+        size_t middle = start + (hi - start) / 2;
+        if (values[middle] < v) {
+            start = middle;
+        } else {
+            hi = middle;
+        }
+    }
+    return scan(values, start + 1, hi, v);
+}
+
+size_t SortedKernels::upperBound(const Term_t *values, const size_t start,
+        const size_t end, const Term_t v) {
+    if (v == (Term_t) ~0ul) {
+        return end;
+    }
+    return lowerBound(values, start, end, v + 1);
+}
+
+//Similar sizes: few values are skipped at a time, a merge is faster
+static void mergeIntersect(const Term_t *values1, const size_t size1,
+        const Term_t *values2, const size_t size2,
+        std::vector<Term_t> &output) {
+    size_t i1 = 0;
+    size_t i2 = 0;
+    while (i1 < size1 && i2 < size2) {
+        if (values1[i1] < values2[i2]) {
+            i1++;
+        } else if (values1[i1] > values2[i2]) {
+            i2++;
+        } else {
+            output.push_back(values1[i1]);
+            i1++;
+            i2++;
+        }
+    }
+}
+
+static void gallopIntersect(const Term_t *values1, const size_t size1,
+        const Term_t *values2, const size_t size2,
+        std::vector<Term_t> &output) {
+    size_t i1 = 0;
+    size_t i2 = 0;
+    while (i1 < size1 && i2 < size2) {
+        if (values1[i1] < values2[i2]) {
+            i1 = SortedKernels::lowerBound(values1, i1 + 1, size1, values2[i2]);
+        } else if (values1[i1] > values2[i2]) {
+            i2 = SortedKernels::lowerBound(values2, i2 + 1, size2, values1[i1]);
+        } else {
+            output.push_back(values1[i1]);
+            i1++;
+            i2++;
+        }
+    }
+}
+
+static bool useMerge(const size_t size1, const size_t size2) {
+    return size1 < size2 * MERGE_SIZE_RATIO && size2 < size1 * MERGE_SIZE_RATIO;
+}
+
+void SortedKernels::intersect(const Term_t *values1, const size_t size1,
+        const Term_t *values2, const size_t size2,
+        std::vector<Term_t> &output) {
+    if (useMerge(size1, size2)) {
+        mergeIntersect(values1, size1, values2, size2, output);
+    } else {
+        gallopIntersect(values1, size1, values2, size2, output);
+    }
+}
+
+SortedKernels::Implementation SortedKernels::getImplementation() {
+    return currentImplementation;
+}
+
+bool SortedKernels::setImplementation(Implementation impl) {
+    if (!isSupported(impl)) {
+        return false;
+    }
+    currentImplementation = impl;
+    scan = getScanFunction(impl);
+    return true;
+}
+
+std::string SortedKernels::getImplementationName(Implementation impl) {
+    switch (impl) {
+        case AVX2:
+            return "AVX2";
+        case SSE42:
+            return "SSE4.2";
+        default:
+            return "Scalar";
+    }
+}
+
+static std::vector<Term_t> generateSortedColumn(std::mt19937_64 &generator,
+        const size_t size, const uint64_t range) {
+    std::uniform_int_distribution<uint64_t> distribution(0, range);
+    std::vector<Term_t> values(size);
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = distribution(generator);
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    return values;
+}
+
+//Average time in ms of a run of f. f is repeated until the runs take at
+//least 100ms, so that small inputs are measured as well.
+static double timeRuns(const std::function<void()> &f) {
+    size_t runs = 0;
+    std::chrono::duration<double> sec(0);
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    do {
+        f();
+        runs++;
+        sec = std::chrono::system_clock::now() - start;
+    } while (sec.count() < 0.1);
+    return sec.count() * 1000 / runs;
+}
+
+void SortedKernels::benchmark(const size_t size1, const size_t size2,
+        const unsigned density) {
+    std::mt19937_64 generator(42);
+    const uint64_t range = (uint64_t) std::max(size1, size2) * std::max(density, 1u);
+    std::vector<Term_t> column1 = generateSortedColumn(generator, size1, range);
+    std::vector<Term_t> column2 = generateSortedColumn(generator, size2, range);
+    std::cout << "Size1: " << column1.size() << std::endl;
+    std::cout << "Size2: " << column2.size() << std::endl;
+    std::cout << "Intersect: " << (useMerge(column1.size(), column2.size()) ?
+            "merge" : "gallop") << std::endl;
+
+    //The merge loop of Column::intersection, as a baseline
+    std::vector<Term_t> expected;
+    double ms = timeRuns([&]() {
+            expected.clear();
+            mergeIntersect(column1.data(), column1.size(),
+                    column2.data(), column2.size(), expected);
+            });
+    std::cout << "Results: " << expected.size() << std::endl;
+    std::cout << "Time-Merge: " << ms << std::endl;
+
+    //Point lookups over the whole first column, which use the binary
+    //search and the final scan but not the exponential search
+    std::vector<Term_t> keys(column2);
+    std::shuffle(keys.begin(), keys.end(), generator);
+
+    const Implementation previous = getImplementation();
+    std::vector<Implementation> implementations;
+    for (Implementation impl : {SCALAR, SSE42, AVX2}) {
+        std::string name = getImplementationName(impl);
+        if (!setImplementation(impl)) {
+            std::cout << "Time-" << name << ": unsupported" << std::endl;
+            continue;
+        }
+        implementations.push_back(impl);
+        //The galloping intersection, whatever the sizes of the columns
+        std::vector<Term_t> output;
+        ms = timeRuns([&]() {
+                output.clear();
+                gallopIntersect(column1.data(), column1.size(),
+                        column2.data(), column2.size(), output);
+                });
+        std::cout << "Time-" << name << ": " << ms << std::endl;
+        if (output != expected) {
+            LOG(ERRORL) << "The " << name << " kernel returned a wrong intersection";
+        }
+        size_t checksum = 0;
+        ms = timeRuns([&]() {
+                checksum = 0;
+                for (Term_t key : keys) {
+                    checksum += lowerBound(column1.data(), 0, column1.size(), key);
+                }
+                });
+        std::cout << "Time-LowerBound-" << name << ": " << ms << std::endl;
+        size_t expectedChecksum = 0;
+        for (Term_t key : keys) {
+            expectedChecksum += std::lower_bound(column1.begin(), column1.end(),
+                    key) - column1.begin();
+        }
+        if (checksum != expectedChecksum) {
+            LOG(ERRORL) << "The " << name << " kernel returned a wrong lower bound";
+        }
+    }
+
+    //Sweep the size of the second column across the threshold of intersect
+    std::cout << "Sweep (size2, merge and gallop times in ms):" << std::endl;
+    std::cout << "size2\tintersect\tMerge";
+    for (Implementation impl : implementations) {
+        std::cout << "\t" << getImplementationName(impl);
+    }
+    std::cout << std::endl;
+    for (size_t ratio = 1; ratio <= 1024 && column1.size() / ratio > 0; ratio *= 2) {
+        const size_t sweepSize = column1.size() / ratio;
+        std::vector<Term_t> sweepColumn = generateSortedColumn(generator,
+                sweepSize, range);
+        std::vector<Term_t> output;
+        std::cout << sweepColumn.size() << "\t" << (useMerge(column1.size(),
+                    sweepColumn.size()) ? "merge" : "gallop");
+        std::cout << "\t" << timeRuns([&]() {
+                output.clear();
+                mergeIntersect(column1.data(), column1.size(),
+                        sweepColumn.data(), sweepColumn.size(), output);
+                });
+        for (Implementation impl : implementations) {
+            setImplementation(impl);
+            std::cout << "\t" << timeRuns([&]() {
+                    output.clear();
+                    gallopIntersect(column1.data(), column1.size(),
+                            sweepColumn.data(), sweepColumn.size(), output);
+                    });
+        }
+        std::cout << std::endl;
+    }
+    setImplementation(previous);
+}
@@ -0,0 +1,189 @@
+#include <vlog/spill.h>
+#include <vlog/segment.h>
+#include <vlog/arena.h>
+
+#include <kognac/logs.h>
+
+#include <sstream>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static std::atomic<uint64_t> nPageIns(0);
+
+void MappedFile::countPageIn() {
+    nPageIns++;
+}
+
+void MappedFile::release() {
+    if (resident.exchange(false)) {
+        //The pages are clean, so they are read again from the file
+        madvise(data, length, MADV_DONTNEED);
+    }
+}
+
+MappedFile::~MappedFile() {
+    munmap(data, length);
+}
+
+std::shared_ptr<Column> MappedColumn::sort() const {
+    std::vector<Term_t> newvals = getReader()->asVector();
+    std::sort(newvals.begin(), newvals.end());
+    return ColumnWriter::getColumn(newvals, true);
+}
+
+std::shared_ptr<Column> MappedColumn::sort(const int nthreads) const {
+    if (nthreads <= 1) {
+        return sort();
+    }
+    std::vector<Term_t> newvals = getReader()->asVector();
+    ParallelTasks::sort_int(newvals.begin(), newvals.end());
+    return ColumnWriter::getColumn(newvals, true);
+}
+
+std::shared_ptr<Column> MappedColumn::unique() const {
+    //I assume the column is already sorted
+    std::vector<Term_t> newvals = getReader()->asVector();
+    newvals.erase(std::unique(newvals.begin(), newvals.end()), newvals.end());
+    return ColumnWriter::getColumn(newvals, true);
+}
+
+SpillManager::SpillManager(const size_t budget, const std::string &directory) :
+    budget(budget), directory(directory), nSpilledSegments(0),
+    spilledBytes(0), nReleases(0) {
+    }
+
+size_t SpillManager::getExcess() const {
+    const size_t rss = MemoryStats::getCurrentRSS();
+    return rss > budget ? rss - budget : 0;
+}
+
+static bool writeAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        const ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+std::shared_ptr<const Segment> SpillManager::spill(const Segment &segment,
+        const uint8_t nfields, size_t &freed) {
+    freed = 0;
+    std::vector<int> toSpill;
+    size_t length = 0;
+    for (int i = 0; i < nfields; ++i) {
+        std::shared_ptr<Column> column = segment.getColumn(i);
+        if (!column->isEDB() && column->getBytes() >= SPILL_MIN_COLUMN_BYTES) {
+            toSpill.push_back(i);
+            length += column->size() * sizeof(Term_t);
+        }
+    }
+    if (toSpill.empty()) {
+        return NULL;
+    }
+
+    std::string path = directory + "/vlog-spill-XXXXXX";
+    std::vector<char> pathBuffer(path.begin(), path.end());
+    pathBuffer.push_back('\0');
+    const int fd = mkstemp(pathBuffer.data());
+    if (fd < 0) {
+        LOG(ERRORL) << "Cannot create a spill file in " << directory << ": " <<
+            strerror(errno);
+        throw std::string("Cannot create a spill file");
+    }
+    //The file is removed when it is unmapped
+    unlink(pathBuffer.data());
+
+    std::vector<size_t> offsets;
+    size_t offset = 0;
+    //The columns are written in chunks, to not decompress them in memory
+    std::vector<Term_t> buffer;
+    buffer.reserve(SPILL_WRITE_BUFFER);
+    for (const int i : toSpill) {
+        offsets.push_back(offset);
+        std::unique_ptr<ColumnReader> reader = segment.getColumn(i)->getReader();
+        bool hasNext = reader->hasNext();
+        while (hasNext) {
+            buffer.push_back(reader->next());
+            hasNext = reader->hasNext();
+            if (buffer.size() == SPILL_WRITE_BUFFER || !hasNext) {
+                if (!writeAll(fd, (const char *) buffer.data(),
+                            buffer.size() * sizeof(Term_t))) {
+                    close(fd);
+                    LOG(ERRORL) << "Cannot write a spill file in " << directory <<
+                        ": " << strerror(errno);
+                    throw std::string("Cannot write a spill file");
+                }
+                offset += buffer.size() * sizeof(Term_t);
+                buffer.clear();
+            }
+        }
+    }
+    char *data = (char *) mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        LOG(ERRORL) << "Cannot map a spill file: " << strerror(errno);
+        throw std::string("Cannot map a spill file");
+    }
+    std::shared_ptr<MappedFile> file(new MappedFile(data, length));
+
+    std::vector<std::shared_ptr<Column>> columns;
+    for (int i = 0, j = 0; i < nfields; ++i) {
+        std::shared_ptr<Column> column = segment.getColumn(i);
+        if (j < toSpill.size() && toSpill[j] == i) {
+            //Shared columns stay in memory anyway
+            if (column.use_count() <= 2) {
+                freed += column->getBytes();
+            }
+            columns.push_back(std::shared_ptr<Column>(new MappedColumn(file,
+                            offsets[j], column->size())));
+            j++;
+        } else {
+            columns.push_back(column);
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    nSpilledSegments++;
+    spilledBytes += length;
+    files.push_back(file);
+    return std::shared_ptr<const Segment>(new Segment(nfields, columns));
+}
+
+void SpillManager::releasePages() {
+    std::lock_guard<std::mutex> guard(lock);
+    size_t live = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::shared_ptr<MappedFile> file = files[i].lock();
+        if (file != NULL) {
+            file->release();
+            files[live++] = files[i];
+        }
+    }
+    files.resize(live);
+    nReleases++;
+}
+
+std::string SpillManager::getStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    std::stringstream ss;
+    ss << "budget " << budget / 1024 / 1024 << "MB, spilled " <<
+        nSpilledSegments << " segments (" << spilledBytes / 1024 / 1024 <<
+        "MB, " << files.size() << " files mapped), " << nPageIns <<
+        " page-ins, " << nReleases << " releases";
+    return ss.str();
+}
+
+uint64_t SpillManager::getNPageIns() {
+    return nPageIns;
+}
@@ -7,6 +7,17 @@
 
 #include <zstr/zstr.hpp>
 
+#include <thread>
+#include <algorithm>
+
+#if defined(_WIN32)
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 std::vector<std::string> readRow(istream &ifs) {
     char buffer[65536];
     bool insideEscaped = false;
@@ -67,6 +78,478 @@ std::vector<std::string> readRow(istream &ifs) {
     }
 }
 
+// Same format as readRow(istream &), but reads from a memory buffer and
+// advances current. Returns false at the end of the buffer. If row is NULL,
+// the row is only skipped, which is used to find the chunk boundaries.
+bool readRow(const char *&current, const char *end, std::vector<std::string> *row) {
+    std::string field;
+    size_t nfields = 0;
+    bool insideEscaped = false;
+    bool justSeenQuote = false;
+    int quoteCount = 0;
+    while (true) {
+        bool eof = (current >= end);
+        char c = eof ? '\n' : *current++;
+        if (eof && field.empty() && nfields == 0) {
+            return false;
+        }
+        if (c == '\r') {
+            continue;
+        }
+        if (field.empty() && ! justSeenQuote) {
+            if (c == '"') {
+                insideEscaped = true;
+                justSeenQuote = true;
+                continue;
+            }
+        } else if (c == '"') {
+            quoteCount++;
+            insideEscaped = (quoteCount & 1) == 0;
+            if (insideEscaped && ! field.empty()) {
+                field.pop_back();
+            }
+        } else {
+            quoteCount = 0;
+        }
+        if (eof || (! insideEscaped && (c == '\n' || c == ','))) {
+            if (justSeenQuote && ! field.empty()) {
+                field.pop_back();
+            }
+            if (row != NULL) {
+                row->push_back(field);
+            }
+            nfields++;
+            if (c == '\n') {
+                return true;
+            }
+            field.clear();
+            insideEscaped = false;
+        } else {
+            field.push_back(c);
+        }
+        justSeenQuote = (c == '"');
+    }
+}
+
+// Read-only view of a whole file. Uses mmap where available.
+struct MappedFile {
+    const char *data;
+    size_t size;
+#if defined(_WIN32)
+    std::vector<char> buffer;
+#endif
+
+    MappedFile(const std::string &path) : data(NULL), size(0) {
+#if defined(_WIN32)
+        std::ifstream ifs(path, ios_base::in | ios_base::binary);
+        if (ifs.fail()) {
+            throw ("Could not open file " + path);
+        }
+        buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw ("Could not open file " + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw ("Could not stat file " + path);
+        }
+        size = st.st_size;
+        if (size > 0) {
+            void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw ("Could not map file " + path);
+            }
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            data = (const char *) mapped;
+        }
+        close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(_WIN32)
+#else
+        if (data != NULL) {
+            munmap((void *) data, size);
+        }
+#endif
+    }
+};
+
+// One chunk of a CSV file, with its terms numbered locally
+// in the order of their first appearance.
+struct CSVChunk {
+    const char *begin;
+    const char *end;
+    size_t arity;
+    bool multipleArities;
+    std::vector<std::vector<Term_t>> columns;
+    std::vector<std::string> terms;
+    std::vector<Term_t> globalIds;
+
+    CSVChunk(const char *begin, const char *end) : begin(begin), end(end),
+        arity(0), multipleArities(false) {
+    }
+
+    void parse() {
+        std::unordered_map<std::string, Term_t> localIds;
+        std::vector<std::string> row;
+        const char *current = begin;
+        while (true) {
+            row.clear();
+            if (! readRow(current, end, &row)) {
+                break;
+            }
+            if (arity == 0) {
+                arity = row.size();
+                columns.resize(arity);
+            } else if (row.size() != arity) {
+                multipleArities = true;
+                return;
+            }
+            for (size_t i = 0; i < arity; i++) {
+                auto itr = localIds.find(row[i]);
+                Term_t localId;
+                if (itr == localIds.end()) {
+                    localId = terms.size();
+                    localIds.insert(std::make_pair(row[i], localId));
+                    terms.push_back(row[i]);
+                } else {
+                    localId = itr->second;
+                }
+                columns[i].push_back(localId);
+            }
+        }
+    }
+
+    void remap() {
+        for (size_t i = 0; i < columns.size(); i++) {
+            for (auto &value : columns[i]) {
+                value = globalIds[value];
+            }
+        }
+        std::vector<std::string>().swap(terms);
+        std::vector<Term_t>().swap(globalIds);
+    }
+};
+
+void InmemoryTable::loadCSVParallel(const std::string &tablefile, int nthreads) {
+    MappedFile file(tablefile);
+    const char *end = file.data + file.size;
+
+    // Chunks have to start at a row, which can contain quoted newlines,
+    // so the boundaries are found by skipping rows from the start.
+    std::vector<CSVChunk> chunks;
+    size_t targetChunkSize = file.size / nthreads + 1;
+    const char *chunkBegin = file.data;
+    const char *current = file.data;
+    while (current < end) {
+        readRow(current, end, NULL);
+        if ((size_t) (current - chunkBegin) >= targetChunkSize) {
+            chunks.push_back(CSVChunk(chunkBegin, current));
+            chunkBegin = current;
+        }
+    }
+    if (chunkBegin < end) {
+        chunks.push_back(CSVChunk(chunkBegin, end));
+    }
+
+    std::vector<std::thread> threads(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        threads[i] = std::thread(&CSVChunk::parse, &chunks[i]);
+    }
+    for (size_t i = 0; i < chunks.size(); i++) {
+        threads[i].join();
+    }
+
+    for (auto &chunk : chunks) {
+        if (chunk.multipleArities || (arity != 0 && chunk.arity != 0 && chunk.arity != arity)) {
+            LOG(ERRORL) << "Multiple arities";
+            throw ("Multiple arities in file " + tablefile);
+        }
+        if (arity == 0) {
+            arity = chunk.arity;
+        }
+    }
+    if (arity == 0) {
+        segment = NULL;
+        return;
+    }
+
+    // Chunks are merged in file order, so the terms get the same
+    // numbers as with the sequential loader
+    for (auto &chunk : chunks) {
+        chunk.globalIds.resize(chunk.terms.size());
+        for (size_t i = 0; i < chunk.terms.size(); i++) {
+            uint64_t val;
+            layer->getOrAddDictNumber(chunk.terms[i].c_str(), chunk.terms[i].size(), val);
+            chunk.globalIds[i] = val;
+        }
+    }
+
+    for (size_t i = 0; i < chunks.size(); i++) {
+        threads[i] = std::thread(&CSVChunk::remap, &chunks[i]);
+    }
+    for (size_t i = 0; i < chunks.size(); i++) {
+        threads[i].join();
+    }
+
+    // The columns of the chunks are appended as a whole
+    std::vector<std::shared_ptr<Column>> columns;
+    for (uint8_t i = 0; i < arity; i++) {
+        size_t nrows = 0;
+        for (auto &chunk : chunks) {
+            if (chunk.arity != 0) {
+                nrows += chunk.columns[i].size();
+            }
+        }
+        std::vector<Term_t> values;
+        values.reserve(nrows);
+        for (auto &chunk : chunks) {
+            if (chunk.arity != 0) {
+                values.insert(values.end(), chunk.columns[i].begin(), chunk.columns[i].end());
+                std::vector<Term_t>().swap(chunk.columns[i]);
+            }
+        }
+        columns.push_back(std::shared_ptr<Column>(new InmemoryColumn(values, true)));
+    }
+    segment = std::shared_ptr<const Segment>(new Segment(arity, columns));
+    if (segment->getNRows() > 1) {
+        // Filtering duplicates while sorting is not supported for more than two columns
+        segment = segment->sortBy(NULL, nthreads, false);
+        segment = SegmentInserter::unique(segment);
+    }
+}
+
+// Returns true if both files exist and path was modified after other
+bool isNewer(const std::string &path, const std::string &other) {
+#if defined(_WIN32)
+    return false;
+#else
+    struct stat st1, st2;
+    if (stat(path.c_str(), &st1) != 0 || stat(other.c_str(), &st2) != 0) {
+        return false;
+    }
+    return st1.st_mtime > st2.st_mtime;
+#endif
+}
+
+// Snapshot layout (host byte order):
+//   magic, arity, number of rows, number of terms (uint64 each)
+//   terms: length (uint32) and text, in the order of their local ids
+//   per column: encoding (uint64), then either the CompressedColumn blocks
+//   (count, then value/delta/size) or the plain values (one per row)
+// Local ids are ordered like the ids of the layer that wrote the snapshot,
+// so the rows are sorted by them as well.
+static const uint64_t SNAPSHOT_MAGIC = 0x31504e53474c4f56ULL; // "VLOGSNP1"
+static const uint64_t SNAPSHOT_BLOCKS = 0;
+static const uint64_t SNAPSHOT_PLAIN = 1;
+
+struct SnapshotReader {
+    const char *current;
+    const char *end;
+    std::string path;
+
+    SnapshotReader(const char *begin, const char *end, const std::string &path) :
+        current(begin), end(end), path(path) {
+    }
+
+    const char *readBytes(size_t n) {
+        if ((size_t) (end - current) < n) {
+            LOG(ERRORL) << "Truncated snapshot " << path;
+            throw ("Truncated snapshot " + path);
+        }
+        const char *result = current;
+        current += n;
+        return result;
+    }
+
+    uint64_t readUInt64() {
+        uint64_t v;
+        memcpy(&v, readBytes(sizeof(v)), sizeof(v));
+        return v;
+    }
+
+    uint32_t readUInt32() {
+        uint32_t v;
+        memcpy(&v, readBytes(sizeof(v)), sizeof(v));
+        return v;
+    }
+};
+
+template<typename T>
+void writeBinary(std::ofstream &out, const T v) {
+    out.write((const char *) &v, sizeof(v));
+}
+
+// Same blocks as ColumnWriter::add produces
+void encodeBlocks(const std::vector<Term_t> &values, std::vector<CompressedColumnBlock> &blocks) {
+    Term_t lastv = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        Term_t v = values[i];
+        if (i == 0) {
+            blocks.push_back(CompressedColumnBlock(v, 0, 0));
+        } else {
+            CompressedColumnBlock *b = &blocks.back();
+            if (v == lastv + b->delta) {
+                b->size++;
+            } else if (b->size == 0) {
+                b->delta = v - lastv;
+                b->size++;
+            } else {
+                blocks.push_back(CompressedColumnBlock(v, 0, 0));
+            }
+        }
+        lastv = v;
+    }
+}
+
+void InmemoryTable::writeSnapshot(const std::string &snapshotfile) {
+    std::vector<std::vector<Term_t>> columns(arity);
+    for (uint8_t i = 0; i < arity && segment != NULL; i++) {
+        columns[i] = segment->getColumn(i)->getReader()->asVector();
+    }
+
+    std::vector<Term_t> ids;
+    for (const auto &column : columns) {
+        ids.insert(ids.end(), column.begin(), column.end());
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::ofstream out(snapshotfile, ios_base::out | ios_base::binary);
+    if (out.fail()) {
+        std::string e = "Could not create snapshot " + snapshotfile;
+        LOG(ERRORL) << e;
+        throw (e);
+    }
+    writeBinary(out, SNAPSHOT_MAGIC);
+    writeBinary(out, (uint64_t) arity);
+    writeBinary(out, (uint64_t) getSize());
+    writeBinary(out, (uint64_t) ids.size());
+    for (Term_t id : ids) {
+        std::string text = layer->getDictText(id);
+        writeBinary(out, (uint32_t) text.size());
+        out.write(text.c_str(), text.size());
+    }
+
+    for (auto &column : columns) {
+        for (auto &value : column) {
+            value = std::lower_bound(ids.begin(), ids.end(), value) - ids.begin();
+        }
+        std::vector<CompressedColumnBlock> blocks;
+        encodeBlocks(column, blocks);
+        // Same threshold as ColumnWriter::getColumn
+        if (blocks.size() < column.size() / 5) {
+            writeBinary(out, SNAPSHOT_BLOCKS);
+            writeBinary(out, (uint64_t) blocks.size());
+            for (const auto &block : blocks) {
+                writeBinary(out, (uint64_t) block.value);
+                writeBinary(out, (int64_t) block.delta);
+                writeBinary(out, (uint64_t) block.size);
+            }
+        } else {
+            writeBinary(out, SNAPSHOT_PLAIN);
+            out.write((const char *) column.data(), column.size() * sizeof(Term_t));
+        }
+    }
+    if (out.fail()) {
+        std::string e = "Could not write snapshot " + snapshotfile;
+        LOG(ERRORL) << e;
+        throw (e);
+    }
+}
+
+void InmemoryTable::loadSnapshot(const std::string &snapshotfile) {
+    MappedFile file(snapshotfile);
+    SnapshotReader reader(file.data, file.data + file.size, snapshotfile);
+    if (file.size < sizeof(uint64_t) || reader.readUInt64() != SNAPSHOT_MAGIC) {
+        std::string e = "The file " + snapshotfile + " is not a VLog snapshot";
+        LOG(ERRORL) << e;
+        throw (e);
+    }
+    arity = (uint8_t) reader.readUInt64();
+    uint64_t nrows = reader.readUInt64();
+    uint64_t nterms = reader.readUInt64();
+
+    // If all terms are new to the layer, they get consecutive ids and the
+    // columns only have to be shifted. Otherwise they are remapped.
+    std::vector<Term_t> globalIds(nterms);
+    bool consecutive = true;
+    bool increasing = true;
+    for (uint64_t i = 0; i < nterms; i++) {
+        uint32_t len = reader.readUInt32();
+        const char *text = reader.readBytes(len);
+        uint64_t val;
+        layer->getOrAddDictNumber(text, len, val);
+        globalIds[i] = val;
+        if (i > 0) {
+            consecutive = consecutive && globalIds[i] == globalIds[i - 1] + 1;
+            increasing = increasing && globalIds[i] > globalIds[i - 1];
+        }
+    }
+    Term_t offset = nterms > 0 ? globalIds[0] : 0;
+
+    std::vector<std::shared_ptr<Column>> columns;
+    for (uint8_t i = 0; i < arity; i++) {
+        uint64_t encoding = reader.readUInt64();
+        if (encoding == SNAPSHOT_BLOCKS && consecutive) {
+            uint64_t nblocks = reader.readUInt64();
+            std::vector<CompressedColumnBlock> blocks;
+            blocks.reserve(nblocks);
+            for (uint64_t j = 0; j < nblocks; j++) {
+                Term_t value = reader.readUInt64();
+                int64_t delta = (int64_t) reader.readUInt64();
+                size_t size = reader.readUInt64();
+                blocks.push_back(CompressedColumnBlock(value + offset, delta, size));
+            }
+            columns.push_back(std::shared_ptr<Column>(new CompressedColumn(blocks, nrows)));
+            continue;
+        }
+
+        std::vector<Term_t> values;
+        if (encoding == SNAPSHOT_BLOCKS) {
+            uint64_t nblocks = reader.readUInt64();
+            values.reserve(nrows);
+            for (uint64_t j = 0; j < nblocks; j++) {
+                Term_t value = reader.readUInt64();
+                int64_t delta = (int64_t) reader.readUInt64();
+                size_t size = reader.readUInt64();
+                for (size_t k = 0; k <= size; k++) {
+                    values.push_back(value + k * delta);
+                }
+            }
+        } else {
+            values.resize(nrows);
+            memcpy(values.data(), reader.readBytes(nrows * sizeof(Term_t)), nrows * sizeof(Term_t));
+        }
+        if (values.size() != nrows) {
+            LOG(ERRORL) << "Corrupt snapshot " << snapshotfile;
+            throw ("Corrupt snapshot " + snapshotfile);
+        }
+        for (auto &value : values) {
+            value = consecutive ? value + offset : globalIds[value];
+        }
+        columns.push_back(std::shared_ptr<Column>(new InmemoryColumn(values, true)));
+    }
+
+    if (arity == 0 || nrows == 0) {
+        segment = NULL;
+        return;
+    }
+    segment = std::shared_ptr<const Segment>(new Segment(arity, columns));
+    if (! increasing && nrows > 1) {
+        // The ids of the layer do not preserve the order of the rows
+        segment = segment->sortBy(NULL);
+    }
+}
+
 std::string convertString(const char *s, int len) {
     if (s == NULL || len == 0) {
         return "";
@@ -81,7 +564,7 @@ std::string convertString(const char *s, int len) {
 }
 
 InmemoryTable::InmemoryTable(std::string repository, std::string tablename,
-        PredId_t predid, EDBLayer *layer) {
+        PredId_t predid, EDBLayer *layer, int loadThreads) {
     this->layer = layer;
     arity = 0;
     this->predid = predid;
@@ -92,6 +575,28 @@ InmemoryTable::InmemoryTable(std::string repository, std::string tablename,
     }
     std::string tablefile = repository + "/" + tablename + ".csv";
     std::string gz = tablefile + ".gz";
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    std::string snapshotfile = repository + "/" + tablename + ".snap";
+    if (Utils::exists(snapshotfile)) {
+        if (isNewer(tablefile, snapshotfile) || isNewer(repository + "/" + tablename + ".nt", snapshotfile)) {
+            LOG(WARNL) << "Ignoring " << snapshotfile << " because it is older than the data of " << tablename;
+        } else {
+            loadSnapshot(snapshotfile);
+            std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+            LOG(INFOL) << "Loaded snapshot " << snapshotfile << " (" << getSize() << " rows) in "
+                << sec.count() * 1000 << " ms";
+            return;
+        }
+    }
+    if (loadThreads > 1 && Utils::exists(tablefile)) {
+        LOG(DEBUGL) << "Reading " << tablefile << " with " << loadThreads << " threads";
+        loadCSVParallel(tablefile, loadThreads);
+        std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+        double mb = Utils::fileSize(tablefile) / (1024.0 * 1024.0);
+        LOG(INFOL) << "Loaded " << tablefile << ": " << mb << " MB in " << sec.count() * 1000
+            << " ms (" << (sec.count() > 0 ? mb / sec.count() : 0) << " MB/s)";
+        return;
+    }
     istream *ifs = NULL;
     /*if (Utils::exists(gz)) {
         ifs = new zstr::ifstream(gz);
@@ -100,14 +605,14 @@ InmemoryTable::InmemoryTable(std::string repository, std::string tablename,
             LOG(ERRORL) << e;
             throw (e);
         }
-    } else if (Utils::exists(tablefile)) {*/
+    } else*/ if (Utils::exists(tablefile)) {
         ifs = new std::ifstream(tablefile, ios_base::in | ios_base::binary);
         if (ifs->fail()) {
             std::string e = "While importing data for predicate \"" + layer->getPredName(predid) + "\": could not open file " + tablefile;
             LOG(ERRORL) << e;
             throw (e);
         }
-    //}
+    }
     if (ifs != NULL) {
         LOG(DEBUGL) << "Reading " << tablefile;
         size_t longLineNumber = 0;
@@ -185,6 +690,12 @@ InmemoryTable::InmemoryTable(std::string repository, std::string tablename,
         segment = inserter->getSortedAndUniqueSegment();
         delete inserter;
     }
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    if (Utils::exists(tablefile)) {
+        double mb = Utils::fileSize(tablefile) / (1024.0 * 1024.0);
+        LOG(INFOL) << "Loaded " << tablefile << ": " << mb << " MB in " << sec.count() * 1000
+            << " ms (" << (sec.count() > 0 ? mb / sec.count() : 0) << " MB/s)";
+    }
 }
 
 InmemoryTable::InmemoryTable(PredId_t predid,
@@ -246,6 +757,32 @@ InmemoryTable::InmemoryTable(PredId_t predid,
     delete inserter;
 }
 
+InmemoryTable::InmemoryTable(PredId_t predid,
+        std::vector<std::vector<Term_t>> &columns,
+        EDBLayer *layer, const bool sorted) {
+    this->arity = columns.size();
+    this->predid = predid;
+    this->layer = layer;
+    segment = NULL;
+    if (arity == 0 || columns[0].empty()) {
+        return;
+    }
+    std::vector<std::shared_ptr<Column>> cols;
+    for (auto &values : columns) {
+        if (values.size() != columns[0].size()) {
+            throw ("Columns of different sizes in input");
+        }
+    }
+    for (auto &values : columns) {
+        cols.push_back(std::shared_ptr<Column>(new InmemoryColumn(values, true)));
+    }
+    segment = std::shared_ptr<const Segment>(new Segment(arity, cols));
+    if (!sorted && segment->getNRows() > 1) {
+        segment = segment->sortBy(NULL);
+        segment = SegmentInserter::unique(segment);
+    }
+}
+
 struct VSorter {
     unsigned sz;
 
@@ -548,6 +1085,188 @@ std::shared_ptr<const Segment> InmemoryTable::getSortedCachedSegment(
 }
 
 
+// Merges the rows to remove and to add (sorted by fields) into the rows of
+// segment, which are sorted by fields as well. The removals are applied
+// first, and the rows between two updated ones are copied as a whole. If
+// deleted and inserted are not NULL, they receive the rows that were really
+// removed and added.
+static std::shared_ptr<const Segment> mergeRows(
+        std::shared_ptr<const Segment> segment, const uint8_t arity,
+        const std::vector<uint8_t> &fields,
+        const std::vector<Term_t> &removed, const std::vector<Term_t> &added,
+        std::vector<Term_t> *deleted, std::vector<Term_t> *inserted) {
+    if (arity == 0) {
+        return NULL;
+    }
+    const size_t nrows = segment == NULL ? 0 : segment->getNRows();
+    std::vector<std::vector<Term_t>> copies(arity);
+    std::vector<const std::vector<Term_t> *> columns;
+    for (uint8_t i = 0; i < arity; ++i) {
+        std::shared_ptr<Column> column;
+        if (segment != NULL) {
+            column = segment->getColumn(i);
+        }
+        if (column != NULL && column->isBackedByVector()) {
+            columns.push_back(&column->getVectorRef());
+        } else {
+            if (column != NULL) {
+                column->getValues(0, nrows, copies[i]);
+            }
+            columns.push_back(&copies[i]);
+        }
+    }
+    auto cmpRow = [&](const size_t r, const Term_t *row) {
+        for (const uint8_t f : fields) {
+            const Term_t v = (*columns[f])[r];
+            if (v != row[f]) {
+                return v < row[f] ? -1 : 1;
+            }
+        }
+        return 0;
+    };
+    auto cmpRows = [&](const Term_t *r1, const Term_t *r2) {
+        for (const uint8_t f : fields) {
+            if (r1[f] != r2[f]) {
+                return r1[f] < r2[f] ? -1 : 1;
+            }
+        }
+        return 0;
+    };
+
+    std::vector<std::vector<Term_t>> values(arity);
+    for (uint8_t i = 0; i < arity; ++i) {
+        values[i].reserve(nrows + added.size() / arity);
+    }
+    size_t copied = 0;
+    size_t ir = 0, ia = 0;
+    while (ir < removed.size() || ia < added.size()) {
+        const Term_t *row;
+        if (ia == added.size() || (ir < removed.size() &&
+                    cmpRows(&removed[ir], &added[ia]) <= 0)) {
+            row = &removed[ir];
+        } else {
+            row = &added[ia];
+        }
+        const bool isRemoved = ir < removed.size() &&
+            cmpRows(&removed[ir], row) == 0;
+        const bool isAdded = ia < added.size() && cmpRows(&added[ia], row) == 0;
+        ir += isRemoved ? arity : 0;
+        ia += isAdded ? arity : 0;
+
+        //Binary search of the first row >= row
+        size_t pos = copied, end = nrows;
+        while (pos < end) {
+            const size_t mid = pos + (end - pos) / 2;
+            if (cmpRow(mid, row) < 0) {
+                pos = mid + 1;
+            } else {
+                end = mid;
+            }
+        }
+        for (uint8_t i = 0; i < arity; ++i) {
+            values[i].insert(values[i].end(), columns[i]->begin() + copied,
+                    columns[i]->begin() + pos);
+        }
+        const bool found = pos < nrows && cmpRow(pos, row) == 0;
+        copied = found ? pos + 1 : pos;
+        if (found && isRemoved && deleted != NULL) {
+            deleted->insert(deleted->end(), row, row + arity);
+        }
+        if (isAdded && (!found || isRemoved) && inserted != NULL) {
+            inserted->insert(inserted->end(), row, row + arity);
+        }
+        if (isAdded || (found && !isRemoved)) {
+            for (uint8_t i = 0; i < arity; ++i) {
+                values[i].push_back(row[i]);
+            }
+        }
+    }
+    for (uint8_t i = 0; i < arity; ++i) {
+        values[i].insert(values[i].end(), columns[i]->begin() + copied,
+                columns[i]->end());
+    }
+
+    if (values[0].empty()) {
+        return NULL;
+    }
+    std::vector<std::shared_ptr<Column>> newColumns;
+    for (auto &v : values) {
+        newColumns.push_back(std::shared_ptr<Column>(new InmemoryColumn(v, true)));
+    }
+    return std::shared_ptr<const Segment>(new Segment(arity, newColumns));
+}
+
+// The rows sorted by fields
+static std::vector<Term_t> sortRows(const std::vector<Term_t> &rows,
+        const uint8_t arity, const std::vector<uint8_t> &fields) {
+    std::vector<size_t> idx(rows.size() / arity);
+    for (size_t i = 0; i < idx.size(); ++i) {
+        idx[i] = i * arity;
+    }
+    std::sort(idx.begin(), idx.end(), [&](size_t a, size_t b) {
+            for (const uint8_t f : fields) {
+                if (rows[a + f] != rows[b + f]) {
+                    return rows[a + f] < rows[b + f];
+                }
+            }
+            return false;
+            });
+    std::vector<Term_t> sorted;
+    sorted.reserve(rows.size());
+    for (const size_t i : idx) {
+        sorted.insert(sorted.end(), rows.begin() + i, rows.begin() + i + arity);
+    }
+    return sorted;
+}
+
+InmemoryTable::InmemoryTable(PredId_t predid, uint8_t arity, EDBLayer *layer) :
+    predid(predid), arity(arity), layer(layer) {
+}
+
+InmemoryTable *InmemoryTable::update(const std::vector<Term_t> &removed,
+        const std::vector<Term_t> &added, std::vector<Term_t> &deleted,
+        std::vector<Term_t> &inserted) const {
+    InmemoryTable *table = new InmemoryTable(predid, arity, layer);
+    std::vector<uint8_t> fields;
+    for (uint8_t i = 0; i < arity; ++i) {
+        fields.push_back(i);
+    }
+    table->segment = mergeRows(segment, arity, fields, removed, added,
+            &deleted, &inserted);
+
+    //A cached segment is stored under the prefixes of its sort order: the
+    //longest key gives the whole order. The keys have one byte per field
+    if (arity > 8) {
+        return table;
+    }
+    std::map<const Segment *, std::pair<uint64_t,
+        std::shared_ptr<const Segment>>> orders;
+    for (const auto &el : cachedSortedSegments) {
+        auto &order = orders[el.second.get()];
+        if (el.first > order.first) {
+            order = el;
+        }
+    }
+    std::map<const Segment *, std::shared_ptr<const Segment>> merged;
+    for (const auto &el : orders) {
+        std::vector<uint8_t> sortFields;
+        for (uint64_t key = el.second.first; key != 0; key >>= 8) {
+            sortFields.insert(sortFields.begin(), (uint8_t) ((key & 0xFF) - 1));
+        }
+        //Only the rows that changed the table are merged
+        merged[el.first] = mergeRows(el.second.second, arity, sortFields,
+                sortRows(deleted, arity, sortFields),
+                sortRows(inserted, arity, sortFields), NULL, NULL);
+    }
+    for (const auto &el : cachedSortedSegments) {
+        std::shared_ptr<const Segment> s = merged[el.second.get()];
+        if (s != NULL) {
+            table->cachedSortedSegments[el.first] = s;
+        }
+    }
+    return table;
+}
+
 EDBIterator *InmemoryTable::getSortedIterator(const Literal &query,
         const std::vector<uint8_t> &fields) {
     std::vector<uint8_t> offsets;
@@ -0,0 +1,106 @@
+package karmaresearch.vlog;
+
+import java.nio.LongBuffer;
+
+import karmaresearch.vlog.Term.TermType;
+import karmaresearch.vlog.VLog.LogLevel;
+
+/**
+ * Compares the throughput of reading the answers of a query one at a time,
+ * in batches, and all at once. Like a JMH benchmark, every method is first
+ * run a few times to warm up the JIT, and then measured over several runs.
+ *
+ * Usage: QueryBenchmark [number of facts] [batch size]
+ */
+class QueryBenchmark {
+
+    private static final int WARMUP_RUNS = 5;
+    private static final int MEASURED_RUNS = 10;
+
+    private static final Atom query = new Atom("E",
+            new Term(TermType.VARIABLE, "x"), new Term(TermType.VARIABLE, "y"));
+
+    private interface Method {
+        long run() throws Exception;
+    }
+
+    private static long tupleAtATime(VLog vlog) throws Exception {
+        long checksum = 0;
+        try (QueryResultIterator it = vlog.getQueryIter(query)) {
+            while (it.hasNext()) {
+                long[] v = it.next();
+                checksum += v[0] + v[1];
+            }
+        }
+        return checksum;
+    }
+
+    private static long batched(VLog vlog, int batchSize, boolean columnMajor)
+            throws Exception {
+        long checksum = 0;
+        try (QueryResultIterator it = vlog.getQueryIter(query)) {
+            LongBuffer buffer = it.allocateBuffer(batchSize);
+            int n;
+            while ((n = it.next(buffer, batchSize, columnMajor)) > 0) {
+                for (int i = 0; i < n; i++) {
+                    if (columnMajor) {
+                        checksum += buffer.get(i) + buffer.get(batchSize + i);
+                    } else {
+                        checksum += buffer.get(2 * i) + buffer.get(2 * i + 1);
+                    }
+                }
+            }
+        }
+        return checksum;
+    }
+
+    private static long bulk(VLog vlog) throws Exception {
+        long checksum = 0;
+        LongBuffer buffer = vlog.queryToBuffer(query, true, false);
+        while (buffer.hasRemaining()) {
+            checksum += buffer.get();
+        }
+        return checksum;
+    }
+
+    private static void measure(String name, long nfacts, Method method)
+            throws Exception {
+        long checksum = 0;
+        for (int i = 0; i < WARMUP_RUNS; i++) {
+            checksum = method.run();
+        }
+        long start = System.nanoTime();
+        for (int i = 0; i < MEASURED_RUNS; i++) {
+            if (method.run() != checksum) {
+                throw new Error("Different answers in " + name);
+            }
+        }
+        double ms = (System.nanoTime() - start) / 1e6 / MEASURED_RUNS;
+        System.out.println(String.format("%-20s %10.2f ms/op %14.0f tuples/s",
+                name, ms, nfacts / ms * 1000));
+    }
+
+    public static void main(String[] args) throws Exception {
+        final int nfacts = args.length > 0 ? Integer.parseInt(args[0])
+                : 1000000;
+        final int batchSize = args.length > 1 ? Integer.parseInt(args[1])
+                : 4096;
+
+        String[][] facts = new String[nfacts][];
+        for (int i = 0; i < nfacts; i++) {
+            facts[i] = new String[] { "a" + i, "b" + (i % 1000) };
+        }
+        final VLog vlog = new VLog();
+        vlog.setLogLevel(LogLevel.WARNING);
+        vlog.start("", false);
+        vlog.addData("E", facts);
+
+        measure("tuple-at-a-time", nfacts, () -> tupleAtATime(vlog));
+        measure("batched row-major", nfacts,
+                () -> batched(vlog, batchSize, false));
+        measure("batched column-major", nfacts,
+                () -> batched(vlog, batchSize, true));
+        measure("bulk", nfacts, () -> bulk(vlog));
+        vlog.stop();
+    }
+}
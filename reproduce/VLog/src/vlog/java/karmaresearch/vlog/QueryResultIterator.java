@@ -1,5 +1,8 @@
 package karmaresearch.vlog;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.LongBuffer;
 import java.util.Iterator;
 import java.util.NoSuchElementException;
 
@@ -85,6 +88,74 @@ public class QueryResultIterator implements Iterator<long[]>, AutoCloseable {
         return retval;
     }
 
+    /**
+     * Returns the number of terms of the results.
+     *
+     * @return the number of terms of a result
+     */
+    public int getTupleSize() {
+        if (cleaned) {
+            throw new IllegalStateException("Iterator already closed");
+        }
+        return getTupleSize(handle);
+    }
+
+    /**
+     * Allocates a buffer that can hold the specified number of results, to be
+     * filled by {@link #next(LongBuffer, int, boolean)}.
+     *
+     * @param maxTuples
+     *            the number of results
+     * @return the buffer
+     */
+    public LongBuffer allocateBuffer(int maxTuples) {
+        return ByteBuffer.allocateDirect(maxTuples * getTupleSize() * 8)
+                .order(ByteOrder.nativeOrder()).asLongBuffer();
+    }
+
+    /**
+     * Copies the next results, up to <code>maxTuples</code> of them, into the
+     * buffer with a single native call. In row-major order, the terms of the
+     * i-th result start at index <code>i * getTupleSize()</code>; in
+     * column-major order, term j of the i-th result is at index
+     * <code>j * maxTuples + i</code>. The position of the buffer is not used.
+     *
+     * @param buffer
+     *            a direct buffer in native byte order, of at least
+     *            <code>maxTuples * getTupleSize()</code> longs, for instance
+     *            obtained with {@link #allocateBuffer(int)}
+     * @param maxTuples
+     *            the maximum number of results to copy
+     * @param columnMajor
+     *            whether the results are stored column by column
+     * @return the number of results copied, 0 when there are no more results
+     */
+    public int next(LongBuffer buffer, int maxTuples, boolean columnMajor) {
+        if (cleaned) {
+            throw new IllegalStateException("Iterator already closed");
+        }
+        if (!buffer.isDirect() || buffer.order() != ByteOrder.nativeOrder()) {
+            throw new IllegalArgumentException(
+                    "The buffer must be direct and in native byte order");
+        }
+        if (maxTuples <= 0) {
+            return 0;
+        }
+        int first = 0;
+        // hasNext() may have fetched a result already
+        if (saved != null) {
+            int tupleSize = saved.length;
+            for (int i = 0; i < tupleSize; i++) {
+                buffer.put(columnMajor ? i * maxTuples : i, saved[i]);
+            }
+            saved = null;
+            first = 1;
+        }
+        hasNextCalled = false;
+        return first + nextBatch(handle, buffer, first, maxTuples, columnMajor,
+                filterBlanks);
+    }
+
     /**
      * Cleans up the underlying VLog iterator, if not done before.
      */
@@ -107,6 +178,11 @@ public class QueryResultIterator implements Iterator<long[]>, AutoCloseable {
 
     private native boolean hasBlanks(long[] v);
 
+    private native int getTupleSize(long handle);
+
+    private native int nextBatch(long handle, LongBuffer buffer, int first,
+            int maxTuples, boolean columnMajor, boolean filterBlanks);
+
     @Override
     public void close() {
         if (!cleaned) {
@@ -4,6 +4,10 @@ import java.io.BufferedInputStream;
 import java.io.File;
 import java.io.IOException;
 import java.io.InputStream;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.LongBuffer;
+import java.nio.charset.StandardCharsets;
 import java.nio.file.Files;
 import java.nio.file.StandardCopyOption;
 import java.util.ArrayList;
@@ -186,6 +190,94 @@ public class VLog {
     public native void addData(String predicate, String[][] contents)
             throws EDBConfigurationException;
 
+    /**
+     * Adds terms to the dictionary, with a single native call, and stores
+     * their ids. If VLog is not started yet, it will be started with an empty
+     * configuration. The terms follow each other in the buffer: each one is
+     * its length in bytes, as an int in native byte order, followed by its
+     * UTF-8 encoding.
+     *
+     * @param terms
+     *            a direct buffer with the encoded terms
+     * @param nterms
+     *            the number of terms in the buffer
+     * @param ids
+     *            a direct buffer in native byte order, that receives the ids
+     *            of the terms
+     */
+    public native void addTerms(ByteBuffer terms, int nterms, LongBuffer ids);
+
+    /**
+     * Adds terms to the dictionary, with a single native call, and returns
+     * their ids, to be used in {@link #addData(String, LongBuffer[], int)}.
+     * If VLog is not started yet, it will be started with an empty
+     * configuration.
+     *
+     * @param terms
+     *            the terms
+     * @return the ids of the terms
+     */
+    public long[] addTerms(String[] terms) {
+        byte[][] encoded = new byte[terms.length][];
+        int size = 0;
+        for (int i = 0; i < terms.length; i++) {
+            encoded[i] = terms[i].getBytes(StandardCharsets.UTF_8);
+            size += 4 + encoded[i].length;
+        }
+        ByteBuffer buffer = ByteBuffer.allocateDirect(size)
+                .order(ByteOrder.nativeOrder());
+        for (byte[] term : encoded) {
+            buffer.putInt(term.length);
+            buffer.put(term);
+        }
+        LongBuffer ids = ByteBuffer.allocateDirect(terms.length * 8)
+                .order(ByteOrder.nativeOrder()).asLongBuffer();
+        addTerms(buffer, terms.length, ids);
+        long[] result = new long[terms.length];
+        ids.get(result);
+        return result;
+    }
+
+    private native void addDataColumns(String predicate, LongBuffer[] columns,
+            int nrows) throws EDBConfigurationException;
+
+    /**
+     * Adds the data for the specified predicate to the database, column by
+     * column. The values are ids of terms, obtained with
+     * {@link #addTerms(String[])} or {@link #getOrAddConstantId(String)}, so
+     * no string is converted. If VLog is not started yet, it will be started
+     * with an empty configuration.
+     *
+     * @param predicate
+     *            the predicate
+     * @param columns
+     *            a direct buffer in native byte order for every term of the
+     *            facts; the i-th fact is made of the i-th value of every
+     *            column
+     * @param nrows
+     *            the number of facts
+     * @exception EDBConfigurationException
+     *                is thrown when there already are rules.
+     * @exception IllegalArgumentException
+     *                is thrown when a column is not a direct buffer, is too
+     *                small, or contains an unknown id.
+     */
+    public void addData(String predicate, LongBuffer[] columns, int nrows)
+            throws EDBConfigurationException {
+        checkColumns(columns);
+        addDataColumns(predicate, columns, nrows);
+    }
+
+    private static void checkColumns(LongBuffer[] columns) {
+        for (LongBuffer column : columns) {
+            if (column == null || !column.isDirect()
+                    || column.order() != ByteOrder.nativeOrder()) {
+                throw new IllegalArgumentException(
+                        "The columns must be direct buffers in native byte order");
+            }
+        }
+    }
+
     /**
      * Stops and de-allocates the reasoner. If vlog is not started yet, this
      * call does nothing, so it does no harm to call it more than once.
@@ -465,6 +557,39 @@ public class VLog {
                 filterBlanks);
     }
 
+    private native long[] queryToBuffer(int predicate, long[] terms,
+            boolean includeConstants, boolean filterBlanks)
+            throws NotStartedException, NonExistingPredicateException;
+
+    /**
+     * Queries the current, so possibly materialized, database, and returns
+     * all the answers at once, with a single native call. The terms of the
+     * answers follow each other: each answer has as many terms as the query,
+     * or as its distinct variables when the constants are not included.
+     *
+     * @param query
+     *            the query
+     * @param includeConstants
+     *            whether to include the constants in the results
+     * @param filterBlanks
+     *            whether results with blanks in them should be filtered out
+     * @return the answers
+     * @exception NotStartedException
+     *                is thrown when vlog is not started yet.
+     * @exception NonExistingPredicateException
+     *                is thrown when the query predicate does not exist.
+     */
+    public LongBuffer queryToBuffer(Atom query, boolean includeConstants,
+            boolean filterBlanks)
+            throws NotStartedException, NonExistingPredicateException {
+        query.checkNoBlank();
+        int intPred = getPredicateId(query.getPredicate());
+        long[] longTerms = extractTerms(query.getTerms());
+        long[] result = queryToBuffer(intPred, longTerms, includeConstants,
+                filterBlanks);
+        return LongBuffer.wrap(result == null ? new long[0] : result);
+    }
+
     private native void queryToCsv(int predicate, long[] term, String fileName,
             boolean filterBlanks) throws IOException;
 
@@ -583,6 +708,51 @@ public class VLog {
     public native boolean materialize(boolean skolem, int timeout)
             throws NotStartedException;
 
+    private native void updateDataColumns(String predicate, LongBuffer[] added,
+            int nadded, LongBuffer[] removed, int nremoved)
+            throws NotStartedException, NonExistingPredicateException;
+
+    /**
+     * Adds and removes facts of an EDB predicate, and updates the
+     * materialization instead of computing it again: the facts derived from
+     * the removed ones are deleted unless they have another derivation, and
+     * the consequences of the added facts are derived. The removals are
+     * applied first. The facts are given column by column as in
+     * {@link #addData(String, LongBuffer[], int)}.
+     *
+     * @param predicate
+     *            the EDB predicate
+     * @param added
+     *            the columns of the facts to add, or <code>null</code>
+     * @param nadded
+     *            the number of facts to add
+     * @param removed
+     *            the columns of the facts to remove, or <code>null</code>
+     * @param nremoved
+     *            the number of facts to remove
+     * @exception NotStartedException
+     *                is thrown when vlog is not started yet.
+     * @exception NonExistingPredicateException
+     *                is thrown when the predicate is not an EDB predicate.
+     * @exception MaterializationException
+     *                is thrown when there is no materialization yet, or the
+     *                update fails.
+     * @exception IllegalArgumentException
+     *                is thrown when a column is not a direct buffer, is too
+     *                small, or contains an unknown id.
+     */
+    public void updateData(String predicate, LongBuffer[] added, int nadded,
+            LongBuffer[] removed, int nremoved)
+            throws NotStartedException, NonExistingPredicateException {
+        if (added != null) {
+            checkColumns(added);
+        }
+        if (removed != null) {
+            checkColumns(removed);
+        }
+        updateDataColumns(predicate, added, nadded, removed, nremoved);
+    }
+
     /**
      * Creates a CSV file at the specified location, for the specified
      * predicate.
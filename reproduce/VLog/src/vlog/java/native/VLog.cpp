@@ -5,6 +5,8 @@
 #include <vlog/seminaiver.h>
 #include <vlog/cycles/checker.h>
 #include <vlog/reasoner.h>
+#include <vlog/querycache.h>
+#include <vlog/incremental.h>
 #include <vlog/utils.h>
 #include <kognac/utils.h>
 #include <kognac/logs.h>
@@ -21,14 +23,21 @@ class VLogInfo {
 		SemiNaiver *sn;
 		Program *program;
 		EDBLayer *layer;
+		// Answers of the repeated queries
+		std::shared_ptr<QueryCache> cache;
+		// Updates sn when facts are added or removed, set by materialize
+		IncrementalMaintenance *maint;
 
 		VLogInfo() {
 			sn = NULL;
 			program = NULL;
 			layer = NULL;
+			maint = NULL;
+			cache = std::shared_ptr<QueryCache>(new QueryCache(QUERYCACHE_DEFAULT_BYTES));
 		}
 
 		~VLogInfo() {
+			dropMaintenance();
 			if (layer != NULL) {
 				delete layer;
 				layer = NULL;
@@ -42,6 +51,13 @@ class VLogInfo {
 				sn = NULL;
 			}
 		}
+
+		void dropMaintenance() {
+			if (maint != NULL) {
+				delete maint;
+				maint = NULL;
+			}
+		}
 };
 
 static std::map<jint, VLogInfo *> vlogMap;
@@ -321,12 +337,8 @@ extern "C" {
 		vlogMap.erase(inf);
 	}
 
-	/*
-	 * Class:     karmaresearch_vlog_VLog
-	 * Method:    addData
-	 * Signature: (Ljava/lang/String;[[Ljava/lang/String;)V
-	 */
-	JNIEXPORT void JNICALL Java_karmaresearch_vlog_VLog_addData(JNIEnv *env, jobject obj, jstring jpred, jobjectArray data) {
+	// Starts VLog with an empty configuration if needed, for adding data.
+	static VLogInfo *getVLogInfoForData(JNIEnv *env, jobject obj) {
 		jint id = getVLogId(env, obj);
 		VLogInfo *f = getVLogInfo(id);
 		if (f == NULL) {
@@ -342,17 +354,36 @@ extern "C" {
 			EDBConf conf("", false);
 			f->layer = new EDBLayer(conf, false);
 		}
+		return f;
+	}
 
-		std::string pred = jstring2string(env, jpred);
-
+	// The program is created again after adding data, to see the new predicates.
+	static bool dropProgramForData(JNIEnv *env, VLogInfo *f) {
 		if (f->program != NULL) {
 			if (f->program->getNRules() > 0) {
 				throwEDBConfigurationException(env, "Cannot add data if there already are rules");
-				return;
+				return false;
 			}
+			f->dropMaintenance();
 			delete f->program;
 			f->program = NULL;
 		}
+		return true;
+	}
+
+	/*
+	 * Class:     karmaresearch_vlog_VLog
+	 * Method:    addData
+	 * Signature: (Ljava/lang/String;[[Ljava/lang/String;)V
+	 */
+	JNIEXPORT void JNICALL Java_karmaresearch_vlog_VLog_addData(JNIEnv *env, jobject obj, jstring jpred, jobjectArray data) {
+		VLogInfo *f = getVLogInfoForData(env, obj);
+
+		std::string pred = jstring2string(env, jpred);
+
+		if (! dropProgramForData(env, f)) {
+			return;
+		}
 
 		if (data == NULL) {
 			throwEDBConfigurationException(env, "null data");
@@ -397,6 +428,173 @@ extern "C" {
 		}
 
 		f->program = new Program(f->layer);
+		f->cache->invalidate(f->program->getPredicate(pred).getId());
+	}
+
+	/*
+	 * Class:     karmaresearch_vlog_VLog
+	 * Method:    addTerms
+	 * Signature: (Ljava/nio/ByteBuffer;ILjava/nio/LongBuffer;)V
+	 */
+	JNIEXPORT void JNICALL Java_karmaresearch_vlog_VLog_addTerms(JNIEnv *env, jobject obj, jobject jterms, jint nterms, jobject jids) {
+		VLogInfo *f = getVLogInfoForData(env, obj);
+
+		const char *terms = (const char *) env->GetDirectBufferAddress(jterms);
+		jlong *ids = (jlong *) env->GetDirectBufferAddress(jids);
+		if (terms == NULL || ids == NULL) {
+			throwIllegalArgumentException(env, "The buffers are not direct");
+			return;
+		}
+		if (nterms < 0 || env->GetDirectBufferCapacity(jids) < nterms) {
+			throwIllegalArgumentException(env, "The buffer of the ids is too small");
+			return;
+		}
+		// Every term is its length in bytes (an int in native order) followed
+		// by its UTF-8 encoding
+		const jlong size = env->GetDirectBufferCapacity(jterms);
+		jlong pos = 0;
+		for (jint i = 0; i < nterms; i++) {
+			int32_t len;
+			if (pos + (jlong) sizeof(len) > size) {
+				throwIllegalArgumentException(env, "Truncated buffer of terms");
+				return;
+			}
+			memcpy(&len, terms + pos, sizeof(len));
+			pos += sizeof(len);
+			if (len < 0 || pos + len > size) {
+				throwIllegalArgumentException(env, "Truncated buffer of terms");
+				return;
+			}
+			uint64_t value;
+			f->layer->getOrAddDictNumber(terms + pos, len, value);
+			ids[i] = value;
+			pos += len;
+		}
+	}
+
+	// Copies the columns of the facts, which contain ids of the dictionary.
+	static bool getColumns(JNIEnv *env, VLogInfo *f, const std::string &pred, jobjectArray jcolumns, jint nrows, std::vector<std::vector<Term_t>> &columns) {
+		if (jcolumns == NULL || nrows < 0) {
+			throwEDBConfigurationException(env, "null data");
+			return false;
+		}
+		jsize arity = env->GetArrayLength(jcolumns);
+		if (arity != (uint8_t) arity) {
+			throwIllegalArgumentException(env, ("Arity of " + pred + " too large (" + std::to_string(arity) + " > 255)").c_str());
+			return false;
+		}
+
+		const uint64_t nterms = f->layer->getNTerms();
+		columns.resize(arity);
+		for (int i = 0; i < arity; i++) {
+			jobject jcolumn = env->GetObjectArrayElement(jcolumns, (jsize) i);
+			const jlong *values = jcolumn == NULL ? NULL : (const jlong *) env->GetDirectBufferAddress(jcolumn);
+			if (values == NULL) {
+				throwIllegalArgumentException(env, "The columns must be direct buffers");
+				return false;
+			}
+			if (env->GetDirectBufferCapacity(jcolumn) < nrows) {
+				throwIllegalArgumentException(env, ("Column " + std::to_string(i) + " has less than " + std::to_string(nrows) + " values").c_str());
+				return false;
+			}
+			columns[i].resize(nrows);
+			memcpy(columns[i].data(), values, (size_t) nrows * sizeof(Term_t));
+			for (const Term_t value : columns[i]) {
+				if (value >= nterms) {
+					throwIllegalArgumentException(env, ("Unknown term id " + std::to_string((int64_t) value) + " in column " + std::to_string(i)).c_str());
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	/*
+	 * Class:     karmaresearch_vlog_VLog
+	 * Method:    addDataColumns
+	 * Signature: (Ljava/lang/String;[Ljava/nio/LongBuffer;I)V
+	 */
+	JNIEXPORT void JNICALL Java_karmaresearch_vlog_VLog_addDataColumns(JNIEnv *env, jobject obj, jstring jpred, jobjectArray jcolumns, jint nrows) {
+		VLogInfo *f = getVLogInfoForData(env, obj);
+
+		std::string pred = jstring2string(env, jpred);
+
+		std::vector<std::vector<Term_t>> columns;
+		if (! getColumns(env, f, pred, jcolumns, nrows, columns)) {
+			return;
+		}
+
+		if (! dropProgramForData(env, f)) {
+			return;
+		}
+
+		try {
+			f->layer->addInmemoryTable(pred, columns);
+		} catch(std::string s) {
+			throwEDBConfigurationException(env, s.c_str());
+			return;
+		} catch(char const *s) {
+			throwEDBConfigurationException(env, s);
+			return;
+		}
+
+		f->program = new Program(f->layer);
+		f->cache->invalidate(f->program->getPredicate(pred).getId());
+	}
+
+	/*
+	 * Class:     karmaresearch_vlog_VLog
+	 * Method:    updateDataColumns
+	 * Signature: (Ljava/lang/String;[Ljava/nio/LongBuffer;I[Ljava/nio/LongBuffer;I)V
+	 */
+	JNIEXPORT void JNICALL Java_karmaresearch_vlog_VLog_updateDataColumns(JNIEnv *env, jobject obj, jstring jpred, jobjectArray jadded, jint nadded, jobjectArray jremoved, jint nremoved) {
+		VLogInfo *f = getVLogInfo(env, obj);
+		if (f == NULL || f->program == NULL) {
+			throwNotStartedException(env, "VLog is not started yet");
+			return;
+		}
+		if (f->sn == NULL || f->maint == NULL) {
+			throwMaterializationException(env, "The materialization must be computed before updating it");
+			return;
+		}
+
+		std::string pred = jstring2string(env, jpred);
+		Predicate p = f->program->getPredicate(pred);
+		if (p.getCardinality() == 0 || p.getType() != EDB) {
+			throwNonExistingPredicateException(env, ("EDB predicate " + pred + " does not exist").c_str());
+			return;
+		}
+		const PredId_t predid = p.getId();
+
+		std::map<PredId_t, EDBFacts> added;
+		std::map<PredId_t, EDBFacts> removed;
+		if (jadded != NULL && ! getColumns(env, f, pred, jadded, nadded, added[predid])) {
+			return;
+		}
+		if (jremoved != NULL && ! getColumns(env, f, pred, jremoved, nremoved, removed[predid])) {
+			return;
+		}
+
+		//The update owns the materialization while it runs: if it fails after
+		//dropping it, f->sn stays NULL and it must be computed again. The EDB
+		//table may have been updated anyway
+		std::unique_ptr<SemiNaiver> sn(f->sn);
+		f->sn = NULL;
+		try {
+			f->maint->update(sn, added, removed);
+		} catch(std::string s) {
+			f->sn = sn.release();
+			f->cache->invalidate(predid);
+			throwMaterializationException(env, s.c_str());
+			return;
+		} catch(const char *s) {
+			f->sn = sn.release();
+			f->cache->invalidate(predid);
+			throwMaterializationException(env, s);
+			return;
+		}
+		f->sn = sn.release();
+		f->cache->invalidate(predid);
 	}
 
 
@@ -568,10 +766,15 @@ extern "C" {
 		// Now create an iterator over the query result.
 		TupleIterator *iter = NULL;
 		Reasoner r((uint64_t) 0);
+		r.setQueryCache(f->cache);
 		if (pred.getType() == EDB) {
-			iter = r.getEDBIterator(query, NULL, NULL, *(f->layer), ! (bool) includeConstants, NULL);
+			iter = r.getCachedIterator(query, ! (bool) includeConstants, NULL, *(f->program), [&]() {
+					return r.getEDBIterator(query, NULL, NULL, *(f->layer), ! (bool) includeConstants, NULL);
+					});
 		} else if (f->sn != NULL) {
-			iter = r.getIteratorWithMaterialization(f->sn, query, ! (bool) includeConstants, NULL);
+			iter = r.getCachedIterator(query, ! (bool) includeConstants, NULL, *(f->program), [&]() {
+					return r.getIteratorWithMaterialization(f->sn, query, ! (bool) includeConstants, NULL);
+					});
 		} else {
 			// No materialization yet, but non-EDB predicate ... so, empty.
 			TupleTable *table = new TupleTable(sz);
@@ -689,6 +892,7 @@ JNIEXPORT jlong JNICALL Java_karmaresearch_vlog_VLog_nativeQuerySize(JNIEnv * en
 		}
 		if (rules != NULL) {
 			// Create a new program, to remove any left-overs from old rule stuff
+			f->dropMaintenance();
 			delete f->program;
 			f->program = new Program(f->layer);
 
@@ -754,6 +958,7 @@ JNIEXPORT jlong JNICALL Java_karmaresearch_vlog_VLog_nativeQuerySize(JNIEnv * en
 			return;
 		}
 
+		f->dropMaintenance();
 		delete f->program;
 		f->program = new Program(f->layer);
 
@@ -792,21 +997,24 @@ JNIEXPORT jlong JNICALL Java_karmaresearch_vlog_VLog_nativeQuerySize(JNIEnv * en
 			delete f->sn;
             f->sn = NULL;
 		}
+		f->dropMaintenance();
+		f->cache->clear();
 
 		LOG(INFOL) << "Starting full materialization";
 		try {
-			f->sn = new SemiNaiver(*(f->layer), f->program, true, false, false,
+			f->maint = new IncrementalMaintenance(*(f->layer), f->program, true, false,
 					(bool) skolem ?
 					TypeChase::SKOLEM_CHASE : TypeChase::RESTRICTED_CHASE,
-					-1, false, false);
+					-1);
 			std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
 			unsigned long *p = NULL;
 			unsigned long t = (unsigned long) jtimeout;
 			if (t > 0) {
 				p = &t;
 			}
-			f->sn->run(p);
+			f->sn = f->maint->materialize(p);
 			if (p != NULL && *p == 0) {
+				f->dropMaintenance();
 				return (jboolean) false;
 			}
 			std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
@@ -920,6 +1128,48 @@ JNIEXPORT jlong JNICALL Java_karmaresearch_vlog_VLog_nativeQuerySize(JNIEnv * en
 		streamout.close();
 	}
 
+	/*
+	 * Class:     karmaresearch_vlog_VLog
+	 * Method:    queryToBuffer
+	 * Signature: (I[JZZ)[J
+	 */
+	JNIEXPORT jlongArray JNICALL Java_karmaresearch_vlog_VLog_queryToBuffer(JNIEnv *env, jobject obj, jint pred, jlongArray q, jboolean includeConstants, jboolean filterBlanks) {
+		if (pred < 0) {
+			throwNonExistingPredicateException(env, "Predicate does not exist");
+			return NULL;
+		}
+		TupleIterator *iter = getQueryIter(env, obj, (PredId_t) pred, q, includeConstants);
+		if (iter == NULL) {
+			return NULL;
+		}
+		// All the answers, row after row, are copied into the array at once
+		size_t sz = iter->getTupleSize();
+		std::vector<jlong> rows;
+		while (iter->hasNext()) {
+			iter->next();
+			if (filterBlanks) {
+				bool filter = false;
+				for (int i = 0; i < sz; i++) {
+					if (IS_BLANK(iter->getElementAt(i))) {
+						filter = true;
+						break;
+					}
+				}
+				if (filter) {
+					continue;
+				}
+			}
+			for (int i = 0; i < sz; i++) {
+				rows.push_back(iter->getElementAt(i));
+			}
+		}
+		delete iter;
+		jlongArray outJNIArray = env->NewLongArray(rows.size());
+		if (NULL == outJNIArray) return NULL;
+		env->SetLongArrayRegion(outJNIArray, 0, rows.size(), rows.data());
+		return outJNIArray;
+	}
+
 	/*
 	 * Class:     karmaresearch_vlog_QueryResultIterator
 	 * Method:    hasMoreElements
@@ -955,6 +1205,70 @@ JNIEXPORT jlong JNICALL Java_karmaresearch_vlog_VLog_nativeQuerySize(JNIEnv * en
 		return outJNIArray;
 	}
 
+	/*
+	 * Class:     karmaresearch_vlog_QueryResultIterator
+	 * Method:    getTupleSize
+	 * Signature: (J)I
+	 */
+	JNIEXPORT jint JNICALL Java_karmaresearch_vlog_QueryResultIterator_getTupleSize(JNIEnv *env, jobject obj, jlong ref) {
+		TupleIterator *iter = (TupleIterator *) ref;
+		if (iter == NULL) {
+			return 0;
+		}
+		return (jint) iter->getTupleSize();
+	}
+
+	/*
+	 * Class:     karmaresearch_vlog_QueryResultIterator
+	 * Method:    nextBatch
+	 * Signature: (JLjava/nio/LongBuffer;IIZZ)I
+	 */
+	JNIEXPORT jint JNICALL Java_karmaresearch_vlog_QueryResultIterator_nextBatch(JNIEnv *env, jobject obj, jlong ref, jobject buffer, jint first, jint maxTuples, jboolean columnMajor, jboolean filterBlanks) {
+		TupleIterator *iter = (TupleIterator *) ref;
+		if (iter == NULL) {
+			return 0;
+		}
+		jlong *out = (jlong *) env->GetDirectBufferAddress(buffer);
+		if (out == NULL) {
+			throwIllegalArgumentException(env, "The buffer is not direct");
+			return 0;
+		}
+		size_t sz = iter->getTupleSize();
+		if (first < 0 || maxTuples < first || (jlong) maxTuples * sz > env->GetDirectBufferCapacity(buffer)) {
+			throwIllegalArgumentException(env, "The buffer is too small for the tuples");
+			return 0;
+		}
+		// Row-major: the tuples one after the other. Column-major: the first
+		// field of the maxTuples tuples, then the second one, and so on.
+		jint n = first;
+		while (n < maxTuples && iter->hasNext()) {
+			iter->next();
+			if (filterBlanks) {
+				bool filter = false;
+				for (int i = 0; i < sz; i++) {
+					if (IS_BLANK(iter->getElementAt(i))) {
+						filter = true;
+						break;
+					}
+				}
+				if (filter) {
+					continue;
+				}
+			}
+			if (columnMajor) {
+				for (int i = 0; i < sz; i++) {
+					out[(size_t) i * maxTuples + n] = iter->getElementAt(i);
+				}
+			} else {
+				for (int i = 0; i < sz; i++) {
+					out[(size_t) n * sz + i] = iter->getElementAt(i);
+				}
+			}
+			n++;
+		}
+		return n - first;
+	}
+
 	/*
 	 * Class:     karmaresearch_vlog_QueryResultIterator
 	 * Method:    cleanup
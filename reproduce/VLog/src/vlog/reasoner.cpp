@@ -8,12 +8,14 @@
 #include <vlog/edb.h>
 #include <vlog/qsqquery.h>
 #include <vlog/qsqr.h>
+#include <vlog/reliances/reliances.h>
 
 #include <trident/kb/consts.h>
 #include <trident/model/table.h>
 
 #include <string>
 #include <vector>
+#include <chrono>
 
 long cmpRow(std::vector<uint8_t> *posJoins, const Term_t *row1, const uint64_t *row2) {
     for (int i = 0; i < posJoins->size(); ++i) {
@@ -285,11 +287,58 @@ FCBlock Reasoner::getBlockFromQuery(Literal constantsQuery, Literal &boundQuery,
             NULL, 0, true);
 }
 
+TupleIterator *Reasoner::getCachedIterator(Literal &query,
+        bool returnOnlyVars, std::vector<uint8_t> *sortByFields,
+        Program &program, std::function<TupleIterator *()> evaluate) {
+    if (queryCache == NULL) {
+        return evaluate();
+    }
+    const std::string key = QueryCache::getKey(query, returnOnlyVars,
+            sortByFields);
+    std::shared_ptr<TupleTable> table = queryCache->get(key);
+    if (table != NULL) {
+        return new TupleTableItr(table);
+    }
+    TupleIterator *itr = evaluate();
+    const size_t sz = itr->getTupleSize();
+    if (sz == 0) {
+        return itr;
+    }
+    table = std::shared_ptr<TupleTable>(new TupleTable(sz));
+    while (itr->hasNext()) {
+        itr->next();
+        for (size_t i = 0; i < sz; ++i) {
+            table->addValue(itr->getElementAt(i));
+        }
+    }
+    delete itr;
+    queryCache->put(key, table, QueryCache::getDependencies(program,
+                query.getPredicate().getId()));
+    return new TupleTableItr(table);
+}
+
 TupleIterator *Reasoner::getIterator(Literal &query,
         std::vector<uint8_t> *posJoins,
         std::vector<Term_t> *possibleValuesJoins,
         EDBLayer &edb, Program &program, bool returnOnlyVars,
         std::vector<uint8_t> *sortByFields) {
+    if (queryCache != NULL && posJoins == NULL) {
+        return getCachedIterator(query, returnOnlyVars, sortByFields, program,
+                [&]() {
+                return getUncachedIterator(query, posJoins,
+                        possibleValuesJoins, edb, program, returnOnlyVars,
+                        sortByFields);
+                });
+    }
+    return getUncachedIterator(query, posJoins, possibleValuesJoins, edb,
+            program, returnOnlyVars, sortByFields);
+}
+
+TupleIterator *Reasoner::getUncachedIterator(Literal &query,
+        std::vector<uint8_t> *posJoins,
+        std::vector<Term_t> *possibleValuesJoins,
+        EDBLayer &edb, Program &program, bool returnOnlyVars,
+        std::vector<uint8_t> *sortByFields) {
     if (posJoins != NULL && possibleValuesJoins != NULL) {
         /* No, let's keep them. --Ceriel
         // Check if there are'nt too many values to check.
@@ -307,23 +356,53 @@ TupleIterator *Reasoner::getIterator(Literal &query,
         return Reasoner::getEDBIterator(query, posJoins, possibleValuesJoins, edb,
                 returnOnlyVars, sortByFields);
     }
+    //The iterators copy the answers, so the sliced program can go
+    std::shared_ptr<Program> relevantProgram = getRelevantProgram(query, program);
+    Program &queryProgram = relevantProgram != NULL ? *relevantProgram : program;
     if (posJoins == NULL || posJoins->size() < query.getNVars() || returnOnlyVars || posJoins->size() > 1) {
-        ReasoningMode mode = chooseMostEfficientAlgo(query, edb, program, posJoins, possibleValuesJoins);
+        ReasoningMode mode = chooseMostEfficientAlgo(query, edb, queryProgram, posJoins, possibleValuesJoins);
         if (mode == MAGIC) {
             LOG(INFOL) << "Using magic for " << query.tostring(&program, &edb);
             return Reasoner::getMagicIterator(
-                    query, posJoins, possibleValuesJoins, edb, program,
+                    query, posJoins, possibleValuesJoins, edb, queryProgram,
                     returnOnlyVars, sortByFields);
         }
         //top-down
         LOG(INFOL) << "Using top-down for " << query.tostring(&program, &edb);
         return Reasoner::getTopDownIterator(
-                query, posJoins, possibleValuesJoins, edb, program,
+                query, posJoins, possibleValuesJoins, edb, queryProgram,
                 returnOnlyVars, sortByFields);
     }
 
     LOG(INFOL) << "Using incremental reasoning for " << query.tostring(&program, &edb);
-    return getIncrReasoningIterator(query, posJoins, possibleValuesJoins, edb, program, returnOnlyVars, sortByFields);
+    return getIncrReasoningIterator(query, posJoins, possibleValuesJoins, edb, queryProgram, returnOnlyVars, sortByFields);
+}
+
+std::shared_ptr<Program> Reasoner::getRelevantProgram(Literal &query,
+        Program &program) {
+    if (!relevanceSlicing || query.getPredicate().getType() == EDB) {
+        return NULL;
+    }
+    std::vector<Rule> rules = program.getAllRules();
+    RelevanceResult relevance = computeRelevantRules(rules, query,
+            relevanceTimeout);
+    LOG(INFOL) << "Relevance of " << query.tostring(&program, NULL) <<
+        ": kept " << relevance.rules.size() << " of " << rules.size() <<
+        " rules (" << relevance.numberOfReachableRules <<
+        " reachable through the predicates) in " <<
+        relevance.timeMilliSeconds << "ms, " << relevance.numberOfCalls <<
+        " reliance checks" << (relevance.timeout ? ", timeout" : "");
+    if (relevance.rules.size() == rules.size()) {
+        return NULL;
+    }
+    std::vector<Rule> selected;
+    for (const size_t ruleIndex : relevance.rules) {
+        selected.push_back(rules[ruleIndex]);
+    }
+    std::shared_ptr<Program> relevantProgram = program.cloneNew();
+    relevantProgram->cleanAllRules();
+    relevantProgram->addAllRules(selected);
+    return relevantProgram;
 }
 
 TupleIterator *Reasoner::getIncrReasoningIterator(Literal &query,
@@ -825,6 +904,20 @@ ReasoningMode Reasoner::chooseMostEfficientAlgo(Literal &query,
     } else {
         cost = estimate(query, NULL, NULL, layer, program);
     }
+    if (useCostModel) {
+        RelevanceFeatures features = ReasoningCostModel::getFeatures(query, program);
+        ReasoningMode mode = costModel.preferTopDown(cost, features) ? TOPDOWN : MAGIC;
+        LOG(INFOL) << "Resolving " << query.tostring(&program, &layer) <<
+            " with " << (mode == TOPDOWN ? "QSQR" : "magic") <<
+            ". Estimated cost: " << cost << ", relevant rules " <<
+            features.numberOfRelevantRules << ", recursive rules " <<
+            features.numberOfRecursiveRules << (features.existentialRecursion ?
+                    " (existential)" : "") << ", restraints " <<
+            features.numberOfRestraints << (features.timeout ? " (timeout)" : "") <<
+            ", adjusted cost " << costModel.getAdjustedCost(cost, features) <<
+            ", " << costModel.tostring();
+        return mode;
+    }
     ReasoningMode mode = cost < threshold ? TOPDOWN : MAGIC;
     LOG(DEBUGL) << "Deciding whether I should resolve " <<
         query.tostring(&program, &layer) <<
@@ -833,6 +926,64 @@ ReasoningMode Reasoner::chooseMostEfficientAlgo(Literal &query,
     return mode;
 }
 
+//Both strategies evaluate the query when the iterator is built, so the time
+//includes building it
+static double timeQuery(std::function<TupleIterator*()> getIterator) {
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    TupleIterator *itr = getIterator();
+    while (itr->hasNext()) {
+        itr->next();
+    }
+    delete itr;
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    return sec.count() * 1000;
+}
+
+ReasoningCostModel Reasoner::calibrate(std::vector<Literal> &queries,
+        EDBLayer &layer, Program &program, const int repeat) {
+    std::vector<CalibrationSample> samples;
+    for (Literal &query : queries) {
+        if (query.getPredicate().getType() == EDB) {
+            continue;
+        }
+        CalibrationSample sample;
+        sample.query = query.tostring(&program, &layer);
+        sample.cost = estimate(query, NULL, NULL, layer, program);
+        sample.features = ReasoningCostModel::getFeatures(query, program);
+        const bool onlyVars = query.getNVars() > 0;
+        sample.topDownMs = 0;
+        sample.magicMs = 0;
+        //QSQR is not tried on recursion through existential rules, and the
+        //model always chooses magic sets for them: they are left out of the
+        //fit
+        if (sample.features.existentialRecursion) {
+            LOG(INFOL) << "Calibration query " << sample.query <<
+                ": recursion through existential rules, skipped";
+            continue;
+        }
+        for (int i = 0; i < std::max(1, repeat); ++i) {
+            sample.topDownMs += timeQuery([&]() {
+                    return getTopDownIterator(query, NULL, NULL, layer,
+                            program, onlyVars, NULL);
+                    });
+            sample.magicMs += timeQuery([&]() {
+                    return getMagicIterator(query, NULL, NULL, layer,
+                            program, onlyVars, NULL);
+                    });
+        }
+        LOG(INFOL) << "Calibration query " << sample.query << ": cost " <<
+            sample.cost << ", recursive rules " <<
+            sample.features.numberOfRecursiveRules << ", restraints " <<
+            sample.features.numberOfRestraints << ", QSQR " <<
+            sample.topDownMs << "ms, magic " << sample.magicMs << "ms";
+        samples.push_back(sample);
+    }
+    ReasoningCostModel model = useCostModel ? costModel : ReasoningCostModel(threshold);
+    model.fit(samples);
+    setCostModel(model);
+    return model;
+}
+
 TupleIterator *Reasoner::getEDBIterator(Literal &query,
         std::vector<uint8_t> *posJoins,
         std::vector<Term_t> *possibleValuesJoins,
@@ -696,21 +696,39 @@ RuleHashInfo ruleHashInfoFirst(const Rule &rule)
     return result;
 }
 
-std::string rulePairHash(RuleHashInfo ruleFromInfo, const RuleHashInfo &ruleToInfo, const Rule &rule)
+std::string rulePairHash(RuleHashInfo &ruleFromInfo, const RuleHashInfo &ruleToInfo, const Rule &rule)
 {
     std::string result = ruleFromInfo.firstRuleString + ruleToInfo.secondRuleString;
 
+    // ruleFromInfo is shared by all pairs of this ruleFrom,
+    // so predicates local to this pair are removed again at the end
+    unsigned localPredicateBefore = ruleFromInfo.localPredicate;
+    std::vector<PredId_t> addedPredicates;
+
+    auto addPairPredicate = [&] (const Literal &currentLiteral) {
+        PredId_t predId = currentLiteral.getPredicate().getId();
+        unsigned currentPredId = addPredicate(ruleFromInfo, predId);
+        result += std::string("|") + std::to_string(currentPredId);
+
+        if (currentPredId >= localPredicateBefore)
+            addedPredicates.push_back(predId);
+    };
+
     for (const Literal &currentLiteral : rule.getHeads())
     {
-        unsigned currentPredId = addPredicate(ruleFromInfo, currentLiteral.getPredicate().getId());
-        result += std::string("|") + std::to_string(currentPredId);
+        addPairPredicate(currentLiteral);
     }
 
     for (const Literal &currentLiteral : rule.getBody())
     {
-        unsigned currentPredId = addPredicate(ruleFromInfo, currentLiteral.getPredicate().getId());
-        result += std::string("|") + std::to_string(currentPredId);
+        addPairPredicate(currentLiteral);
+    }
+
+    for (PredId_t predId : addedPredicates)
+    {
+        ruleFromInfo.predIdToLocal.erase(predId);
     }
+    ruleFromInfo.localPredicate = localPredicateBefore;
 
     return result;
 
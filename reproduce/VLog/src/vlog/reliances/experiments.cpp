@@ -137,11 +137,12 @@ void printShortestCycle(const SimpleGraph &positiveGraph, const SimpleGraph &pos
     }
 }
 
-void experimentCoreStratified(const std::string &rulesPath, bool pieceDecomposition, RelianceStrategy strat, unsigned timeoutMilliSeconds, bool printCycles)
+void experimentCoreStratified(const std::string &rulesPath, bool pieceDecomposition, RelianceStrategy strat, unsigned timeoutMilliSeconds, bool printCycles, bool lazy)
 {
     std::cout << "Launched coreStratified experiment with parameters " << '\n';
     std::cout << "\t" << "Path: " << rulesPath << '\n';
     std::cout << "\t" << "Piece: " << ((pieceDecomposition) ? "true" : "false") << '\n';
+    std::cout << "\t" << "Lazy: " << ((lazy) ? "true" : "false") << '\n';
     std::cout << "\t" <<  "Strat: " << strat << std::endl;
 
     EDBConf emptyConf("", false);
@@ -171,6 +172,31 @@ void experimentCoreStratified(const std::string &rulesPath, bool pieceDecomposit
     if (pieceDecomposition)
         std::cout << "#PieceRules: " << allPieceDecomposedRules.size() << '\n';
 
+    if (lazy)
+    {
+        auto experimentStart = std::chrono::system_clock::now();
+
+        LazyRelianceGraph positiveGraph(allRules, RelianceType::Positive, strat, timeoutMilliSeconds);
+        LazyRelianceGraph restraintGraph(allRules, RelianceType::Restraint, strat, timeoutMilliSeconds);
+        bool coreStratified = isCoreStratifiedLazy(positiveGraph, restraintGraph);
+        bool timeout = positiveGraph.timeout || restraintGraph.timeout;
+
+        double timeMilliSeconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - experimentStart).count() / 1000.0;
+
+        std::cout << "Calls-Positive: " << positiveGraph.numberOfCalls << '\n';
+        std::cout << "Calls-Restraint: " << restraintGraph.numberOfCalls << '\n';
+        std::cout << "Calls-Overall: " << positiveGraph.numberOfCalls + restraintGraph.numberOfCalls << '\n';
+
+        if (!timeout)
+        {
+            std::cout << "Time-Overall: " << timeMilliSeconds << '\n';
+            std::cout << "Core-Stratified: " << ((coreStratified) ? "1" : "0") << '\n';
+        }
+
+        std::cout << "Timeout: " << ((timeout) ? "1" : "0") << '\n';
+        return;
+    }
+
     RelianceComputationResult positiveResult = computePositiveReliances(allRules, strat, timeoutMilliSeconds);
     std::pair<SimpleGraph, SimpleGraph> positiveGraphs = positiveResult.graphs;
 
@@ -332,7 +358,7 @@ void experimentCycles(const std::string &rulesPath, const std::string &algorithm
     std::cout << "Timeout: 0" << '\n';
 }
 
-void experimentGRD(const std::string &rulesPath, unsigned timeoutMilliSeconds)
+void experimentGRD(const std::string &rulesPath, unsigned timeoutMilliSeconds, bool lazy)
 {
     EDBConf emptyConf("", false);
     EDBLayer edbLayer(emptyConf, false);
@@ -347,6 +373,25 @@ void experimentGRD(const std::string &rulesPath, unsigned timeoutMilliSeconds)
     const std::vector<Rule> &allRules = program.getAllRules();
 
     auto experimentStart = std::chrono::system_clock::now();
+
+    if (lazy)
+    {
+        LazyRelianceGraph positiveGraph(allRules, RelianceType::Positive, RelianceStrategy::Full, timeoutMilliSeconds);
+        bool isAcyclic = isAcyclicLazy(positiveGraph);
+
+        if (positiveGraph.timeout)
+        {
+            std::cout << "Timeout: 1" << '\n';
+            return;
+        }
+
+        double timeMilliSeconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - experimentStart).count() / 1000.0;
+
+        std::cout << "Acyclic: " << (isAcyclic ? "1" : "0") << '\n';
+        std::cout << "Calls: " << positiveGraph.numberOfCalls << '\n';
+        std::cout << "Time: " << timeMilliSeconds << " ms" << '\n';
+        return;
+    }
     
     RelianceComputationResult positiveResult = computePositiveReliances(allRules, RelianceStrategy::Full, timeoutMilliSeconds);
     
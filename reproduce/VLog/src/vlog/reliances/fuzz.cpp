@@ -0,0 +1,390 @@
+#include <vlog/reliances/fuzz.h>
+
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <set>
+
+struct FuzzAtom
+{
+    unsigned predicate;
+    std::vector<std::string> terms;
+};
+
+struct FuzzRule
+{
+    std::vector<FuzzAtom> heads;
+    std::vector<FuzzAtom> body;
+};
+
+struct FuzzProgram
+{
+    std::vector<unsigned> arities;
+    std::vector<FuzzRule> rules;
+};
+
+enum class FuzzGraphType
+{
+    Positive, Restraint, Lazy
+};
+
+struct FuzzDisagreement
+{
+    bool found = false;
+    FuzzGraphType type = FuzzGraphType::Positive;
+    int32_t strategy = 0;
+    std::string description;
+};
+
+typedef std::set<std::pair<size_t, size_t>> EdgeSet;
+
+std::string fuzzAtomToString(const FuzzAtom &atom)
+{
+    std::string result = "P" + std::to_string(atom.predicate) + "(";
+
+    for (size_t termIndex = 0; termIndex < atom.terms.size(); ++termIndex)
+    {
+        if (termIndex > 0)
+            result += ",";
+
+        result += atom.terms[termIndex];
+    }
+
+    return result + ")";
+}
+
+std::string fuzzAtomsToString(const std::vector<FuzzAtom> &atoms)
+{
+    std::string result;
+
+    for (size_t atomIndex = 0; atomIndex < atoms.size(); ++atomIndex)
+    {
+        if (atomIndex > 0)
+            result += ",";
+
+        result += fuzzAtomToString(atoms[atomIndex]);
+    }
+
+    return result;
+}
+
+std::string fuzzProgramToString(const FuzzProgram &program)
+{
+    std::string result;
+
+    for (const FuzzRule &rule : program.rules)
+    {
+        result += fuzzAtomsToString(rule.heads) + " :- " + fuzzAtomsToString(rule.body) + "\n";
+    }
+
+    return result;
+}
+
+FuzzProgram generateFuzzProgram(const FuzzParameters &parameters, std::mt19937 &generator)
+{
+    auto randomBelow = [&] (unsigned bound) -> unsigned {
+        return std::uniform_int_distribution<unsigned>(0, bound - 1)(generator);
+    };
+
+    FuzzProgram result;
+
+    for (unsigned predicate = 0; predicate < parameters.numberOfPredicates; ++predicate)
+    {
+        result.arities.push_back(1 + randomBelow(parameters.maxArity));
+    }
+
+    // Few variables per rule, so that joins, repeated variables and
+    // existential variables shared between head atoms are frequent
+    const unsigned numberOfUniversals = 3;
+    const unsigned numberOfExistentials = 2;
+
+    unsigned numberOfRules = 1 + randomBelow(parameters.maxRules);
+    for (unsigned ruleIndex = 0; ruleIndex < numberOfRules; ++ruleIndex)
+    {
+        FuzzRule currentRule;
+        std::vector<std::string> bodyVariables;
+
+        auto randomAtom = [&] (bool isHead) -> FuzzAtom {
+            FuzzAtom atom;
+            atom.predicate = randomBelow(parameters.numberOfPredicates);
+
+            for (unsigned termIndex = 0; termIndex < result.arities[atom.predicate]; ++termIndex)
+            {
+                unsigned choice = randomBelow(10);
+
+                if (parameters.numberOfConstants > 0 && choice == 0)
+                {
+                    atom.terms.push_back("c" + std::to_string(randomBelow(parameters.numberOfConstants)));
+                }
+                else if (isHead && (choice <= 3 || bodyVariables.empty()))
+                {
+                    atom.terms.push_back("Y" + std::to_string(randomBelow(numberOfExistentials)));
+                }
+                else if (isHead)
+                {
+                    atom.terms.push_back(bodyVariables[randomBelow((unsigned)bodyVariables.size())]);
+                }
+                else
+                {
+                    atom.terms.push_back("X" + std::to_string(randomBelow(numberOfUniversals)));
+                }
+            }
+
+            return atom;
+        };
+
+        unsigned bodySize = 1 + randomBelow(parameters.maxBodySize);
+        for (unsigned bodyIndex = 0; bodyIndex < bodySize; ++bodyIndex)
+        {
+            currentRule.body.push_back(randomAtom(false));
+
+            for (const std::string &term : currentRule.body.back().terms)
+            {
+                if (term[0] == 'X' && std::find(bodyVariables.begin(), bodyVariables.end(), term) == bodyVariables.end())
+                    bodyVariables.push_back(term);
+            }
+        }
+
+        unsigned headSize = 1 + randomBelow(parameters.maxHeadSize);
+        for (unsigned headIndex = 0; headIndex < headSize; ++headIndex)
+        {
+            currentRule.heads.push_back(randomAtom(true));
+        }
+
+        result.rules.push_back(currentRule);
+    }
+
+    return result;
+}
+
+EdgeSet graphToEdgeSet(const SimpleGraph &graph)
+{
+    EdgeSet result;
+
+    for (size_t from = 0; from < graph.edges.size(); ++from)
+    {
+        for (size_t to : graph.edges[from])
+        {
+            result.insert(std::make_pair(from, to));
+        }
+    }
+
+    return result;
+}
+
+std::string edgeSetToString(const EdgeSet &edges)
+{
+    std::string result = "{";
+
+    for (const auto &edge : edges)
+    {
+        if (result.size() > 1)
+            result += ", ";
+
+        result += std::to_string(edge.first) + "->" + std::to_string(edge.second);
+    }
+
+    return result + "}";
+}
+
+EdgeSet computeFuzzGraph(const std::vector<Rule> &rules, FuzzGraphType type, int32_t strategy)
+{
+    RelianceComputationResult result = (type == FuzzGraphType::Positive)
+        ? computePositiveReliances(rules, (RelianceStrategy)strategy)
+        : computeRestrainReliances(rules, (RelianceStrategy)strategy);
+
+    return graphToEdgeSet(result.graphs.first);
+}
+
+// If only is given, just its graph type and strategy are compared to the naive strategy
+FuzzDisagreement findDisagreement(const FuzzProgram &fuzzProgram,
+    const FuzzDisagreement *only = nullptr)
+{
+    FuzzDisagreement result;
+
+    EDBConf emptyConf("", false);
+    EDBLayer edbLayer(emptyConf, false);
+
+    Program program(&edbLayer);
+    std::string errorString = program.readFromString(fuzzProgramToString(fuzzProgram), false);
+    if (!errorString.empty()) {
+        LOG(ERRORL) << errorString;
+        return result;
+    }
+
+    const std::vector<Rule> &allRules = program.getAllRules();
+
+    for (FuzzGraphType type : {FuzzGraphType::Positive, FuzzGraphType::Restraint})
+    {
+        if (only != nullptr && only->type != type)
+            continue;
+
+        EdgeSet expected = computeFuzzGraph(allRules, type, RelianceStrategy::Naive);
+
+        for (int32_t strategy = RelianceStrategy::Naive + 1; strategy <= RelianceStrategy::Full; ++strategy)
+        {
+            if (only != nullptr && only->strategy != strategy)
+                continue;
+
+            EdgeSet actual = computeFuzzGraph(allRules, type, strategy);
+            if (actual != expected)
+            {
+                result.found = true;
+                result.type = type;
+                result.strategy = strategy;
+                result.description = std::string((type == FuzzGraphType::Positive) ? "Positive" : "Restraint")
+                    + " graph of strategy " + std::to_string(strategy)
+                    + " is " + edgeSetToString(actual)
+                    + " but strategy 0 computed " + edgeSetToString(expected);
+
+                return result;
+            }
+        }
+    }
+
+    // The lazy queries have to agree with the ones on the complete graphs
+    if (only == nullptr || only->type == FuzzGraphType::Lazy)
+    {
+        RelianceComputationResult positiveResult = computePositiveReliances(allRules, RelianceStrategy::Naive);
+        RelianceComputationResult restraintResult = computeRestrainReliances(allRules, RelianceStrategy::Naive);
+
+        bool expectedAcyclic = true;
+        RelianceGroupResult positiveGroups = computeRelianceGroups(positiveResult.graphs.first, positiveResult.graphs.second);
+        for (const std::vector<unsigned> &group : positiveGroups.groups)
+        {
+            if (group.size() > 1 || positiveResult.graphs.first.containsEdge(group[0], group[0]))
+                expectedAcyclic = false;
+        }
+
+        std::pair<SimpleGraph, SimpleGraph> unionGraphs = combineGraphs(positiveResult.graphs.first, restraintResult.graphs.first);
+        bool expectedStratified = isCoreStratified(unionGraphs.first, unionGraphs.second, restraintResult.graphs.first).stratified;
+
+        LazyRelianceGraph positiveGraph(allRules, RelianceType::Positive);
+        LazyRelianceGraph restraintGraph(allRules, RelianceType::Restraint);
+        bool actualAcyclic = isAcyclicLazy(positiveGraph);
+        bool actualStratified = isCoreStratifiedLazy(positiveGraph, restraintGraph);
+
+        if (actualAcyclic != expectedAcyclic || actualStratified != expectedStratified)
+        {
+            result.found = true;
+            result.type = FuzzGraphType::Lazy;
+            result.strategy = RelianceStrategy::Full;
+            result.description = std::string("Lazy queries computed acyclic ") + std::to_string(actualAcyclic)
+                + ", core-stratified " + std::to_string(actualStratified)
+                + " but the complete graphs give " + std::to_string(expectedAcyclic)
+                + ", " + std::to_string(expectedStratified);
+        }
+    }
+
+    return result;
+}
+
+// Greedily removes rules and atoms as long as the same disagreement remains
+FuzzProgram minimizeFuzzProgram(const FuzzProgram &program, FuzzDisagreement &disagreement)
+{
+    FuzzProgram current = program;
+
+    auto tryCandidate = [&] (const FuzzProgram &candidate) -> bool {
+        FuzzDisagreement candidateDisagreement = findDisagreement(candidate, &disagreement);
+        if (!candidateDisagreement.found)
+            return false;
+
+        current = candidate;
+        disagreement = candidateDisagreement;
+        return true;
+    };
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+
+        for (size_t ruleIndex = 0; current.rules.size() > 1 && ruleIndex < current.rules.size(); ++ruleIndex)
+        {
+            FuzzProgram candidate = current;
+            candidate.rules.erase(candidate.rules.begin() + ruleIndex);
+
+            if (tryCandidate(candidate))
+            {
+                changed = true;
+                --ruleIndex;
+            }
+        }
+
+        for (size_t ruleIndex = 0; ruleIndex < current.rules.size(); ++ruleIndex)
+        {
+            for (size_t atomIndex = 0; current.rules[ruleIndex].body.size() > 1 && atomIndex < current.rules[ruleIndex].body.size(); ++atomIndex)
+            {
+                FuzzProgram candidate = current;
+                std::vector<FuzzAtom> &body = candidate.rules[ruleIndex].body;
+                body.erase(body.begin() + atomIndex);
+
+                if (tryCandidate(candidate))
+                {
+                    changed = true;
+                    --atomIndex;
+                }
+            }
+
+            for (size_t atomIndex = 0; current.rules[ruleIndex].heads.size() > 1 && atomIndex < current.rules[ruleIndex].heads.size(); ++atomIndex)
+            {
+                FuzzProgram candidate = current;
+                std::vector<FuzzAtom> &heads = candidate.rules[ruleIndex].heads;
+                heads.erase(heads.begin() + atomIndex);
+
+                if (tryCandidate(candidate))
+                {
+                    changed = true;
+                    --atomIndex;
+                }
+            }
+        }
+    }
+
+    return current;
+}
+
+bool performFuzzTests(const FuzzParameters &parameters)
+{
+    unsigned seed = parameters.seed;
+    if (seed == 0)
+        seed = (unsigned)std::chrono::system_clock::now().time_since_epoch().count();
+
+    std::cout << "Launched fuzz tests with parameters " << '\n';
+    std::cout << "\t" << "Seed: " << seed << '\n';
+    std::cout << "\t" << "Budget: " << parameters.timeBudgetSeconds << " s" << std::endl;
+
+    std::mt19937 generator(seed);
+    std::chrono::system_clock::time_point timepointStart = std::chrono::system_clock::now();
+
+    size_t numberOfPrograms = 0;
+    size_t numberOfDisagreements = 0;
+
+    while (std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - timepointStart).count() < parameters.timeBudgetSeconds)
+    {
+        FuzzProgram program = generateFuzzProgram(parameters, generator);
+        ++numberOfPrograms;
+
+        FuzzDisagreement disagreement = findDisagreement(program);
+        if (!disagreement.found)
+            continue;
+
+        ++numberOfDisagreements;
+
+        FuzzProgram minimized = minimizeFuzzProgram(program, disagreement);
+
+        std::string reproducerPath = parameters.reproducerFolder + "/fuzz_" + std::to_string(seed)
+            + "_" + std::to_string(numberOfPrograms) + ".dl";
+        std::ofstream stream(reproducerPath);
+        stream << "// Seed: " << seed << ", program: " << numberOfPrograms << '\n';
+        stream << "// " << disagreement.description << '\n';
+        stream << fuzzProgramToString(minimized);
+
+        std::cout << "Disagreement found, reproducer written to " << reproducerPath << '\n';
+        std::cout << "\t" << disagreement.description << '\n';
+    }
+
+    std::cout << (numberOfPrograms - numberOfDisagreements) << "/" << numberOfPrograms << " programs agreed." << std::endl;
+
+    return numberOfDisagreements == 0;
+}
@@ -0,0 +1,256 @@
+#include "vlog/reliances/reliances.h"
+
+#include <vector>
+#include <utility>
+#include <stack>
+
+LazyRelianceGraph::LazyRelianceGraph(const std::vector<Rule> &rules, RelianceType type,
+    RelianceStrategy strat, unsigned timeoutMilliSeconds)
+    : rules(rules), type(type), strat(strat), candidateIndex(rules.size())
+{
+    markedRules.reserve(rules.size());
+    variableCounts.reserve(rules.size());
+    ruleHashInfos.reserve(rules.size());
+
+    for (const Rule &currentRule : rules)
+    {
+        unsigned variableCount = std::max(highestLiteralsId(currentRule.getHeads()), highestLiteralsId(currentRule.getBody()));
+        variableCounts.push_back(variableCount + 1);
+
+        markedRules.push_back(markExistentialVariables(currentRule));
+        ruleHashInfos.push_back(ruleHashInfoFirst(currentRule));
+    }
+
+    // Same candidates as in computePositiveReliances/computeRestrainReliances
+    for (size_t ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex)
+    {
+        const Rule &markedRule = markedRules[ruleIndex];
+
+        if (type == RelianceType::Positive)
+        {
+            for (const Literal &currentLiteral : markedRule.getBody())
+            {
+                candidateIndex.addRule(currentLiteral.getPredicate().getId(), ruleIndex);
+            }
+        }
+        else
+        {
+            for (const Literal &currentLiteral : markedRule.getHeads())
+            {
+                bool containsExistentialVariable = false;
+                for (size_t termIndex = 0; termIndex < currentLiteral.getTupleSize(); ++termIndex)
+                {
+                    if ((int32_t)currentLiteral.getTermAtPos(termIndex).getId() < 0)
+                    {
+                        containsExistentialVariable = true;
+                        break;
+                    }
+                }
+
+                if (containsExistentialVariable)
+                    candidateIndex.addRule(currentLiteral.getPredicate().getId(), ruleIndex);
+            }
+        }
+    }
+
+    successors.resize(rules.size());
+    computed.resize(rules.size(), false);
+
+    if (type == RelianceType::Positive)
+        positiveStartTimeout(timeoutMilliSeconds);
+    else
+        restrainStartTimeout(timeoutMilliSeconds);
+}
+
+bool LazyRelianceGraph::isReliance(size_t ruleFrom, size_t ruleTo)
+{
+    unsigned variableCountFrom = variableCounts[ruleFrom];
+    unsigned variableCountTo = variableCounts[ruleTo];
+
+    if (type == RelianceType::Positive)
+        return positiveReliance(markedRules[ruleFrom], variableCountFrom, markedRules[ruleTo], variableCountTo, strat);
+
+    bool isSelfExistential = (ruleFrom == ruleTo && rules[ruleFrom].isExistential());
+
+    bool result = restrainReliance(markedRules[ruleFrom], variableCountFrom, markedRules[ruleTo], variableCountTo, strat);
+    if (isSelfExistential && !result)
+        result = selfRestrainReliance(markedRules[ruleFrom], variableCountFrom, strat);
+
+    return result;
+}
+
+const std::vector<size_t> &LazyRelianceGraph::getSuccessors(size_t ruleFrom)
+{
+    if (computed[ruleFrom] || timeout)
+        return successors[ruleFrom];
+
+    std::vector<size_t> candidates;
+    if ((strat & RelianceStrategy::CutPairs) > 0)
+    {
+        candidates = candidateIndex.getCandidates(rules[ruleFrom].getHeads());
+    }
+    else
+    {
+        candidates.resize(rules.size());
+        std::iota(candidates.begin(), candidates.end(), 0);
+    }
+
+    for (size_t ruleTo : candidates)
+    {
+        bool isTimeout = (type == RelianceType::Positive) ? positiveIsTimeout(false) : restrainIsTimeout(false);
+        if (isTimeout)
+        {
+            timeout = true;
+            return successors[ruleFrom];
+        }
+
+        std::string stringHash;
+        if ((strat & RelianceStrategy::PairHash) > 0)
+        {
+            stringHash = rulePairHash(ruleHashInfos[ruleFrom], ruleHashInfos[ruleTo], rules[ruleTo]);
+            auto cacheIterator = resultCache.find(stringHash);
+            if (cacheIterator != resultCache.end())
+            {
+                if (cacheIterator->second)
+                    successors[ruleFrom].push_back(ruleTo);
+
+                continue;
+            }
+        }
+
+        ++numberOfCalls;
+
+        // A rule whose pieces can be applied separately always restrains itself
+        if (type == RelianceType::Restraint && ruleFrom == ruleTo && rules[ruleFrom].isExistential())
+        {
+            std::vector<Rule> splitRules;
+            splitIntoPieces(rules[ruleFrom], splitRules);
+
+            if (splitRules.size() > 1)
+            {
+                successors[ruleFrom].push_back(ruleTo);
+                continue;
+            }
+        }
+
+        bool currentIsReliance = isReliance(ruleFrom, ruleTo);
+
+        // A check that was aborted by the timeout has no meaningful result
+        isTimeout = (type == RelianceType::Positive) ? positiveIsTimeout(false) : restrainIsTimeout(false);
+        if (isTimeout)
+        {
+            timeout = true;
+            return successors[ruleFrom];
+        }
+
+        if (currentIsReliance)
+            successors[ruleFrom].push_back(ruleTo);
+
+        if (((strat & RelianceStrategy::PairHash) > 0) && (resultCache.size() < rulePairCacheSize))
+        {
+            resultCache[stringHash] = currentIsReliance;
+        }
+    }
+
+    computed[ruleFrom] = true;
+    return successors[ruleFrom];
+}
+
+bool isAcyclicLazy(LazyRelianceGraph &graph)
+{
+    // 0 = unvisited, 1 = on the current path, 2 = finished
+    std::vector<uint8_t> state(graph.size(), 0);
+    std::stack<std::pair<size_t, size_t>> dfsStack; // node, index of next successor
+
+    for (size_t startNode = 0; startNode < graph.size(); ++startNode)
+    {
+        if (state[startNode] != 0)
+            continue;
+
+        state[startNode] = 1;
+        dfsStack.push(std::make_pair(startNode, 0));
+
+        while (!dfsStack.empty())
+        {
+            size_t currentNode = dfsStack.top().first;
+            size_t successorIndex = dfsStack.top().second;
+
+            const std::vector<size_t> &currentSuccessors = graph.getSuccessors(currentNode);
+            if (graph.timeout)
+                return false;
+
+            if (successorIndex >= currentSuccessors.size())
+            {
+                state[currentNode] = 2;
+                dfsStack.pop();
+                continue;
+            }
+
+            ++dfsStack.top().second;
+
+            size_t successor = currentSuccessors[successorIndex];
+            if (state[successor] == 1)
+                return false;
+
+            if (state[successor] == 0)
+            {
+                state[successor] = 1;
+                dfsStack.push(std::make_pair(successor, 0));
+            }
+        }
+    }
+
+    return true;
+}
+
+bool isCoreStratifiedLazy(LazyRelianceGraph &positiveGraph, LazyRelianceGraph &restraintGraph)
+{
+    // A restraining edge from -> to lies inside a strongly connected component
+    // of the union graph iff from is reachable from to
+    std::vector<size_t> visitedIn(positiveGraph.size(), std::numeric_limits<size_t>::max());
+    std::vector<size_t> searchStack;
+
+    for (size_t ruleFrom = 0; ruleFrom < restraintGraph.size(); ++ruleFrom)
+    {
+        const std::vector<size_t> &restrained = restraintGraph.getSuccessors(ruleFrom);
+        if (restraintGraph.timeout)
+            return false;
+
+        for (size_t ruleTo : restrained)
+        {
+            if (ruleTo == ruleFrom)
+                return false;
+
+            searchStack.clear();
+            searchStack.push_back(ruleTo);
+            visitedIn[ruleTo] = ruleFrom;
+
+            while (!searchStack.empty())
+            {
+                size_t currentNode = searchStack.back();
+                searchStack.pop_back();
+
+                for (LazyRelianceGraph *graph : {&positiveGraph, &restraintGraph})
+                {
+                    const std::vector<size_t> &currentSuccessors = graph->getSuccessors(currentNode);
+                    if (graph->timeout)
+                        return false;
+
+                    for (size_t successor : currentSuccessors)
+                    {
+                        if (successor == ruleFrom)
+                            return false;
+
+                        if (visitedIn[successor] != ruleFrom)
+                        {
+                            visitedIn[successor] = ruleFrom;
+                            searchStack.push_back(successor);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
@@ -12,6 +12,13 @@ unsigned globalPositiveTimeout = 0;
 unsigned globalPositiveTimeoutCheckCount = 0;
 bool globalPositiveIsTimeout = false;
 
+void positiveStartTimeout(unsigned timeoutMilliSeconds)
+{
+    globalPositiveTimepointStart = std::chrono::system_clock::now();
+    globalPositiveTimeout = timeoutMilliSeconds;
+    globalPositiveIsTimeout = false;
+}
+
 bool positiveIsTimeout(bool rare)
 {
     if (globalPositiveTimeout == 0)
@@ -375,7 +382,7 @@ RelianceComputationResult computePositiveReliances(const std::vector<Rule> &rule
         ruleHashInfos.push_back(ruleHashInfoFirst(currentRule));
     }
 
-    std::unordered_map<PredId_t, std::vector<size_t>> bodyToMap;
+    PredicateRuleIndex bodyToIndex(rules.size());
     std::unordered_map<std::string, bool> resultCache;
 
     for (size_t ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex)
@@ -386,13 +393,12 @@ RelianceComputationResult computePositiveReliances(const std::vector<Rule> &rule
         {
             PredId_t currentPredId = currentLiteral.getPredicate().getId();
 
-            bodyToMap[currentPredId].push_back(ruleIndex);
+            bodyToIndex.addRule(currentPredId, ruleIndex);
         }
     }
 
-    std::chrono::system_clock::time_point timepointStart = std::chrono::system_clock::now();
-    globalPositiveTimepointStart = timepointStart;
-    globalPositiveTimeout = timeoutMilliSeconds;
+    positiveStartTimeout(timeoutMilliSeconds);
+    std::chrono::system_clock::time_point timepointStart = globalPositiveTimepointStart;
 
     uint64_t numCalls = 0;
 
@@ -402,15 +408,7 @@ RelianceComputationResult computePositiveReliances(const std::vector<Rule> &rule
         Return
     };
 
-    auto relianceExecution = [&] (size_t ruleFrom, size_t ruleTo, std::unordered_set<size_t> &proccesedRules) {
-        if ((strat & RelianceStrategy::CutPairs) > 0)
-        {
-            if (proccesedRules.find(ruleTo) != proccesedRules.end())
-                return RelianceExecutionCommand::Continue;
-
-            proccesedRules.insert(ruleTo);
-        }
-
+    auto relianceExecution = [&] (size_t ruleFrom, size_t ruleTo) {
         if (positiveIsTimeout(false))
         {
             result.timeout = true;
@@ -476,38 +474,25 @@ RelianceComputationResult computePositiveReliances(const std::vector<Rule> &rule
     {
         for (size_t ruleFrom = 0; ruleFrom < rules.size(); ++ruleFrom)
         {
-            std::unordered_set<size_t> proccesedRules;
-
-            for (const Literal &currentLiteral : rules[ruleFrom].getHeads())
+            for (size_t ruleTo : bodyToIndex.getCandidates(rules[ruleFrom].getHeads()))
             {
-                PredId_t currentPredicate = currentLiteral.getPredicate().getId();
-                auto toIterator = bodyToMap.find(currentPredicate);
-
-                if (toIterator == bodyToMap.end())
-                    continue;
-                
-                for (size_t ruleTo : toIterator->second)
+                switch (relianceExecution(ruleFrom, ruleTo))
                 {
-                    switch (relianceExecution(ruleFrom, ruleTo, proccesedRules))
-                    {
-                        case RelianceExecutionCommand::Return:
-                            return result;
-                        case RelianceExecutionCommand::Continue:
-                            continue;
-                    }
+                    case RelianceExecutionCommand::Return:
+                        return result;
+                    case RelianceExecutionCommand::Continue:
+                        continue;
                 }
             }
         }
     }
     else
     {
-        std::unordered_set<size_t> proccesedRules;
-
         for (size_t ruleFrom = 0; ruleFrom < rules.size(); ++ruleFrom)
         {
             for (size_t ruleTo = 0; ruleTo < rules.size(); ++ruleTo)
             {
-                switch (relianceExecution(ruleFrom, ruleTo, proccesedRules))
+                switch (relianceExecution(ruleFrom, ruleTo))
                 {
                     case RelianceExecutionCommand::Return:
                         return result;
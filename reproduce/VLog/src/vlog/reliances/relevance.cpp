@@ -0,0 +1,220 @@
+#include "vlog/reliances/reliances.h"
+
+#include <vector>
+#include <chrono>
+
+// Rules whose head predicate may be needed by the query, found by following
+// the predicates of the bodies backwards.
+static std::vector<bool> predicateReachable(const std::vector<Rule> &rules, PredicateRuleIndex &headIndex,
+    const Literal &query)
+{
+    std::vector<bool> reachable(rules.size(), false);
+    std::vector<size_t> queue;
+
+    std::vector<Literal> queryLiterals = { query };
+    for (size_t ruleIndex : headIndex.getCandidates(queryLiterals))
+    {
+        reachable[ruleIndex] = true;
+        queue.push_back(ruleIndex);
+    }
+
+    while (!queue.empty())
+    {
+        size_t ruleTo = queue.back();
+        queue.pop_back();
+
+        for (size_t ruleFrom : headIndex.getCandidates(rules[ruleTo].getBody()))
+        {
+            if (!reachable[ruleFrom])
+            {
+                reachable[ruleFrom] = true;
+                queue.push_back(ruleFrom);
+            }
+        }
+    }
+
+    return reachable;
+}
+
+RelevanceResult computeRelevantRules(const std::vector<Rule> &rules, const Literal &query, unsigned timeoutMilliSeconds)
+{
+    std::chrono::system_clock::time_point timepointStart = std::chrono::system_clock::now();
+    RelevanceResult result;
+
+    PredicateRuleIndex headIndex(rules.size());
+    PredId_t highestPredicate = query.getPredicate().getId();
+    for (size_t ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex)
+    {
+        for (const Literal &currentLiteral : rules[ruleIndex].getHeads())
+        {
+            headIndex.addRule(currentLiteral.getPredicate().getId(), ruleIndex);
+            highestPredicate = std::max(highestPredicate, currentLiteral.getPredicate().getId());
+        }
+
+        for (const Literal &currentLiteral : rules[ruleIndex].getBody())
+        {
+            highestPredicate = std::max(highestPredicate, currentLiteral.getPredicate().getId());
+        }
+    }
+
+    std::vector<bool> reachable = predicateReachable(rules, headIndex, query);
+
+    // The positive reliances follow the restricted chase, while the
+    // existential rules are answered with Skolem terms
+    bool sliceable = true;
+    for (size_t ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex)
+    {
+        if (reachable[ruleIndex])
+        {
+            ++result.numberOfReachableRules;
+
+            if (rules[ruleIndex].isExistential())
+                sliceable = false;
+        }
+    }
+
+    std::vector<bool> relevant(rules.size(), false);
+
+    if (sliceable)
+    {
+        // Only the reachable rules are prepared for the reliance checks,
+        // the query being the last one
+        std::vector<size_t> preparedIndex(rules.size() + 1, 0);
+        std::vector<Rule> markedRules;
+        std::vector<unsigned> variableCounts;
+        markedRules.reserve(result.numberOfReachableRules + 1);
+        variableCounts.reserve(result.numberOfReachableRules + 1);
+
+        auto prepareRule = [&](size_t ruleIndex, const Rule &rule)
+        {
+            preparedIndex[ruleIndex] = markedRules.size();
+            variableCounts.push_back(std::max(highestLiteralsId(rule.getHeads()), highestLiteralsId(rule.getBody())) + 1);
+            markedRules.push_back(markExistentialVariables(rule));
+        };
+
+        for (size_t ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex)
+        {
+            if (reachable[ruleIndex])
+                prepareRule(ruleIndex, rules[ruleIndex]);
+        }
+
+        // The query is the body of a rule with a fresh head predicate, so that
+        // its head is never satisfied. The relevant rules are the ancestors of
+        // this rule in the positive reliance graph.
+        Predicate queryHeadPredicate(highestPredicate + 1, 0, IDB, query.getTupleSize());
+        std::vector<Literal> queryHeads = { Literal(queryHeadPredicate, query.getTuple()) };
+        std::vector<Literal> queryBody = { Literal(query.getPredicate(), query.getTuple()) };
+        prepareRule(rules.size(), Rule((uint32_t)rules.size(), queryHeads, queryBody));
+
+        positiveStartTimeout(timeoutMilliSeconds);
+
+        std::vector<size_t> queue = { rules.size() };
+        while (!queue.empty() && !result.timeout)
+        {
+            size_t ruleTo = queue.back();
+            queue.pop_back();
+
+            const Rule &markedTo = markedRules[preparedIndex[ruleTo]];
+            unsigned variableCountTo = variableCounts[preparedIndex[ruleTo]];
+            for (size_t ruleFrom : headIndex.getCandidates(markedTo.getBody()))
+            {
+                if (relevant[ruleFrom])
+                    continue;
+
+                if (positiveIsTimeout(false))
+                {
+                    result.timeout = true;
+                    break;
+                }
+
+                ++result.numberOfCalls;
+                if (positiveReliance(markedRules[preparedIndex[ruleFrom]], variableCounts[preparedIndex[ruleFrom]],
+                    markedTo, variableCountTo, RelianceStrategy::Full))
+                {
+                    relevant[ruleFrom] = true;
+                    queue.push_back(ruleFrom);
+                }
+            }
+
+            // A negated atom needs all the facts of its predicate
+            for (const Literal &currentLiteral : markedTo.getBody())
+            {
+                if (!currentLiteral.isNegated())
+                    continue;
+
+                std::vector<bool> negatedReachable = predicateReachable(rules, headIndex, currentLiteral);
+                for (size_t ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex)
+                {
+                    if (negatedReachable[ruleIndex] && !relevant[ruleIndex])
+                    {
+                        relevant[ruleIndex] = true;
+                        queue.push_back(ruleIndex);
+                    }
+                }
+            }
+        }
+    }
+
+    // Without the reliances, every rule that may reach the query is kept
+    bool useReliances = sliceable && !result.timeout;
+    for (size_t ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex)
+    {
+        if (useReliances ? relevant[ruleIndex] : reachable[ruleIndex])
+            result.rules.push_back(ruleIndex);
+    }
+
+    result.timeMilliSeconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - timepointStart).count();
+    return result;
+}
+
+RelevanceFeatures computeRelevanceFeatures(const std::vector<Rule> &rules, const Literal &query, unsigned timeoutMilliSeconds)
+{
+    std::chrono::system_clock::time_point timepointStart = std::chrono::system_clock::now();
+    RelevanceFeatures result;
+
+    RelevanceResult relevance = computeRelevantRules(rules, query, timeoutMilliSeconds);
+    result.timeout = relevance.timeout;
+
+    std::vector<Rule> relevantRules;
+    relevantRules.reserve(relevance.rules.size());
+    bool existential = false;
+    for (size_t ruleIndex : relevance.rules)
+    {
+        relevantRules.push_back(rules[ruleIndex]);
+        existential |= rules[ruleIndex].isExistential();
+    }
+    result.numberOfRelevantRules = relevantRules.size();
+
+    RelianceComputationResult positiveResult = computePositiveReliances(relevantRules, RelianceStrategy::Full, timeoutMilliSeconds);
+    result.timeout |= positiveResult.timeout;
+
+    RelianceGroupResult groups = computeRelianceGroups(positiveResult.graphs.first, positiveResult.graphs.second);
+    for (const std::vector<unsigned> &group : groups.groups)
+    {
+        if (group.size() == 1 && !positiveResult.graphs.first.containsEdge(group[0], group[0]))
+            continue;
+
+        result.numberOfRecursiveRules += group.size();
+
+        for (unsigned ruleIndex : group)
+        {
+            if (relevantRules[ruleIndex].isExistential())
+                result.existentialRecursion = true;
+        }
+    }
+
+    // Without existential variables no rule restrains another
+    if (existential)
+    {
+        RelianceComputationResult restraintResult = computeRestrainReliances(relevantRules, RelianceStrategy::Full, timeoutMilliSeconds);
+        result.timeout |= restraintResult.timeout;
+
+        for (const std::vector<size_t> &successors : restraintResult.graphs.first.edges)
+        {
+            result.numberOfRestraints += successors.size();
+        }
+    }
+
+    result.timeMilliSeconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - timepointStart).count();
+    return result;
+}
@@ -13,6 +13,13 @@ unsigned globalRestraintTimeout = 0;
 unsigned globalRestraintTimeoutCheckCount = 0;
 bool globalRestraintIsTimeout = false;
 
+void restrainStartTimeout(unsigned timeoutMilliSeconds)
+{
+    globalRestraintTimepointStart = std::chrono::system_clock::now();
+    globalRestraintTimeout = timeoutMilliSeconds;
+    globalRestraintIsTimeout = false;
+}
+
 bool restrainIsTimeout(bool rare)
 {
     if (globalRestraintTimeout == 0)
@@ -713,7 +720,7 @@ RelianceComputationResult computeRestrainReliances(const std::vector<Rule> &rule
         ruleHashInfos.push_back(ruleHashInfoFirst(currentRule));
     }
 
-    std::unordered_map<PredId_t, std::vector<size_t>> headToMap;
+    PredicateRuleIndex headToIndex(rules.size());
     std::unordered_map<std::string, bool> resultCache;
 
     for (size_t ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex)
@@ -734,15 +741,13 @@ RelianceComputationResult computeRestrainReliances(const std::vector<Rule> &rule
                 }
             }
 
-            std::vector<size_t> &headToVector = headToMap[currentLiteral.getPredicate().getId()];
             if (containsExistentialVariable)
-                headToVector.push_back(ruleIndex);
+                headToIndex.addRule(currentLiteral.getPredicate().getId(), ruleIndex);
         }
     }
 
-    std::chrono::system_clock::time_point timepointStart = std::chrono::system_clock::now();
-    globalRestraintTimepointStart = timepointStart;
-    globalRestraintTimeout = timeoutMilliSeconds;
+    restrainStartTimeout(timeoutMilliSeconds);
+    std::chrono::system_clock::time_point timepointStart = globalRestraintTimepointStart;
 
     uint64_t numCalls = 0;
 
@@ -752,15 +757,7 @@ RelianceComputationResult computeRestrainReliances(const std::vector<Rule> &rule
         Return
     };
 
-    auto relianceExecution = [&] (size_t ruleFrom, size_t ruleTo, std::unordered_set<size_t> &proccesedRules) -> RelianceExecutionCommand {
-        if ((strat & RelianceStrategy::CutPairs) > 0)
-        {
-            if (proccesedRules.find(ruleTo) != proccesedRules.end())
-                return RelianceExecutionCommand::Continue;
-
-            proccesedRules.insert(ruleTo);
-        }
-
+    auto relianceExecution = [&] (size_t ruleFrom, size_t ruleTo) -> RelianceExecutionCommand {
         if (restrainIsTimeout(false))
         {
             result.timeout = true;
@@ -848,38 +845,25 @@ RelianceComputationResult computeRestrainReliances(const std::vector<Rule> &rule
     {
         for (size_t ruleFrom = 0; ruleFrom < rules.size(); ++ruleFrom)
         {
-            std::unordered_set<size_t> proccesedRules;
-
-            for (const Literal &currentLiteral : rules[ruleFrom].getHeads())
+            for (size_t ruleTo : headToIndex.getCandidates(rules[ruleFrom].getHeads()))
             {
-                PredId_t currentPredicate = currentLiteral.getPredicate().getId();
-                auto toIterator = headToMap.find(currentPredicate);
-
-                if (toIterator == headToMap.end())
-                    continue;
-                
-                for (size_t ruleTo : toIterator->second)
+                switch (relianceExecution(ruleFrom, ruleTo))
                 {
-                    switch (relianceExecution(ruleFrom, ruleTo, proccesedRules))
-                    {
-                        case RelianceExecutionCommand::Return:
-                            return result;
-                        case RelianceExecutionCommand::Continue:
-                            continue;
-                    }
+                    case RelianceExecutionCommand::Return:
+                        return result;
+                    case RelianceExecutionCommand::Continue:
+                        continue;
                 }
             }
         }
     }
     else
     {
-        std::unordered_set<size_t> proccesedRules;
-
         for (size_t ruleFrom = 0; ruleFrom < rules.size(); ++ruleFrom)
         {
             for (size_t ruleTo = 0; ruleTo < rules.size(); ++ruleTo)
             {
-                switch (relianceExecution(ruleFrom, ruleTo, proccesedRules))
+                switch (relianceExecution(ruleFrom, ruleTo))
                 {
                     case RelianceExecutionCommand::Return:
                         return result;
@@ -23,15 +23,20 @@
 #include <fstream>
 #include <chrono>
 #include <thread>
-#include <regex>
+#include <algorithm>
 
 WebInterface::WebInterface(
         ProgramArgs &vm, std::shared_ptr<SemiNaiver> sn, std::string htmlfiles,
         std::string cmdArgs, std::string edbfile) : vm(vm), sn(sn),
     dirhtmlfiles(htmlfiles), cmdArgs(cmdArgs),
-    isActive(false),
+    nActive(0),
     edbFile(edbfile),
-    nthreads(1) {
+    nthreads(std::max(1, vm["webThreads"].as<int>())) {
+        const int cacheMB = vm["queryCacheMB"].as<int>();
+        if (cacheMB > 0) {
+            queryCache = std::shared_ptr<QueryCache>(new QueryCache(
+                        (size_t) cacheMB << 20));
+        }
         //Setup the EDB layer
         EDBConf conf(edbFile, true);
         edb = std::unique_ptr<EDBLayer>(new EDBLayer(conf, false));
@@ -39,6 +44,101 @@ WebInterface::WebInterface(
         setupTridentLayer();
     }
 
+void WebStateLock::lockShared() {
+    std::unique_lock<std::mutex> lck(mutex);
+    while (writer || waitingWriters > 0) {
+        cv.wait(lck);
+    }
+    readers++;
+}
+
+void WebStateLock::unlockShared() {
+    std::unique_lock<std::mutex> lck(mutex);
+    readers--;
+    if (readers == 0) {
+        cv.notify_all();
+    }
+}
+
+void WebStateLock::lock() {
+    std::unique_lock<std::mutex> lck(mutex);
+    waitingWriters++;
+    while (writer || readers > 0) {
+        cv.wait(lck);
+    }
+    waitingWriters--;
+    writer = true;
+}
+
+void WebStateLock::unlock() {
+    std::unique_lock<std::mutex> lck(mutex);
+    writer = false;
+    cv.notify_all();
+}
+
+//Releases the lock also when the request throws an exception
+class WebStateGuard {
+    private:
+        WebStateLock &lock;
+        const bool exclusive;
+
+    public:
+        WebStateGuard(WebStateLock &lock, bool exclusive) : lock(lock),
+        exclusive(exclusive) {
+            if (exclusive) {
+                lock.lock();
+            } else {
+                lock.lockShared();
+            }
+        }
+
+        ~WebStateGuard() {
+            if (exclusive) {
+                lock.unlock();
+            } else {
+                lock.unlockShared();
+            }
+        }
+};
+
+void WebRequestStats::add(const std::string &endpoint, const double ms) {
+    std::lock_guard<std::mutex> guard(mutex);
+    Endpoint &e = endpoints[endpoint];
+    if (e.samples.size() < WEB_LATENCY_SAMPLES) {
+        e.samples.push_back(ms);
+    } else {
+        e.samples[e.count % WEB_LATENCY_SAMPLES] = ms;
+    }
+    if (e.count == 0 || ms > e.maxMs) {
+        e.maxMs = ms;
+    }
+    e.count++;
+}
+
+static double _percentile(std::vector<double> &samples, const int perc) {
+    size_t idx = samples.size() * perc / 100;
+    if (idx >= samples.size()) {
+        idx = samples.size() - 1;
+    }
+    std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+    return samples[idx];
+}
+
+void WebRequestStats::toJSON(JSON &out) {
+    std::lock_guard<std::mutex> guard(mutex);
+    for (const auto &el : endpoints) {
+        JSON entry;
+        std::vector<double> samples = el.second.samples;
+        entry.put("endpoint", el.first);
+        entry.put("count", (unsigned long) el.second.count);
+        entry.put("p50", _percentile(samples, 50));
+        entry.put("p90", _percentile(samples, 90));
+        entry.put("p99", _percentile(samples, 99));
+        entry.put("max", el.second.maxMs);
+        out.push_back(entry);
+    }
+}
+
 void WebInterface::setupTridentLayer() {
     tridentlayer = std::unique_ptr<TridentLayer>();
     if (edb) {
@@ -55,6 +155,38 @@ void WebInterface::setupTridentLayer() {
     }
 }
 
+void WebInterface::addQueryCacheStats(JSON &pt) {
+    if (queryCache) {
+        pt.put("querycachehits", (unsigned long) queryCache->getNHits());
+        pt.put("querycachemisses", (unsigned long) queryCache->getNMisses());
+        pt.put("querycacheentries", (unsigned long) queryCache->getNEntries());
+        pt.put("querycachebytes", (unsigned long) queryCache->getBytes());
+    }
+}
+
+std::unique_ptr<VLogLayer> WebInterface::getVLogLayer() {
+    {
+        std::lock_guard<std::mutex> guard(vloglayersMutex);
+        if (!vloglayers.empty()) {
+            std::unique_ptr<VLogLayer> layer = std::move(vloglayers.back());
+            vloglayers.pop_back();
+            return layer;
+        }
+    }
+    //The layer may add its predicates to the program
+    std::lock_guard<std::mutex> guard(programMutex);
+    std::unique_ptr<VLogLayer> layer(new VLogLayer(*edb.get(),
+                *program.get(), vm["reasoningThreshold"].as<int64_t>(),
+                "TI", "TE"));
+    layer->getReasoner().setQueryCache(queryCache);
+    return layer;
+}
+
+void WebInterface::releaseVLogLayer(std::unique_ptr<VLogLayer> layer) {
+    std::lock_guard<std::mutex> guard(vloglayersMutex);
+    vloglayers.push_back(std::move(layer));
+}
+
 void WebInterface::processMaterialization() {
     std::unique_lock<std::mutex> lck(mtxMatRunner);
     while (true) {
@@ -83,7 +215,7 @@ void WebInterface::start(int port) {
 
 void WebInterface::stop() {
     LOG(INFOL) << "Stopping server ...";
-    while (isActive) {
+    while (nActive > 0) {
         std::this_thread::sleep_for(chrono::milliseconds(100));
     }
     LOG(INFOL) << "Done";
@@ -95,6 +227,30 @@ long WebInterface::getDurationExecMs() {
     return std::chrono::duration_cast<std::chrono::milliseconds>(sec).count();
 }
 
+//Decodes a value of a form: '+' is a space, %XX the character XX, and the
+//line breaks are "\n"
+static std::string _decodeFormValue(const std::string &value) {
+    std::string out;
+    out.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        char c = value[i];
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%' && i + 2 < value.size() &&
+                isxdigit((unsigned char) value[i + 1]) &&
+                isxdigit((unsigned char) value[i + 2])) {
+            c = (char) std::stoi(value.substr(i + 1, 2), NULL, 16);
+            i += 2;
+        }
+        if (c == '\n' && !out.empty() && out.back() == '\r') {
+            out.back() = '\n';
+        } else {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
 static std::string _getValueParam(std::string req, std::string param) {
     int pos = req.find(param);
     if (pos == std::string::npos) {
@@ -126,7 +282,9 @@ void WebInterface::getResultsQueryLiteral(std::string predicate, long limit, JSO
     long nshownresults = 0;
     JSON data;
     if (program != NULL && sn != NULL) {
+        std::unique_lock<std::mutex> lck(programMutex);
         Predicate pred = program->getPredicate(predicate);
+        lck.unlock();
         nresults = sn->getSizeTable(pred.getId());
         auto itr = sn->getTable(pred.getId());
         while (!itr.isEmpty() && (limit == -1 || nshownresults < limit)) {
@@ -157,6 +315,38 @@ void WebInterface::getResultsQueryLiteral(std::string predicate, long limit, JSO
 
 void WebInterface::processRequest(std::string req, std::string &resp) {
     setActive();
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+
+    //The endpoint of the request, for the latencies
+    std::string endpoint;
+    size_t posMethod = req.find(' ');
+    size_t posPath = req.find(' ', posMethod + 1);
+    if (posMethod != std::string::npos && posPath != std::string::npos) {
+        endpoint = req.substr(0, posMethod + 1) +
+            req.substr(posMethod + 1, posPath - posMethod - 1);
+    }
+    //The pages are counted together
+    if (Utils::starts_with(endpoint, "GET ") && endpoint.find('.') != std::string::npos) {
+        endpoint = "GET page";
+    }
+
+    //Only /setup and /launchMat change the program or the materialization,
+    //the other requests run concurrently
+    const bool exclusive = endpoint == "POST /setup" ||
+        endpoint == "GET /launchMat";
+    {
+        WebStateGuard guard(stateLock, exclusive);
+        handleRequest(req, resp);
+    }
+
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    if (endpoint != "") {
+        requestStats.add(endpoint, sec.count() * 1000);
+    }
+    setInactive();
+}
+
+void WebInterface::handleRequest(std::string req, std::string &resp) {
     //Get the page
     std::string page;
     bool isjson = false;
@@ -171,18 +361,7 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
             std::string printresults = _getValueParam(form, "print");
             std::string sparqlquery = _getValueParam(form, "query");
             //Decode the query
-            sparqlquery = HttpClient::unescape(sparqlquery);
-            std::regex e1("\\+");
-            std::string replacedString;
-            std::regex_replace(std::back_inserter(replacedString),
-                    sparqlquery.begin(), sparqlquery.end(),
-                    e1, "$1 ");
-            sparqlquery = replacedString;
-            std::regex e2("\\r\\n");
-            replacedString = "";
-            std::regex_replace(std::back_inserter(replacedString),
-                    sparqlquery.begin(), sparqlquery.end(), e2, "$1\n");
-            sparqlquery = replacedString;
+            sparqlquery = _decodeFormValue(sparqlquery);
 
             //Execute the SPARQL query
             JSON pt;
@@ -192,6 +371,7 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
             bool jsonoutput = printresults == std::string("true");
             if (program) {
                 LOG(INFOL) << "Answering the SPARQL query with VLog ...";
+                std::unique_ptr<VLogLayer> vloglayer = getVLogLayer();
                 VLogUtils::execSPARQLQuery(sparqlquery,
                         false,
                         edb->getNTerms(),
@@ -201,8 +381,10 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
                         &vars,
                         &bindings,
                         &stats);
+                releaseVLogLayer(std::move(vloglayer));
             } else {
                 LOG(INFOL) << "Answering the SPARQL query with Trident ...";
+                std::lock_guard<std::mutex> guard(tridentlayerMutex);
                 VLogUtils::execSPARQLQuery(sparqlquery,
                         false,
                         edb->getNTerms(),
@@ -225,7 +407,9 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
             std::string form = req.substr(req.find("application/x-www-form-urlencoded"));
             std::string id = _getValueParam(form, "id");
             //Lookup the value
+            std::unique_lock<std::mutex> lck(tridentlayerMutex);
             std::string value = lookup(id, *(tridentlayer.get()));
+            lck.unlock();
             JSON pt;
             pt.put("value", value);
             std::ostringstream buf;
@@ -256,33 +440,16 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
             std::string sauto = _getValueParam(form, "automat");
             int automatThreshold = 1000000; // microsecond timeout
 
-            srules = HttpClient::unescape(srules);
-            std::regex e1("\\+");
-            std::string replacedString;
-            std::regex_replace(std::back_inserter(replacedString),
-                    srules.begin(), srules.end(),
-                    e1, "$1 ");
-            srules = replacedString;
-            std::regex e2("\\r\\n");
-            replacedString = "";
-            std::regex_replace(std::back_inserter(replacedString),
-                    srules.begin(), srules.end(), e2, "$1\n");
-            srules = replacedString;
-
-            spremat = HttpClient::unescape(spremat);
-            replacedString = "";
-            std::regex_replace(std::back_inserter(replacedString),
-                    spremat.begin(), spremat.end(),
-                    e1, "$1 ");
-            spremat = replacedString;
-            replacedString = "";
-            std::regex_replace(std::back_inserter(replacedString),
-                    spremat.begin(), spremat.end(), e2, "$1\n");
-            spremat = replacedString;
+            srules = _decodeFormValue(srules);
+            spremat = _decodeFormValue(spremat);
 
             LOG(INFOL) << "Setting up the KB with the given rules ...";
 
             //Cleanup and install the EDB layer
+            vloglayers.clear();
+            if (queryCache) {
+                queryCache->clear();
+            }
             EDBConf conf(edbFile, true);
             edb = std::unique_ptr<EDBLayer>(new EDBLayer(conf, false));
             setupTridentLayer();
@@ -295,6 +462,8 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
                 page = s;
             } else {
                 program->sortRulesByIDBPredicates();
+                //The layers of the SPARQL queries are created on demand
+                releaseVLogLayer(getVLogLayer());
                 //Set up the ruleset and perform the pre-materialization if necessary
                 if (sauto != "") {
                     //Automatic prematerialization
@@ -361,6 +530,7 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
             }
             outrules = outrules.substr(0, outrules.size() - 1);
             pt.put("outputrules", outrules);
+            addQueryCacheStats(pt);
 
             std::ostringstream buf;
             JSON::write(buf, pt);
@@ -375,6 +545,7 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
             long ramperc = (((double)usedmem / totmem) * 100);
             pt.put("ramperc", to_string(ramperc));
             pt.put("usedmem", to_string(usedmem));
+            addQueryCacheStats(pt);
 
             std::ostringstream buf;
             JSON::write(buf, pt);
@@ -473,6 +644,10 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
                             multithreaded ? vm["nthreads"].as<int>() : -1,
                             multithreaded ? vm["interRuleThreads"].as<int>() : 0,
                             vm["shufflerules"].as<bool>());
+                    //The facts of the IDB predicates change
+                    if (queryCache) {
+                        queryCache->clear();
+                    }
                     cvMatRunner.notify_one(); //start the computation
                     page = getPage("/mat/infobox.html");
                 } else {
@@ -484,6 +659,14 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
                 page = "You first need to load the rules!";
             }
 
+        } else if (path == "/requeststats") {
+            JSON pt;
+            requestStats.toJSON(pt);
+            std::ostringstream buf;
+            JSON::write(buf, pt);
+            page = buf.str();
+            isjson = true;
+
         } else if (path == "/sizeidbs") {
             JSON pt;
             std::vector<std::pair<string, std::vector<StatsSizeIDB>>> sizeIDBs = getSemiNaiver()->getSizeIDBs();
@@ -529,7 +712,6 @@ void WebInterface::processRequest(std::string req, std::string &resp) {
     } else {
         resp = "HTTP/1.1 " + code + "\r\nContent-Length: " + to_string(page.size()) + "\r\n\r\n" + page;
     }
-    setInactive();
 }
 
 std::string WebInterface::getDefaultPage() {
@@ -537,6 +719,7 @@ std::string WebInterface::getDefaultPage() {
 }
 
 std::string WebInterface::getPage(std::string f) {
+    std::lock_guard<std::mutex> guard(cachehtmlMutex);
     if (cachehtml.count(f)) {
         return cachehtml.find(f)->second;
     }
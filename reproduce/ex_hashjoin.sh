@@ -0,0 +1,31 @@
+mkdir -p Results
+mkdir -p Results/hashjoin
+
+# Prints the runtime of the materialization and the number of derivations
+summary() {
+	runtime=$(grep -o "Runtime materialization = [0-9.]*" "$1" | awk '{print $4}')
+	derivations=$(grep -o "Total # derivations: [0-9]*" "$1" | awk '{print $4}')
+	echo "${runtime:-none} ${derivations:-none}"
+}
+
+printf "%-6s %-8s %14s %14s %14s\n" "size" "threads" "merge(ms)" "hash(ms)" "derivations"
+for size in ${@:-1 5 10}
+do
+	python3 ./VLog/examples/triejoin/generate.py $size Results/hashjoin/data_$size
+	for threads in 1 4
+	do
+		for hash in 0 1
+		do
+			./VLog/build/vlog mat -e Results/hashjoin/data_$size/edb.conf --rules ./VLog/examples/hashjoin/rules.dlog --trieJoin 0 --hashJoin $hash --multithreaded $([ $threads -gt 1 ] && echo 1 || echo 0) --nthreads $threads > "Results/hashjoin/lubm_$size.$threads.$hash.result" 2>&1
+		done
+		read merge mergeDerivations <<< "$(summary Results/hashjoin/lubm_$size.$threads.0.result)"
+		read hash hashDerivations <<< "$(summary Results/hashjoin/lubm_$size.$threads.1.result)"
+		if [ "$mergeDerivations" = "$hashDerivations" ]
+		then
+			derivations=$mergeDerivations
+		else
+			derivations="$mergeDerivations/$hashDerivations(DIFFERENT)"
+		fi
+		printf "%-6s %-8s %14s %14s %14s\n" $size $threads $merge $hash $derivations
+	done
+done
@@ -0,0 +1,26 @@
+mkdir -p Results
+mkdir -p Results/triejoin
+
+# Prints the runtime of the materialization and the number of derivations
+summary() {
+	runtime=$(grep -o "Runtime materialization = [0-9.]*" "$1" | awk '{print $4}')
+	derivations=$(grep -o "Total # derivations: [0-9]*" "$1" | awk '{print $4}')
+	echo "${runtime:-none} ${derivations:-none}"
+}
+
+printf "%-6s %14s %14s %14s\n" "size" "triejoin(ms)" "binary(ms)" "derivations"
+for size in ${@:-1 5 10}
+do
+	python3 ./VLog/examples/triejoin/generate.py $size Results/triejoin/data_$size
+	./VLog/build/vlog mat -e Results/triejoin/data_$size/edb.conf --rules ./VLog/examples/triejoin/rules.dlog --trieJoin 1 > "Results/triejoin/lubm_$size.triejoin.result" 2>&1
+	./VLog/build/vlog mat -e Results/triejoin/data_$size/edb.conf --rules ./VLog/examples/triejoin/rules.dlog --trieJoin 0 > "Results/triejoin/lubm_$size.binary.result" 2>&1
+	read triejoin triejoinDerivations <<< "$(summary Results/triejoin/lubm_$size.triejoin.result)"
+	read binary binaryDerivations <<< "$(summary Results/triejoin/lubm_$size.binary.result)"
+	if [ "$triejoinDerivations" = "$binaryDerivations" ]
+	then
+		derivations=$triejoinDerivations
+	else
+		derivations="$triejoinDerivations/$binaryDerivations(DIFFERENT)"
+	fi
+	printf "%-6s %14s %14s %14s\n" $size $triejoin $binary $derivations
+done
@@ -0,0 +1,20 @@
+mkdir -p Results
+mkdir -p Results/fuzz
+./VLog/build/vlog rel --test 1 --rule ./VLog/examples/reliances --strat 15
+./VLog/build/vlog rel --fuzz 1 --fuzzBudget ${1:-60} --rule Results/fuzz
+# The restricted chase must derive the same facts when it skips the checks of
+# the heads that are never satisfied
+for rules in ./VLog/examples/restrictedchase/*.dlog
+do
+	for skip in 0 1
+	do
+		./VLog/build/vlog mat -e ./VLog/examples/restrictedchase/edb.conf --rules $rules --skipFreshHeadChecks $skip --storemat_path Results/restrictedchase_$skip --storemat_format csv > /dev/null 2>&1
+	done
+	if diff -r Results/restrictedchase_0 Results/restrictedchase_1 > /dev/null
+	then
+		echo "restricted chase $(basename $rules): OK"
+	else
+		echo "restricted chase $(basename $rules): different materializations"
+	fi
+	rm -rf Results/restrictedchase_0 Results/restrictedchase_1
+done